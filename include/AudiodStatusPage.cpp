@@ -0,0 +1,250 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "AudiodStatusPage.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log.h"
+
+#ifdef AUDIOD_IPC_SERVER
+AudiodStatusWriter gAudiodStatus;
+#endif
+
+static const char cMagic[4] = { 'A', 'S', 'T', 'S' };
+
+template <size_t Size> static void copyName(char (&to)[Size], const char * from)
+{
+    strncpy(to, from ? from : "", Size - 1);
+    to[Size - 1] = 0;
+}
+
+/// Its magic is written last, & erased when audiod replaces the page
+static bool isPageReady(const AudiodStatusPage * page)
+{
+    bool ready = memcmp(page->mMagic, cMagic, sizeof(cMagic)) == 0;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return ready;
+}
+
+AudiodStatusReader::AudiodStatusReader() : mPage(0), mMappedSize(0)
+{
+    copyName(mName, AUDIOD_STATUS_PAGE_NAME);
+}
+
+bool AudiodStatusReader::open(const char * name)
+{
+    close();
+    copyName(mName, name);
+
+    int fd = shm_open(mName, O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    void * address = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size >= (off_t) sizeof(AudiodStatusPage))
+        address = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED)
+        return false;
+
+    // a newer audiod may have a bigger page: we only read what we know
+    const AudiodStatusPage * page = static_cast<const AudiodStatusPage *>(address);
+    if (!isPageReady(page) || page->mVersion != AudiodStatusPage::cVersion ||
+        page->mSize < sizeof(AudiodStatusPage))
+    {
+        munmap(address, info.st_size);
+        return false;
+    }
+    mPage = page;
+    mMappedSize = info.st_size;
+    return true;
+}
+
+void AudiodStatusReader::close()
+{
+    if (mPage)
+        munmap(const_cast<AudiodStatusPage *>(mPage), mMappedSize);
+    mPage = 0;
+    mMappedSize = 0;
+}
+
+bool AudiodStatusReader::read(AudiodStatus & status)
+{
+    if (mPage && !isPageReady(mPage))
+        close();    // replaced by a newer audiod
+    if (!mPage && !open(mName))
+        return false;
+    return mPage->mSeqlock.read(&status, &mPage->mStatus, sizeof(status));
+}
+
+bool AudiodStatusWriter::open(const char * name)
+{
+    close();
+
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        g_warning("AudiodStatusWriter::open: can't open '%s': %s", name, strerror(errno));
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        info.st_size = 0;
+        info.st_uid = (uid_t) -1;
+    }
+    // only trust a page we created ourselves: anyone else's is replaced unread
+    bool owned = info.st_uid == geteuid();
+
+    bool reuse = false;
+    if (owned && info.st_size == sizeof(AudiodStatusPage))
+    {
+        void * address = mmap(NULL, sizeof(AudiodStatusPage), PROT_READ | PROT_WRITE,
+                              MAP_SHARED, fd, 0);
+        if (address != MAP_FAILED)
+        {
+            mPage = static_cast<AudiodStatusPage *>(address);
+            reuse = isPageReady(mPage) && mPage->mVersion == AudiodStatusPage::cVersion &&
+                    mPage->mSize == sizeof(AudiodStatusPage);
+            if (!reuse)
+                close();
+        }
+    }
+    if (!reuse)
+    {
+        // incompatible page: tell its readers to reopen, & start a new one
+        if (owned && info.st_size >= (off_t) sizeof(cMagic))
+        {
+            void * address = mmap(NULL, sizeof(cMagic), PROT_READ | PROT_WRITE,
+                                  MAP_SHARED, fd, 0);
+            if (address != MAP_FAILED)
+            {
+                memset(address, 0, sizeof(cMagic));
+                munmap(address, sizeof(cMagic));
+            }
+        }
+        ::close(fd);
+        shm_unlink(name);
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd >= 0)
+            fchmod(fd, 0644);   // whatever our umask, clients must read it
+    }
+
+    if (reuse)
+    {
+        // readers may have it mapped: keep the sequence going up
+        mPage->mSeqlock.recover();
+        mPage->mSeqlock.writeBegin();
+        memset(&mPage->mStatus, 0, sizeof(mPage->mStatus));
+        mPage->mSeqlock.writeEnd();
+        g_message("AudiodStatusWriter::open: took over '%s' from pid %u", name,
+                  mPage->mWriterPid);
+    }
+    else
+    {
+        void * address = MAP_FAILED;
+        if (fd >= 0 && ftruncate(fd, sizeof(AudiodStatusPage)) == 0)
+            address = mmap(NULL, sizeof(AudiodStatusPage), PROT_READ | PROT_WRITE,
+                           MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED)
+        {
+            g_warning("AudiodStatusWriter::open: can't create '%s': %s", name,
+                      strerror(errno));
+            if (fd >= 0)
+                ::close(fd);
+            return false;
+        }
+        mPage = new (address) AudiodStatusPage;
+        mPage->mVersion = AudiodStatusPage::cVersion;
+        mPage->mSize = sizeof(AudiodStatusPage);
+        memset(&mPage->mStatus, 0, sizeof(mPage->mStatus));
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(mPage->mMagic, cMagic, sizeof(cMagic));
+    }
+    ::close(fd);
+    mPage->mWriterPid = getpid();
+    return true;
+}
+
+void AudiodStatusWriter::close()
+{
+    if (mPage)
+        munmap(mPage, sizeof(AudiodStatusPage));
+    mPage = 0;
+}
+
+void AudiodStatusWriter::setCategory(const char * category, const char * scenario,
+                                     int volume, int micGain, bool muted, bool active)
+{
+    if (!mPage)
+        return;
+    AudiodStatus & status = mPage->mStatus;
+    uint32_t index = 0;
+    while (index < status.mCategoryCount &&
+           strncmp(status.mCategories[index].mCategory, category,
+                   sizeof(status.mCategories[index].mCategory)) != 0)
+        index++;
+    if (!VERIFY(index < AudiodStatus::cMaxCategories))
+        return;
+
+    mPage->mSeqlock.writeBegin();
+    AudiodCategoryStatus & entry = status.mCategories[index];
+    copyName(entry.mCategory, category);
+    copyName(entry.mScenario, scenario);
+    entry.mVolume = volume;
+    entry.mMicGain = micGain;
+    entry.mMuted = muted;
+    if (active)
+        for (uint32_t i = 0; i < status.mCategoryCount; i++)
+            status.mCategories[i].mActive = false;
+    entry.mActive = active;
+    if (index == status.mCategoryCount)
+        status.mCategoryCount++;
+    mPage->mSeqlock.writeEnd();
+}
+
+void AudiodStatusWriter::setSink(int sink, const char * name, int volume, int activeStreams)
+{
+    if (!mPage || !VERIFY(sink >= 0 && sink < AudiodStatus::cMaxSinks))
+        return;
+    AudiodStatus & status = mPage->mStatus;
+    mPage->mSeqlock.writeBegin();
+    AudiodSinkStatus & entry = status.mSinks[sink];
+    copyName(entry.mName, name);
+    entry.mVolume = volume;
+    entry.mActiveStreams = activeStreams;
+    // sinks never seen yet stay unnamed
+    for (uint32_t i = status.mSinkCount; i < (uint32_t) sink; i++)
+        status.mSinks[i].mVolume = -1;
+    if ((uint32_t) sink >= status.mSinkCount)
+        status.mSinkCount = sink + 1;
+    mPage->mSeqlock.writeEnd();
+}
+
+void AudiodStatusWriter::setHeadsetState(int state)
+{
+    if (!mPage)
+        return;
+    mPage->mSeqlock.writeBegin();
+    mPage->mStatus.mHeadsetState = state;
+    mPage->mSeqlock.writeEnd();
+}
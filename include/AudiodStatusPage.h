@@ -0,0 +1,160 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef AUDIODSTATUSPAGE_H_
+#define AUDIODSTATUSPAGE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include "IPC_Seqlock.h"
+
+// where audiod publishes its status (POSIX shared memory name)
+#define AUDIOD_STATUS_PAGE_NAME "/audiod-status"
+
+/*
+ * Read-mostly state of audiod, published in a read-only shared memory page
+ * so that clients can read it without a Luna call to getStatus, getVolume or
+ * /state/sinkStatus. audiod updates the page when that state changes, under
+ * a seqlock: readers get a consistent copy without ever blocking audiod.
+ * The layout is fixed size & has no pointers. It only grows at the end:
+ * fields are never moved, & cVersion only changes when they are.
+ */
+struct AudiodCategoryStatus
+{
+    char        mCategory[32];  ///< "media", "phone"...
+    char        mScenario[32];  ///< current scenario, or "none"
+    int32_t     mVolume;        ///< of the current scenario, -1 if none
+    int32_t     mMicGain;       ///< of the current scenario, -1 if none
+    uint8_t     mMuted;
+    uint8_t     mActive;        ///< category of the current module
+    uint8_t     mReserved[2];
+};
+
+struct AudiodSinkStatus
+{
+    char        mName[32];      ///< virtual sink name
+    int32_t     mVolume;        ///< last programmed in Pulse, -1 if unknown
+    int32_t     mActiveStreams;
+};
+
+struct AudiodStatus
+{
+    enum { cMaxCategories = 16, cMaxSinks = 32 };
+
+    int32_t                 mHeadsetState;      ///< EHeadsetState
+    uint32_t                mCategoryCount;
+    uint32_t                mSinkCount;         ///< indexed by EVirtualSink
+    uint32_t                mReserved;
+    AudiodCategoryStatus    mCategories[cMaxCategories];
+    AudiodSinkStatus        mSinks[cMaxSinks];
+
+    /// Null if audiod has no such category or sink
+    const AudiodCategoryStatus *    findCategory(const char * category) const
+    {
+        for (uint32_t i = 0; i < mCategoryCount && i < cMaxCategories; i++)
+            if (strncmp(mCategories[i].mCategory, category, sizeof(mCategories[i].mCategory)) == 0)
+                return &mCategories[i];
+        return 0;
+    }
+    const AudiodSinkStatus *        findSink(const char * sink) const
+    {
+        for (uint32_t i = 0; i < mSinkCount && i < cMaxSinks; i++)
+            if (strncmp(mSinks[i].mName, sink, sizeof(mSinks[i].mName)) == 0)
+                return &mSinks[i];
+        return 0;
+    }
+};
+
+/// The shared memory page itself
+struct AudiodStatusPage
+{
+    static const uint32_t cVersion = 1;
+
+    char            mMagic[4];      ///< written last, when the page is ready
+    uint32_t        mVersion;
+    uint32_t        mSize;          ///< sizeof(AudiodStatusPage) for its writer
+    uint32_t        mWriterPid;
+    IPC_Seqlock     mSeqlock;       ///< guards mStatus
+    uint32_t        mReserved;
+    AudiodStatus    mStatus;
+};
+
+/*
+ * Client side: maps the page read-only. Not thread safe: use one reader
+ * per thread.
+ */
+class AudiodStatusReader
+{
+public:
+    AudiodStatusReader();
+    ~AudiodStatusReader()                   { close(); }
+
+    /// False if audiod didn't publish the page yet, or it's incompatible
+    bool            open(const char * name = AUDIOD_STATUS_PAGE_NAME);
+    void            close();
+    bool            isOpen() const          { return mPage != 0; }
+
+    /// Consistent copy of the status. Opens the page if needed, & reopens it
+    // if audiod replaced it. False if there is no usable page.
+    bool            read(AudiodStatus & status);
+
+    /// Grows with each update: read() again only when it changed
+    uint32_t        sequence() const        { return mPage ? mPage->mSeqlock.sequence() : 0; }
+
+private:
+    AudiodStatusReader(const AudiodStatusReader &);
+    AudiodStatusReader & operator=(const AudiodStatusReader &);
+
+    const AudiodStatusPage *    mPage;
+    size_t                      mMappedSize;
+    char                        mName[64];
+};
+
+/*
+ * audiod side: creates the page, or takes over the one left by a previous
+ * audiod, which readers may still have mapped. Setters do nothing until
+ * open() succeeded. Not thread safe: call from the main loop only.
+ */
+class AudiodStatusWriter
+{
+public:
+    AudiodStatusWriter() : mPage(0) {}
+    ~AudiodStatusWriter()                   { close(); }
+
+    bool            open(const char * name = AUDIOD_STATUS_PAGE_NAME);
+    /// Unmap. The page stays, with the last status, for the next audiod.
+    void            close();
+    bool            isOpen() const          { return mPage != 0; }
+
+    /// Add the category the first time. Only one category is active.
+    void            setCategory(const char * category, const char * scenario,
+                                int volume, int micGain, bool muted, bool active);
+    void            setSink(int sink, const char * name, int volume, int activeStreams);
+    void            setHeadsetState(int state);
+
+private:
+    AudiodStatusWriter(const AudiodStatusWriter &);
+    AudiodStatusWriter & operator=(const AudiodStatusWriter &);
+
+    AudiodStatusPage *  mPage;
+};
+
+#ifdef AUDIOD_IPC_SERVER
+extern AudiodStatusWriter gAudiodStatus;
+#endif
+
+#endif /* AUDIODSTATUSPAGE_H_ */
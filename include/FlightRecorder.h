@@ -0,0 +1,112 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#ifndef _FLIGHT_RECORDER_H_
+#define _FLIGHT_RECORDER_H_
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// where audiod dumps its flight recorder
+#define FLIGHT_RECORDER_PATH "/tmp/audiod-flightrecorder.bin"
+
+enum EFlightEvent
+{
+    eFlightEvent_None = 0,
+    eFlightEvent_MixerCommand,      // code: command, sink, value, 1 sent/0 skipped/-1 failed
+    eFlightEvent_PulseMessage,      // code: command, sink, info
+    eFlightEvent_PulseConnection,   // 1 connected/0 lost, connection attempt
+    eFlightEvent_State,             // tag: what changed, new value(s)
+    eFlightEvent_Module,            // tag: category of the module made current
+    eFlightEvent_Scenario,          // tag: scenario selected
+    eFlightEvent_LunaCall,          // tag: method, code 'b'egin or 'e'nd, duration (us) at the end
+    eFlightEvent_Stall,             // tag: handler, code 'w'atchdog/'e'nd of stall/'h'andler too long, ms
+
+    eFlightEvent_Count
+};
+
+/*
+ * Always-on recorder of the last significant events of the daemon, to tell
+ * what happened before a field issue, long after the logs rotated.
+ * Events are fixed size binary records in a ring: recording one is a clock
+ * read, an atomic increment & a few stores, from any thread, without locks.
+ * The oldest events are overwritten.
+ * The dump is the raw ring behind a small header, written with async-signal
+ * safe calls only, so that it can be taken from a signal handler, even when
+ * the main loop is stuck. decode() turns a dump into text, offline.
+ */
+class FlightRecorder
+{
+public:
+    /// capacity: number of events kept, rounded up to a power of 2
+    explicit FlightRecorder(size_t capacity);
+    ~FlightRecorder();
+
+    /// tag is truncated to cTagSize characters, unterminated if that long
+    void            record(EFlightEvent type, char code, int32_t a,
+                           int32_t b = 0, int32_t c = 0, const char * tag = NULL);
+
+    /// Number of events recorded since the start
+    uint64_t        recorded() const { return mNext.load(std::memory_order_relaxed); }
+
+    /// Write the ring in a file. Async-signal safe.
+    bool            dump(int fd) const;
+    bool            dump(const char * path) const;
+
+    /// Dump in a file when the process receives that signal
+    bool            dumpOnSignal(int signal, const char * path);
+
+    /// Decode a dump to text, one event per line, the oldest first
+    static bool     decode(const char * path, std::string & text);
+
+    static const size_t cTagSize = 16;
+
+private:
+    struct Event
+    {
+        std::atomic<uint64_t>   mSequence;  // index + 1 once written, 0 while written
+        uint64_t                mTime;      // monotonic, in ns
+        uint16_t                mType;
+        char                    mCode;
+        uint8_t                 mReserved;
+        int32_t                 mArgs[3];
+        char                    mTag[cTagSize];
+    };
+
+    struct Header
+    {
+        char        mMagic[4];
+        uint32_t    mVersion;
+        uint32_t    mEventSize;
+        uint32_t    mCapacity;
+        uint64_t    mNext;
+        uint64_t    mMonotonic;     // clocks at the time of the dump, in ns,
+        uint64_t    mRealtime;      // to date the events
+    };
+
+    static const uint32_t cVersion = 1;
+
+    Event *                 mEvents;
+    size_t                  mMask;
+    std::atomic<uint64_t>   mNext;
+};
+
+extern FlightRecorder gFlightRecorder;
+
+#endif // _FLIGHT_RECORDER_H_
@@ -0,0 +1,120 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef IPC_CHANGENOTIFIER_H_
+#define IPC_CHANGENOTIFIER_H_
+
+#include <atomic>
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Count of changes in shared memory, that processes can wait on with a futex.
+ * The writer bumps the count after each change & wakes up the waiters.
+ * Waiters remember the count they have seen: whatever changed meanwhile,
+ * however many times, they wake up once & find out what changed from the
+ * generation of each value.
+ * The lowest bit of the shared word tells that someone sleeps on it: the
+ * writer only makes the wake up system call then. So waiters write the word
+ * too, & need it mapped read write.
+ */
+class IPC_ChangeNotifier
+{
+public:
+    IPC_ChangeNotifier() : mWord(0) {}
+
+    /// Writer: something changed. Costs a system call only if someone waits.
+    void        notify()
+    {
+        uint32_t word = mWord.load(std::memory_order_relaxed);
+        while (!mWord.compare_exchange_weak(word, (word + cOneChange) & ~cWaiters,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed))
+            ;
+        // not private: the count is shared with other processes
+        if (word & cWaiters)
+            syscall(SYS_futex, &mWord, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+
+    /// Changes so far: what to wait from
+    uint32_t    changes() const     { return mWord.load(std::memory_order_acquire) >> 1; }
+
+    /// Wait until the count is no longer 'seen', for at most timeoutMs
+    /// (forever if negative). True if it changed.
+    bool        wait(uint32_t seen, int timeoutMs = -1)
+    {
+        struct timespec deadline = { 0, 0 };
+        if (timeoutMs >= 0)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec += timeoutMs / 1000;
+            deadline.tv_nsec += (timeoutMs % 1000) * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L)
+            {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+        }
+        for (;;)
+        {
+            uint32_t word = mWord.load(std::memory_order_acquire);
+            if ((word >> 1) != seen)
+                return true;
+            // tell the writer to wake us up, unless it changed meanwhile
+            if ((word & cWaiters) == 0 &&
+                !mWord.compare_exchange_weak(word, word | cWaiters, std::memory_order_relaxed))
+                continue;
+
+            // FUTEX_WAIT takes a relative timeout: what is left of it
+            struct timespec left;
+            if (timeoutMs >= 0)
+            {
+                struct timespec now;
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                left.tv_sec = deadline.tv_sec - now.tv_sec;
+                left.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+                if (left.tv_nsec < 0)
+                {
+                    left.tv_sec--;
+                    left.tv_nsec += 1000000000L;
+                }
+                if (left.tv_sec < 0)
+                    break;
+            }
+            if (syscall(SYS_futex, &mWord, FUTEX_WAIT, word | cWaiters,
+                        timeoutMs < 0 ? NULL : &left, NULL, 0) != 0 &&
+                errno != EAGAIN && errno != EINTR)
+                break;  // ETIMEDOUT
+        }
+        return changes() != seen;
+    }
+
+private:
+    IPC_ChangeNotifier(const IPC_ChangeNotifier &);
+    IPC_ChangeNotifier & operator=(const IPC_ChangeNotifier &);
+
+    static const uint32_t cWaiters = 1;     ///< someone sleeps on the word
+    static const uint32_t cOneChange = 2;   ///< the count is above it
+
+    std::atomic<uint32_t>   mWord;
+};
+
+#endif /* IPC_CHANGENOTIFIER_H_ */
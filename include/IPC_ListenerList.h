@@ -0,0 +1,216 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef IPC_LISTENERLIST_H_
+#define IPC_LISTENERLIST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include <type_traits>
+
+/*
+ * Handle on a listener in an IPC_ListenerList, to disconnect it.
+ * Must not be used once the list is gone.
+ */
+class IPC_ListenerConnection
+{
+public:
+    IPC_ListenerConnection() : mList(0), mControl(0), mSlot(0), mSerial(0) {}
+    IPC_ListenerConnection(void * list, bool (*control)(void *, unsigned, unsigned, bool),
+                           unsigned slot, unsigned serial) :
+                             mList(list), mControl(control), mSlot(slot), mSerial(serial) {}
+
+    /// Remove the listener. Can be called from a listener, even itself.
+    void        disconnect()
+    {
+        if (mList)
+            mControl(mList, mSlot, mSerial, true);
+        mList = 0;
+    }
+
+    bool        connected() const   { return mList && mControl(mList, mSlot, mSerial, false); }
+
+private:
+    void *      mList;
+    bool        (*mControl)(void * list, unsigned slot, unsigned serial, bool disconnect);
+    unsigned    mSlot;
+    unsigned    mSerial;
+};
+
+/*
+ * Up to Capacity listeners, called in place of a boost::signals2::signal:
+ * no allocation, no lock & no shared_ptr. Listeners are function pointers
+ * or small function objects (boost::bind of a method & its object...),
+ * copied in the list itself, so that it can live in shared memory.
+ * Each listener can give an interest mask: notify() only calls those
+ * interested in one of the bits given. Listeners may connect & disconnect
+ * while being called: new ones are called from the next notification on.
+ * connect(), empty() & operator() work like with signals2.
+ * Not thread safe, like the properties using it.
+ */
+template <class Signature, size_t Capacity> class IPC_ListenerList;
+
+template <class... Args, size_t Capacity> class IPC_ListenerList<void (Args...), Capacity>
+{
+public:
+    /// Enough for a method bound to its object, or a boost::function
+    enum { cStorageSize = 4 * sizeof(void *) };
+
+    static const uint64_t cAllInterests = ~uint64_t(0);
+
+    IPC_ListenerList() : mDispatching(0), mPendingChanges(false)
+    {
+        for (size_t i = 0; i < Capacity; i++)
+        {
+            mSlots[i].mCall = 0;
+            mSlots[i].mDestroy = 0;
+            mSlots[i].mSerial = 0;
+            mSlots[i].mNew = false;
+        }
+    }
+    ~IPC_ListenerList()                 { disconnect_all_slots(); cleanup(); }
+
+    /// Add a listener. The connection returned isn't connected if the list is full.
+    template <class Listener> IPC_ListenerConnection connect(const Listener & listener,
+                                                     uint64_t interests = cAllInterests)
+    {
+        static_assert(sizeof(Listener) <= cStorageSize,
+                      "listener too big to be stored in an IPC_ListenerList");
+        static_assert(alignof(Listener) <= alignof(TStorage),
+                      "listener too aligned to be stored in an IPC_ListenerList");
+        for (size_t i = 0; i < Capacity; i++)
+        {
+            Slot & slot = mSlots[i];
+            if (slot.mDestroy)
+                continue;   // in use, or disconnected during a notification
+            new (&slot.mStorage) Listener(listener);
+            slot.mCall = &call<Listener>;
+            slot.mDestroy = &destroy<Listener>;
+            slot.mInterests = interests;
+            slot.mNew = mDispatching > 0;
+            mPendingChanges |= slot.mNew;
+            return IPC_ListenerConnection(this, &control, i, ++slot.mSerial);
+        }
+        return IPC_ListenerConnection();
+    }
+
+    /// Call all the listeners
+    void        operator()(Args... args)  { notify(cAllInterests, args...); }
+
+    /// Call the listeners interested in one of these
+    void        notify(uint64_t interests, Args... args)
+    {
+        mDispatching++;
+        for (size_t i = 0; i < Capacity; i++)
+        {
+            Slot & slot = mSlots[i];
+            if (slot.mCall && !slot.mNew && (slot.mInterests & interests))
+                slot.mCall(&slot.mStorage, args...);
+        }
+        if (--mDispatching == 0 && mPendingChanges)
+            cleanup();
+    }
+
+    bool        empty() const               { return num_slots() == 0; }
+
+    size_t      num_slots() const
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < Capacity; i++)
+            if (mSlots[i].mCall)
+                count++;
+        return count;
+    }
+
+    void        disconnect_all_slots()
+    {
+        for (size_t i = 0; i < Capacity; i++)
+            disconnect(i);
+    }
+
+private:
+    IPC_ListenerList(const IPC_ListenerList &);
+    IPC_ListenerList & operator=(const IPC_ListenerList &);
+
+    typedef typename std::aligned_storage<cStorageSize, alignof(void *)>::type TStorage;
+
+    struct Slot
+    {
+        void        (*mCall)(void * storage, Args... args); ///< null when not connected
+        void        (*mDestroy)(void * storage);            ///< null when free
+        uint64_t    mInterests;
+        unsigned    mSerial;    ///< so that old connections don't disconnect a new listener
+        bool        mNew;       ///< connected during the current notification
+        TStorage    mStorage;
+    };
+
+    template <class Listener> static void call(void * storage, Args... args)
+    {
+        (*static_cast<Listener *>(storage))(args...);
+    }
+
+    template <class Listener> static void destroy(void * storage)
+    {
+        static_cast<Listener *>(storage)->~Listener();
+    }
+
+    static bool control(void * list, unsigned slot, unsigned serial, bool disconnect)
+    {
+        IPC_ListenerList * self = static_cast<IPC_ListenerList *>(list);
+        if (slot >= Capacity || self->mSlots[slot].mSerial != serial ||
+            self->mSlots[slot].mCall == 0)
+            return false;
+        if (disconnect)
+            self->disconnect(slot);
+        return true;
+    }
+
+    /// The listener may be running: it's only destroyed after the notification
+    void        disconnect(size_t index)
+    {
+        Slot & slot = mSlots[index];
+        slot.mCall = 0;
+        if (mDispatching > 0)
+            mPendingChanges = true;
+        else if (slot.mDestroy)
+        {
+            slot.mDestroy(&slot.mStorage);
+            slot.mDestroy = 0;
+        }
+    }
+
+    void        cleanup()
+    {
+        mPendingChanges = false;
+        for (size_t i = 0; i < Capacity; i++)
+        {
+            Slot & slot = mSlots[i];
+            slot.mNew = false;
+            if (slot.mCall == 0 && slot.mDestroy)
+            {
+                slot.mDestroy(&slot.mStorage);
+                slot.mDestroy = 0;
+            }
+        }
+    }
+
+    Slot        mSlots[Capacity];
+    int         mDispatching;
+    bool        mPendingChanges;
+};
+
+#endif /* IPC_LISTENERLIST_H_ */
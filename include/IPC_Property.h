@@ -21,10 +21,12 @@
 
 #include <vector>
 #include <string>
+#include <type_traits>
 
-#include <boost/signals2.hpp>
-#include <boost/signals2/signal.hpp>
-
+#include "IPC_ChangeNotifier.h"
+#include "IPC_ListenerList.h"
+#include "IPC_Seqlock.h"
+#include "IPC_Socket.h"
 #include "log.h"
 
 namespace boost {
@@ -77,9 +79,31 @@ enum EOperationRequest
     eOperationRequest_HandlesChangeNotifications, // sent by clients
                                                   //requesting change
                                                   // notification notices
-    eOperationRequest_ReportIncompatibleClient    // debug message
+    eOperationRequest_ReportIncompatibleClient,   // debug message
+
+    eOperationRequest_Transaction, // several operations at once, both directions
+    eOperationRequest_Changed,     // change notification, in transactions sent
+                                   // to clients
+    eOperationRequest_Interests    // sent by clients: properties they listen to
+                                   // & use. ID is the count of properties,
+                                   // followed by a bitmap of each.
+};
+
+/*
+ * Operation in a transaction message, followed by its value, if any.
+ * Entries start on 8 bytes boundaries in the message.
+ */
+struct IPC_TransactionEntry
+{
+    IPC_PropertyID  mID;
+    guint16         mOperation;
+    guint16         mSize;          ///< of the value that follows
+    guint16         mReserved;
 };
 
+/// Largest transaction sent in one message. Bigger ones are split.
+const size_t cMaxTransactionSize = 256;
+
 /*
  * Type independent base class of a property.
  * Holds type independent methods.
@@ -93,8 +117,10 @@ public:
         ePropertyFlag_None = 0,
 
         ePropertyFlag_UseLocalCopy = 1 << 0, ///< do not use the version in
-                                             // shared memory. Use for
-                                             // non-atomic values (> 32bits). Slower.
+                                             // shared memory: each change
+                                             // is sent to the slaves. Slower.
+                                             // Values > 32bits don't need
+                                             // it: they are read under a seqlock.
         ePropertyFlag_NotifyClientsEvenIfNoChange = 1 << 1, ///< requesting a
                                                   // change with the current
                                                   // value will always trigger
@@ -118,6 +144,10 @@ public:
 
     IPC_PropertyID            getID() const    { return mID; }
 
+    /// Bit of the property in transaction listeners' interests.
+    // Properties 64 apart share the same bit.
+    guint64                   getInterestMask() const    { return guint64(1) << (mID % 64); }
+
     void setFlag(EPropertyFlag flag)                { mPropertyFlags |= flag; }
     void clearFlag(EPropertyFlag flag)            { mPropertyFlags &= ~flag; }
     bool testFlag(EPropertyFlag flag) const { return (mPropertyFlags & flag) != 0; }
@@ -139,6 +169,18 @@ public:
     // register for notifications. INTERNAL USE ONLY!
     virtual        void        onConnectedClient()        {}
 
+    /// Server only: tell clients about a change made in a transaction.
+    // INTERNAL USE ONLY!
+    virtual        void        addTransactionEntry(std::vector<char> & entries) {}
+
+    /// Server only: the value clients keep a local copy of, if they are sent one.
+    // INTERNAL USE ONLY!
+    virtual        const void * getLocalCopyValue(ssize_t & size) const    { return 0; }
+
+    /// Does this process listen to the property's changes, or messages?
+    virtual        bool        hasChangeListeners() const     { return false; }
+    virtual        bool        hasMessageListeners() const    { return false; }
+
 protected:
     IPC_SharedProperties *    mSharedProperties;
     IPC_PropertyID            mID;
@@ -166,6 +208,10 @@ public:
     /// Server only: Notify clients that a property was changed
     virtual void    sendChangeNotification(IPC_PropertyID id) = 0;
 
+    /// Send the operations of a transaction in one message.
+    // The server only sends clients the changes they listen to.
+    virtual bool    sendTransaction(const void * entries, ssize_t size) = 0;
+
     /// Client only: Send an operation request on a property.
     // Can be a request to set the master from a slave,
     // or a request to set local copy from master to a slave.
@@ -188,7 +234,10 @@ public:
     /// do: SharedProperties * sharedProperties =
     // IPC_SharedProperties::createSharedProperties<SharedProperties>
     //("name of shared memory segment");
-    template <class SP> static SP * createSharedProperties(const std::string & name);
+    /// Links use controlled packets. Both sides may opt into
+    // eSocketPacketsSize_Sequenced, which caps messages to cSequencedMessageSize.
+    template <class SP> static SP * createSharedProperties(const std::string & name,
+                              ESocketPacketsSize packetsSizeMode = eSocketPacketsSize_Controlled);
 
     /// When appropriate (when master-slave communication is established
     // for instance), bind the local copy of the slave with the shared memory
@@ -209,6 +258,8 @@ public:
                         IPC_PropertyID id,
                         const void * value, ssize_t size)
     {
+        if (isTransactionRequest(operation))
+            return addTransactionEntry(mTransactionRequests, operation, id, value, size);
         if (mLink)
             return mLink->sendRequest(operation, id, value, size);
         return false;
@@ -226,6 +277,8 @@ public:
     // or a request to set local copy from master to a slave.
     bool    sendRequest(EOperationRequest operation, IPC_PropertyID id)
     {
+        if (isTransactionRequest(operation))
+            return addTransactionEntry(mTransactionRequests, operation, id, 0, 0);
         if (mLink)
             return mLink->sendRequest(operation, id);
         return false;
@@ -272,6 +325,88 @@ public:
 
     size_t    getPropertyCount() const    { return mProperties.size(); }
 
+    /// Server only: value of a property that clients keep a local copy of, or 0
+    const void *    getLocalCopyValue(IPC_PropertyID id, ssize_t & size) const
+    {
+        if (VERIFY(id < mProperties.size()))
+            return mProperties[id]->getLocalCopyValue(size);
+        return 0;
+    }
+
+    /// Count of value changes in shared memory. Clients can wait for it to
+    // move with waitForChanges(), then compare the generation of the
+    // properties they follow, instead of getting change notifications.
+    guint32   getChangeCount() const
+                                { return mChangeNotifier ? mChangeNotifier->changes() : 0; }
+
+    /// Client only: wait until the change count is no longer 'seen'.
+    // Many changes wake up once. Use a timeout to notice a lost server.
+    bool      waitForChanges(guint32 seen, int timeoutMs = -1) const
+                        { return mChangeNotifier && mChangeNotifier->wait(seen, timeoutMs); }
+
+    /// Shared memory of the change count of the properties 'name'
+    static std::string  changesName(const std::string & name)   { return name + ".changes"; }
+
+    /// Server only: a value changed in shared memory
+    void      valueChanged()
+                        { if (mChangeNotifier) mChangeNotifier->notify(); }
+
+    /// Group operations: on the server, the values changed are published
+    // together, then clients & listeners are notified once. On a client,
+    // the requests go to the server in one message.
+    // Can be nested. Prefer IPC_Transaction.
+    void      beginTransaction();
+    void      endTransaction();
+    bool      isInTransaction() const     { return mTransactionDepth > 0; }
+
+    /// Client only: read several values as published by the same
+    // transaction. reader() is called again if one was published meanwhile,
+    // so it must only copy values. False if they couldn't be read whole.
+    template <class Reader> bool readTransaction(Reader reader) const
+                        { return mSharedProperties->mTransactionSeqlock.read(reader); }
+
+    typedef IPC_ListenerList<void (const IPC_PropertyID *, size_t), 4> TTransactionSignal;
+
+    /// Be notified once per transaction, with the properties it changed
+    // (on clients: those this process listens to), after their listeners.
+    // interests: getInterestMask() of the properties to be notified for.
+    template <class Listener> IPC_ListenerConnection sendTransactions(const Listener & listener,
+                                    guint64 interests = TTransactionSignal::cAllInterests)
+    {
+        IPC_ListenerConnection connection = mTransactionSignal.connect(listener, interests);
+        if (!connection.connected())
+            FAILURE("IPC_SharedProperties::sendTransactions: too many listeners");
+        return connection;
+    }
+
+    /// A property changed in the current transaction. INTERNAL USE ONLY!
+    void      addTransactionChange(IPC_PropertyID id);
+
+    /// Client only: the properties this process uses. The server only sends
+    // it their values & messages, & the changes of those it listens to.
+    // Local copies of the others aren't kept up to date. Properties with
+    // listeners are always included. By default, every property is.
+    // Can be changed at any time, including from the constructor of the
+    // shared properties, so that the server knows from the connection on.
+    void      setInterests(const IPC_PropertyID * ids, size_t count);
+    void      setInterestedInAll();
+
+    /// Client only: a listener was added to a property. INTERNAL USE ONLY!
+    void      addInterest(IPC_PropertyID id);
+
+    /// Client only: tell the server what we use, when connected.
+    // INTERNAL USE ONLY!
+    bool      sendInterests();
+
+    /// Append an operation to transaction entries. If they would get too
+    // big for one message, the entries so far are sent first.
+    // INTERNAL USE ONLY!
+    bool      addTransactionEntry(std::vector<char> & entries, EOperationRequest operation,
+                                  IPC_PropertyID id, const void * value, ssize_t size);
+
+    /// A transaction message was received. INTERNAL USE ONLY!
+    void      transactionReceived(const void * entries, ssize_t size);
+
     bool    isServer() const            { return mIsPropertyServer; }
 
 protected:
@@ -290,36 +425,102 @@ protected:
     size_t                                        mSharedPropertiesCount;
     IPC_Link *                                    mLink;
 
+    /// The change count has its own shared memory, that clients map read
+    // write to tell they wait on it, while the values stay read only.
+    void                attachChanges();
+    void                detachChanges();
+
+    boost::interprocess::shared_memory_object *   mChangesMemory;
+    boost::interprocess::mapped_region *          mChangesRegion;
+    IPC_ChangeNotifier *                          mChangeNotifier;
+
+    /// Client requests of a transaction are batched, not server changes
+    bool    isTransactionRequest(EOperationRequest operation) const
+    {
+        return mTransactionDepth > 0 && !mIsPropertyServer &&
+               operation <= eOperationRequest_Invert;
+    }
+
+    IPC_Seqlock                                   mTransactionSeqlock;
+    int                                           mTransactionDepth;
+    std::vector<IPC_PropertyID>                   mTransactionChanges;
+    std::vector<char>                             mTransactionRequests;
+    TTransactionSignal                            mTransactionSignal;
+
+    bool                                          mInterestedInAll;
+    std::vector<IPC_PropertyID>                   mInterests;
+
     /// for internal use, and only while properties are being created...
     static IPC_SharedProperties *        sSharedPropertiesBeingBuilt;
 };
 
+/*
+ * Groups the operations made on a set of shared properties while it exists.
+ * For instance, to change the phone status & the headset state together:
+ * clients never see one changed without the other, and get one message.
+ */
+class IPC_Transaction
+{
+public:
+    IPC_Transaction(IPC_SharedProperties & sharedProperties) :
+                                             mSharedProperties(sharedProperties)
+    {
+        mSharedProperties.beginTransaction();
+    }
+    ~IPC_Transaction()                  { mSharedProperties.endTransaction(); }
+
+private:
+    IPC_Transaction(const IPC_Transaction &);
+    IPC_Transaction & operator=(const IPC_Transaction &);
+
+    IPC_SharedProperties &      mSharedProperties;
+};
+
 template <class T> class IPC_PropertyBaseT : public IPC_PropertyBase
 {
 public:
-    typedef boost::signals2::signal<void (const T &)>         TSignal;
-    typedef boost::signals2::slot<void (const T &)>            TSlot;
-    typedef boost::signals2::signal<void (const char *)>     TMessageSignal;
-    typedef boost::signals2::slot<void (const char *)>        TMessageSlot;
+    typedef IPC_ListenerList<void (const T &), 4>        TSignal;
+    typedef IPC_ListenerList<void (const char *), 2>     TMessageSignal;
 
     // Be notified when a property is changed
-    boost::signals2::connection sendChanges(const TSlot & slot)
+    template <class Listener> IPC_ListenerConnection sendChanges(const Listener & listener)
     {
-        if (mSignal.empty() && !mSharedProperties->isServer())
+        IPC_ListenerConnection connection = this->mSignal.connect(listener);
+        if (!connection.connected())
+            FAILURE("IPC_PropertyBaseT::sendChanges: too many listeners");
+        else if (mSignal.num_slots() == 1 && !mSharedProperties->isServer())
             mSharedProperties->sendRequest(
                    eOperationRequest_HandlesChangeNotifications, this->getID());
-        return this->mSignal.connect(slot);
+        return connection;
     }
 
     // Be notified when a property receives a message
-    boost::signals2::connection sendMessages(const TMessageSlot & slot)
+    template <class Listener> IPC_ListenerConnection sendMessages(const Listener & listener)
     {
-        return mMessageSignal.connect(slot);
+        IPC_ListenerConnection connection = mMessageSignal.connect(listener);
+        if (!connection.connected())
+            FAILURE("IPC_PropertyBaseT::sendMessages: too many listeners");
+        else if (mMessageSignal.num_slots() == 1 && !mSharedProperties->isServer())
+            mSharedProperties->addInterest(this->getID());
+        return connection;
     }
 
+    bool            hasChangeListeners() const      { return !mSignal.empty(); }
+    bool            hasMessageListeners() const     { return !mMessageSignal.empty(); }
+
     /// Initial value of the property. Will NEVER make an IPC request
     void init(const T & newValue)        { setLocalValue(newValue); }
 
+    /// Generation of the value in shared memory: grows with each change.
+    // Compare with the last one seen to know if it changed, without IPC.
+    guint32          getGeneration() const
+    {
+        const IPC_PropertyBaseT<T> * propertyInSharedMemory =
+                               reinterpret_cast<const IPC_PropertyBaseT<T> *>
+                               (mSharedProperties->getSharedPropertyAddress(this));
+        return propertyInSharedMemory->mSeqlock.sequence() / 2;
+    }
+
     const T &        getLocalValue() const                    { return mValue; }
 
     /// Call listeners' message reception callbacks
@@ -349,7 +550,19 @@ protected:
 
     /// Last level setter of the property. Should not be used directly,
     // but may well be overridden! (save as init, but for code clarity...)
-    virtual void    setLocalValue(const T & newValue)        { mValue = newValue; }
+    virtual void    setLocalValue(const T & newValue)        { publishValue(newValue); }
+
+    /// Change the value under its seqlock, so that slaves reading it
+    // from shared memory never see half of it.
+    void            publishValue(const T & newValue)
+    {
+        mSeqlock.writeBegin();
+        mValue = newValue;
+        mSeqlock.writeEnd();
+    }
+
+    /// Guards mValue in shared memory
+    IPC_Seqlock                      mSeqlock;
 
     /// The value of the property for master properties
     // and properties using local copies.
@@ -417,7 +630,13 @@ public:
         if (newValue != this->mValue ||
             this->testFlag(IPC_PropertyBase::ePropertyFlag_NotifyClientsEvenIfNoChange))
         {
-            this->mValue = newValue;
+            this->publishValue(newValue);
+            if (this->mSharedProperties->isInTransaction())
+            {   // clients & listeners are notified when it ends
+                this->mSharedProperties->addTransactionChange(this->getID());
+                return true;
+            }
+            this->mSharedProperties->valueChanged();
             if (!this->testFlag(IPC_PropertyBase::ePropertyFlag_DontNotifyClients))
             {
                 if (this->testFlag(IPC_PropertyBase::ePropertyFlag_UseLocalCopy))
@@ -486,6 +705,29 @@ public:
     {
         this->mSignal(this->mValue);
     }
+
+    /// Used internally: the value local copies get, as doSet() sends it
+    const void * getLocalCopyValue(ssize_t & size) const
+    {
+        if (!this->testFlag(IPC_PropertyBase::ePropertyFlag_UseLocalCopy) ||
+                this->testFlag(IPC_PropertyBase::ePropertyFlag_DontNotifyClients))
+            return 0;
+        size = sizeof(T);
+        return &this->mValue;
+    }
+
+    /// Used internally: what clients are told of a change in a transaction
+    void addTransactionEntry(std::vector<char> & entries)
+    {
+        if (this->testFlag(IPC_PropertyBase::ePropertyFlag_DontNotifyClients))
+            return;
+        if (this->testFlag(IPC_PropertyBase::ePropertyFlag_UseLocalCopy))
+            this->mSharedProperties->addTransactionEntry(entries, eOperationRequest_Set,
+                                          this->getID(), &this->mValue, sizeof(T));
+        else
+            this->mSharedProperties->addTransactionEntry(entries, eOperationRequest_Changed,
+                                                         this->getID(), 0, 0);
+    }
 };
 
 /*
@@ -503,7 +745,8 @@ public:
 
     /// Normal way to get the value of the property. Will use the shared
     // memory value if allowed, or cached value.
-    const T &        get() const
+    /// Values wider than 32 bits are copied under their seqlock, without IPC.
+    T                get() const
     {
         if (this->testFlag(IPC_PropertyBase::ePropertyFlag_UseLocalCopy))
             return this->mValue;
@@ -512,7 +755,17 @@ public:
                                reinterpret_cast<const IPC_ClientProperty<T> *>
                                (this->mSharedProperties->getSharedPropertyAddress(this));
 
-        return propertyInSharedMemory->mValue;
+        if (sizeof(T) <= sizeof(guint32))
+            return propertyInSharedMemory->mValue;
+
+        // values go through memcpy on the links already
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type copy;
+        if (propertyInSharedMemory->mSeqlock.read(&copy, &propertyInSharedMemory->mValue,
+                                                  sizeof(T)))
+            return *reinterpret_cast<const T *>(&copy);
+
+        FAILURE("IPC_ClientProperty::get: value in shared memory left half written");
+        return this->mValue;
     }
 
     /// Normal way to set the value. Will forward the request to master.
@@ -581,7 +834,10 @@ public:
             if (VERIFY(size == sizeof(T)))
             {
                 this->mValue = *reinterpret_cast<const T *>(valuePtr);
-                IPC_PropertyBase::notifyListeners();
+                if (this->mSharedProperties->isInTransaction())
+                    this->mSharedProperties->addTransactionChange(this->getID());
+                else
+                    IPC_PropertyBase::notifyListeners();
             }
         }
         else if (VERIFY(operation == eOperationRequest_Message))
@@ -603,15 +859,7 @@ public:
     /// Call listeners' callback method
     void            notifyListeners()
     {
-        mSignal(get());
-    }
-
-    /// Called when property is connected. Don't call directly.
-    void            onConnectedClient()
-    {
-        if (!this->mSignal.empty())
-            this->mSharedProperties->sendRequest
-                (eOperationRequest_HandlesChangeNotifications, this->getID());
+        this->mSignal(get());
     }
 };
 
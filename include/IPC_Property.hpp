@@ -21,6 +21,7 @@
 #include "IPC_Property.h"
 #include "IPC_Socket.hpp"
 
+#include <algorithm>
 #include <map>
 
 struct IPC_MessageHeader        // make this fit in 32 bits
@@ -31,6 +32,9 @@ struct IPC_MessageHeader        // make this fit in 32 bits
 
 const ssize_t cBasicMessageSize = 16;
 
+// largest message on links that opted into sequenced packets
+const ssize_t cSequencedMessageSize = 512;
+
 struct IPC_MessageWithData
 {
     IPC_MessageHeader    mHeader;
@@ -42,7 +46,8 @@ class IPC_MasterLink : public IPC_Link, public IPC_SocketServerCallbacks
     class Client : public IPC_SocketCallbacks
     {
     public:
-        Client() : mSocket(0), mLink(0), mPropertyBeingChanged(cInvalidPropertyID) {}
+        Client() : mSocket(0), mLink(0), mPropertyBeingChanged(cInvalidPropertyID),
+                   mSendingTransaction(false) {}
 
         // IPC_SocketCallbacks methods
         void    connectionEstablished(IPC_Socket * socket)
@@ -52,6 +57,8 @@ class IPC_MasterLink : public IPC_Link, public IPC_SocketServerCallbacks
             if (VERIFY(mLink))
             {
                 mProperties.resize(mLink->sharedProperties().getPropertyCount(), false);
+                // everything, until the client tells what it uses
+                mInterests.resize(mLink->sharedProperties().getPropertyCount(), true);
             }
         }
         void    dataReceived(const void * data, ssize_t size)
@@ -66,10 +73,7 @@ class IPC_MasterLink : public IPC_Link, public IPC_SocketServerCallbacks
                     EOperationRequest operation = EOperationRequest(message->mOperation);
                     if (operation == eOperationRequest_HandlesChangeNotifications)
                     {
-                        mProperties.set(message->mID);
-                        if (!mLink->sharedProperties().testPropertyFlag(message->mID,
-                             IPC_PropertyBase::ePropertyFlag_NoNotificationOnConnect))
-                            sendChangeNotification(message->mID);
+                        listenTo(message->mID);
                     }
                     else
                     {
@@ -83,6 +87,20 @@ class IPC_MasterLink : public IPC_Link, public IPC_SocketServerCallbacks
                 {
                     const IPC_MessageWithData * message =
                           reinterpret_cast<const IPC_MessageWithData *>(data);
+                    if (message->mHeader.mOperation == eOperationRequest_Transaction)
+                    {
+                        mSendingTransaction = true;
+                        mLink->sharedProperties().transactionReceived(message->mData,
+                                                     size - sizeof(IPC_MessageHeader));
+                        mSendingTransaction = false;
+                        return;
+                    }
+                    if (message->mHeader.mOperation == eOperationRequest_Interests)
+                    {
+                        interestsReceived(message->mHeader.mID, message->mData,
+                                          size - sizeof(IPC_MessageHeader));
+                        return;
+                    }
                     mPropertyBeingChanged = message->mHeader.mID;
                     mLink->sharedProperties().requestReceived(
                                    EOperationRequest(message->mHeader.mOperation),
@@ -97,6 +115,53 @@ class IPC_MasterLink : public IPC_Link, public IPC_SocketServerCallbacks
             if (mLink)
                 mLink->socketClosed(socket);
         }
+        /// Start sending changes of a property, & its current value
+        void    listenTo(IPC_PropertyID id)
+        {
+            if (!VERIFY(id < mProperties.size()))
+                return;
+            mProperties.set(id);
+            addInterest(id);
+            if (!mLink->sharedProperties().testPropertyFlag(id,
+                 IPC_PropertyBase::ePropertyFlag_NoNotificationOnConnect))
+                sendChangeNotification(id);
+        }
+        /// Bitmaps of the properties the client listens to, then uses
+        void    interestsReceived(IPC_PropertyID count, const void * data, ssize_t size)
+        {
+            size_t bytes = (count + 7) / 8;
+            if (!VERIFY(count == mProperties.size() && size >= (ssize_t) (2 * bytes)))
+                return;
+            const unsigned char * listened = reinterpret_cast<const unsigned char *>(data);
+            const unsigned char * used = listened + bytes;
+            for (IPC_PropertyID id = 0; id < count; id++)
+            {
+                if ((used[id / 8] >> (id % 8)) & 1)
+                    addInterest(id);
+                else
+                    mInterests.reset(id);
+                if (((listened[id / 8] >> (id % 8)) & 1) == 0)
+                    mProperties.reset(id);
+                else if (!mProperties.test(id))
+                    listenTo(id);
+            }
+        }
+        /// Send the values & messages of a property again. A local copy
+        // missed the changes made meanwhile: it gets the current value.
+        void    addInterest(IPC_PropertyID id)
+        {
+            if (mInterests.test(id))
+                return;
+            mInterests.set(id);
+            ssize_t size = 0;
+            const void * value = mLink->sharedProperties().getLocalCopyValue(id, size);
+            if (value && VERIFY(mSocket))
+                sendValue(*mSocket, eOperationRequest_Set, id, value, size);
+        }
+        bool    isInterestedIn(IPC_PropertyID id) const
+        {
+            return id < mInterests.size() && mInterests.test(id);
+        }
         void    sendChangeNotification(IPC_PropertyID id)
         {
             if (VERIFY(mSocket && mLink) &&        // defensive programming
@@ -108,13 +173,49 @@ class IPC_MasterLink : public IPC_Link, public IPC_SocketServerCallbacks
                             IPC_PropertyBase::ePropertyFlag_DontNotifyClientsForOwnChanges)))
                 mSocket->send(&id, sizeof(id));
         }
+        void    sendTransaction(const char * entries, ssize_t size)
+        {
+            if (!VERIFY(mSocket && mLink))
+                return;
+
+            // values of local copies for all, only the changes the client
+            // listens to, except its own if it doesn't want them
+            mTransaction.clear();
+            for (const char * entry = entries; entry < entries + size; )
+            {
+                const IPC_TransactionEntry * header =
+                             reinterpret_cast<const IPC_TransactionEntry *>(entry);
+                size_t length = sizeof(IPC_TransactionEntry) + ((header->mSize + 7) & ~7);
+                IPC_PropertyID id = header->mID;
+                if ((header->mOperation != eOperationRequest_Changed && isInterestedIn(id)) ||
+                        (header->mOperation == eOperationRequest_Changed &&
+                            id < mProperties.size() && mProperties.test(id) &&
+                            (!mSendingTransaction ||
+                                !mLink->sharedProperties().testPropertyFlag(id,
+                                IPC_PropertyBase::ePropertyFlag_DontNotifyClientsForOwnChanges))))
+                    mTransaction.insert(mTransaction.end(), entry, entry + length);
+                entry += length;
+            }
+            if (!mTransaction.empty())
+            {
+                IPC_MessageHeader message;
+                message.mID = 0;
+                message.mOperation = eOperationRequest_Transaction;
+                mSocket->send(&message, sizeof(IPC_MessageHeader),
+                              &mTransaction[0], mTransaction.size());
+            }
+        }
 
         typedef boost::dynamic_bitset<>    Bitset;
 
         IPC_Socket *        mSocket;
         IPC_MasterLink *    mLink;
         IPC_PropertyID        mPropertyBeingChanged;
+        bool                mSendingTransaction;    ///< transaction it sent
+                                                    /// being processed
         Bitset                mProperties;
+        Bitset              mInterests;     ///< values & messages it gets
+        std::vector<char>   mTransaction;   ///< to send, filtered
     };
 
     class ClosedSocketsCollector
@@ -147,47 +248,54 @@ class IPC_MasterLink : public IPC_Link, public IPC_SocketServerCallbacks
     };
 
 public:
-    IPC_MasterLink(IPC_SharedProperties & sharedProperties) :
-                         IPC_Link(sharedProperties), mClosedSocketCollector(0)
+    IPC_MasterLink(IPC_SharedProperties & sharedProperties,
+                   ESocketPacketsSize packetsSizeMode) :
+                         IPC_Link(sharedProperties), mClosedSocketCollector(0),
+                         mPacketsSizeMode(packetsSizeMode)
     {
         sharedProperties.setLink(this);
         mSocketServer.setCallbacks(this);
-        mSocketServer.listen(sharedProperties.getName(), eSocketPacketsSize_Controlled);
+        if (mPacketsSizeMode == eSocketPacketsSize_Sequenced)
+            mSocketServer.listen(sharedProperties.getName(), eSocketPacketsSize_Sequenced,
+                                 cSequencedMessageSize);
+        else
+            mSocketServer.listen(sharedProperties.getName(), eSocketPacketsSize_Controlled);
     }
     ~IPC_MasterLink() {}
 
+    /// Send an operation with its value to one client
+    static void sendValue(IPC_Socket & socket, EOperationRequest operation,
+                          IPC_PropertyID id, const void * value, ssize_t size)
+    {
+        if (size <= cBasicMessageSize)
+        {    // send in one transaction
+            IPC_MessageWithData    message;
+            message.mHeader.mID = id;
+            message.mHeader.mOperation = operation;
+            ::memcpy(message.mData, value, size);
+            socket.send(&message, sizeof(IPC_MessageWithData) - cBasicMessageSize + size);
+        }
+        else
+        {    // send in two transactions
+            IPC_MessageHeader    message;
+            message.mID = id;
+            message.mOperation = operation;
+            socket.send(&message, sizeof(IPC_MessageHeader), value, size);
+        }
+    }
+
     // IPC_Link methods
     bool    sendRequest(EOperationRequest operation, IPC_PropertyID id,
                                              const void * value, ssize_t size)
     {
         if (VERIFY(size > 0))
         {
-            if (size <= cBasicMessageSize)
-            {    // send in one transaction
-                IPC_MessageWithData    message;
-                message.mHeader.mID = id;
-                message.mHeader.mOperation = operation;
-                ::memcpy(message.mData, value, size);
-                ClosedSocketsCollector    collector(*this);
-                for (Clients::iterator iter = mClients.begin();
-                                                 iter != mClients.end(); ++iter)
-                {
-                    iter->first->send(&message,
-                        sizeof(IPC_MessageWithData) - cBasicMessageSize + size);
-                }
-            }
-            else
-            {    // send in two transactions
-                IPC_MessageHeader    message;
-                message.mID = id;
-                message.mOperation = operation;
-                ClosedSocketsCollector    collector(*this);
-                for (Clients::iterator iter = mClients.begin();
-                                                iter != mClients.end(); ++iter)
-                {
-                    iter->first->send(&message,
-                                       sizeof(IPC_MessageHeader), value, size);
-                }
+            ClosedSocketsCollector    collector(*this);
+            for (Clients::iterator iter = mClients.begin();
+                                             iter != mClients.end(); ++iter)
+            {
+                if (iter->second.isInterestedIn(id))
+                    sendValue(*iter->first, operation, id, value, size);
             }
         }
         return false;
@@ -209,6 +317,17 @@ public:
         }
     }
 
+    bool    sendTransaction(const void * entries, ssize_t size)
+    {
+        ClosedSocketsCollector    collector(*this);
+        for (Clients::iterator iter = mClients.begin();
+                                         iter != mClients.end(); ++iter)
+        {
+            iter->second.sendTransaction(reinterpret_cast<const char *>(entries), size);
+        }
+        return true;
+    }
+
     IPC_SharedProperties & sharedProperties()    { return mSharedProperties; }
 
     void    socketClosed(IPC_Socket * socket)
@@ -225,7 +344,8 @@ public:
         Client & client = mClients[&connection];
         client.mLink = this;
         connection.setCallbacks(&client);
-        connection.setPacketing(eSocketPacketsSize_Controlled, 512);
+        if (mPacketsSizeMode != eSocketPacketsSize_Sequenced)
+            connection.setPacketing(eSocketPacketsSize_Controlled, 512);
     }
 
 private:
@@ -236,19 +356,27 @@ private:
     IPC_SocketServer            mSocketServer;
     Clients                        mClients;
     ClosedSocketsCollector *    mClosedSocketCollector;
+    ESocketPacketsSize          mPacketsSizeMode;
 };
 
 class IPC_SlaveLink : public IPC_Link, public IPC_SocketCallbacks
 {
 public:
-    IPC_SlaveLink(IPC_SharedProperties & sharedProperties) :
+    IPC_SlaveLink(IPC_SharedProperties & sharedProperties,
+                  ESocketPacketsSize packetsSizeMode) :
                                       IPC_Link(sharedProperties), mSocket(0)
     {
         sharedProperties.setLink(this);
         mSocketClient.setCallbacks(this);
-        mSocketClient.connect(sharedProperties.getName(),
-                                      true,
-                                      eSocketPacketsSize_Controlled);
+        if (packetsSizeMode == eSocketPacketsSize_Sequenced)
+            mSocketClient.connect(sharedProperties.getName(),
+                                          true,
+                                          eSocketPacketsSize_Sequenced,
+                                          cSequencedMessageSize);
+        else
+            mSocketClient.connect(sharedProperties.getName(),
+                                          true,
+                                          eSocketPacketsSize_Controlled);
     }
     ~IPC_SlaveLink() {}
 
@@ -270,8 +398,11 @@ public:
                 return mSocket->send(&message, size + sizeof(IPC_MessageHeader));
             }
             else
-            {    // send in two transactions
-                return sendRequest(operation, id) && mSocket && mSocket->send(value, size);
+            {    // header & value in one message
+                IPC_MessageHeader    message;
+                message.mID = id;
+                message.mOperation = operation;
+                return mSocket->send(&message, sizeof(IPC_MessageHeader), value, size);
             }
         }
         return false;
@@ -294,6 +425,18 @@ public:
         SHOULD_NOT_REACH_HERE;// This method should be called only on IPC_MasterLink
     }
 
+    bool    sendTransaction(const void * entries, ssize_t size)
+    {
+        if (mSocket)
+        {
+            IPC_MessageHeader    message;
+            message.mID = 0;
+            message.mOperation = eOperationRequest_Transaction;
+            return mSocket->send(&message, sizeof(IPC_MessageHeader), entries, size);
+        }
+        return false;
+    }
+
     // IPC_SocketCallbacks methods
     void    connectionEstablished(IPC_Socket * socket)
     {
@@ -323,6 +466,12 @@ public:
         else if (VERIFY(size > (ssize_t) sizeof(IPC_MessageHeader)))
         {
             const IPC_MessageWithData *    message = reinterpret_cast<const IPC_MessageWithData *>(data);
+            if (message->mHeader.mOperation == eOperationRequest_Transaction)
+            {
+                mSharedProperties.transactionReceived(message->mData,
+                                                      size - sizeof(IPC_MessageHeader));
+                return;
+            }
             mSharedProperties.requestReceived(EOperationRequest
                                              (message->mHeader.mOperation),
                                               message->mHeader.mID,
@@ -359,7 +508,9 @@ IPC_SharedProperties::IPC_SharedProperties(const std::string & name,
         mSharedMemoryName(name), mIsPropertyServer(true), mSharedMemory(0),
         mRegion(0), mSharedProperties(this),
         mSharedPropertiesSize(sharedPropertiesSize),
-        mSharedPropertiesCount(0), mLink(0)
+        mSharedPropertiesCount(0), mLink(0), mChangesMemory(0), mChangesRegion(0),
+        mChangeNotifier(0), mTransactionDepth(0),
+        mInterestedInAll(true)
 {
     // reserve enough to avoid multiple reallocatio
     mProperties.reserve(sharedPropertiesSize / sizeof(IPC_PropertyBaseT<bool>));
@@ -368,7 +519,8 @@ IPC_SharedProperties::IPC_SharedProperties(const std::string & name,
 }
 
 template <class SharedProperties> SharedProperties * IPC_SharedProperties::
-                               createSharedProperties(const std::string & name)
+                               createSharedProperties(const std::string & name,
+                                                      ESocketPacketsSize packetsSizeMode)
 {
     using namespace boost::interprocess;
 
@@ -394,7 +546,18 @@ template <class SharedProperties> SharedProperties * IPC_SharedProperties::
             sharedProperties->mSharedMemory = sharedMemory;
             sharedProperties->mRegion = region;
 
-            new IPC_MasterLink(*sharedProperties);
+            // writable by all clients, unlike the values
+            permissions unrestricted;
+            unrestricted.set_unrestricted();
+            sharedProperties->mChangesMemory = new shared_memory_object(open_or_create,
+                                        changesName(name).c_str(), read_write, unrestricted);
+            sharedProperties->mChangesMemory->truncate(sizeof(IPC_ChangeNotifier));
+            sharedProperties->mChangesRegion = new mapped_region(
+                    *sharedProperties->mChangesMemory, read_write, 0, sizeof(IPC_ChangeNotifier));
+            sharedProperties->mChangeNotifier = new (sharedProperties->mChangesRegion->
+                                                     get_address()) IPC_ChangeNotifier;
+
+            new IPC_MasterLink(*sharedProperties, packetsSizeMode);
         }
         else
         {
@@ -405,7 +568,7 @@ template <class SharedProperties> SharedProperties * IPC_SharedProperties::
             sharedProperties->mSharedPropertiesCount =
                                            sharedProperties->mProperties.size();
 
-            new IPC_SlaveLink(*sharedProperties);
+            new IPC_SlaveLink(*sharedProperties, packetsSizeMode);
         }
 
         IPC_SharedProperties::sSharedPropertiesBeingBuilt = 0;
@@ -418,6 +581,7 @@ template <class SharedProperties> SharedProperties * IPC_SharedProperties::
         sharedProperties->mRegion = 0;
         delete sharedProperties->mSharedMemory;
         sharedProperties->mSharedMemory = 0;
+        sharedProperties->detachChanges();
     }
 
     return sharedProperties;
@@ -446,6 +610,7 @@ bool IPC_SharedProperties::attachSharedMemory()
         if (sharedProperties->mSharedPropertiesSize == this->mSharedPropertiesSize &&
            sharedProperties->mSharedPropertiesCount == this->mSharedPropertiesCount)
         {
+            attachChanges();
             this->mSharedProperties = sharedProperties;
             for (IPC_PropertyRegister::iterator iter = mProperties.begin();
                                             iter != mProperties.end(); ++iter)
@@ -454,6 +619,8 @@ bool IPC_SharedProperties::attachSharedMemory()
                 if (VERIFY(property))
                     property->onConnectedClient();
             }
+            // one message for the properties listened to, not one each
+            sendInterests();
         }
         else
         {
@@ -488,9 +655,206 @@ void IPC_SharedProperties::detachSharedMemory()
     mRegion = 0;
     delete mSharedMemory;
     mSharedMemory = 0;
+    detachChanges();
     this->mSharedProperties = this;
 }
 
+void IPC_SharedProperties::attachChanges()
+{
+    using namespace boost::interprocess;
+
+    // read write: waiters flag the count to be woken up
+    mChangesMemory = new shared_memory_object(open_only, changesName(mSharedMemoryName).c_str(),
+                                              read_write);
+    mChangesRegion = new mapped_region(*mChangesMemory, read_write, 0,
+                                       sizeof(IPC_ChangeNotifier));
+    mChangeNotifier = reinterpret_cast<IPC_ChangeNotifier *>(mChangesRegion->get_address());
+}
+
+void IPC_SharedProperties::detachChanges()
+{
+    mChangeNotifier = 0;
+    delete mChangesRegion;
+    mChangesRegion = 0;
+    delete mChangesMemory;
+    mChangesMemory = 0;
+}
+
+void IPC_SharedProperties::beginTransaction()
+{
+    // clients reading several values wait for all the changes
+    if (mTransactionDepth++ == 0 && mIsPropertyServer)
+        mTransactionSeqlock.writeBegin();
+}
+
+void IPC_SharedProperties::endTransaction()
+{
+    if (!VERIFY(mTransactionDepth > 0) || --mTransactionDepth > 0)
+        return;
+
+    // listeners may start new transactions
+    std::vector<IPC_PropertyID> changes;
+    changes.swap(mTransactionChanges);
+
+    if (mIsPropertyServer)
+    {
+        mTransactionSeqlock.writeEnd();
+        if (!changes.empty())
+        {
+            valueChanged();
+            std::vector<char> entries;
+            for (std::vector<IPC_PropertyID>::iterator iter = changes.begin();
+                                               iter != changes.end(); ++iter)
+                mProperties[*iter]->addTransactionEntry(entries);
+            if (!entries.empty() && mLink)
+                mLink->sendTransaction(&entries[0], entries.size());
+        }
+    }
+    else if (!mTransactionRequests.empty())
+    {
+        std::vector<char> requests;
+        requests.swap(mTransactionRequests);
+        if (mLink)
+            mLink->sendTransaction(&requests[0], requests.size());
+    }
+
+    if (!changes.empty())
+    {
+        guint64 interests = 0;
+        for (std::vector<IPC_PropertyID>::iterator iter = changes.begin();
+                                           iter != changes.end(); ++iter)
+        {
+            mProperties[*iter]->notifyListeners();
+            interests |= mProperties[*iter]->getInterestMask();
+        }
+        mTransactionSignal.notify(interests, &changes[0], changes.size());
+    }
+}
+
+void IPC_SharedProperties::addTransactionChange(IPC_PropertyID id)
+{
+    if (VERIFY(id < mProperties.size()) &&
+        std::find(mTransactionChanges.begin(), mTransactionChanges.end(), id) ==
+                                                         mTransactionChanges.end())
+        mTransactionChanges.push_back(id);
+}
+
+bool IPC_SharedProperties::addTransactionEntry(std::vector<char> & entries,
+                                               EOperationRequest operation,
+                                               IPC_PropertyID id,
+                                               const void * value, ssize_t size)
+{
+    size_t length = sizeof(IPC_TransactionEntry) + ((size + 7) & ~7);
+    if (!VERIFY(length <= cMaxTransactionSize))
+        return false;
+    if (entries.size() + length > cMaxTransactionSize)
+    {
+        g_warning("%s: transaction too big for one message, split", getName());
+        if (mLink)
+            mLink->sendTransaction(&entries[0], entries.size());
+        entries.clear();
+    }
+
+    IPC_TransactionEntry entry;
+    entry.mID = id;
+    entry.mOperation = operation;
+    entry.mSize = size;
+    entry.mReserved = 0;
+    size_t offset = entries.size();
+    entries.resize(offset + length, 0);
+    ::memcpy(&entries[offset], &entry, sizeof(entry));
+    if (size > 0)
+        ::memcpy(&entries[offset + sizeof(entry)], value, size);
+    return true;
+}
+
+void IPC_SharedProperties::transactionReceived(const void * entries, ssize_t size)
+{
+    // values are copied aligned: entries follow the message header
+    guint64 value[cMaxTransactionSize / sizeof(guint64)];
+    const char * entry = reinterpret_cast<const char *>(entries);
+    const char * end = entry + size;
+
+    beginTransaction();
+    while (entry + sizeof(IPC_TransactionEntry) <= end)
+    {
+        IPC_TransactionEntry header;
+        ::memcpy(&header, entry, sizeof(header));
+        const char * data = entry + sizeof(header);
+        if (!VERIFY(header.mID < mProperties.size()) ||
+            !VERIFY(header.mSize <= sizeof(value) && data + header.mSize <= end))
+            break;
+
+        EOperationRequest operation = EOperationRequest(header.mOperation);
+        if (operation == eOperationRequest_Changed)
+        {
+            if (VERIFY(!mIsPropertyServer))
+                addTransactionChange(header.mID);
+        }
+        else if (header.mSize > 0)
+        {
+            ::memcpy(value, data, header.mSize);
+            mProperties[header.mID]->requestReceived(operation, value, header.mSize);
+        }
+        else
+            mProperties[header.mID]->requestReceived(operation);
+        entry = data + ((header.mSize + 7) & ~7);
+    }
+    endTransaction();
+}
+
+void IPC_SharedProperties::setInterests(const IPC_PropertyID * ids, size_t count)
+{
+    mInterests.assign(ids, ids + count);
+    mInterestedInAll = false;
+    sendInterests();
+}
+
+void IPC_SharedProperties::setInterestedInAll()
+{
+    mInterests.clear();
+    mInterestedInAll = true;
+    sendInterests();
+}
+
+void IPC_SharedProperties::addInterest(IPC_PropertyID id)
+{
+    if (!mInterestedInAll &&
+        std::find(mInterests.begin(), mInterests.end(), id) == mInterests.end())
+    {
+        mInterests.push_back(id);
+        sendInterests();
+    }
+}
+
+bool IPC_SharedProperties::sendInterests()
+{
+    size_t count = mProperties.size();
+    size_t bytes = (count + 7) / 8;
+    if (mIsPropertyServer || count == 0)
+        return false;
+
+    // bitmaps of the properties listened to, then of those used
+    std::vector<unsigned char> bitmaps(2 * bytes, 0);
+    for (size_t id = 0; id < count; id++)
+    {
+        unsigned char bit = 1 << (id % 8);
+        if (mProperties[id]->hasChangeListeners())
+            bitmaps[id / 8] |= bit;
+        if (mInterestedInAll || mProperties[id]->hasChangeListeners() ||
+            mProperties[id]->hasMessageListeners())
+            bitmaps[bytes + id / 8] |= bit;
+    }
+    for (std::vector<IPC_PropertyID>::iterator iter = mInterests.begin();
+                                       iter != mInterests.end(); ++iter)
+        if (VERIFY(*iter < count))
+            bitmaps[bytes + *iter / 8] |= 1 << (*iter % 8);
+
+    // before the connection, the handshake sends them
+    return sendRequest(eOperationRequest_Interests, IPC_PropertyID(count),
+                       &bitmaps[0], bitmaps.size());
+}
+
 /// Specialized operations for int
 template <> bool IPC_ServerProperty<int>::add(const int & value)
                                              { return set(get() + value); }
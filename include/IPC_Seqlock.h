@@ -0,0 +1,112 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef IPC_SEQLOCK_H_
+#define IPC_SEQLOCK_H_
+
+#include <atomic>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Sequence lock guarding a value in shared memory, for values too wide to
+ * be written atomically. The sequence is odd while a writer is updating the
+ * value. Readers copy the value & retry if the sequence moved meanwhile:
+ * they never block the writer & never see half a value.
+ * Writers exclude each other, even in different processes.
+ * Lives in the shared memory next to the value: no pointers, no process
+ * local state.
+ */
+class IPC_Seqlock
+{
+public:
+    enum { cSpinsBeforeYield = 64, cMaxReadAttempts = 10000 };
+
+    IPC_Seqlock() : mSequence(0) {}
+
+    /// Start updating the value: readers will retry until writeEnd()
+    void        writeBegin()
+    {
+        uint32_t sequence = mSequence.load(std::memory_order_relaxed);
+        for (unsigned spins = 1; ; spins++)
+        {
+            if ((sequence & 1) == 0 &&
+                mSequence.compare_exchange_weak(sequence, sequence + 1,
+                                                std::memory_order_acquire,
+                                                std::memory_order_relaxed))
+                break;
+            if (spins % cSpinsBeforeYield == 0)
+                sched_yield();
+            sequence = mSequence.load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    /// Value updated: publish it
+    void        writeEnd()
+    {
+        mSequence.fetch_add(1, std::memory_order_release);
+    }
+
+    /// Only when the previous writer is known to be gone: end the update it
+    /// may have left in progress, so that readers & writers stop waiting.
+    void        recover()
+    {
+        uint32_t sequence = mSequence.load(std::memory_order_relaxed);
+        if (sequence & 1)
+            mSequence.compare_exchange_strong(sequence, sequence + 1,
+                                              std::memory_order_release);
+    }
+
+    /// Copy size bytes of a value written under this lock. False if no
+    /// consistent copy could be made: a writer died in the middle of an update.
+    bool        read(void * copy, const void * value, size_t size) const
+    {
+        return read([=] { memcpy(copy, value, size); });
+    }
+
+    /// Call reader() until it ran while no update happened: it must only copy
+    /// what the lock guards, as what it sees may be inconsistent until then.
+    template <class Reader> bool read(Reader reader) const
+    {
+        for (unsigned attempt = 1; attempt <= cMaxReadAttempts; attempt++)
+        {
+            uint32_t before = mSequence.load(std::memory_order_acquire);
+            if ((before & 1) == 0)
+            {
+                reader();
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (mSequence.load(std::memory_order_relaxed) == before)
+                    return true;
+            }
+            if (attempt % cSpinsBeforeYield == 0)
+                sched_yield();
+        }
+        return false;
+    }
+
+    /// Even when no update is in progress. Grows by 2 with each update.
+    uint32_t    sequence() const    { return mSequence.load(std::memory_order_acquire); }
+
+private:
+    IPC_Seqlock(const IPC_Seqlock &);
+    IPC_Seqlock & operator=(const IPC_Seqlock &);
+
+    std::atomic<uint32_t>   mSequence;
+};
+
+#endif /* IPC_SEQLOCK_H_ */
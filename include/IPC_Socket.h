@@ -18,10 +18,11 @@
 #define IPC_SOCKET_H_
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <glib.h>
 
-#include <map>
+#include <vector>
 
 class IPC_Socket;
 
@@ -32,6 +33,7 @@ class IPC_SocketCallbacks
 {
 public:
     virtual void    connectionEstablished(IPC_Socket * socket) = 0;
+    // The data is only valid during the call: it's in the receive buffer.
     virtual void    dataReceived(const void * data, ssize_t size) = 0;
 
     // Called when socket is closed. In the case of a server (which can have
@@ -46,9 +48,14 @@ enum ESocketPacketsSize
                              // in without buffering.
     eSocketPacketsSize_Fixed, // Sent packets always have the same size.
                               // Will be read using that same fixed size.
-    eSocketPacketsSize_Controlled // Variable size, but ensure that each
-                                  // message sent is received individually
-                                  // once it has all been received.
+    eSocketPacketsSize_Controlled, // Variable size, but ensure that each
+                                   // message sent is received individually
+                                   // once it has all been received.
+    eSocketPacketsSize_Sequenced // Like controlled, using a SOCK_SEQPACKET
+                                 // socket that keeps each message apart.
+                                 // Packet size is the largest message.
+                                 // Falls back to controlled with peers
+                                 // that only know about it.
 };
 
 /*
@@ -58,8 +65,7 @@ struct IPC_Socket
 {
     enum { cDefaultPacketSize = 256 };
 
-    IPC_Socket(); // would be private, if the class wasn't used in an
-                  //STL map... Do not create/delete directly!
+    IPC_Socket(); // Do not create/delete directly!
     ~IPC_Socket();        // Let IPC_SocketClient & IPC_SocketServer manage
                          // these objects for you.
 
@@ -72,11 +78,18 @@ struct IPC_Socket
     bool                isConnected() const         { return mFD != -1; }
 
     /// Send data. Will not disconnect/reconnect in case of error.
+    /// Header & data go in a single system call. What the socket can't take
+    /// right away is queued & sent when it can, so a frame is never cut.
     bool send(const void * data,
               ssize_t size,
               const void * data2 = 0,
               ssize_t size2 = 0);
 
+    /// Send what send() had to queue, as much as the socket takes.
+    /// False on socket error only: use hasPendingSend() to know if all went.
+    bool                flushPending();
+    bool                hasPendingSend() const  { return mPendingSent < mPendingSend.size(); }
+
     /// Name of the server or client that created it.
     const char *        getName() const                { return mName; }
 
@@ -90,9 +103,19 @@ protected:
 
     void                connectionEstablished();
     bool                receiveData();
+    bool                handleFrames();
+    bool                receivePackets();
+    void                allocateBuffer(ssize_t size);
+    void                releaseBuffer();
     bool                receiveError();
     void           close(bool flush);        ///< direct close of everything
 
+    bool                queuePending(const struct iovec * segments, int count,
+                                     size_t total, size_t sent);
+    static gboolean     socketWritableCallback(GIOChannel * ch,
+                                               GIOCondition condition,
+                                               gpointer user_data);
+
     int                 mFD;                 ///< file descriptor for socket
     GIOChannel *        mChannel;            ///< socket event handler
     guint               mSourceID;            ///< source ID for that channel
@@ -100,14 +123,20 @@ protected:
 
     const char *            mName;
 
-    char *                    mBuffer;        ///< receive buffer allocated
+    char *                    mBuffer;        ///< receive buffer, from the
+                                              /// pool while it is big enough
     ssize_t                    mBufferSize;   ///< size allocated
-    ssize_t                    mBufferUsed;   ///< size used during partial receives
-    ssize_t                    mMessageSize;  ///< total message size expected.
-                                              /// Will fill-up buffer until
-                                              ///the size is reached
+    ssize_t                    mBufferUsed;   ///< data received & not handled:
+                                              /// the start of a frame
+    ssize_t                    mMessageSize;  ///< size of fixed size packets
+    ssize_t                    mPacketSize;   ///< as set by setPacketing()
     ESocketPacketsSize        mPacketsSizeMode;    ///< How are packets
                                                    ///received & sent size-wise?
+
+    std::vector<char>       mPendingSend;   ///< end of the frames the socket
+                                            /// couldn't take yet
+    size_t                  mPendingSent;   ///< part of it already sent
+    guint                   mWriteSourceID; ///< to send it when possible
 };
 
 /*
@@ -143,6 +172,7 @@ public:
 private:
     static gboolean socketConnectTimerCallback(gpointer user_data);
     bool            tryToConnectOnce();
+    bool            connectSocket(int type);
     char *            socketName()  { return &mAddressName.sun_path[1]; }
 
     static gboolean socketStatusCallback(GIOChannel * ch,
@@ -157,6 +187,8 @@ private:
     guint                    mTimeout;
     int                        mConnectAttempt;
     bool                    mAutoConnect;
+    ESocketPacketsSize      mPacketsSizeMode;   ///< as requested, before
+                                                /// any fallback
 };
 
 /*
@@ -170,7 +202,7 @@ public:
 
 class IPC_SocketServer
 {
-    typedef std::map<GIOChannel *, IPC_Socket>    SocketMap;
+    typedef std::vector<IPC_Socket *>    SocketVector;   // indexed by fd
 
 public:
     IPC_SocketServer();
@@ -206,6 +238,8 @@ private:
                                                                 //that delegates
                                                                 //to the next method
     void            connectionCallback(GIOChannel * ch, GIOCondition condition);
+    void            removeConnection(int fd);
+    bool            listenSocket(IPC_Socket & socket, int type);
 
     struct sockaddr_un            mAddressName;
 
@@ -213,7 +247,10 @@ private:
     IPC_SocketCallbacks *        mSocketCallbacks;
     IPC_Socket  mSocket;    ///< the socket we use to
                             // listen for incoming connections
-    SocketMap                    mConnections;
+    IPC_Socket  mFallbackSocket;    ///< in sequenced mode, to listen
+                                    // for controlled mode connections
+    SocketVector                mConnections;
+    size_t                        mConnectionsCount;
     size_t                        mMaxConnectionsCount;
 };
 
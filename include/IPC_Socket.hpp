@@ -18,6 +18,7 @@
 #include "log.h"
 
 #include <cerrno>
+#include <stdint.h>
 
 #define DO_DEBUG_SOCKETS 0
 
@@ -34,6 +35,28 @@
 #define _NAME_STRUCT_OFFSET(struct_type, member) \
                      ((long) ((unsigned char*) &((struct_type*) 0)->member))
 
+// receive buffers are taken from a pool of buffers of that size, & only
+// held by a socket while it has part of a frame
+const ssize_t cPooledBufferSize = 4096;
+const size_t cMaxPooledBuffers = 16;
+
+// how many times to read the socket on a wakeup, while it fills the buffer
+const int cMaxReadsPerWakeup = 4;
+
+// most packets received with one recvmmsg
+const int cMaxPacketsPerRead = 16;
+
+// never destroyed: sockets may be released by the destructors of globals
+static std::vector<char *> & _bufferPool()
+{
+    static std::vector<char *> * pool = new std::vector<char *>;
+    return *pool;
+}
+
+// most the queue of frames the socket couldn't take can hold, before
+// send() gives up on new frames
+const size_t cMaxPendingSend = 256 * 1024;
+
 const gint32 cMagicSignature = 0x47656d42; // 4 bytes signature to add
                                            // confidence that we are receiving
                                            // the size of a message...
@@ -52,9 +75,10 @@ struct IPC_Header
 
 IPC_Socket::IPC_Socket() : mFD(-1), mChannel(0), mSourceID(0), mCallbacks(0),
                            mName(""), mBuffer(0),
-                           mBufferSize(cDefaultPacketSize), mBufferUsed(0),
-                           mMessageSize(0),
-                           mPacketsSizeMode(eSocketPacketsSize_Free)
+                           mBufferSize(0), mBufferUsed(0),
+                           mMessageSize(0), mPacketSize(cDefaultPacketSize),
+                           mPacketsSizeMode(eSocketPacketsSize_Free),
+                           mPendingSent(0), mWriteSourceID(0)
 {
 }
 
@@ -66,9 +90,7 @@ IPC_Socket::~IPC_Socket()
 void IPC_Socket::connectionEstablished()
 {
     DEBUG_SOCKETS_M("IPC_Socket::connectionEstablished: %s/%d", mName, mFD);
-    mBufferUsed = 0;
-    if (mPacketsSizeMode == eSocketPacketsSize_Controlled)
-        mMessageSize = 0;
+    releaseBuffer();
     if (mCallbacks)
         mCallbacks->connectionEstablished(this);
 }
@@ -79,85 +101,219 @@ void IPC_Socket::setPacketing(ESocketPacketsSize packetsSizeMode,
     if (packetSize <= 0)
         packetSize = cDefaultPacketSize;
     mPacketsSizeMode = packetsSizeMode;
+    mPacketSize = packetSize;
     if (mPacketsSizeMode == eSocketPacketsSize_Controlled)
-    {
-        mBufferSize = packetSize;
         mMessageSize = 0;
-    }
     else
-        mMessageSize = mBufferSize = packetSize;
+        mMessageSize = packetSize;
     // reset current buffers
-    delete[] mBuffer;
+    releaseBuffer();
+}
+
+void IPC_Socket::allocateBuffer(ssize_t size)
+{
+    if (mBuffer && mBufferSize >= size)
+        return;
+    releaseBuffer();
+
+    std::vector<char *> & pool = _bufferPool();
+    if (size <= cPooledBufferSize && !pool.empty())
+    {
+        mBuffer = pool.back();
+        pool.pop_back();
+        mBufferSize = cPooledBufferSize;
+    }
+    else
+    {
+        mBufferSize = size > cPooledBufferSize ? size : cPooledBufferSize;
+        mBuffer = new char[mBufferSize];
+    }
+}
+
+void IPC_Socket::releaseBuffer()
+{
+    if (mBuffer)
+    {
+        std::vector<char *> & pool = _bufferPool();
+        if (mBufferSize == cPooledBufferSize && pool.size() < cMaxPooledBuffers)
+            pool.push_back(mBuffer);
+        else
+            delete[] mBuffer;
+    }
     mBuffer = 0;
+    mBufferSize = 0;
     mBufferUsed = 0;
 }
 
 bool IPC_Socket::receiveData()
 {
     DEBUG_SOCKETS("IPC_Socket::receiveData: %s/%d", mName, mFD);
-    if (mPacketsSizeMode == eSocketPacketsSize_Controlled && mMessageSize == 0)
+    if (mPacketsSizeMode == eSocketPacketsSize_Sequenced)
+        return receivePackets();
+
+    // read what's there in few calls, then handle all the complete frames
+    for (int reads = 0; reads < cMaxReadsPerWakeup && isConnected(); reads++)
     {
-        IPC_Header    header;
+        if (mBuffer == 0)
+            allocateBuffer(mMessageSize);
+
+        ssize_t room = mBufferSize - mBufferUsed;
+        ssize_t bytes = ::recv(mFD, mBuffer + mBufferUsed, room, MSG_DONTWAIT);
 
-        ssize_t bytes = ::recv(mFD, &header, sizeof(IPC_Header), 0);
+        DEBUG_SOCKETS("IPC_Socket::receiveData: %d bytes on '%s/%d'.", bytes, mName, mFD);
 
         if (bytes == 0)    // connection is being closed.
-            return true;
+            break;
 
         if (bytes < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
             return receiveError();
+        }
 
-        if (!VERIFY(bytes == sizeof(IPC_Header)) ||
-            !VERIFY(header.mSize > 0) ||
-            !VERIFY(header.mMagic == cMagicSignature))
-        {
-            DEBUG_SOCKETS_W("IPC_Socket::receiveData: invalid header  \
-                          data on %s/%d. Shutting down socket...", mName, mFD);
-            shutdown();
+        mBufferUsed += bytes;
+        if (!handleFrames())
             return false;
+        if (bytes < room)
+            break;
+    }
+
+    if (mBufferUsed == 0)
+        releaseBuffer();
+    return true;
+}
+
+bool IPC_Socket::receivePackets()
+{
+    // the buffer is cut in slots as big as the biggest packet, aligned
+    ssize_t slotSize = (mMessageSize + sizeof(ssize_t) - 1) & ~(sizeof(ssize_t) - 1);
+    allocateBuffer(slotSize);
+    int slots = mBufferSize / slotSize;
+    if (slots > cMaxPacketsPerRead)
+        slots = cMaxPacketsPerRead;
+
+    struct mmsghdr  packets[cMaxPacketsPerRead];
+    struct iovec    vectors[cMaxPacketsPerRead];
+    bool            ok = true;
+
+    for (int reads = 0; reads < cMaxReadsPerWakeup && isConnected(); reads++)
+    {
+        ::memset(packets, 0, sizeof(packets[0]) * slots);
+        for (int i = 0; i < slots; i++)
+        {
+            vectors[i].iov_base = mBuffer + i * slotSize;
+            vectors[i].iov_len = slotSize;
+            packets[i].msg_hdr.msg_iov = &vectors[i];
+            packets[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int count = ::recvmmsg(mFD, packets, slots, MSG_DONTWAIT, NULL);
+
+        DEBUG_SOCKETS("IPC_Socket::receivePackets: %d packets on '%s/%d'.", count, mName, mFD);
+
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                ok = receiveError();
+            break;
         }
 
-        mMessageSize = header.mSize;
-        mBufferUsed = 0;
+        for (int i = 0; i < count && isConnected(); i++)
+        {
+            if (packets[i].msg_len == 0)    // connection is being closed.
+                break;
+            if (!VERIFY((packets[i].msg_hdr.msg_flags & MSG_TRUNC) == 0))
+            {
+                DEBUG_SOCKETS_W("IPC_Socket::receivePackets: packet too big  \
+                          on %s/%d. Shutting down socket...", mName, mFD);
+                shutdown();
+                ok = false;
+                break;
+            }
+            if (mCallbacks)
+                mCallbacks->dataReceived(vectors[i].iov_base, packets[i].msg_len);
+        }
+        if (!ok || count < slots)
+            break;
     }
-    if (mMessageSize > mBufferSize)
+
+    releaseBuffer();
+    return ok;
+}
+
+bool IPC_Socket::handleFrames()
+{
+    ssize_t offset = 0;
+    ssize_t needed = 0;     // buffer size the frame being received needs
+    while (isConnected())
     {
-        delete[] mBuffer;
-        mBuffer = 0;
-        mBufferSize = mMessageSize;
-        VERIFY(mBufferUsed == 0);
-    }
-    if (mBuffer == 0)
-        mBuffer = new char[mBufferSize];
+        const char * frame = mBuffer + offset;
+        ssize_t available = mBufferUsed - offset;
+        ssize_t headerSize = 0;
+        ssize_t size = available;
 
-    ssize_t bytes = ::recv(mFD, mBuffer + mBufferUsed,
-                                mMessageSize - mBufferUsed, 0);
-    mBufferUsed += bytes;
+        if (mPacketsSizeMode == eSocketPacketsSize_Controlled)
+        {
+            if (available < (ssize_t) sizeof(IPC_Header))
+                break;
 
-    DEBUG_SOCKETS("IPC_Socket::receiveData: %d bytes payload on '%s/%d'.", bytes, mName, mFD);
+            IPC_Header header;
+            ::memcpy(&header, frame, sizeof(header));
+            if (!VERIFY(header.mSize > 0) ||
+                !VERIFY(header.mMagic == cMagicSignature))
+            {
+                DEBUG_SOCKETS_W("IPC_Socket::handleFrames: invalid header  \
+                          data on %s/%d. Shutting down socket...", mName, mFD);
+                shutdown();
+                return false;
+            }
+            headerSize = sizeof(header);
+            size = header.mSize;
+        }
+        else if (mPacketsSizeMode == eSocketPacketsSize_Fixed)
+            size = mMessageSize;
 
-    if (bytes == 0)    // connection is being closed.
-        return true;
+        if (available == 0 || available < headerSize + size)
+        {
+            needed = headerSize + size;
+            break;
+        }
 
-    if (bytes < 0 || (mPacketsSizeMode == eSocketPacketsSize_Fixed &&
-                      bytes != mMessageSize))
-        return receiveError();
+        // handlers cast the data to structures: keep it aligned
+        const char * data = frame + headerSize;
+        if (offset > 0 && (reinterpret_cast<uintptr_t>(data) % sizeof(ssize_t)) != 0)
+        {
+            ::memmove(mBuffer, frame, available);
+            mBufferUsed = available;
+            offset = 0;
+            continue;
+        }
+
+        if (mCallbacks)
+            mCallbacks->dataReceived(data, size);
+        offset += headerSize + size;
+    }
 
-    if (!VERIFY(mBufferUsed <= mMessageSize)) // should never happen: we got
-                                              // more bytes than we asked for
-                                              // an overrun our buffer... :-(
+    // keep the start of the next frame, with room for all of it
+    if (offset > 0)
     {
-        shutdown();
-        return false;
+        ::memmove(mBuffer, mBuffer + offset, mBufferUsed - offset);
+        mBufferUsed -= offset;
     }
-    if (mPacketsSizeMode == eSocketPacketsSize_Free ||
-        mBufferUsed == mMessageSize)
+    if (needed > mBufferSize)
     {
-        if (mCallbacks)
-            mCallbacks->dataReceived(mBuffer, mBufferUsed);
-        mBufferUsed = 0;
-        if (mPacketsSizeMode == eSocketPacketsSize_Controlled)
-            mMessageSize = 0;
+        char * buffer = new char[needed];
+        ssize_t used = mBufferUsed;
+        ::memcpy(buffer, mBuffer, used);
+        releaseBuffer();
+        mBuffer = buffer;
+        mBufferSize = needed;
+        mBufferUsed = used;
     }
     return true;
 }
@@ -165,11 +321,7 @@ bool IPC_Socket::receiveData()
 bool IPC_Socket::receiveError()
 {
     if (errno == ECONNRESET)
-    {
-        mBufferUsed = 0;    // don't close the connection...
-        if (mPacketsSizeMode == eSocketPacketsSize_Controlled)
-            mMessageSize = 0;
-    }
+        releaseBuffer();    // don't close the connection...
     else
     {
         DEBUG_SOCKETS_W("IPC_Socket::receiveError: error on '%s/%d'.  \
@@ -192,13 +344,30 @@ bool IPC_Socket::send(const void * data,
         return false;
     }
 
-    if (mPacketsSizeMode == eSocketPacketsSize_Controlled)
+    if (size2 < 0 || !data2)
+        size2 = 0;
+
+    IPC_Header    header(size + size2);
+    struct iovec  segments[3];
+    int           count = 0;
+    int           first = 0;    // first segment that goes on the wire
+
+    // sequenced packets don't need a header on the wire, but frames
+    // queued keep theirs, to be sent one per packet later
+    if (mPacketsSizeMode == eSocketPacketsSize_Controlled ||
+        mPacketsSizeMode == eSocketPacketsSize_Sequenced)
+    {
+        segments[count].iov_base = &header;
+        segments[count++].iov_len = sizeof(header);
+    }
+    if (mPacketsSizeMode == eSocketPacketsSize_Sequenced)
     {
-        IPC_Header    header(size + size2);
-        if (::send(mFD, &header, sizeof(header), MSG_DONTWAIT) != sizeof(header))
+        first = 1;
+        if (size + size2 > mMessageSize)
         {
-            g_warning("IPC_SocketServer::send: error '%s' on socket '%s/%d'.",
-                                                  strerror(errno), mName, mFD);
+            g_warning("IPC_SocketServer::send: packet too big  \
+                                    (%zd > %zd) on socket '%s/%d'.",
+                                     size + size2, mMessageSize, mName, mFD);
             return false;
         }
     }
@@ -212,21 +381,152 @@ bool IPC_Socket::send(const void * data,
             return false;
         }
     }
-    if (::send(mFD, data, size, MSG_DONTWAIT) != size ||
-              (size2 > 0 && data2 &&
-              ::send(mFD, data2, size2, MSG_DONTWAIT) != size2))
+    segments[count].iov_base = const_cast<void *>(data);
+    segments[count++].iov_len = size;
+    if (size2 > 0)
+    {
+        segments[count].iov_base = const_cast<void *>(data2);
+        segments[count++].iov_len = size2;
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < count; i++)
+        total += segments[i].iov_len;
+
+    // frames queued before go first: try to get rid of them
+    if (!flushPending())
+        return false;
+
+    size_t sent = 0;
+    if (!hasPendingSend())
     {
-        g_warning("IPC_SocketServer::send: error '%s' on socket '%s/%d'.",
+        struct msghdr message;
+        ::memset(&message, 0, sizeof(message));
+        message.msg_iov = segments + first;
+        message.msg_iovlen = count - first;
+
+        ssize_t bytes;
+        do
+            bytes = ::sendmsg(mFD, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+        while (bytes < 0 && errno == EINTR);
+
+        if (bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            g_warning("IPC_SocketServer::send: error '%s' on socket '%s/%d'.",
                                                 strerror(errno), mName, mFD);
+            return false;
+        }
+        sent = bytes > 0 ? bytes : 0;
+        if (first > 0 && sent > 0)   // a packet goes whole or not at all
+            sent += segments[0].iov_len;
+        if (sent == total)
+        {
+            DEBUG_SOCKETS("IPC_Socket::send: sent %d bytes on '%s/%d'",
+                                                   size + size2, mName, mFD);
+            return true;
+        }
+    }
+    return queuePending(segments, count, total, sent);
+}
+
+bool IPC_Socket::queuePending(const struct iovec * segments, int count,
+                              size_t total, size_t sent)
+{
+    // a frame started must be finished, or the stream is garbled:
+    // only refuse frames that didn't go at all
+    if (sent == 0 &&
+        mPendingSend.size() - mPendingSent + total > cMaxPendingSend)
+    {
+        g_warning("IPC_Socket::send: socket '%s/%d' is full, dropping a %zu bytes message.",
+                                                        mName, mFD, total);
         return false;
     }
-    DEBUG_SOCKETS("IPC_Socket::send: sent %d bytes on '%s/%d'",
-                                                   size + size2, mName, mFD);
+
+    if (mPendingSent > 0)
+    {
+        mPendingSend.erase(mPendingSend.begin(), mPendingSend.begin() + mPendingSent);
+        mPendingSent = 0;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        const char * bytes = (const char *) segments[i].iov_base;
+        size_t length = segments[i].iov_len;
+        size_t skip = sent < length ? sent : length;
+        mPendingSend.insert(mPendingSend.end(), bytes + skip, bytes + length);
+        sent -= skip;
+    }
+
+    if (mChannel && mWriteSourceID == 0)
+        mWriteSourceID = g_io_add_watch(mChannel, GIOCondition(G_IO_OUT),
+                                        IPC_Socket::socketWritableCallback, this);
+    DEBUG_SOCKETS("IPC_Socket::send: %zu bytes queued on '%s/%d'",
+                                  mPendingSend.size(), mName, mFD);
+    return true;
+}
+
+bool IPC_Socket::flushPending()
+{
+    while (hasPendingSend())
+    {
+        ssize_t bytes;
+        if (mPacketsSizeMode == eSocketPacketsSize_Sequenced)
+        {
+            // one packet per frame queued, without its header
+            IPC_Header header;
+            ::memcpy(&header, &mPendingSend[mPendingSent], sizeof(header));
+            bytes = ::send(mFD, &mPendingSend[mPendingSent + sizeof(header)],
+                           header.mSize, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (bytes >= 0)
+                bytes = sizeof(header) + header.mSize;
+        }
+        else
+            bytes = ::send(mFD, &mPendingSend[mPendingSent],
+                           mPendingSend.size() - mPendingSent,
+                           MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (bytes < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return true;
+            g_warning("IPC_Socket::flushPending: error '%s' on socket '%s/%d'.",
+                                                strerror(errno), mName, mFD);
+            mPendingSend.clear();
+            mPendingSent = 0;
+            return false;
+        }
+        mPendingSent += bytes;
+    }
+    mPendingSend.clear();
+    mPendingSent = 0;
     return true;
 }
 
+gboolean IPC_Socket::socketWritableCallback(GIOChannel * ch,
+                                            GIOCondition condition,
+                                            gpointer user_data)
+{
+    IPC_Socket * socket = reinterpret_cast<IPC_Socket *> (user_data);
+
+    if (!VERIFY(socket))
+        return FALSE;
+
+    if (socket->isConnected() && socket->flushPending() && socket->hasPendingSend())
+        return TRUE;
+
+    socket->mWriteSourceID = 0;
+    return FALSE;
+}
+
 void IPC_Socket::shutdown()
 {
+    if (mWriteSourceID)
+    {
+        g_source_remove(mWriteSourceID);
+        mWriteSourceID = 0;
+    }
+    mPendingSend.clear();
+    mPendingSent = 0;
     if (mFD != -1)
     {
         ::shutdown(mFD, SHUT_RDWR);
@@ -239,7 +539,9 @@ void IPC_Socket::close(bool flush)
 {
     if (mChannel)
     {
-        g_io_channel_shutdown(mChannel, flush ? TRUE : FALSE, NULL);
+        // once shut down, the fd is closed & may already belong to someone else
+        if (mFD != -1)
+            g_io_channel_shutdown(mChannel, flush ? TRUE : FALSE, NULL);
         g_source_remove(mSourceID);
         g_io_channel_unref(mChannel);
         mChannel = 0;
@@ -248,9 +550,7 @@ void IPC_Socket::close(bool flush)
             mCallbacks->closed(this);
     }
     shutdown();
-    delete[] mBuffer;
-    mBuffer = 0;
-    mBufferUsed = 0;
+    releaseBuffer();
 }
 
 gboolean IPC_SocketClient::socketStatusCallback(GIOChannel * ch,
@@ -277,7 +577,8 @@ gboolean IPC_SocketClient::socketConnectTimerCallback(gpointer user_data)
 
 IPC_SocketClient::IPC_SocketClient() : mTimeout(10),
                                        mConnectAttempt(0),
-                                       mAutoConnect(false)
+                                       mAutoConnect(false),
+                                       mPacketsSizeMode(eSocketPacketsSize_Controlled)
 {
     *socketName() = 0;
     mSocket.mName = socketName();
@@ -289,6 +590,7 @@ bool IPC_SocketClient::connect(const char * name,
                                ssize_t packetSize)
 {
     mSocket.setPacketing(packetsSizeMode, packetSize);
+    mPacketsSizeMode = packetsSizeMode;
     mAutoConnect = autoConnect;
     ::memset(&mAddressName, 0, sizeof(mAddressName));
     mAddressName.sun_family = AF_UNIX;
@@ -328,14 +630,9 @@ bool IPC_SocketClient::tryAndRetryToConnect()
     return connected;
 }
 
-bool IPC_SocketClient::tryToConnectOnce()
+bool IPC_SocketClient::connectSocket(int type)
 {
-    if (isConnected())
-        return true;
-
-    ++mConnectAttempt;
-
-    if (-1 == (mSocket.mFD = ::socket(AF_UNIX, SOCK_STREAM, 0)))
+    if (-1 == (mSocket.mFD = ::socket(AF_UNIX, type, 0)))
     {
         g_warning("IPC_SocketClient::connect: error '%s' on socket '%s/%d'.",
                                   strerror(errno), socketName(), mSocket.mFD);
@@ -359,6 +656,31 @@ bool IPC_SocketClient::tryToConnectOnce()
         mSocket.mFD = -1;
         return false;
     }
+    return true;
+}
+
+bool IPC_SocketClient::tryToConnectOnce()
+{
+    if (isConnected())
+        return true;
+
+    ++mConnectAttempt;
+
+    // a server that doesn't know about sequenced packets only listens
+    // to a stream socket: talk to it in controlled mode
+    mSocket.setPacketing(mPacketsSizeMode, mSocket.mPacketSize);
+    if (mPacketsSizeMode == eSocketPacketsSize_Sequenced &&
+        !connectSocket(SOCK_SEQPACKET))
+    {
+        mSocket.setPacketing(eSocketPacketsSize_Controlled, mSocket.mPacketSize);
+        if (!connectSocket(SOCK_STREAM))
+            return false;
+        g_message("IPC_SocketClient::connect: '%s' uses controlled packets.",
+                                                                socketName());
+    }
+    else if (mPacketsSizeMode != eSocketPacketsSize_Sequenced &&
+             !connectSocket(SOCK_STREAM))
+        return false;
 
     mSocket.mChannel = g_io_channel_unix_new(mSocket.mFD);
     mSocket.mSourceID = g_io_add_watch(mSocket.mChannel,
@@ -426,6 +748,7 @@ void IPC_SocketClient::statusCallback(GIOChannel *ch, GIOCondition condition)
 
 IPC_SocketServer::IPC_SocketServer() : mCallbacks(0),
                                        mSocketCallbacks(0),
+                                       mConnectionsCount(0),
                                        mMaxConnectionsCount(64)
 {
     *socketName() = 0;
@@ -443,8 +766,12 @@ void IPC_SocketServer::setMaxConnectionsCount(size_t maxConnectionsCount)
 
 void IPC_SocketServer::closeAll()
 {
+    for (size_t fd = 0; fd < mConnections.size(); fd++)
+        if (mConnections[fd])
+            removeConnection(fd);
     mConnections.clear();
     mSocket.close(false);
+    mFallbackSocket.close(false);
     *socketName() = 0;
 }
 
@@ -472,8 +799,27 @@ bool IPC_SocketServer::listen(const char * name,
 
     ::strncpy(socketName(), name, nameLength);
 
+    if (packetsSizeMode != eSocketPacketsSize_Sequenced)
+        return listenSocket(mSocket, SOCK_STREAM);
+
+    if (!listenSocket(mSocket, SOCK_SEQPACKET))
+        return false;
+
+    // clients that don't know about sequenced packets connect to a stream
+    // socket of the same name: talk to them in controlled mode
+    mFallbackSocket.setPacketing(eSocketPacketsSize_Controlled, packetSize);
+    if (!listenSocket(mFallbackSocket, SOCK_STREAM))
+        g_warning("IPC_SocketServer::create: no controlled packets fallback for '%s'.", name);
+    return true;
+}
+
+bool IPC_SocketServer::listenSocket(IPC_Socket & socket, int type)
+{
+    const char * name = socketName();
+    size_t nameLength = ::strlen(name) + 1;
+
     /* build the socket */
-    if (-1 == (mSocket.mFD = socket(AF_UNIX, SOCK_STREAM, 0)))
+    if (-1 == (socket.mFD = ::socket(AF_UNIX, type, 0)))
     {
         g_warning("IPC_SocketServer::create: error creating socket   \
                                             '%s': %s ", name, strerror(errno));
@@ -481,28 +827,28 @@ bool IPC_SocketServer::listen(const char * name,
     }
 
     /* bind it to a name */
-    if (-1 == ::bind(mSocket.mFD, (struct sockaddr*) &(mAddressName),
+    if (-1 == ::bind(socket.mFD, (struct sockaddr*) &(mAddressName),
                                     _NAME_STRUCT_OFFSET (struct sockaddr_un,
                                                       sun_path) + nameLength))
     {
         g_warning("IPC_SocketServer::create: error binding socket   \
-                            '%s/%d': %s ", name, mSocket.mFD, strerror(errno));
-        ::close(mSocket.mFD);
-        mSocket.mFD = -1;
+                            '%s/%d': %s ", name, socket.mFD, strerror(errno));
+        ::close(socket.mFD);
+        socket.mFD = -1;
         return false;
     }
 
-    if (-1 == ::listen(mSocket.mFD, 5))
+    if (-1 == ::listen(socket.mFD, 5))
     {
         g_warning("IPC_SocketServer::create: error listening to socket   \
-                            '%s/%d': %s ", name, mSocket.mFD, strerror(errno));
-        ::close(mSocket.mFD);
-        mSocket.mFD = -1;
+                            '%s/%d': %s ", name, socket.mFD, strerror(errno));
+        ::close(socket.mFD);
+        socket.mFD = -1;
         return false;
     }
 
-    mSocket.mChannel = g_io_channel_unix_new(mSocket.mFD);
-    mSocket.mSourceID = g_io_add_watch(mSocket.mChannel,
+    socket.mChannel = g_io_channel_unix_new(socket.mFD);
+    socket.mSourceID = g_io_add_watch(socket.mChannel,
                                        GIOCondition(G_IO_ERR |
                                                     G_IO_HUP |
                                                     G_IO_IN),
@@ -526,31 +872,43 @@ gboolean IPC_SocketServer::socketListenCallback(GIOChannel * ch,
 
 void IPC_SocketServer::listenCallback(GIOChannel * ch, GIOCondition condition)
 {
-    if (!VERIFY(ch == mSocket.mChannel))
+    // connections get the packet mode of the socket they came from
+    IPC_Socket * listener = ch == mSocket.mChannel ? &mSocket :
+                            ch == mFallbackSocket.mChannel ? &mFallbackSocket : 0;
+    if (!VERIFY(listener))
         return;
 
     if (condition & G_IO_IN)
     {
-        if (mConnections.size() < mMaxConnectionsCount)
+        if (mConnectionsCount < mMaxConnectionsCount)
         {
             int    fd = -1;
             size_t nameLength = ::strlen(socketName()) + 1;
             socklen_t len = _NAME_STRUCT_OFFSET
                                    (struct sockaddr_un, sun_path) + nameLength;
-            if (-1 == (fd = ::accept(mSocket.mFD,
+            if (-1 == (fd = ::accept(listener->mFD,
                                    (struct sockaddr*) &mAddressName, &len)))
             {
                 g_warning("IPC_SocketServer::listenCallback: could not   \
                                create new connection on socket: '%s/%d' (%s)",
-                                socketName(), mSocket.mFD, strerror(errno));
+                                socketName(), listener->mFD, strerror(errno));
             }
             else
             {
                 g_message("IPC_SocketServer::listenCallback: created   \
                                      connection '%s/%d' on socket '%s/%d'",
-                                     socketName(), fd, socketName(), mSocket.mFD);
+                                     socketName(), fd, socketName(), listener->mFD);
+                // the fd was reused: its former connection was shut down &
+                // only needs detaching, which leaves the fd alone
+                if ((size_t) fd < mConnections.size() && mConnections[fd])
+                    removeConnection(fd);
+                if ((size_t) fd >= mConnections.size())
+                    mConnections.resize(fd + 1, 0);
+                mConnections[fd] = new IPC_Socket;
+                ++mConnectionsCount;
+
                 GIOChannel * channel = g_io_channel_unix_new(fd);
-                IPC_Socket & socket = mConnections[channel];
+                IPC_Socket & socket = *mConnections[fd];
                 socket.mName = socketName();
                 socket.mFD = fd;
                 socket.mChannel = channel;
@@ -560,33 +918,35 @@ void IPC_SocketServer::listenCallback(GIOChannel * ch, GIOCondition condition)
                                                                G_IO_IN),
                                                  IPC_SocketServer::socketConnectionCallback,
                                                   this);
-                socket.setPacketing(mSocket.mPacketsSizeMode,
-                                    mSocket.mBufferSize);
+                socket.setPacketing(listener->mPacketsSizeMode,
+                                    listener->mPacketSize);
                 if (mSocketCallbacks)
                     socket.setCallbacks(mSocketCallbacks);
                 if (mCallbacks)
                     mCallbacks->newConnection(socket);
                 socket.connectionEstablished();
+                if (!socket.isConnected())
+                    removeConnection(fd);
             }
         }
         else
         {
             g_warning("IPC_SocketServer::listenCallback: declined new   \
                          connection on '%s/%d': too many connections (%u)!...",
-                         socketName(), mSocket.mFD, mConnections.size());
+                         socketName(), listener->mFD, mConnectionsCount);
         }
     }
 
     if (condition & G_IO_ERR)
     {
         g_warning("IPC_SocketServer::listenCallback: error condition   \
-                               on socket '%s/%d'.", socketName(), mSocket.mFD);
+                               on socket '%s/%d'.", socketName(), listener->mFD);
     }
 
     if (condition & G_IO_HUP)
     {
         g_warning("IPC_SocketServer::listenCallback: socket   \
-                                 '%s/%d' hung up.", socketName(), mSocket.mFD);
+                                 '%s/%d' hung up.", socketName(), listener->mFD);
         this->closeAll();
     }
 }
@@ -606,11 +966,12 @@ gboolean IPC_SocketServer::socketConnectionCallback(GIOChannel * ch,
 void IPC_SocketServer::connectionCallback(GIOChannel * ch,
                                           GIOCondition condition)
 {
-    SocketMap::iterator iter = mConnections.find(ch);
-    if (!VERIFY(iter != mConnections.end()))
+    int fd = g_io_channel_unix_get_fd(ch);
+    if (!VERIFY(fd >= 0 && (size_t) fd < mConnections.size() &&
+                mConnections[fd] && mConnections[fd]->mChannel == ch))
         return;
 
-    IPC_Socket & connection = iter->second;
+    IPC_Socket & connection = *mConnections[fd];
 
     if (condition & G_IO_IN)
     {
@@ -619,19 +980,34 @@ void IPC_SocketServer::connectionCallback(GIOChannel * ch,
                                        receive error on socket '%s/%d' (%s).",
                                         connection.mName, connection.mFD,
                                          strerror(errno));
+        // shut down while receiving: drop it now, before its fd gets reused
+        if (!connection.isConnected())
+        {
+            removeConnection(fd);
+            return;
+        }
     }
 
     if (condition & G_IO_HUP)
     {
         g_warning("IPC_SocketServer::socketConnectionCallback:   \
                     socket '%s/%d' hung up.", connection.mName, connection.mFD);
-        mConnections.erase(iter);
+        removeConnection(fd);
     }
     else if (condition & G_IO_ERR)
     {
         g_warning("IPC_SocketServer::socketConnectionCallback: error   \
                                   condition on socket '%s/%d'. Closing it...",
                                   connection.mName, connection.mFD);
-        mConnections.erase(iter);
+        removeConnection(fd);
     }
 }
+
+void IPC_SocketServer::removeConnection(int fd)
+{
+    // free the slot first: closing the socket calls back
+    IPC_Socket * connection = mConnections[fd];
+    mConnections[fd] = 0;
+    --mConnectionsCount;
+    delete connection;
+}
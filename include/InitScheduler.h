@@ -0,0 +1,119 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#ifndef _INIT_SCHEDULER_H_
+#define _INIT_SCHEDULER_H_
+
+#include <pthread.h>
+#include <deque>
+#include <set>
+#include <string>
+#include <vector>
+
+enum EInitPhase
+{
+    eInitPhase_Init = 0,
+    eInitPhase_Module,
+    eInitPhase_Control,
+    eInitPhase_Service
+};
+
+enum EInitHookFlags
+{
+    eInitHook_MainThread = 0,   // runs on the thread calling run()
+    eInitHook_ThreadSafe = 1    // may run on a worker thread
+};
+
+/*
+ * Runs the daemon's init & start hooks.
+ * Hooks registered without dependencies keep their historical behaviour: they
+ * run on the main thread, after every hook of the earlier phases & every hook
+ * registered before them in their own phase.
+ * Hooks that declare their dependencies (a comma separated list of hook names,
+ * possibly empty) only wait for those, and if they are also thread safe, run on
+ * a small worker pool, so that slow file I/O or bus calls overlap with the rest
+ * of the startup. Main thread hooks are still run one at a time.
+ * If the dependencies can't be satisfied (unknown name or cycle), everything
+ * runs serially on the main thread, in phase & registration order.
+ */
+class InitScheduler
+{
+public:
+    typedef int (*HookFunction)(void * data);
+    /// Called around each hook, from the thread running it
+    typedef void (*Observer)(const std::string & hook, bool started, void * data);
+
+    InitScheduler();
+    ~InitScheduler();
+
+    /// dependencies: NULL for a hook without declaration, or "name1,name2"
+    void            add(EInitPhase phase, const char * name, HookFunction function,
+                        void * data, const char * dependencies, int flags);
+
+    /// Run all hooks, using at most 'workers' threads for the thread safe ones.
+    /// Returns false if a hook failed: no hook depending on it was started.
+    bool            run(int workers);
+
+    const std::string & failedHook() const          { return mFailedHook; }
+
+    /// Why the last run() was serial, empty if it wasn't
+    const std::string & serialReason() const        { return mSerialReason; }
+
+    void            clear();
+
+    void            setObserver(Observer observer, void * data);
+
+    static const int cDefaultWorkers = 2;
+
+private:
+    struct Hook
+    {
+        EInitPhase          mPhase;
+        std::string         mName;
+        HookFunction        mFunction;
+        void *              mData;
+        bool                mDeclared;
+        bool                mThreadSafe;
+        std::vector<std::string> mDependencyNames;
+        std::vector<size_t> mDependents;
+        int                 mPending;
+    };
+
+    bool            resolve();
+    bool            runSerially();
+    int             call(size_t index);
+    void            release(size_t index);
+    void            complete(size_t index, int result);
+    static void *   workerThread(void * data);
+
+    std::vector<Hook>   mHooks;     // in phase, then registration order, once resolved
+
+    pthread_mutex_t     mMutex;
+    pthread_cond_t      mCondition;
+    std::deque<size_t>  mWorkerQueue;
+    std::set<size_t>    mMainQueue;
+    size_t              mDone;
+    int                 mRunning;
+    int                 mWorkers;
+    bool                mStop;
+    std::string         mFailedHook;
+    std::string         mSerialReason;
+    Observer            mObserver;
+    void *              mObserverData;
+};
+
+#endif // _INIT_SCHEDULER_H_
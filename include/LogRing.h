@@ -0,0 +1,79 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef LOG_RING_H_
+#define LOG_RING_H_
+
+#include <atomic>
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+/*
+ * Bounded queue of log records, for many producers & a single consumer,
+ * without locks.
+ * The ring is made of fixed size slots, each with a sequence number telling
+ * whether it's free or published for the current lap. A record takes as many
+ * consecutive slots as it needs: a producer claims them all at once by moving
+ * the enqueue position forward, copies its record & publishes the slots.
+ * When there isn't room, the record is dropped & counted instead of waiting,
+ * so that logging never blocks the caller.
+ */
+class LogRing
+{
+public:
+    /// slots: rounded up to a power of 2
+    explicit LogRing(size_t slots);
+    ~LogRing();
+
+    /// Copy a record made of several parts, truncated to cMaxRecordSize.
+    /// Returns false if it had to be dropped.
+    bool            push(unsigned char tag, const struct iovec * parts, int count);
+
+    /// Consumer only: get the oldest record, if it's completely published
+    bool            pop(unsigned char & tag, std::string & record);
+
+    bool            empty() const;
+
+    /// Records dropped since the last call
+    unsigned long   takeDropped()       { return mDropped.exchange(0); }
+
+    static const size_t cSlotDataSize = 240;
+    static const size_t cMaxSlotsPerRecord = 32;
+    static const size_t cMaxRecordSize = cSlotDataSize * cMaxSlotsPerRecord;
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> mSequence;
+        uint8_t             mTag;
+        uint8_t             mCount;     // slots of the record, in its first slot
+        uint16_t            mSize;      // bytes used in this slot
+        char                mData[cSlotDataSize];
+    };
+
+    Slot &          slot(size_t position)   { return mSlots[position & mMask]; }
+
+    Slot *              mSlots;
+    size_t              mMask;
+    size_t              mMaxSlots;
+    std::atomic<size_t> mEnqueuePosition;
+    std::atomic<size_t> mDequeuePosition;
+    std::atomic<unsigned long> mDropped;
+};
+
+#endif // LOG_RING_H_
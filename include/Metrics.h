@@ -0,0 +1,155 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+ * In-process metrics: counters, gauges & latency histograms with fixed
+ * buckets. Updating a metric is a relaxed atomic operation, so it's cheap
+ * enough for hot paths & safe from any thread.
+ * Metrics register themselves by name when they are constructed, usually as
+ * static objects next to the code they measure:
+ *     static MetricsCounter sSent("mixer.commands.sent");
+ * Metrics::report() lists them all as a JSON object, sorted by name:
+ * { "counters": { "mixer.commands.sent": 12 },
+ *   "gauges": { "pulse.connected": 1 },
+ *   "histograms": { "luna./state/getMetrics": { "count": 2, "sum_us": 310,
+ *       "max_us": 200, "bounds_us": [ 50, 100, ... ], "counts": [ 0, 0, ... ] } } }
+ * The last histogram count is for the values above the last bound.
+ */
+class Metric
+{
+public:
+    enum EType
+    {
+        eCounter,
+        eGauge,
+        eHistogram
+    };
+
+    const char *    getName() const     { return mName; }
+    EType           getType() const     { return mType; }
+
+protected:
+    Metric(const char * name, EType type);
+    ~Metric();
+
+private:
+    Metric(const Metric &);
+    Metric & operator=(const Metric &);
+
+    friend class Metrics;
+
+    const char *    mName;
+    EType           mType;
+    Metric *        mNext;
+};
+
+/// Counts events. Only goes up.
+class MetricsCounter : public Metric
+{
+public:
+    explicit MetricsCounter(const char * name) : Metric(name, eCounter), mValue(0) {}
+
+    void            add(uint64_t count = 1)
+                        { mValue.fetch_add(count, std::memory_order_relaxed); }
+    uint64_t        get() const { return mValue.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t>   mValue;
+};
+
+/// A value that goes up & down, like a number of connections.
+class MetricsGauge : public Metric
+{
+public:
+    explicit MetricsGauge(const char * name) : Metric(name, eGauge), mValue(0) {}
+
+    void            set(int64_t value)  { mValue.store(value, std::memory_order_relaxed); }
+    void            add(int64_t delta)  { mValue.fetch_add(delta, std::memory_order_relaxed); }
+    int64_t         get() const         { return mValue.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t>    mValue;
+};
+
+/// Latencies, in microseconds, counted in fixed buckets
+class MetricsHistogram : public Metric
+{
+public:
+    explicit MetricsHistogram(const char * name);
+
+    void            record(uint64_t microseconds);
+
+    uint64_t        getCount() const    { return mCount.load(std::memory_order_relaxed); }
+    uint64_t        getSum() const      { return mSum.load(std::memory_order_relaxed); }
+    uint64_t        getMax() const      { return mMax.load(std::memory_order_relaxed); }
+    uint64_t        getBucket(int bucket) const
+                        { return mBuckets[bucket].load(std::memory_order_relaxed); }
+
+    /// Upper bound of each bucket, the last one excepted
+    static const int        cBucketCount = 16;
+    static const uint64_t   cBounds[cBucketCount - 1];
+
+private:
+    std::atomic<uint64_t>   mBuckets[cBucketCount];
+    std::atomic<uint64_t>   mCount;
+    std::atomic<uint64_t>   mSum;
+    std::atomic<uint64_t>   mMax;
+};
+
+/// The registry of all the metrics of the process
+class Metrics
+{
+public:
+    /// All the metrics as a JSON object
+    static std::string  report();
+
+    /// One line per metric that was used, to dump them in the logs
+    static std::string  summary();
+
+    /// Monotonic time in microseconds
+    static uint64_t     now();
+
+private:
+    friend class Metric;
+
+    static void         add(Metric * metric);
+    static void         remove(Metric * metric);
+    static std::vector<const Metric *> sorted();
+};
+
+/// Records the time spent in a scope in a histogram
+class MetricsTimer
+{
+public:
+    explicit MetricsTimer(MetricsHistogram & histogram) :
+        mHistogram(histogram), mStart(Metrics::now())   {}
+    ~MetricsTimer()                 { mHistogram.record(Metrics::now() - mStart); }
+
+private:
+    MetricsHistogram &  mHistogram;
+    uint64_t            mStart;
+};
+
+#endif // _METRICS_H_
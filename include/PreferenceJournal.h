@@ -0,0 +1,106 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#ifndef _PREFERENCE_JOURNAL_H_
+#define _PREFERENCE_JOURNAL_H_
+
+#include <map>
+#include <string>
+#include <sys/types.h>
+
+/*
+ * Append-only store for preferences.
+ * Each change is appended to a journal as a small checksummed record. Records
+ * are buffered & written together by flush(), with a single fdatasync, so the
+ * caller decides how often the flash gets written.
+ * Once the journal has grown enough, compact() writes all the values in a new
+ * binary snapshot (written aside, synced, then renamed over the old one) and
+ * empties the journal. Opening maps & loads the snapshot, then replays the
+ * journal, ignoring a torn record at the end of the journal, as left by a crash
+ * in the middle of a write. A snapshot of another version or with a bad
+ * checksum is rejected: the values it held must then be restored from elsewhere.
+ * Values are strings, typed by the helpers below.
+ */
+class PreferenceJournal
+{
+public:
+    typedef std::map<std::string, std::string> Values;
+
+    /// Files are 'directory/name.snapshot' & 'directory/name.journal'
+    PreferenceJournal(const std::string & directory, const std::string & name);
+    ~PreferenceJournal();
+
+    /// Load the snapshot & replay the journal. Returns false if neither existed.
+    bool            open();
+
+    bool            isOpen() const                  { return mJournalFd >= 0; }
+
+    /// Did open() find a snapshot it couldn't use?
+    bool            snapshotRejected() const        { return mSnapshotRejected; }
+
+    const Values &  values() const                  { return mValues; }
+    bool            get(const std::string & key, std::string & value) const;
+
+    /// Record changes. Nothing is written until flush(). Setting a key to
+    // the value it already has is free.
+    void            set(const std::string & key, const std::string & value);
+    void            erase(const std::string & key);
+
+    bool            hasPendingChanges() const       { return !mPending.empty(); }
+
+    /// Write the pending records & sync them
+    bool            flush();
+
+    /// Has the journal grown enough to be worth a compaction?
+    bool            needsCompaction() const;
+
+    /// Write a new snapshot of all values & empty the journal
+    bool            compact();
+
+    /// Typed values
+    static std::string  fromBool(bool value)        { return value ? "b1" : "b0"; }
+    static std::string  fromInt(int value);
+    static std::string  fromString(const std::string & value) { return "s" + value; }
+    static bool         toBool(const std::string & value, bool & out);
+    static bool         toInt(const std::string & value, int & out);
+    static bool         toString(const std::string & value, std::string & out);
+
+    /// Journal records before compaction is recommended
+    static const int    cCompactionThreshold = 256;
+
+    /// Snapshot format version, to bump when the layout changes
+    static const unsigned int cSnapshotVersion = 2;
+
+private:
+    void            append(char op, const std::string & key, const std::string & value);
+    bool            loadSnapshot();
+    bool            parseSnapshot(const char * data, size_t size);
+    bool            replay(const std::string & path, off_t & validSize);
+    bool            apply(const std::string & line);
+    bool            openJournal();
+
+    std::string     mDirectory;
+    std::string     mSnapshotPath;
+    std::string     mJournalPath;
+    int             mJournalFd;
+    int             mJournalRecords;
+    bool            mSnapshotRejected;
+    Values          mValues;
+    std::string     mPending;
+};
+
+#endif // _PREFERENCE_JOURNAL_H_
@@ -0,0 +1,58 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#ifndef _PREFERENCE_TABLES_H_
+#define _PREFERENCE_TABLES_H_
+
+#include <map>
+#include <string>
+
+namespace pbnjson { class JValue; }
+
+template <class T> struct PreferencePair
+{
+    void    init(const T & value)
+    {
+        mValue = mDefaultValue = value;
+    }
+    T    mValue;
+    T    mDefaultValue;
+};
+
+typedef std::map<std::string, PreferencePair<bool> > TBooleanPreferences;
+typedef std::map<std::string, PreferencePair<std::string> > TStringPreferences;
+typedef std::map<std::string, PreferencePair<int> > TintPreferences;
+
+/*
+ * Preferences are restored either from luna-prefs, as JSON, or from the
+ * preference journal. Both go through the journal's typed encoding (see
+ * PreferenceJournal), so that a value restores the same from either source.
+ */
+
+/// Journal encoding of a JSON value: a bool, a string or an integer, tried in that order.
+bool                preferenceFromJson(pbnjson::JValue json, std::string & value);
+
+/// JSON value of a journal encoding, null if it isn't one
+pbnjson::JValue     preferenceToJson(const std::string & value);
+
+/// Set a known preference to an encoded value, in the table of the value's type.
+// Returns false if there is no preference of that name & type.
+bool                restorePreference(TBooleanPreferences & booleans, TStringPreferences & strings,
+                                      TintPreferences & integers, const std::string & name,
+                                      const std::string & value);
+
+#endif // _PREFERENCE_TABLES_H_
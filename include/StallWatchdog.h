@@ -0,0 +1,105 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#ifndef _STALL_WATCHDOG_H_
+#define _STALL_WATCHDOG_H_
+
+#include <atomic>
+#include <pthread.h>
+#include <stdint.h>
+
+/// Names the main loop handler running, for as long as the object exists.
+/// Use in main loop callbacks only: Luna methods, IO watches, timers...
+/// The name must live as long as the process (a string literal).
+/// A handler that runs longer than the watchdog threshold is logged.
+class MainLoopHandler
+{
+public:
+    explicit MainLoopHandler(const char * name);
+    ~MainLoopHandler();
+
+    /// Innermost handler running in the main loop, if any
+    static const char * current()   { return sCurrent.load(std::memory_order_relaxed); }
+
+private:
+    MainLoopHandler(const MainLoopHandler &);
+    MainLoopHandler & operator=(const MainLoopHandler &);
+
+    const char *    mName;
+    const char *    mPrevious;
+    uint64_t        mStart;
+
+    static std::atomic<const char *>    sCurrent;
+};
+
+#define MAINLOOP_HANDLER(name) MainLoopHandler mainLoopHandler(name)
+
+/*
+ * Detects when the main loop stops running for longer than a threshold.
+ * The main loop calls beat() from a periodic timer, which records how late
+ * each beat is in the "mainloop.lag" histogram. A watchdog thread checks
+ * that the beats keep coming: when one is late by more than the threshold,
+ * it reports the stall while it's happening, with the main loop handler
+ * running at that time, in the logs & the flight recorder.
+ */
+class StallWatchdog
+{
+public:
+    StallWatchdog();
+    ~StallWatchdog();
+
+    struct Stall
+    {
+        uint64_t        mDuration;  // us, so far
+        const char *    mHandler;   // NULL if none was marked
+    };
+
+    /// Interval of the beats & report threshold, in ms
+    void            configure(unsigned intervalMs, unsigned thresholdMs);
+    unsigned        getInterval() const     { return mInterval / 1000; }
+    unsigned        getThreshold() const    { return mThreshold / 1000; }
+
+    /// Main loop: the timer fired. Returns how late it was (us).
+    uint64_t        beat(uint64_t now);
+
+    /// Watchdog: true once per stall longer than the threshold
+    bool            check(uint64_t now, Stall & stall);
+
+    /// Start & stop the watchdog thread. The beats are up to the caller.
+    bool            start();
+    void            stop();
+
+    /// Last threshold configured, for the handlers to compare with (us)
+    static uint64_t threshold()     { return sThreshold.load(std::memory_order_relaxed); }
+
+    static const unsigned cDefaultInterval = 250;
+    static const unsigned cDefaultThreshold = 100;
+
+private:
+    static void *   run(void * data);
+
+    uint64_t                mInterval;
+    uint64_t                mThreshold;
+    std::atomic<uint64_t>   mLastBeat;
+    uint64_t                mReportedBeat;  // watchdog thread only
+    std::atomic<bool>       mRunning;
+    pthread_t               mThread;
+
+    static std::atomic<uint64_t>    sThreshold;
+};
+
+#endif // _STALL_WATCHDOG_H_
@@ -0,0 +1,95 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#ifndef _STARTUP_PROFILER_H_
+#define _STARTUP_PROFILER_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+ * Records when the startup phases of the daemon begin & end, and when some
+ * one-time events first happen, on the monotonic clock.
+ * The report is a JSON object, times in microseconds relative to the profiler's
+ * creation (during static initialization), plus that origin as an absolute
+ * monotonic time, so that reports from different boots & releases compare:
+ * { "origin_us": 1234567, "events": [
+ *     { "name": "state init", "start_us": 150, "end_us": 900 },
+ *     { "name": "pulse connected", "at_us": 81200 } ] }
+ * Phases may be recorded from any thread. Once the report is written,
+ * recording stops, so that the daemon's normal life isn't profiled.
+ */
+class StartupProfiler
+{
+public:
+    StartupProfiler();
+    ~StartupProfiler();
+
+    /// A phase. Only its first occurrence is recorded.
+    void            begin(const std::string & name);
+    void            end(const std::string & name);
+
+    /// An instant event. Returns false if it was already recorded.
+    bool            mark(const std::string & name);
+
+    bool            isRecording() const;
+
+    /// Stop recording & get the report
+    std::string     finish();
+
+    /// Write a report in a file
+    static bool     write(const std::string & report, const std::string & path);
+
+    static uint64_t now();
+
+private:
+    struct Event
+    {
+        std::string mName;
+        uint64_t    mStart;
+        uint64_t    mEnd;
+        bool        mInstant;
+        bool        mOpen;
+    };
+
+    Event *         find(const std::string & name);
+    std::string     report() const;
+
+    mutable pthread_mutex_t mMutex;
+    uint64_t            mOrigin;
+    bool                mRecording;
+    std::vector<Event>  mEvents;
+};
+
+/// Records a phase for the lifetime of the object
+class StartupPhase
+{
+public:
+    StartupPhase(StartupProfiler & profiler, const std::string & name) :
+        mProfiler(profiler), mName(name)            { mProfiler.begin(mName); }
+    ~StartupPhase()                                 { mProfiler.end(mName); }
+
+private:
+    StartupProfiler &   mProfiler;
+    std::string         mName;
+};
+
+extern StartupProfiler gStartupProfiler;
+
+#endif // _STARTUP_PROFILER_H_
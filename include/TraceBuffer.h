@@ -0,0 +1,99 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#ifndef _TRACE_BUFFER_H_
+#define _TRACE_BUFFER_H_
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+// where audiod writes its trace when asked to
+#define TRACE_BUFFER_PATH "/tmp/audiod-trace.json"
+
+/*
+ * Tracing backend used when LTTng isn't available: see audiodTracer.h.
+ * Each thread records its tracepoints in its own ring, without locks or
+ * system calls but a clock read. The rings keep the most recent events,
+ * & are only read when the trace is written, in the Chrome trace event
+ * format, that chrome://tracing & Perfetto display as timelines.
+ * Tracepoint names must be string literals (or live as long as the process):
+ * only their address is recorded. Text arguments are copied, truncated.
+ */
+class TraceBuffer
+{
+public:
+    enum EPhase
+    {
+        ePhase_Begin = 'B',
+        ePhase_End = 'E',
+        ePhase_Instant = 'i'
+    };
+
+    /// How to present the arguments of an event
+    enum EArgs
+    {
+        eArgs_None,
+        eArgs_Text,             // text
+        eArgs_MixerCommand,     // code: command, a: sink, b: value
+        eArgs_Sample            // text: sample, a: sink
+    };
+
+    static void         record(EPhase phase, const char * name, EArgs args = eArgs_None,
+                               const char * text = 0, char code = 0,
+                               int32_t a = 0, int32_t b = 0)
+    {
+        if (sEnabled.load(std::memory_order_relaxed))
+            add(phase, name, args, text, code, a, b);
+    }
+
+    static void         setEnabled(bool enabled)    { sEnabled.store(enabled); }
+    static bool         isEnabled()                 { return sEnabled.load(); }
+
+    /// All the threads' events, as a Chrome trace
+    static std::string  chromeTrace();
+    static bool         writeChromeTrace(const char * path);
+
+    /// Events kept per thread
+    static const unsigned   cEventsPerThread = 4096;
+    static const unsigned   cTextSize = 32;
+
+private:
+    static void         add(EPhase phase, const char * name, EArgs args,
+                            const char * text, char code, int32_t a, int32_t b);
+
+    static std::atomic<bool>    sEnabled;
+};
+
+/// Records the duration of a scope
+class TraceBufferScope
+{
+public:
+    TraceBufferScope(const char * name, const char * text = 0) : mName(name)
+        { TraceBuffer::record(TraceBuffer::ePhase_Begin, name,
+                              text ? TraceBuffer::eArgs_Text : TraceBuffer::eArgs_None, text); }
+    ~TraceBufferScope()
+        { TraceBuffer::record(TraceBuffer::ePhase_End, mName); }
+
+private:
+    TraceBufferScope(const TraceBufferScope &);
+    TraceBufferScope & operator=(const TraceBufferScope &);
+
+    const char *    mName;
+};
+
+#endif // _TRACE_BUFFER_H_
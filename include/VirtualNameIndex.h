@@ -0,0 +1,81 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#ifndef _VIRTUAL_NAME_INDEX_H_
+#define _VIRTUAL_NAME_INDEX_H_
+
+#include <vector>
+#include <cstddef>
+
+/*
+ * Sorted name -> identifier table used to resolve virtual sink & source names.
+ * The pulse policy tables are walked once to build the index, so it follows
+ * pulse/module-palm-policy-tables.h without having to be maintained by hand.
+ * Lookups are a binary search instead of a strcmp over every table entry.
+ */
+class VirtualNameIndex
+{
+public:
+    /// Add a name. If the name is already known, the first identifier wins,
+    // matching the behavior of the former linear scan.
+    void        insert(const char * name, int identifier);
+
+    /// Find the identifier of a name, or return notFound.
+    int         lookup(const char * name, int notFound) const;
+
+    size_t      size() const                        { return mEntries.size(); }
+
+    /// Build an index from a palm policy virtual sink table, for [first, last].
+    // Both the internal name ("pmedia") & the pretty name ("media") resolve.
+    template <class SinkMap>
+    static VirtualNameIndex fromSinkMap(const SinkMap * map, int first, int last)
+    {
+        VirtualNameIndex index;
+        for (int i = first; i <= last; i++)
+        {
+            index.insert(map[i].virtualsinkname, map[i].virtualsinkidentifier);
+            index.insert(map[i].virtualsinkname + 1, map[i].virtualsinkidentifier);
+        }
+        return index;
+    }
+
+    /// Same as fromSinkMap, for the virtual source table.
+    template <class SourceMap>
+    static VirtualNameIndex fromSourceMap(const SourceMap * map, int first, int last)
+    {
+        VirtualNameIndex index;
+        for (int i = first; i <= last; i++)
+        {
+            index.insert(map[i].virtualsourcename, map[i].virtualsourceidentifier);
+            index.insert(map[i].virtualsourcename + 1, map[i].virtualsourceidentifier);
+        }
+        return index;
+    }
+
+private:
+    struct Entry
+    {
+        const char *    mName;
+        int             mIdentifier;
+    };
+
+    static bool         lessThan(const Entry & entry, const char * name);
+
+    std::vector<Entry>  mEntries;    // sorted by strcmp on mName
+};
+
+#endif // _VIRTUAL_NAME_INDEX_H_
@@ -58,6 +58,42 @@
 #define PMTRACE_FUNCTION \
     PmTraceFunction traceFunction(const_cast<char*>(__PRETTY_FUNCTION__))
 
+/* Typed tracepoints, on the paths we most often need timelines of:
+ * mixer commands sent to Pulse, sample playback, UMI calls (a scope)
+ * & subscription posts.
+ */
+#define PMTRACE_MIXER_COMMAND(cmd, sink, value) \
+    tracepoint(pmtrace_audiod, mixer_command, cmd, sink, value)
+#define PMTRACE_SAMPLE_PLAY(sample, sink) \
+    tracepoint(pmtrace_audiod, sample_play, const_cast<char*>(sample), sink)
+#define PMTRACE_UMI_CALL(method, detail) \
+    PmTraceUmiCall traceUmiCall(const_cast<char*>(method), const_cast<char*>(detail))
+#define PMTRACE_SUBSCRIPTION_POST(key) \
+    tracepoint(pmtrace_audiod, subscription_post, const_cast<char*>(key))
+
+class PmTraceUmiCall {
+public:
+    PmTraceUmiCall(char* method, char* detail)
+        : umiMethod(method)
+    {
+        tracepoint(pmtrace_audiod, umi_call_entry, umiMethod, detail);
+    }
+
+    ~PmTraceUmiCall()
+    {
+        tracepoint(pmtrace_audiod, umi_call_exit, umiMethod);
+    }
+
+private:
+    char* umiMethod;
+
+    // Prevent heap allocation
+    void operator delete(void*);
+    void* operator new(size_t);
+    PmTraceUmiCall(const PmTraceUmiCall&);
+    PmTraceUmiCall& operator=(const PmTraceUmiCall&);
+};
+
 class PmTraceScope {
 public:
     PmTraceScope(char* label)
@@ -106,15 +142,42 @@ private:
 
 #else // HAS_LTNG
 
-#define PMTRACE(label)
-#define PMTRACE_BEFORE(label)
-#define PMTRACE_AFTER(label)
-#define PMTRACE_SCOPE_ENTRY(label)
-#define PMTRACE_SCOPE_EXIT(label)
-#define PMTRACE_SCOPE(label)
-#define PMTRACE_FUNCTION_ENTRY(label)
-#define PMTRACE_FUNCTION_EXIT(label)
-#define PMTRACE_FUNCTION
+/* Without LTTng, the same tracepoints are recorded in per-thread rings,
+ * written as a Chrome trace on demand: see TraceBuffer.h.
+ * Labels must be string literals.
+ */
+#include "TraceBuffer.h"
+
+#define PMTRACE(label) \
+    TraceBuffer::record(TraceBuffer::ePhase_Instant, label)
+#define PMTRACE_BEFORE(label) \
+    TraceBuffer::record(TraceBuffer::ePhase_Begin, label)
+#define PMTRACE_AFTER(label) \
+    TraceBuffer::record(TraceBuffer::ePhase_End, label)
+#define PMTRACE_SCOPE_ENTRY(label) \
+    TraceBuffer::record(TraceBuffer::ePhase_Begin, label)
+#define PMTRACE_SCOPE_EXIT(label) \
+    TraceBuffer::record(TraceBuffer::ePhase_End, label)
+#define PMTRACE_SCOPE(label) \
+    TraceBufferScope traceScope(label)
+#define PMTRACE_FUNCTION_ENTRY(label) \
+    TraceBuffer::record(TraceBuffer::ePhase_Begin, label)
+#define PMTRACE_FUNCTION_EXIT(label) \
+    TraceBuffer::record(TraceBuffer::ePhase_End, label)
+#define PMTRACE_FUNCTION \
+    TraceBufferScope traceFunction(__PRETTY_FUNCTION__)
+
+#define PMTRACE_MIXER_COMMAND(cmd, sink, value) \
+    TraceBuffer::record(TraceBuffer::ePhase_Instant, "mixer command", \
+                        TraceBuffer::eArgs_MixerCommand, 0, cmd, sink, value)
+#define PMTRACE_SAMPLE_PLAY(sample, sink) \
+    TraceBuffer::record(TraceBuffer::ePhase_Instant, "sample play", \
+                        TraceBuffer::eArgs_Sample, sample, 0, sink)
+#define PMTRACE_UMI_CALL(method, detail) \
+    TraceBufferScope traceUmiCall(method, detail)
+#define PMTRACE_SUBSCRIPTION_POST(key) \
+    TraceBuffer::record(TraceBuffer::ePhase_Instant, "subscription post", \
+                        TraceBuffer::eArgs_Text, key)
 
 #endif // HAS_LTTNG
 
@@ -19,6 +19,7 @@
 
 #include <PmLogLib.h>
 #include <glib.h>
+#include <atomic>
 
 enum ELogDestination
 {
@@ -65,17 +66,47 @@ void logFilter(const gchar *log_domain,
 // priority are logged in the system log (to avoid duplication).
 void setProcessName(const char * name);
 
+/// Most verbose level that can reach a destination, kept up to date by the
+// setters above. Read it through LOG_ENABLED.
+extern std::atomic<int> gLogLevelGate;
+
+/// Will a message of that level be logged? Cheap: test it before formatting.
+#define LOG_ENABLED(level) \
+    ((int) (level) <= gLogLevelGate.load(std::memory_order_relaxed))
+
+/// g_debug, g_info & g_message test the level before evaluating their
+// arguments & formatting. Building with AUDIOD_STRIP_DEBUG_LOGS removes
+// debug messages altogether (their arguments are still compiled, not run).
+#undef g_message
+#define g_message(...) (LOG_ENABLED(G_LOG_LEVEL_MESSAGE) ?                    \
+                        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_MESSAGE, __VA_ARGS__) : (void) 0)
+
+#ifdef g_info
+#undef g_info
+#define g_info(...) (LOG_ENABLED(G_LOG_LEVEL_INFO) ?                          \
+                     g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, __VA_ARGS__) : (void) 0)
+#endif
+
+#undef g_debug
+#if defined(AUDIOD_STRIP_DEBUG_LOGS)
+#define g_debug(...) (false ? g_log(G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, __VA_ARGS__) : (void) 0)
+#else
+#define g_debug(...) (LOG_ENABLED(G_LOG_LEVEL_DEBUG) ?                        \
+                      g_log(G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, __VA_ARGS__) : (void) 0)
+#endif
+
 /// Test macro that will make a critical log entry if the test fails
-#define VERIFY(t) (G_LIKELY(t) || (logFailedVerify(#t, __FILE__, __LINE__,  \
-                                                        __FUNCTION__), false))
+#define VERIFY(t) (G_LIKELY(t) || ((LOG_ENABLED(G_LOG_LEVEL_CRITICAL) ?     \
+                   logFailedVerify(#t, __FILE__, __LINE__, __FUNCTION__) : (void) 0), false))
 
 /// Test macro that will make a warning log entry if the test fails
-#define CHECK(t) (G_LIKELY(t) || (logCheck(#t, __FILE__, __LINE__,  \
-                                                        __FUNCTION__), false))
+#define CHECK(t) (G_LIKELY(t) || ((LOG_ENABLED(G_LOG_LEVEL_WARNING) ?       \
+                  logCheck(#t, __FILE__, __LINE__, __FUNCTION__) : (void) 0), false))
 
 /// Direct critical message to put in the logs with
 // file & line number, with filtering of repeats
-#define FAILURE(m) logFailure(m, __FILE__, __LINE__, __FUNCTION__)
+#define FAILURE(m) (LOG_ENABLED(G_LOG_LEVEL_CRITICAL) ?                     \
+                    logFailure(m, __FILE__, __LINE__, __FUNCTION__) : (void) 0)
 
 #define SHOULD_NOT_REACH_HERE FAILURE("This line should never be reached")
 
@@ -93,6 +124,8 @@ void logCheck(const gchar * message,
 
 /// Helper class for log presentation purposes.
 //Indents the logs with the text passed as long as the object exists.
+// Costs nothing when no destination shows indentation.
+// Each thread has its own indentation.
 class LogIndent {
 public:
     LogIndent(const char * indent);
@@ -87,6 +87,37 @@ TRACEPOINT_EVENT(
     TP_ARGS(char*, text),
     TP_FIELDS(ctf_string(scope, text)))
 
+/* typed tracepoints: see audiodTracer.h */
+TRACEPOINT_EVENT(
+    pmtrace_audiod,
+    mixer_command,
+    TP_ARGS(char, cmd, int, sink, int, value),
+    TP_FIELDS(ctf_integer(char, cmd, cmd)
+              ctf_integer(int, sink, sink)
+              ctf_integer(int, value, value)))
+TRACEPOINT_EVENT(
+    pmtrace_audiod,
+    sample_play,
+    TP_ARGS(char*, sample, int, sink),
+    TP_FIELDS(ctf_string(sample, sample)
+              ctf_integer(int, sink, sink)))
+TRACEPOINT_EVENT(
+    pmtrace_audiod,
+    umi_call_entry,
+    TP_ARGS(char*, method, char*, detail),
+    TP_FIELDS(ctf_string(method, method)
+              ctf_string(detail, detail)))
+TRACEPOINT_EVENT(
+    pmtrace_audiod,
+    umi_call_exit,
+    TP_ARGS(char*, method),
+    TP_FIELDS(ctf_string(method, method)))
+TRACEPOINT_EVENT(
+    pmtrace_audiod,
+    subscription_post,
+    TP_ARGS(char*, key),
+    TP_FIELDS(ctf_string(key, key)))
+
 #endif /* _PMTRACE_AUDIOD_PROVIDER_H */
 
 #include <lttng/tracepoint-event.h>
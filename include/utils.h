@@ -21,6 +21,7 @@
 #include <glib.h>
 #include <lunaservice.h>
 #include "AudioDevice.h"
+#include "InitScheduler.h"
 
 class LSMessageJsonParser;
 
@@ -30,10 +31,16 @@ typedef void (*CancelSubscriptionCallback)(LSMessage * message, LSMessageJsonPar
 
 guint64 getCurrentTimeInMs ();
 
-void registerInitFunction (InitFunction function);
-void registerModuleFunction (StartFunction function);
-void registerControlFunction (StartFunction function);
-void registerServiceFunction (StartFunction function);
+// dependencies: NULL to run after everything registered before, like it always did,
+// or the comma separated names of the hooks to wait for. See InitScheduler.
+void registerInitFunction (InitFunction function, const char * name = NULL,
+                           const char * dependencies = NULL, int flags = eInitHook_MainThread);
+void registerModuleFunction (StartFunction function, const char * name = NULL,
+                             const char * dependencies = NULL, int flags = eInitHook_MainThread);
+void registerControlFunction (StartFunction function, const char * name = NULL,
+                              const char * dependencies = NULL, int flags = eInitHook_MainThread);
+void registerServiceFunction (StartFunction function, const char * name = NULL,
+                              const char * dependencies = NULL, int flags = eInitHook_MainThread);
 void registerCancelSubscriptionCallback (CancelSubscriptionCallback function);
 void registerCancelSubscription(LSHandle *handle);
 void oneInitForAll(GMainLoop *loop, LSHandle *handle);
@@ -41,32 +48,69 @@ void oneFreeForAll();
 bool ServiceRegisterCategory(const char *category, LSMethod *methods,
         LSSignal *signal, void *category_user_data);
 
+/// Wrap the methods of a category so that each call is timed in the metrics,
+/// as "luna.<category>/<method>". Register the returned methods instead of
+/// the original ones, and set the category data to *category_user_data,
+/// which is replaced. ServiceRegisterCategory does it already.
+LSMethod * timedLunaMethods(const char *category, LSMethod *methods,
+        void **category_user_data);
+
+// Hooks declared with the *_HOOK macros name the hooks they depend on,
+// e.g. INIT_HOOK(ReadTables, "", eInitHook_ThreadSafe)
 #define INIT_FUNC(func)                                     \
 static void __attribute__ ((constructor))                   \
 ModuleInitializer##func(void)                               \
 {                                                           \
-    registerInitFunction(func);                             \
+    registerInitFunction(func, #func);                      \
+}
+
+#define INIT_HOOK(func, dependencies, flags)                \
+static void __attribute__ ((constructor))                   \
+ModuleInitializer##func(void)                               \
+{                                                           \
+    registerInitFunction(func, #func, dependencies, flags); \
 }
 
 #define MODULE_START_FUNC(func)                             \
 static void __attribute__ ((constructor))                   \
 ModuleInitializer##func(void)                               \
 {                                                           \
-    registerModuleFunction(func);                           \
+    registerModuleFunction(func, #func);                    \
+}
+
+#define MODULE_START_HOOK(func, dependencies, flags)        \
+static void __attribute__ ((constructor))                   \
+ModuleInitializer##func(void)                               \
+{                                                           \
+    registerModuleFunction(func, #func, dependencies, flags); \
 }
 
 #define CONTROL_START_FUNC(func)                            \
 static void __attribute__ ((constructor))                   \
 ModuleInitializer##func(void)                               \
 {                                                           \
-    registerControlFunction(func);                          \
+    registerControlFunction(func, #func);                   \
+}
+
+#define CONTROL_START_HOOK(func, dependencies, flags)       \
+static void __attribute__ ((constructor))                   \
+ModuleInitializer##func(void)                               \
+{                                                           \
+    registerControlFunction(func, #func, dependencies, flags); \
 }
 
 #define SERVICE_START_FUNC(func)                            \
 static void __attribute__ ((constructor))                   \
 ModuleInitializer##func(void)                               \
 {                                                           \
-    registerServiceFunction(func);                          \
+    registerServiceFunction(func, #func);                   \
+}
+
+#define SERVICE_START_HOOK(func, dependencies, flags)       \
+static void __attribute__ ((constructor))                   \
+ModuleInitializer##func(void)                               \
+{                                                           \
+    registerServiceFunction(func, #func, dependencies, flags); \
 }
 
 #endif //_UTILS_H_
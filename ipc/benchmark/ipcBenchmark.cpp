@@ -0,0 +1,589 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Benchmark of the audio-ipc library: a server & client processes on this
+// machine. Measures round trips of IPC_Socket messages in each packet mode,
+// then the shared properties: get from shared memory, set through the
+// server & change notifications, by socket or futex.
+// Prints one CSV line per measurement, so that runs can be compared by scripts.
+//
+// Built with cmake -DAUDIOD_IPC_BENCHMARK=ON.
+// usage: audio-ipc-benchmark [-c clients] [-n operations] [-s filter]
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <vector>
+
+#include "IPC_Property.hpp"
+
+enum
+{
+    cMaxClients = 16,
+    cMessageSize = 32,      ///< a property update & its header
+    cGetBatch = 64,         ///< gets timed together: a get is faster than the clock
+    cTimeoutMs = 2000       ///< longest wait for an answer
+};
+
+static guint64 nowNs()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return guint64(time.tv_sec) * 1000000000ULL + guint64(time.tv_nsec);
+}
+
+/*
+ * What the clients report, in memory shared by all the processes
+ */
+struct ClientResults
+{
+    guint64                 mStart;         ///< ns, same clock in every process
+    guint64                 mEnd;
+    guint32                 mOperations;
+    std::atomic<guint32>    mSeen;          ///< notify: last change seen
+};
+
+struct BenchResults
+{
+    IPC_ChangeNotifier      mReady;         ///< a client can be measured
+    IPC_ChangeNotifier      mAcks;          ///< notify: a client saw a change
+    ClientResults           mClients[cMaxClients];
+};
+
+static BenchResults *   sResults;
+static guint32 *        sLatencies;     ///< in ns, sOperations per client
+static int              sClients = 4;
+static int              sOperations = 10000;
+static char             sName[64];      ///< of the server of the suite
+
+static guint32 * latencies(int client)  { return sLatencies + size_t(client) * sOperations; }
+
+/*
+ * Shared properties of the property suites
+ */
+struct Sample
+{
+    guint64     mTime;          ///< when the server published it, in ns
+    guint32     mCount;
+    guint32     mLevels[5];     ///< wider than 32 bits: read under its seqlock
+
+    bool operator!=(const Sample & other) const
+    {
+        return mTime != other.mTime || mCount != other.mCount;
+    }
+};
+
+template <template <class> class Property> class BenchProperties : public IPC_SharedProperties
+{
+public:
+    static const bool cIsServerNotClient = Property<int>::cIsServerNotClient;
+
+    Property<int>       mValue;
+    Property<Sample>    mSample;
+    Property<int>       mRequests[cMaxClients];     ///< one per client
+
+protected:
+    BenchProperties(const std::string & name) : IPC_SharedProperties(name, sizeof(BenchProperties))
+    {
+        Sample sample;
+        memset(&sample, 0, sizeof(sample));
+        mValue.init(0);
+        mSample.init(sample);
+        for (int i = 0; i < cMaxClients; i++)
+            mRequests[i].init(0);
+    }
+    friend class IPC_SharedProperties;
+};
+
+typedef BenchProperties<IPC_ServerProperty>  ServerProperties;
+typedef BenchProperties<IPC_ClientProperty>  ClientProperties;
+
+struct Suite
+{
+    const char *        mSuite;
+    const char *        mMode;
+    ESocketPacketsSize  mPacketMode;
+    bool                (*mRun)(const Suite & suite);       ///< the server process
+    bool                (*mClient)(int client);
+    bool                (*mServe)(ServerProperties & server);
+};
+
+static const Suite *    sSuite;
+
+static gboolean wakeUp(gpointer)
+{
+    return TRUE;
+}
+
+/// Run the main loop until condition() is true, or the answer is late
+template <class Condition> static bool runUntil(Condition condition)
+{
+    guint64 deadline = nowNs() + cTimeoutMs * 1000000ULL;
+    while (!condition())
+    {
+        if (nowNs() > deadline)
+            return false;
+        g_main_context_iteration(NULL, TRUE);
+    }
+    return true;
+}
+
+/// Time each operation. They may do several things, timed together.
+template <class Operation> static bool measure(int client, Operation operation,
+                                               int perOperation = 1)
+{
+    ClientResults & results = sResults->mClients[client];
+    guint32 * latency = latencies(client);
+    results.mStart = nowNs();
+    for (int i = 0; i < sOperations; i++)
+    {
+        guint64 start = nowNs();
+        if (!operation(i))
+            return false;
+        latency[i] = guint32((nowNs() - start) / perOperation);
+        results.mOperations += perOperation;
+    }
+    results.mEnd = nowNs();
+    return true;
+}
+
+/*
+ * Clients are forked before the server is created, so that they don't
+ * inherit its sockets, then wait for it to be up.
+ */
+static int sStartPipe[2];
+
+static bool forkClients()
+{
+    if (pipe(sStartPipe) != 0)
+        return false;
+    for (int client = 0; client < sClients; client++)
+    {
+        pid_t child = fork();
+        if (child < 0)
+            return false;
+        if (child == 0)
+        {
+            close(sStartPipe[1]);
+            char go;
+            bool ok = read(sStartPipe[0], &go, 1) == 1;
+            g_timeout_add(100, wakeUp, NULL);
+            ok = ok && sSuite->mClient(client);
+            _exit(ok ? 0 : 1);
+        }
+    }
+    close(sStartPipe[0]);
+    return true;
+}
+
+static void startClients()
+{
+    char go[cMaxClients] = { 0 };
+    if (write(sStartPipe[1], go, sClients) != sClients)
+        g_warning("startClients: %s", strerror(errno));
+    close(sStartPipe[1]);
+}
+
+/// Serve the clients until they all exited. False if one failed.
+static bool waitClients()
+{
+    bool ok = true;
+    for (int running = sClients; running > 0; )
+    {
+        g_main_context_iteration(NULL, TRUE);
+        int status = 0;
+        pid_t child;
+        while ((child = waitpid(-1, &status, WNOHANG)) > 0)
+        {
+            running--;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                ok = false;
+        }
+        if (child < 0 && errno == ECHILD)
+            break;
+    }
+    return ok;
+}
+
+/*
+ * Socket suites: clients send messages that the server echoes
+ */
+class Echo : public IPC_SocketCallbacks
+{
+public:
+    Echo(IPC_Socket & socket) : mSocket(socket) {}
+    virtual ~Echo() {}
+
+    void    connectionEstablished(IPC_Socket * socket)  {}
+    void    dataReceived(const void * data, ssize_t size)   { mSocket.send(data, size); }
+    void    closed(IPC_Socket * socket)                 { delete this; }
+
+private:
+    IPC_Socket &    mSocket;
+};
+
+class EchoServer : public IPC_SocketServerCallbacks
+{
+public:
+    void    newConnection(IPC_Socket & connection)  { connection.setCallbacks(new Echo(connection)); }
+};
+
+class ByteCounter : public IPC_SocketCallbacks
+{
+public:
+    ByteCounter() : mBytes(0) {}
+
+    void    connectionEstablished(IPC_Socket * socket)  {}
+    void    dataReceived(const void * data, ssize_t size)   { mBytes += size; }
+    void    closed(IPC_Socket * socket)                 {}
+
+    long long   mBytes;
+};
+
+static bool socketClient(int client)
+{
+    IPC_SocketClient socket;
+    ByteCounter received;
+    socket.setCallbacks(&received);
+    if (!socket.connect(sName, false, sSuite->mPacketMode, cMessageSize))
+        return false;
+
+    char message[cMessageSize];
+    memset(message, client, sizeof(message));
+    return measure(client, [&] (int i) {
+        return socket.send(message, sizeof(message)) &&
+               runUntil([&] { return received.mBytes >= (i + 1LL) * cMessageSize; }); });
+}
+
+static bool runSocketSuite(const Suite & suite)
+{
+    if (!forkClients())
+        return false;
+    IPC_SocketServer server;
+    EchoServer echo;
+    server.setCallbacks(&echo);
+    if (!server.listen(sName, suite.mPacketMode, cMessageSize))
+        return false;
+    g_timeout_add(100, wakeUp, NULL);
+    startClients();
+    return waitClients();
+}
+
+/*
+ * Property suites
+ */
+static int          sSeenRequest;
+static guint32      sSeenCount;
+static guint64      sSeenLatency;
+
+static void requestChanged(const int & value)
+{
+    sSeenRequest = value;
+}
+
+static void sampleChanged(const Sample & sample)
+{
+    sSeenLatency = nowNs() - sample.mTime;
+    sSeenCount = sample.mCount;
+}
+
+/// Connected once a set comes back: the link works both ways.
+// Listeners registered before are then known by the server.
+static bool connectClient(ClientProperties & properties, int client)
+{
+    IPC_ClientProperty<int> & request = properties.mRequests[client];
+    request.sendChanges(&requestChanged);
+    bool sent = false;
+    return runUntil([&] {
+        if (!sent)
+            sent = request.set(1);
+        return sSeenRequest == 1; });
+}
+
+static ClientProperties * createClient(int client, bool listenToSamples)
+{
+    ClientProperties * properties =
+                   IPC_SharedProperties::createSharedProperties<ClientProperties>(sName,
+                                                                       sSuite->mPacketMode);
+    if (!properties)
+        return 0;
+    if (listenToSamples)
+        properties->mSample.sendChanges(&sampleChanged);
+    if (!connectClient(*properties, client))
+        return 0;
+    sResults->mReady.notify();
+    return properties;
+}
+
+static volatile guint64 sSink;
+
+static bool getClient(int client)
+{
+    ClientProperties * properties = createClient(client, false);
+    return properties && measure(client, [&] (int) {
+        guint64 sum = 0;
+        for (int i = 0; i < cGetBatch; i++)
+            sum += properties->mValue.get();
+        sSink = sum;
+        return true; }, cGetBatch);
+}
+
+static bool getWideClient(int client)
+{
+    ClientProperties * properties = createClient(client, false);
+    return properties && measure(client, [&] (int) {
+        guint64 sum = 0;
+        for (int i = 0; i < cGetBatch; i++)
+            sum += properties->mSample.get().mCount;
+        sSink = sum;
+        return true; }, cGetBatch);
+}
+
+/// Set & wait for the change notification
+static bool setClient(int client)
+{
+    ClientProperties * properties = createClient(client, false);
+    if (!properties)
+        return false;
+    IPC_ClientProperty<int> & request = properties->mRequests[client];
+    return measure(client, [&] (int i) {
+        int value = i + 2;
+        return request.set(value) && runUntil([&] { return sSeenRequest == value; }); });
+}
+
+static void sampleSeen(ClientResults & results, guint32 count, guint64 latency)
+{
+    latencies(&results - sResults->mClients)[results.mOperations++] = guint32(latency);
+    results.mSeen.store(count);
+    sResults->mAcks.notify();
+}
+
+/// Told of the changes by the server, on its socket
+static bool notifySocketClient(int client)
+{
+    ClientProperties * properties = createClient(client, true);
+    if (!properties)
+        return false;
+    ClientResults & results = sResults->mClients[client];
+    results.mStart = nowNs();
+    for (guint32 seen = 0; seen < (guint32) sOperations; seen = sSeenCount)
+    {
+        if (!runUntil([&] { return sSeenCount > seen; }))
+            return false;
+        sampleSeen(results, sSeenCount, sSeenLatency);
+    }
+    results.mEnd = nowNs();
+    return true;
+}
+
+/// Waits for the change count in shared memory to move
+static bool notifyFutexClient(int client)
+{
+    ClientProperties * properties = createClient(client, false);
+    if (!properties)
+        return false;
+    ClientResults & results = sResults->mClients[client];
+    results.mStart = nowNs();
+    for (guint32 seen = 0; seen < (guint32) sOperations; )
+    {
+        guint32 changes = properties->getChangeCount();
+        Sample sample = properties->mSample.get();
+        if (sample.mCount > seen)
+        {
+            seen = sample.mCount;
+            sampleSeen(results, seen, nowNs() - sample.mTime);
+        }
+        else if (!properties->waitForChanges(changes, cTimeoutMs))
+            return false;
+    }
+    results.mEnd = nowNs();
+    return true;
+}
+
+static bool allSeen(guint32 count)
+{
+    for (int client = 0; client < sClients; client++)
+        if (sResults->mClients[client].mSeen.load() < count)
+            return false;
+    return true;
+}
+
+/// One change at a time, once every client saw the previous one
+static bool publishSamples(ServerProperties & server)
+{
+    if (!runUntil([] { return sResults->mReady.changes() >= (guint32) sClients; }))
+        return false;
+    Sample sample;
+    memset(&sample, 0, sizeof(sample));
+    for (guint32 count = 1; count <= (guint32) sOperations; count++)
+    {
+        guint32 acks = sResults->mAcks.changes();
+        sample.mTime = nowNs();
+        sample.mCount = count;
+        server.mSample.set(sample);
+        g_main_context_iteration(NULL, FALSE);
+        while (!allSeen(count))
+        {
+            if (!sResults->mAcks.wait(acks, cTimeoutMs))
+                return false;
+            acks = sResults->mAcks.changes();
+        }
+    }
+    return true;
+}
+
+static bool runPropertySuite(const Suite & suite)
+{
+    if (!forkClients())
+        return false;
+    ServerProperties * server =
+                     IPC_SharedProperties::createSharedProperties<ServerProperties>(sName,
+                                                                       suite.mPacketMode);
+    if (!server)
+        return false;
+    g_timeout_add(100, wakeUp, NULL);
+    startClients();
+    bool ok = suite.mServe == 0 || suite.mServe(*server);
+    ok = waitClients() && ok;
+    boost::interprocess::shared_memory_object::remove(sName);
+    boost::interprocess::shared_memory_object::remove(
+                                IPC_SharedProperties::changesName(sName).c_str());
+    return ok;
+}
+
+static const Suite cSuites[] = {
+    { "socket",   "free",          eSocketPacketsSize_Free,       runSocketSuite,   socketClient,       0 },
+    { "socket",   "fixed",         eSocketPacketsSize_Fixed,      runSocketSuite,   socketClient,       0 },
+    { "socket",   "controlled",    eSocketPacketsSize_Controlled, runSocketSuite,   socketClient,       0 },
+    { "socket",   "sequenced",     eSocketPacketsSize_Sequenced,  runSocketSuite,   socketClient,       0 },
+    { "property", "get",           eSocketPacketsSize_Controlled, runPropertySuite, getClient,          0 },
+    { "property", "get-sequenced", eSocketPacketsSize_Sequenced,  runPropertySuite, getClient,          0 },
+    { "property", "get-wide",      eSocketPacketsSize_Controlled, runPropertySuite, getWideClient,      0 },
+    { "property", "set",           eSocketPacketsSize_Controlled, runPropertySuite, setClient,          0 },
+    { "property", "notify-socket", eSocketPacketsSize_Controlled, runPropertySuite, notifySocketClient, publishSamples },
+    { "property", "notify-futex",  eSocketPacketsSize_Controlled, runPropertySuite, notifyFutexClient,  publishSamples },
+};
+
+/// Run a suite in a server process of its own, then print its results
+static bool runSuite(const Suite & suite)
+{
+    new (sResults) BenchResults;
+    for (int client = 0; client < cMaxClients; client++)
+    {
+        ClientResults & results = sResults->mClients[client];
+        results.mStart = results.mEnd = 0;
+        results.mOperations = 0;
+        results.mSeen.store(0);
+    }
+    sSuite = &suite;
+
+    fflush(stdout);
+    pid_t server = fork();
+    if (server == 0)
+    {
+        snprintf(sName, sizeof(sName), "Audiod-IPC-Benchmark-%d", (int) getpid());
+        bool ok = suite.mRun(suite);
+        fflush(stdout);
+        _exit(ok ? 0 : 1);
+    }
+    int status = 0;
+    bool ok = server > 0 && waitpid(server, &status, 0) == server &&
+              WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+    std::vector<guint32> all;
+    guint64 start = ~0ULL, end = 0, operations = 0;
+    for (int client = 0; client < sClients; client++)
+    {
+        const ClientResults & results = sResults->mClients[client];
+        size_t samples = std::min<size_t>(sOperations, results.mOperations);
+        all.insert(all.end(), latencies(client), latencies(client) + samples);
+        operations += results.mOperations;
+        start = std::min(start, results.mStart);
+        end = std::max(end, results.mEnd);
+    }
+    std::sort(all.begin(), all.end());
+    double seconds = end > start ? (end - start) / 1e9 : 0;
+    double percentiles[] = { 0.5, 0.9, 0.99, 0.999, 1 };
+    printf("%s,%s,%d,%llu,%.0f", suite.mSuite, suite.mMode, sClients,
+           (unsigned long long) operations, seconds > 0 ? operations / seconds : 0);
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++)
+    {
+        size_t index = std::min(all.size() - 1, size_t(percentiles[i] * all.size()));
+        printf(",%.3f", all.empty() ? 0 : all[index] / 1000.0);
+    }
+    printf(",%s\n", ok ? "ok" : "failed");
+    return ok;
+}
+
+static void usage(const char * name)
+{
+    fprintf(stderr, "usage: %s [-c clients (1-%d)] [-n operations per client] "
+                    "[-s suites containing this]\n", name, cMaxClients);
+}
+
+int main(int argc, char ** argv)
+{
+    const char * filter = "";
+    int option;
+    while ((option = getopt(argc, argv, "c:n:s:h")) != -1)
+    {
+        switch (option)
+        {
+        case 'c':   sClients = atoi(optarg);    break;
+        case 'n':   sOperations = atoi(optarg); break;
+        case 's':   filter = optarg;            break;
+        default:    usage(argv[0]);             return 2;
+        }
+    }
+    if (sClients < 1 || sClients > cMaxClients || sOperations < 1)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    size_t size = sizeof(BenchResults) + sizeof(guint32) * cMaxClients * size_t(sOperations);
+    void * memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+    sResults = static_cast<BenchResults *>(memory);
+    sLatencies = reinterpret_cast<guint32 *>(sResults + 1);
+
+    int failures = 0;
+    printf("suite,mode,clients,operations,ops_per_s,p50_us,p90_us,p99_us,p999_us,max_us,status\n");
+    for (size_t i = 0; i < sizeof(cSuites) / sizeof(cSuites[0]); i++)
+    {
+        std::string name = std::string(cSuites[i].mSuite) + "/" + cSuites[i].mMode;
+        if (name.find(filter) != std::string::npos && !runSuite(cSuites[i]))
+            failures++;
+    }
+
+    munmap(memory, size);
+    return failures ? 1 : 0;
+}
@@ -16,3 +16,4 @@
 
 
 #include "../include/IPC_SharedAudiodProperties.cpp"
+#include "../include/AudiodStatusPage.cpp"
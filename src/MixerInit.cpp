@@ -18,6 +18,7 @@
 #include <pbnjson/cxx/JDomParser.h>
 #include "umiaudiomixer.h"
 #include  "MixerInit.h"
+#include "log.h"
 using namespace pbnjson;
 
 MixerInit::MixerInit(const std::stringstream& configFilePath): mCongifPath(configFilePath.str())
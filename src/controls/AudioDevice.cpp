@@ -21,6 +21,7 @@
 #include "messageUtils.h"
 #include "main.h"
 #include "state.h"
+#include "StallWatchdog.h"
 
 AudioDevice &gAudioDevice = AudioDevice::get();
 
@@ -66,6 +67,7 @@ bool AudioDevice::museSet (bool enable)
 }
 
 gboolean AudioDevice::delayCall_timercallback(void* data) {
+    MAINLOOP_HANDLER("device.delayed_call");
     Callback* callback = (Callback*)data;
     callback->callback(callback);
     return FALSE;
@@ -23,6 +23,7 @@
 #include <pulse/module-palm-policy.h>
 //#include "AudioDevice.h"
 #include "ConstString.h"
+#include "RampScheduler.h"
 
 enum EPhoneEvent
 {
@@ -118,6 +119,20 @@ inline bool isNeverMutedSink(EVirtualSink sink)
     return sink == eDTMF || sink == efeedback || sink == eeffects || sink == ecallertone;
 }
 
+/// One sink of a compiled mixer program: where it goes and whether it plays
+struct MixerProgramSink {
+    EVirtualSink    mSink;
+    EPhysicalSink   mDestination;
+    bool            mRouted;
+};
+
+/// One source of a compiled mixer program
+struct MixerProgramSource {
+    EVirtualSource  mSource;
+    EPhysicalSource mDestination;
+    bool            mRouted;
+};
+
 enum EControlEvent
 {
     eControlEvent_None                    = 0,
@@ -158,6 +173,7 @@ const char * virtualSinkName(EVirtualSink sink, bool prettyNameNotInternal = tru
 const char * virtualSourceName(EVirtualSource source,
                                bool prettyNameNotInternal = true);
 EVirtualSink getSinkByName(const char * name);
+EVirtualSource getSourceByName(const char * name);
 
 /*
  * AudioMixer abstracts Audiod's view of the subsystem that implements audio mixing.
@@ -198,6 +214,12 @@ public:
     /// Same as program volume, but ramped.
     virtual bool            rampVolume(EVirtualSink sink, int endVolume) = 0;
 
+    /// Fade the volume of a sink over some time, following a curve.
+    // Calling again retargets the fade. Programming the volume cancels it.
+    virtual bool            fadeVolume(EVirtualSink sink, int endVolume,
+                                       int durationMs,
+                                       ERampCurve curve = eRampCurve_Linear) = 0;
+
     /// Program destination of a sink
     virtual bool            programDestination(EVirtualSink sink,
                                                EPhysicalSink destination) = 0;
@@ -211,8 +233,16 @@ public:
     virtual	bool           programBalance(int balance) = 0;
     virtual bool            muteAll() = 0;
 
+    /// Move sinks to the destinations of a new scenario without a global mute:
+    // only sinks that actually change destination while audible are silenced
+    // before they move. Volumes are to be restored by regular programming.
+    virtual bool            programTransition(const MixerProgramSink * sinks,
+                                              int count) = 0;
+
     /// Offset a volume by a number of dB. Calculation only.
-    virtual int                adjustVolume(int volume, int dB) = 0;
+    // Uses the volume curve of the sink, if one is given.
+    virtual int                adjustVolume(int volume, int dB,
+                                            EVirtualSink sink = eVirtualSink_None) = 0;
 
     /// Get active streams set to test which sinks are active.
     virtual VirtualSinkSet    getActiveStreams() = 0;
@@ -0,0 +1,108 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "MixerTransition.h"
+
+MixerTransition::MixerTransition()
+{
+    for (int i = 0; i < eVirtualSink_Count; i++)
+    {
+        mSinks[i].mDestination = -1;
+        mSinks[i].mVolume = -1;
+        mSinks[i].mActive = false;
+        mSinks[i].mTarget = -1;
+    }
+}
+
+void MixerTransition::setCurrent(EVirtualSink sink, int destination, int volume, bool active)
+{
+    if (sink < eVirtualSink_First || sink > eVirtualSink_Last)
+        return;
+
+    mSinks[sink].mDestination = destination;
+    mSinks[sink].mVolume = volume;
+    mSinks[sink].mActive = active;
+}
+
+void MixerTransition::setTarget(EVirtualSink sink, int destination)
+{
+    if (sink < eVirtualSink_First || sink > eVirtualSink_Last)
+        return;
+
+    mSinks[sink].mTarget = destination;
+}
+
+bool MixerTransition::isMoving(EVirtualSink sink) const
+{
+    if (sink < eVirtualSink_First || sink > eVirtualSink_Last)
+        return false;
+
+    const SinkState & state = mSinks[sink];
+    return state.mTarget >= 0 && state.mTarget != state.mDestination;
+}
+
+int MixerTransition::plan(std::vector<Command> & commands) const
+{
+    size_t first = commands.size();
+
+    // fade out whatever is about to move while audible, before anything moves,
+    // so that no sink is heard on its old destination after another one moved
+    for (int sink = eVirtualSink_First; sink <= eVirtualSink_Last; sink++)
+    {
+        const SinkState & state = mSinks[sink];
+        if (isMoving(EVirtualSink(sink)) && state.mActive && state.mVolume > 0 &&
+            sink != ecallertone)
+        {
+            Command fade = { 'r', sink, 0 };
+            commands.push_back(fade);
+        }
+    }
+
+    for (int sink = eVirtualSink_First; sink <= eVirtualSink_Last; sink++)
+    {
+        if (isMoving(EVirtualSink(sink)))
+        {
+            Command move = { 'd', sink, mSinks[sink].mTarget };
+            commands.push_back(move);
+        }
+    }
+
+    return (int) (commands.size() - first);
+}
+
+void MixerTransition::program(Output & output) const
+{
+    std::vector<Command> commands;
+    plan(commands);
+
+    // fades come first in the plan: once one is sent, every move waits for its end
+    bool fading = false;
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+        EVirtualSink sink = EVirtualSink(commands[i].mSink);
+        EPhysicalSink destination = EPhysicalSink(commands[i].mValue);
+        if (commands[i].mCmd == 'r')
+        {
+            output.fadeVolume(sink, commands[i].mValue, cFadeOutMs, eRampCurve_dB);
+            fading = true;
+        }
+        else if (fading)
+            output.deferDestination(sink, destination, cFadeOutMs);
+        else
+            output.programDestination(sink, destination);
+    }
+}
@@ -0,0 +1,95 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#ifndef _MIXER_TRANSITION_H_
+#define _MIXER_TRANSITION_H_
+
+#include <vector>
+#include <cstddef>
+
+#include <pulse/module-palm-policy.h>
+
+#include "RampScheduler.h"
+
+/*
+ * Computes the pulse policy commands needed to move from the routing currently
+ * programmed to the routing of a new scenario, without muting everything.
+ * Sinks that keep their destination are left alone, so that they keep playing.
+ * Sinks that move while audible are faded out first, & all the moves wait for
+ * the end of the fade. The call tone is never faded, as in
+ * PulseAudioMixer::muteAll.
+ * Volumes are not part of the transition: they are brought back up by the
+ * regular volume programming that follows, which the mixer holds for the
+ * sinks still waiting to move.
+ */
+class MixerTransition
+{
+public:
+    /// Fade out of moving sinks: a single Pulse ramp, that the moves wait for
+    static const int cFadeOutMs = RampScheduler::cStepMs;
+
+    /// A command for the pulse policy module: 'r' is a fade out, 'd' a move
+    struct Command
+    {
+        char    mCmd;
+        int     mSink;
+        int     mValue;
+    };
+
+    /// Where program() sends the commands: the mixer, or a test's mock
+    class Output
+    {
+    public:
+        virtual ~Output() {}
+        virtual bool    fadeVolume(EVirtualSink sink, int endVolume, int durationMs,
+                                   ERampCurve curve) = 0;
+        virtual bool    programDestination(EVirtualSink sink, EPhysicalSink destination) = 0;
+        /// Move once afterMs passed, & hold the sink's volume until then
+        virtual bool    deferDestination(EVirtualSink sink, EPhysicalSink destination,
+                                         int afterMs) = 0;
+    };
+
+    MixerTransition();
+
+    /// State of a sink as currently programmed. A negative destination means unknown.
+    void    setCurrent(EVirtualSink sink, int destination, int volume, bool active);
+
+    /// Destination the sink has in the new scenario. Sinks without a target don't move.
+    void    setTarget(EVirtualSink sink, int destination);
+
+    /// Does that sink change destination in this transition?
+    bool    isMoving(EVirtualSink sink) const;
+
+    /// Compute the commands, in the order they must be sent. Returns how many.
+    int     plan(std::vector<Command> & commands) const;
+
+    /// Plan the transition & send it
+    void    program(Output & output) const;
+
+private:
+    struct SinkState
+    {
+        int     mDestination;
+        int     mVolume;
+        bool    mActive;
+        int     mTarget;
+    };
+
+    SinkState   mSinks[eVirtualSink_Count];
+};
+
+#endif // _MIXER_TRANSITION_H_
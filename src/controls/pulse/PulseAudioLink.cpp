@@ -21,6 +21,7 @@
 #include <math.h>
 #include <unistd.h>
 #include <audiodTracer.h>
+#include "StallWatchdog.h"
 static const size_t kSampleNameMaxSize = 64;
 
 struct ssound_t {
@@ -411,6 +412,8 @@ void PulseAudioLink::preload(const char * samplename)
 {
     // is the sound file loaded?
     PMTRACE_FUNCTION;
+    // waits for the upload to complete: attribute the stalls it causes
+    MAINLOOP_HANDLER("PulseAudioLink::preload");
     if (strlen(samplename) >= kSampleNameMaxSize ||
                               mLoadedSounds.find(samplename) != mLoadedSounds.end())
         return;
@@ -27,6 +27,14 @@
 #include "messageUtils.h"
 #include "log.h"
 #include "main.h"
+#include "VirtualNameIndex.h"
+#include "MixerTransition.h"
+#include "StartupProfiler.h"
+#include "Metrics.h"
+#include "FlightRecorder.h"
+#include "StallWatchdog.h"
+#include "AudiodStatusPage.h"
+#include <pbnjson/cxx/JDomParser.h>
 #include "media.h"
 #include "phone.h"
 #include <audiodTracer.h>
@@ -34,10 +42,21 @@
 #define phone_MaxVolume 70
 #define phone_MinVolume 0
 #define FILENAME "/dev/snd/pcmC"
+#define VOLUME_CURVES_CONFIG_PATH "/etc/palm/audiod/volumecurves.json"
 
 #define _NAME_STRUCT_OFFSET(struct_type, member) \
                        ((long) ((unsigned char*) &((struct_type*) 0)->member))
 
+static MetricsCounter   sCommandsSent("mixer.commands.sent");
+static MetricsCounter   sCommandsSkipped("mixer.commands.skipped");
+static MetricsCounter   sCommandsDropped("mixer.commands.dropped");
+static MetricsCounter   sCommandsFailed("mixer.commands.failed");
+static MetricsCounter   sPulseConnectAttempts("pulse.connect.attempts");
+static MetricsCounter   sPulseConnects("pulse.connects");
+static MetricsCounter   sPulseDisconnects("pulse.disconnects");
+static MetricsGauge     sPulseConnected("pulse.connected");
+static MetricsHistogram sPulseStatusLatency("pulse.status");
+
 PulseAudioMixer gPulseAudioMixer;
 
 AudioMixer & gAudioMixer = gPulseAudioMixer;
@@ -69,18 +88,11 @@ const char * virtualSinkName(EVirtualSink sink, bool prettyName)
 
 EVirtualSink getSinkByName(const char * name)
 {
-    EVirtualSink sink = eVirtualSink_None;
-    for (int i = eVirtualSink_First; i <= eVirtualSink_Last; i++)
-    {
-        if (0 == strcmp(name, systemdependantvirtualsinkmap[i].virtualsinkname) ||
-             0 == strcmp(name, systemdependantvirtualsinkmap[i].virtualsinkname + 1))
-        {
-            sink = (EVirtualSink) systemdependantvirtualsinkmap[i].virtualsinkidentifier;
-            break;
-        }
-    }
+    static const VirtualNameIndex sSinkIndex =
+        VirtualNameIndex::fromSinkMap(systemdependantvirtualsinkmap,
+                                      eVirtualSink_First, eVirtualSink_Last);
 
-    return sink;
+    return (EVirtualSink) sSinkIndex.lookup(name, eVirtualSink_None);
 }
 
 const char * virtualSourceName(EVirtualSource source, bool prettyName)
@@ -98,18 +110,11 @@ const char * virtualSourceName(EVirtualSource source, bool prettyName)
 
 EVirtualSource getSourceByName(const char * name)
 {
-    EVirtualSource source = eVirtualSource_None;
-    for (int i = eVirtualSource_First; i <= eVirtualSource_Last; i++)
-    {
-        if (0 == strcmp(name, systemdependantvirtualsourcemap[i].virtualsourcename) ||
-            0 == strcmp(name, systemdependantvirtualsourcemap[i].virtualsourcename + 1))
-        {
-            source = (EVirtualSource) systemdependantvirtualsourcemap[i].virtualsourceidentifier;
-            break;
-        }
-    }
+    static const VirtualNameIndex sSourceIndex =
+        VirtualNameIndex::fromSourceMap(systemdependantvirtualsourcemap,
+                                        eVirtualSource_First, eVirtualSource_Last);
 
-    return source;
+    return (EVirtualSource) sSourceIndex.lookup(name, eVirtualSource_None);
 }
 
 const int cMinTimeout = 50;
@@ -131,7 +136,8 @@ PulseAudioMixer::PulseAudioMixer() : mChannel(0),
                                      BTDeviceType(eBTDevice_NarrowBand),
                                      mIsHfpAgRole(false),
                                      mPreviousVolume(0),
-                                     BTvolumeSupport(false)
+                                     BTvolumeSupport(false),
+                                     mRampTimerID(0)
 {
     // initialize table for the pulse state lookup table
     for (int i = eVirtualSink_First; i <= eVirtualSink_Last; i++)
@@ -150,29 +156,10 @@ PulseAudioMixer::PulseAudioMixer() : mChannel(0),
 PulseAudioMixer::~PulseAudioMixer() {
 }
 
-/*
-  current is the current volume from 0 to 65535
-  dB_diff is the amount in dB added to the current volume
-  returns the desired volume from 0 to 65535
-*/
-static int _add_dB (int current, int dB_diff)
+static VolumeCurves::EDevice curveDevice(EHeadsetState headset)
 {
-    if (current <= 0 && dB_diff <= 0)
-        return 0;
-    else if (current >= 65535 && dB_diff >= 0)
-        return 65535;
-
-    float dB_current = (((float)(current) - 65535)/65535.0) * 100;
-    float desired = 65535 * ((dB_current + (float)(dB_diff)) / 100 + 1);
-
-    if (desired < 0)
-        desired = 0;
-    else if (desired > 65535)
-        desired = 65535;
-
-    int result = (int) desired;
-
-    return result;
+    return headset != eHeadsetState_None ? VolumeCurves::eDevice_Headset :
+                                           VolumeCurves::eDevice_Speaker;
 }
 
 /*
@@ -180,65 +167,70 @@ static int _add_dB (int current, int dB_diff)
  * dB_diff is the amount in dB added to the current volume
  * returns the desired volume from 0 to 100
  */
-int PulseAudioMixer::adjustVolume(int percent, int dB_diff)
+int PulseAudioMixer::adjustVolume(int percent, int dB_diff, EVirtualSink sink)
 {
     if (!VERIFY(percent >= 0 && percent <= 100))
         return percent;
 
-    int tableIndex = gAudioDevice.getHeadsetState() != eHeadsetState_None ? 1 : 0;
-    int * table = _mapPercentToPulseVolume[tableIndex];
-    int pulse_volume = table[percent];
-    pulse_volume = _add_dB(pulse_volume, dB_diff);
+    int result = mVolumeCurves.adjust(sink, curveDevice(gAudioDevice.getHeadsetState()),
+                                      percent, dB_diff);
 
-    int result = percent;
+    g_debug("adjust dB Volume: %dp %+d dB = %dp (%+dp)", \
+                                 percent, dB_diff, result, result - percent);
+    return result;
+}
 
-    int lower = 0;
-    int upper = 100;
-    if (pulse_volume >= table[lower] && pulse_volume <= table[upper])
+/*
+ * Volume curves configuration, for instance:
+ * { "volumeCurves": [ { "sink": "media", "device": "headset",
+ *                       "points": [ { "percent": 0, "dB": -60 },
+ *                                   { "percent": 100, "dB": 0 } ] } ] }
+ * Without "sink", the curve applies to all sinks of that device.
+ */
+void PulseAudioMixer::loadVolumeCurves(const char * path)
+{
+    mVolumeCurves.setDefault(VolumeCurves::eDevice_Speaker, _mapPercentToPulseVolume[0]);
+    mVolumeCurves.setDefault(VolumeCurves::eDevice_Headset, _mapPercentToPulseVolume[1]);
+    mVolumeCurves.resetCurves();
+
+    pbnjson::JValue config = pbnjson::JDomParser::fromFile(path, pbnjson::JSchema::AllSchema());
+    if (!config.isObject() || !config["volumeCurves"].isArray())
     {
-        while (upper - lower > 1)
+        g_debug("%s: no volume curves in %s, using defaults", __FUNCTION__, path);
+    }
+    else
+    {
+        for (auto &entry : config["volumeCurves"].items())
         {
-            int mid = (lower + upper) / 2;
-            int diff = pulse_volume - table[mid];
+            bool valid = false;
+            VolumeCurves::EDevice device =
+                      VolumeCurves::deviceFromName(entry["device"].asString().c_str(), valid);
+            EVirtualSink sink = eVirtualSink_All;
+            std::string sinkName = "<all>";
+            if (entry.hasKey("sink"))
+            {
+                sinkName = entry["sink"].asString();
+                sink = getSinkByName(sinkName.c_str());
+            }
 
-            if (diff == 0)
-                upper = lower = mid;
-            else if (diff < 0)
-                upper = mid;
-            else
-                lower = mid;
-        }
-        result = lower;
-        if (pulse_volume > table[lower])
-        {
-            result = lower + (dB_diff < 0 ? 0 : 1);
-            if (pulse_volume >= table[lower + 1])
-                ++result;
-            if (result > 100)
-                result = 100;
-        }
-        // defensive: catch that rounding never gets us in the wrong direction!
-        if (dB_diff < 0)
-        {
-            if (result > percent)
-                result = percent;
-        }
-        else
-        {
-            if (result < percent)
-                result = percent;
+            std::vector<VolumeCurves::Point> points;
+            for (auto &point : entry["points"].items())
+            {
+                VolumeCurves::Point p;
+                p.mPercent = point["percent"].asNumber<int>();
+                p.mdB = point["dB"].asNumber<double>();
+                points.push_back(p);
+            }
+
+            if (!valid || sink == eVirtualSink_None ||
+                !mVolumeCurves.setCurve(sink, device, points))
+                g_warning("%s: ignoring invalid volume curve for sink '%s' on '%s'",
+                          __FUNCTION__, sinkName.c_str(),
+                          entry["device"].asString().c_str());
         }
-        VERIFY(table[lower] <= pulse_volume);
-        VERIFY(table[upper] >= pulse_volume);
     }
 
-    // arbitrarily force minimal 1% volume...
-    if (result == 0 && percent > 1)
-        result = 1;
-
-    g_debug("adjust dB Volume: %dp %+d dB = %dp (%+dp)", \
-                                 percent, dB_diff, result, result - percent);
-    return result;
+    mVolumeCurves.build();
 }
 
 bool
@@ -265,7 +257,11 @@ bool
 PulseAudioMixer::programSource (char cmd, int sink, int value)
 {
     if (NULL == mChannel)
+    {
+        sCommandsDropped.add();
+        gFlightRecorder.record(eFlightEvent_MixerCommand, cmd, sink, value, -1);
         return false;
+    }
 
     EHeadsetState headset = gAudioDevice.getHeadsetState();
 
@@ -273,6 +269,7 @@ PulseAudioMixer::programSource (char cmd, int sink, int value)
     switch (cmd)
     {
         case 'm':
+            mRamps.cancel((EVirtualSink)sink);
             value = 0;    // the mute command is equivalent to
                        //  setting volume to 0, but faster. There is no unmute!
         case 'v':
@@ -285,6 +282,8 @@ PulseAudioMixer::programSource (char cmd, int sink, int value)
                            mPulseStateVolumeHeadset[sink] != headset);
                 mPulseStateVolume[sink] = value;
                 mPulseStateVolumeHeadset[sink] = headset;
+                if (sendCmd)
+                    publishSinkStatus((EVirtualSink)sink);
             }
             break;
         case 'h':
@@ -352,6 +351,13 @@ PulseAudioMixer::programSource (char cmd, int sink, int value)
             sprintf(buffer, "%c %i %i %i", cmd, mPulseStateVolume[sink], headset, value);
             sinkName = virtualSinkName((EVirtualSink)sink);
         }
+        else if (cmd == 'v' || cmd == 'r')
+        {
+            // the policy module applies its default table: send what gets closest to our curve
+            int policyVolume = mVolumeCurves.toPolicy((EVirtualSink)sink, curveDevice(headset), value);
+            sprintf(buffer, "%c %i %i %i", cmd, sink, policyVolume, headset);
+            sinkName = virtualSinkName((EVirtualSink)sink);
+        }
         else
         {
             sprintf(buffer, "%c %i %i %i", cmd, sink, value, headset);
@@ -359,16 +365,27 @@ PulseAudioMixer::programSource (char cmd, int sink, int value)
         }
 
         g_debug ("%s: sending message '%s' %s", __FUNCTION__, buffer, sinkName);
+        PMTRACE_MIXER_COMMAND(cmd, sink, value);
         int sockfd = g_io_channel_unix_get_fd (mChannel);
         ssize_t bytes = send(sockfd, buffer, SIZE_MESG_TO_PULSE, MSG_DONTWAIT);
+        gFlightRecorder.record(eFlightEvent_MixerCommand, cmd, sink, value,
+                               bytes == SIZE_MESG_TO_PULSE ? 1 : -1);
         if (bytes != SIZE_MESG_TO_PULSE)
         {
+            sCommandsFailed.add();
             if (bytes >= 0)
                 g_warning("programSource: only %u bytes sent to Pulse out of %d (%s).", \
                                    bytes, SIZE_MESG_TO_PULSE, strerror(errno));
             else
                 g_warning("programSource: send to Pulse failed: %s", strerror(errno));
         }
+        else
+            sCommandsSent.add();
+    }
+    else
+    {
+        sCommandsSkipped.add();
+        gFlightRecorder.record(eFlightEvent_MixerCommand, cmd, sink, value, 0);
     }
 
     return true;
@@ -376,6 +393,13 @@ PulseAudioMixer::programSource (char cmd, int sink, int value)
 
 bool PulseAudioMixer::programVolume (EVirtualSink sink, int volume, bool ramp)
 {
+    // a sink fading out before it moves gets its volume once it moved
+    if (mRamps.holdVolume(sink, volume))
+        return true;
+
+    // an explicit volume always wins over a fade in progress
+    mRamps.cancel(sink);
+
     if (volume && !isNeverMutedSink(sink) &&
         mPulseStateActiveStreamCount[sink] <= 0)
     {    // don't set the volume up if
@@ -400,9 +424,28 @@ bool PulseAudioMixer::programMute (EVirtualSource source, int mute)
 bool PulseAudioMixer::programDestination (EVirtualSink sink,
                                           EPhysicalSink destination)
 {
+    // waiting for a fade out: only the destination changes, not when
+    if (mRamps.pendingMove(sink) >= 0)
+    {
+        mRamps.deferMove(sink, destination, 0);
+        return true;
+    }
+
     return programSource ('d', sink, destination);
 }
 
+bool PulseAudioMixer::deferDestination (EVirtualSink sink,
+                                        EPhysicalSink destination, int afterMs)
+{
+    if (!VERIFY(IsValidVirtualSink(sink)) || NULL == mChannel)
+        return false;
+
+    mRamps.deferMove(sink, destination, getCurrentTimeInMs() + afterMs);
+    runRamps();
+
+    return true;
+}
+
 void PulseAudioMixer::sendNREC(bool value)
 {
 
@@ -902,9 +945,52 @@ bool PulseAudioMixer::muteAll ()
     return true;
 }
 
+/// Sends the transition's commands through the mixer, like any other volume or route
+class MixerTransitionOutput : public MixerTransition::Output
+{
+public:
+    MixerTransitionOutput(PulseAudioMixer & mixer) : mMixer(mixer) {}
+
+    bool    fadeVolume(EVirtualSink sink, int endVolume, int durationMs, ERampCurve curve)
+                { return mMixer.fadeVolume(sink, endVolume, durationMs, curve); }
+    bool    programDestination(EVirtualSink sink, EPhysicalSink destination)
+                { return mMixer.programDestination(sink, destination); }
+    bool    deferDestination(EVirtualSink sink, EPhysicalSink destination, int afterMs)
+                { return mMixer.deferDestination(sink, destination, afterMs); }
+
+private:
+    PulseAudioMixer &   mMixer;
+};
+
+bool PulseAudioMixer::programTransition (const MixerProgramSink * sinks, int count)
+{
+    if (NULL == mChannel)
+        return false;
+
+    MixerTransition transition;
+    for (EVirtualSink sink = eVirtualSink_First;
+         sink <= eVirtualSink_Last;
+         sink = EVirtualSink(sink + 1))
+    {
+        // a sink still waiting to move is already where it's going
+        int route = mRamps.pendingMove(sink);
+        transition.setCurrent(sink, route >= 0 ? route : mPulseStateRoute[sink],
+                              mPulseStateVolume[sink], mActiveStreams.contain(sink));
+    }
+
+    for (int i = 0; i < count; i++)
+        transition.setTarget(sinks[i].mSink, sinks[i].mDestination);
+
+    MixerTransitionOutput output(*this);
+    transition.program(output);
+
+    return true;
+}
+
 static gboolean
 _pulseStatus(GIOChannel *ch, GIOCondition condition, gpointer user_data)
 {
+    MAINLOOP_HANDLER("pulse.status");
     gPulseAudioMixer._pulseStatus(ch, condition, user_data);
     return TRUE;
 }
@@ -932,6 +1018,7 @@ PulseAudioMixer::_connectSocket ()
     strncpy (&name.sun_path[1], PALMAUDIO_SOCK_NAME, length);
 
     mConnectAttempt++;
+    sPulseConnectAttempts.add();
 
     int sockfd = -1;
 
@@ -960,6 +1047,10 @@ PulseAudioMixer::_connectSocket ()
     g_message ("%s: successfully connected to Pulse on attempt #%i",\
                                                               __FUNCTION__,
                                                                mConnectAttempt);
+    gStartupProfiler.mark("pulse connected");
+    sPulseConnects.add();
+    sPulseConnected.set(1);
+    gFlightRecorder.record(eFlightEvent_PulseConnection, 0, 1, mConnectAttempt);
     mConnectAttempt = 0;
 
     // initialize table for the pulse state lookup table
@@ -973,6 +1064,7 @@ PulseAudioMixer::_connectSocket ()
         while (mPulseStateActiveStreamCount[sink] > 0)
             outputStreamClosed(sink);
         mPulseStateActiveStreamCount[sink] = 0;    // shouldn't be necessary
+        publishSinkStatus(sink);
     }
 
     EVirtualSource source;
@@ -1015,6 +1107,7 @@ PulseAudioMixer::_connectSocket ()
 static gboolean
 _timer (gpointer data)
 {
+    MAINLOOP_HANDLER("pulse.connect_timer");
     gPulseAudioMixer._timer();
     return FALSE;
 }
@@ -1030,11 +1123,87 @@ void PulseAudioMixer::_timer()
     }
 }
 
+bool PulseAudioMixer::fadeVolume (EVirtualSink sink, int endVolume,
+                                  int durationMs, ERampCurve curve)
+{
+    if (!VERIFY(IsValidVirtualSink(sink)) || NULL == mChannel)
+        return false;
+
+    // waiting to move: ramped up once moved
+    if (mRamps.holdVolume(sink, endVolume))
+        return true;
+
+    int from = mPulseStateVolume[sink] > 0 ? mPulseStateVolume[sink] : 0;
+    mRamps.start(sink, from, endVolume, durationMs, curve, getCurrentTimeInMs());
+    runRamps();
+
+    return true;
+}
+
+static gboolean
+_rampTimer (gpointer data)
+{
+    MAINLOOP_HANDLER("pulse.ramp_timer");
+    gPulseAudioMixer._rampTimer();
+    return FALSE;
+}
+
+void PulseAudioMixer::_rampTimer()
+{
+    mRampTimerID = 0;
+    runRamps();
+}
+
+void PulseAudioMixer::runRamps()
+{
+    guint64 now = getCurrentTimeInMs();
+    std::vector<RampScheduler::Command> commands;
+    mRamps.advance(now, commands);
+
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+        EVirtualSink sink = commands[i].mSink;
+        int volume = commands[i].mVolume;
+        // same rule as programVolume: high latency sinks not playing stay muted
+        if (volume && !isNeverMutedSink(sink) &&
+            mPulseStateActiveStreamCount[sink] <= 0)
+            volume = 0;
+        programSource ('r', sink, volume);
+    }
+
+    // sinks done fading out move, then get the volume programmed meanwhile
+    std::vector<RampScheduler::Move> moves;
+    mRamps.takeMoves(now, moves);
+    for (size_t i = 0; i < moves.size(); i++)
+    {
+        programSource ('d', moves[i].mSink, moves[i].mDestination);
+        if (moves[i].mVolume >= 0)
+            programVolume (moves[i].mSink, moves[i].mVolume, true);
+    }
+
+    if (mRampTimerID)
+    {
+        g_source_remove (mRampTimerID);
+        mRampTimerID = 0;
+    }
+
+    gint64 deadline = mRamps.nextDeadline();
+    if (deadline >= 0)
+        mRampTimerID = g_timeout_add ((guint64) deadline > now ? deadline - now : 0,
+                                      ::_rampTimer, 0);
+}
+
 int PulseAudioMixer::getStreamCount (EVirtualSink sink)
 {
     return mPulseStateActiveStreamCount[sink];
 }
 
+void PulseAudioMixer::publishSinkStatus(EVirtualSink sink)
+{
+    gAudiodStatus.setSink(sink, virtualSinkName(sink, false), mPulseStateVolume[sink],
+                          mPulseStateActiveStreamCount[sink]);
+}
+
 bool PulseAudioMixer::isSinkAudible(EVirtualSink sink)
 {
     if (!VERIFY(IsValidVirtualSink(sink)))
@@ -1062,6 +1231,8 @@ PulseAudioMixer::openCloseSink (EVirtualSink sink, bool openNotClose)
         streamCount = 0;
     }
 
+    publishSinkStatus(sink);
+
     VirtualSinkSet oldstreamflags = mActiveStreams;
 
     if (0 == streamCount)
@@ -1089,6 +1260,8 @@ PulseAudioMixer::_pulseStatus(GIOChannel *ch,
                               GIOCondition condition,
                               gpointer user_data)
 {
+    MetricsTimer timer(sPulseStatusLatency);
+
     if (condition & G_IO_IN)
     {
         char buffer[SIZE_MESG_TO_AUDIOD];
@@ -1106,6 +1279,7 @@ PulseAudioMixer::_pulseStatus(GIOChannel *ch,
         {
             g_debug("PulseAudioMixer::_pulseStatus: Pulse says: '%c %i %i'",\
                                   cmd, isink, info);
+            gFlightRecorder.record(eFlightEvent_PulseMessage, cmd, isink, info);
             EVirtualSink sink = EVirtualSink(isink);
                 EVirtualSource source = EVirtualSource(isink);
             switch (cmd)
@@ -1215,6 +1389,9 @@ PulseAudioMixer::_pulseStatus(GIOChannel *ch,
     if (condition & G_IO_HUP)
     {
         g_warning ("%s: pulse server gone away", __FUNCTION__);
+        sPulseDisconnects.add();
+        sPulseConnected.set(0);
+        gFlightRecorder.record(eFlightEvent_PulseConnection, 0, 0, 0);
         g_io_channel_shutdown (ch, FALSE, NULL);
 
         mTimeout = cMinTimeout;
@@ -1494,6 +1671,7 @@ static int IdToDtmf(const char* snd) {
 bool PulseAudioMixer::playSystemSound(const char *snd, EVirtualSink sink)
 {
     PMTRACE_FUNCTION;
+    PMTRACE_SAMPLE_PLAY(snd, sink);
     if (strncmp(snd, "dtmf_", 5) == 0) {
         // support dtmf_x
         // see http://developer.palm.com/index.php?option=
@@ -1565,6 +1743,8 @@ PulseAudioMixer::init(GMainLoop * loop, LSHandle * handle,
 {
     mCallbacks = interface;
 
+    loadVolumeCurves(VOLUME_CURVES_CONFIG_PATH);
+
 #if defined(AUDIOD_TEST_API)
     bool result;
     CLSError lserror;
@@ -20,6 +20,7 @@
 
 #include "AudioMixer.h"
 #include "PulseAudioLink.h"
+#include "VolumeCurves.h"
 
 /*
  * Implementation of AudioMixer using Pulse as backend
@@ -52,8 +53,15 @@ public:
     bool  rampVolume(EVirtualSink sink, int endVolume)
                        { return programVolume(sink, endVolume, true); }
 
+    /// Fade the volume of a sink over time. See RampScheduler.
+    bool  fadeVolume(EVirtualSink sink, int endVolume, int durationMs,
+                     ERampCurve curve = eRampCurve_Linear);
+
     /// Program destination of a sink
     bool programDestination(EVirtualSink sink, EPhysicalSink destination);
+    /// Move a sink once afterMs passed, when it faded out. Its volume is
+    // held until then: programVolume() only takes effect after the move.
+    bool deferDestination(EVirtualSink sink, EPhysicalSink destination, int afterMs);
     /// Program destination of a source
     bool programDestination(EVirtualSource source, EPhysicalSource destination);
 
@@ -62,9 +70,11 @@ public:
     bool                programLatency(int latency);
     bool                programBalance(int balance);
     bool                muteAll();
+    bool                programTransition(const MixerProgramSink * sinks, int count);
 
     /// Offset a volume by a number of dB. Calculation only.
-    int                    adjustVolume(int volume, int dB);
+    int                    adjustVolume(int volume, int dB,
+                                        EVirtualSink sink = eVirtualSink_None);
 
     /// Get active streams set to test which sinks are active.
     VirtualSinkSet        getActiveStreams()
@@ -126,6 +136,7 @@ public:
                                      GIOCondition condition,
                                      gpointer user_data);
     void                _timer();
+    void                _rampTimer();
     bool                _sinkStatus(LSHandle *lshandle, LSMessage *message);
     bool                _setFilter(LSHandle * lshandle, LSMessage * message);
     bool                _suspend(LSHandle * lshandle, LSMessage * message);
@@ -156,7 +167,10 @@ public:
 private:
     bool                programSource(char cmd, int sink, int value);
     void                openCloseSink(EVirtualSink sink, bool openNotClose);
+    void                publishSinkStatus(EVirtualSink sink);
     int                    getCurrentPulseVolume(EVirtualSink sink);// get Pulse volume
+    void                runRamps();
+    void                loadVolumeCurves(const char * path);
 
     // Direct socket connection to Pulse
     int                    mTimeout;
@@ -191,6 +205,13 @@ private:
     bool voiceRxMuted;
 #endif
     AudiodCallbacksInterface *    mCallbacks;
+
+    // Fades in progress, driven by a single timer
+    RampScheduler          mRamps;
+    guint                  mRampTimerID;
+
+    // Percent to Pulse volume lookup tables, per sink & output device
+    VolumeCurves           mVolumeCurves;
 };
 
 extern PulseAudioMixer gPulseAudioMixer;
@@ -0,0 +1,211 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <cmath>
+
+#include "RampScheduler.h"
+
+// level used for a volume of 0 in dB fades: quiet enough to be inaudible
+static const double cSilence_dB = -60.0;
+
+static double _percentTodB(int volume)
+{
+    if (volume <= 0)
+        return cSilence_dB;
+    double dB = 20.0 * log10(volume / 100.0);
+    return dB < cSilence_dB ? cSilence_dB : dB;
+}
+
+static int _dBToPercent(double dB)
+{
+    if (dB <= cSilence_dB)
+        return 0;
+    return (int) lround(100.0 * pow(10.0, dB / 20.0));
+}
+
+RampScheduler::RampScheduler()
+{
+    for (int i = 0; i < eVirtualSink_Count; i++)
+    {
+        mFades[i].mActive = false;
+        mFades[i].mCurve = eRampCurve_Linear;
+        mFades[i].mFrom = mFades[i].mTo = mFades[i].mLastSent = 0;
+        mFades[i].mDuration = 0;
+        mFades[i].mStart = mFades[i].mDeadline = 0;
+        mMoves[i].mDestination = mMoves[i].mVolume = -1;
+        mMoves[i].mAt = 0;
+    }
+}
+
+void RampScheduler::start(EVirtualSink sink, int from, int to, int durationMs,
+                          ERampCurve curve, uint64_t now)
+{
+    if (!isValid(sink))
+        return;
+
+    Fade & fade = mFades[sink];
+    if (fade.mActive)
+    {
+        // retarget: continue from where we are, not from where Pulse was told to go
+        from = interpolate(fade, now);
+    }
+    else
+        fade.mLastSent = from;
+
+    fade.mActive = true;
+    fade.mCurve = curve;
+    fade.mFrom = from;
+    fade.mTo = to;
+    fade.mDuration = durationMs > 0 ? durationMs : 0;
+    fade.mStart = now;
+    fade.mDeadline = now;
+}
+
+void RampScheduler::cancel(EVirtualSink sink)
+{
+    if (isValid(sink))
+        mFades[sink].mActive = false;
+}
+
+bool RampScheduler::isRamping(EVirtualSink sink) const
+{
+    return isValid(sink) && mFades[sink].mActive;
+}
+
+int RampScheduler::valueAt(EVirtualSink sink, uint64_t now) const
+{
+    if (!isValid(sink))
+        return 0;
+
+    const Fade & fade = mFades[sink];
+    return fade.mActive ? interpolate(fade, now) : fade.mLastSent;
+}
+
+int RampScheduler::interpolate(const Fade & fade, uint64_t now) const
+{
+    if (now <= fade.mStart)
+        return fade.mFrom;
+    if (fade.mDuration == 0 || now >= fade.mStart + fade.mDuration)
+        return fade.mTo;
+
+    double progress = double(now - fade.mStart) / fade.mDuration;
+    if (fade.mCurve == eRampCurve_dB)
+    {
+        double from = _percentTodB(fade.mFrom);
+        double to = _percentTodB(fade.mTo);
+        return _dBToPercent(from + (to - from) * progress);
+    }
+
+    return fade.mFrom + (int) lround((fade.mTo - fade.mFrom) * progress);
+}
+
+int RampScheduler::advance(uint64_t now, std::vector<Command> & commands)
+{
+    int count = 0;
+    for (int sink = eVirtualSink_First; sink <= eVirtualSink_Last; sink++)
+    {
+        Fade & fade = mFades[sink];
+        if (!fade.mActive || fade.mDeadline > now)
+            continue;
+
+        // ask Pulse to ramp to where the fade will be at the end of this step
+        uint64_t end = fade.mStart + fade.mDuration;
+        uint64_t stepEnd = now + cStepMs;
+        if (stepEnd >= end)
+        {
+            stepEnd = end;
+            fade.mActive = false;
+        }
+        else
+            fade.mDeadline = stepEnd;
+
+        int volume = fade.mActive ? interpolate(fade, stepEnd) : fade.mTo;
+        if (volume != fade.mLastSent)
+        {
+            Command command = { EVirtualSink(sink), volume };
+            commands.push_back(command);
+            fade.mLastSent = volume;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+void RampScheduler::deferMove(EVirtualSink sink, int destination, uint64_t at)
+{
+    if (!isValid(sink) || destination < 0)
+        return;
+
+    PendingMove & move = mMoves[sink];
+    if (move.mDestination < 0)
+    {
+        move.mVolume = -1;
+        move.mAt = at;
+    }
+    else if (at > move.mAt)
+        move.mAt = at;
+    move.mDestination = destination;
+}
+
+int RampScheduler::pendingMove(EVirtualSink sink) const
+{
+    return isValid(sink) ? mMoves[sink].mDestination : -1;
+}
+
+bool RampScheduler::holdVolume(EVirtualSink sink, int volume)
+{
+    if (pendingMove(sink) < 0)
+        return false;
+
+    mMoves[sink].mVolume = volume;
+    return true;
+}
+
+int RampScheduler::takeMoves(uint64_t now, std::vector<Move> & moves)
+{
+    int count = 0;
+    for (int sink = eVirtualSink_First; sink <= eVirtualSink_Last; sink++)
+    {
+        PendingMove & pending = mMoves[sink];
+        if (pending.mDestination < 0 || pending.mAt > now)
+            continue;
+
+        Move move = { EVirtualSink(sink), pending.mDestination, pending.mVolume };
+        moves.push_back(move);
+        pending.mDestination = pending.mVolume = -1;
+        count++;
+    }
+
+    return count;
+}
+
+int64_t RampScheduler::nextDeadline() const
+{
+    int64_t deadline = -1;
+    for (int sink = eVirtualSink_First; sink <= eVirtualSink_Last; sink++)
+    {
+        const Fade & fade = mFades[sink];
+        if (fade.mActive && (deadline < 0 || (int64_t) fade.mDeadline < deadline))
+            deadline = fade.mDeadline;
+        const PendingMove & move = mMoves[sink];
+        if (move.mDestination >= 0 && (deadline < 0 || (int64_t) move.mAt < deadline))
+            deadline = move.mAt;
+    }
+
+    return deadline;
+}
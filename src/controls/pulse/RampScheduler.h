@@ -0,0 +1,128 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#ifndef _RAMP_SCHEDULER_H_
+#define _RAMP_SCHEDULER_H_
+
+#include <vector>
+#include <stdint.h>
+
+#include <pulse/module-palm-policy.h>
+
+enum ERampCurve
+{
+    eRampCurve_Linear,      // volume percentage changes linearly over time
+    eRampCurve_dB           // loudness (dB) changes linearly over time
+};
+
+/*
+ * Owns the timeline of the gain of every virtual sink during fades.
+ * Pulse only knows how to do short ramps ('r' command), so a long fade is cut
+ * in steps no shorter than cStepMs, each sent as a ramp to the volume the fade
+ * reaches at the end of that step. Steps that would not change the volume
+ * are not sent. One deadline covers all the sinks, so a single main loop timer
+ * is enough however many fades are running.
+ * Route changes that must wait for a fade out are held here too, with the
+ * volume programmed meanwhile, so that they happen on the same timeline.
+ * Times are in ms, on any monotonic clock the caller likes.
+ */
+class RampScheduler
+{
+public:
+    /// Shortest step: below that, Pulse's own ramp would be cut short anyway
+    static const int cStepMs = 250;
+
+    /// A volume ramp to send to Pulse
+    struct Command
+    {
+        EVirtualSink    mSink;
+        int             mVolume;
+    };
+
+    /// A route change that waited for its sink to fade out
+    struct Move
+    {
+        EVirtualSink    mSink;
+        int             mDestination;
+        int             mVolume;    ///< programmed while waiting, -1 if none
+    };
+
+    RampScheduler();
+
+    /// Start a fade of the sink from 'from' to 'to'. If the sink is already
+    // fading, the fade is retargeted from where it is now & 'from' is ignored.
+    void        start(EVirtualSink sink, int from, int to, int durationMs,
+                      ERampCurve curve, uint64_t now);
+
+    /// Stop a fade where it is. Nothing is sent.
+    void        cancel(EVirtualSink sink);
+
+    bool        isRamping(EVirtualSink sink) const;
+
+    /// Volume of the sink's fade at a given time
+    int         valueAt(EVirtualSink sink, uint64_t now) const;
+
+    /// Collect the ramps due at that time. Returns how many were added.
+    int         advance(uint64_t now, std::vector<Command> & commands);
+
+    /// Move the sink once 'at' is reached. If it already waits to move, the
+    // destination is replaced & the latest time kept.
+    void        deferMove(EVirtualSink sink, int destination, uint64_t at);
+
+    /// Destination the sink waits to move to, or -1
+    int         pendingMove(EVirtualSink sink) const;
+
+    /// Keep a volume for after the sink's pending move, so that it stays
+    // silent until then. False if no move is pending: program it now.
+    bool        holdVolume(EVirtualSink sink, int volume);
+
+    /// Collect the moves due at that time. Returns how many were added.
+    int         takeMoves(uint64_t now, std::vector<Move> & moves);
+
+    /// When advance or takeMoves should be called next, or -1 if nothing is pending
+    int64_t     nextDeadline() const;
+
+private:
+    struct Fade
+    {
+        bool        mActive;
+        ERampCurve  mCurve;
+        int         mFrom;
+        int         mTo;
+        int         mDuration;
+        uint64_t    mStart;
+        uint64_t    mDeadline;
+        int         mLastSent;
+    };
+
+    struct PendingMove
+    {
+        int         mDestination;   ///< -1 if none
+        int         mVolume;
+        uint64_t    mAt;
+    };
+
+    static bool isValid(EVirtualSink sink)
+        { return sink >= eVirtualSink_First && sink <= eVirtualSink_Last; }
+
+    int         interpolate(const Fade & fade, uint64_t now) const;
+
+    Fade        mFades[eVirtualSink_Count];
+    PendingMove mMoves[eVirtualSink_Count];
+};
+
+#endif // _RAMP_SCHEDULER_H_
@@ -0,0 +1,320 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <cmath>
+#include <cstring>
+
+#include "VolumeCurves.h"
+
+/*
+  current is the current volume from 0 to 65535
+  dB_diff is the amount in dB added to the current volume
+  returns the desired volume from 0 to 65535
+*/
+int VolumeCurves::addDB (int current, int dB_diff)
+{
+    const int max = cMaxPulseVolume;
+
+    if (current <= 0 && dB_diff <= 0)
+        return 0;
+    else if (current >= max && dB_diff >= 0)
+        return max;
+
+    // divide in double, as the percent tables were tuned with it
+    float dB_current = (((float)(current) - max)/(double)max) * cdBRange;
+    float desired = max * ((dB_current + (float)(dB_diff)) / cdBRange + 1);
+
+    if (desired < 0)
+        desired = 0;
+    else if (desired > max)
+        desired = max;
+
+    return (int) desired;
+}
+
+static int _dBToPulse (double dB)
+{
+    double pulse = VolumeCurves::cMaxPulseVolume * (dB / VolumeCurves::cdBRange + 1);
+    if (pulse <= 0)
+        return 0;
+    if (pulse >= VolumeCurves::cMaxPulseVolume)
+        return VolumeCurves::cMaxPulseVolume;
+    return (int) lround(pulse);
+}
+
+VolumeCurves::VolumeCurves()
+{
+    // until told otherwise, a straight line in dB from silence to full volume
+    for (int device = 0; device < eDevice_Count; device++)
+        for (int percent = 0; percent <= 100; percent++)
+            mDefault[device][percent] = (cMaxPulseVolume * percent) / 100;
+}
+
+void VolumeCurves::setDefault(EDevice device, const int * pulseVolumes)
+{
+    if (device < 0 || device >= eDevice_Count || pulseVolumes == 0)
+        return;
+
+    memcpy(mDefault[device], pulseVolumes, sizeof(mDefault[device]));
+    for (int sink = 0; sink < eVirtualSink_Count; sink++)
+    {
+        if (mCurves[sink][device].mPoints.empty())
+            mCurves[sink][device].mDirty = true;
+    }
+    if (mAllSinks[device].mPoints.empty())
+        mAllSinks[device].mDirty = true;
+}
+
+bool VolumeCurves::setCurve(EVirtualSink sink, EDevice device, const std::vector<Point> & points)
+{
+    if (device < 0 || device >= eDevice_Count || points.empty())
+        return false;
+    if (sink != eVirtualSink_All && (sink < eVirtualSink_First || sink > eVirtualSink_Last))
+        return false;
+
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        if (points[i].mPercent < 0 || points[i].mPercent > 100 ||
+            points[i].mdB > 0 || points[i].mdB < -cdBRange)
+            return false;
+        if (i > 0 && (points[i].mPercent <= points[i - 1].mPercent ||
+                      points[i].mdB < points[i - 1].mdB))
+            return false;
+    }
+
+    int first = sink == eVirtualSink_All ? eVirtualSink_First : sink;
+    int last = sink == eVirtualSink_All ? eVirtualSink_Last : sink;
+    for (int i = first; i <= last; i++)
+    {
+        mCurves[i][device].mPoints = points;
+        mCurves[i][device].mDirty = true;
+    }
+    if (sink == eVirtualSink_All)
+    {
+        mAllSinks[device].mPoints = points;
+        mAllSinks[device].mDirty = true;
+    }
+
+    return true;
+}
+
+void VolumeCurves::resetCurves()
+{
+    for (int sink = 0; sink < eVirtualSink_Count; sink++)
+    {
+        for (int device = 0; device < eDevice_Count; device++)
+        {
+            mCurves[sink][device].mPoints.clear();
+            mCurves[sink][device].mDirty = true;
+        }
+    }
+    for (int device = 0; device < eDevice_Count; device++)
+    {
+        mAllSinks[device].mPoints.clear();
+        mAllSinks[device].mDirty = true;
+    }
+}
+
+void VolumeCurves::build()
+{
+    for (int device = 0; device < eDevice_Count; device++)
+    {
+        for (int sink = eVirtualSink_First; sink <= eVirtualSink_Last; sink++)
+            if (mCurves[sink][device].mDirty)
+                buildTable(mCurves[sink][device], EDevice(device));
+        if (mAllSinks[device].mDirty)
+            buildTable(mAllSinks[device], EDevice(device));
+    }
+}
+
+VolumeCurves::Curve & VolumeCurves::curve(EVirtualSink sink, EDevice device)
+{
+    if (device < 0 || device >= eDevice_Count)
+        device = eDevice_Speaker;
+
+    Curve & c = (sink >= eVirtualSink_First && sink <= eVirtualSink_Last) ?
+                                      mCurves[sink][device] : mAllSinks[device];
+    if (c.mDirty)
+        buildTable(c, device);
+    return c;
+}
+
+void VolumeCurves::buildTable(Curve & c, EDevice device)
+{
+    if (c.mPoints.empty())
+    {
+        memcpy(c.mTable, mDefault[device], sizeof(c.mTable));
+        for (int percent = 0; percent <= 100; percent++)
+            c.mPolicy[percent] = percent;
+    }
+    else
+    {
+        const std::vector<Point> & points = c.mPoints;
+        size_t next = 0;
+        for (int percent = 0; percent <= 100; percent++)
+        {
+            while (next < points.size() && points[next].mPercent < percent)
+                next++;
+
+            double dB;
+            if (next == 0)
+                dB = points.front().mdB;
+            else if (next == points.size())
+                dB = points.back().mdB;
+            else
+            {
+                const Point & a = points[next - 1];
+                const Point & b = points[next];
+                dB = a.mdB + (b.mdB - a.mdB) * (percent - a.mPercent) / (b.mPercent - a.mPercent);
+            }
+            c.mTable[percent] = _dBToPulse(dB);
+        }
+        // 0% is always silence
+        c.mTable[0] = 0;
+
+        // ...& a non-trivial volume never is
+        for (int percent = 0; percent <= 100; percent++)
+        {
+            int policy = nearestDefault(device, c.mTable[percent]);
+            c.mPolicy[percent] = (percent > 0 && policy == 0 && c.mTable[percent] > 0) ? 1 : policy;
+        }
+    }
+
+    c.mAdjusted.clear();
+    c.mDirty = false;
+}
+
+int VolumeCurves::toPulse(EVirtualSink sink, EDevice device, int percent)
+{
+    if (percent <= 0)
+        return 0;
+    if (percent > 100)
+        percent = 100;
+    return curve(sink, device).mTable[percent];
+}
+
+int VolumeCurves::toPolicy(EVirtualSink sink, EDevice device, int percent)
+{
+    if (percent <= 0)
+        return 0;
+    if (percent > 100)
+        percent = 100;
+    return curve(sink, device).mPolicy[percent];
+}
+
+int VolumeCurves::nearestDefault(EDevice device, int pulseVolume)
+{
+    const int * table = mDefault[device];
+    int lower = 0;
+    int upper = 100;
+    if (pulseVolume <= table[lower])
+        return lower;
+    if (pulseVolume >= table[upper])
+        return upper;
+
+    // table[lower] < pulseVolume <= table[upper]
+    while (upper - lower > 1)
+    {
+        int mid = (lower + upper) / 2;
+        if (table[mid] < pulseVolume)
+            lower = mid;
+        else
+            upper = mid;
+    }
+    return pulseVolume - table[lower] < table[upper] - pulseVolume ? lower : upper;
+}
+
+int VolumeCurves::adjust(EVirtualSink sink, EDevice device, int percent, int dB)
+{
+    if (percent < 0 || percent > 100)
+        return percent;
+    if (dB == 0)
+        return percent;
+
+    Curve & c = curve(sink, device);
+    std::vector<int> & adjusted = c.mAdjusted[dB];
+    if (adjusted.empty())
+    {
+        adjusted.resize(101);
+        for (int p = 0; p <= 100; p++)
+            adjusted[p] = computeAdjusted(c.mTable, p, dB);
+    }
+
+    return adjusted[percent];
+}
+
+int VolumeCurves::computeAdjusted(const int * table, int percent, int dB_diff)
+{
+    int pulse_volume = addDB(table[percent], dB_diff);
+
+    int result = percent;
+
+    int lower = 0;
+    int upper = 100;
+    if (pulse_volume >= table[lower] && pulse_volume <= table[upper])
+    {
+        while (upper - lower > 1)
+        {
+            int mid = (lower + upper) / 2;
+            int diff = pulse_volume - table[mid];
+
+            if (diff == 0)
+                upper = lower = mid;
+            else if (diff < 0)
+                upper = mid;
+            else
+                lower = mid;
+        }
+        result = lower;
+        if (pulse_volume > table[lower])
+        {
+            result = lower + (dB_diff < 0 ? 0 : 1);
+            if (lower < 100 && pulse_volume >= table[lower + 1])
+                ++result;
+            if (result > 100)
+                result = 100;
+        }
+        // defensive: catch that rounding never gets us in the wrong direction!
+        if (dB_diff < 0)
+        {
+            if (result > percent)
+                result = percent;
+        }
+        else
+        {
+            if (result < percent)
+                result = percent;
+        }
+    }
+
+    // arbitrarily force minimal 1% volume...
+    if (result == 0 && percent > 1)
+        result = 1;
+
+    return result;
+}
+
+VolumeCurves::EDevice VolumeCurves::deviceFromName(const char * name, bool & valid)
+{
+    valid = true;
+    if (name && strcmp(name, "speaker") == 0)
+        return eDevice_Speaker;
+    if (name && strcmp(name, "headset") == 0)
+        return eDevice_Headset;
+    valid = false;
+    return eDevice_Speaker;
+}
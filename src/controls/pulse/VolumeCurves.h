@@ -0,0 +1,112 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#ifndef _VOLUME_CURVES_H_
+#define _VOLUME_CURVES_H_
+
+#include <map>
+#include <vector>
+
+#include <pulse/module-palm-policy.h>
+
+/*
+ * Volume curves map a volume percentage to a Pulse volume, per sink & output
+ * device. By default, every sink uses the palm policy table of its device.
+ * Curves can be overridden from configuration, as dB values at a few
+ * percentages, linearly interpolated in between.
+ * Each (sink, device) pair gets a 101 entry lookup table, built ahead of time or
+ * on first use after a change, and a cache of dB adjustments per dB offset,
+ * so that volume adjustments are table lookups.
+ * The palm policy module only takes percentages, so a configured curve is
+ * applied by sending the percentage of the default table nearest to it.
+ */
+class VolumeCurves
+{
+public:
+    enum EDevice
+    {
+        eDevice_Speaker = 0,
+        eDevice_Headset = 1,
+        eDevice_Count
+    };
+
+    /// Pulse volumes go from 0 to cMaxPulseVolume, which is 0 dB.
+    // The palm policy tables are linear in dB, cdBRange dB below 0 dB being 0.
+    static const int cMaxPulseVolume = 65535;
+    static const int cdBRange = 100;
+
+    struct Point
+    {
+        int     mPercent;
+        double  mdB;    // 0 dB is full volume, -cdBRange is silence
+    };
+
+    VolumeCurves();
+
+    /// Default table of a device, 101 pulse volumes. Typically _mapPercentToPulseVolume.
+    void    setDefault(EDevice device, const int * pulseVolumes);
+
+    /// Set the curve of a sink on a device, or of all sinks when sink is eVirtualSink_All.
+    // Points must be in increasing percent order with non-decreasing dB values.
+    bool    setCurve(EVirtualSink sink, EDevice device, const std::vector<Point> & points);
+
+    /// Go back to the default table for every sink & device
+    void    resetCurves();
+
+    /// Build all the tables that need it. Lookups do it on demand otherwise.
+    void    build();
+
+    /// Pulse volume of a percentage. Sinks out of range, such as eVirtualSink_None,
+    // use the curve set for all sinks, or the default table.
+    int     toPulse(EVirtualSink sink, EDevice device, int percent);
+
+    /// Percentage to send to the palm policy module, which maps it to a Pulse
+    // volume with the default table itself: the one that gets closest to toPulse().
+    int     toPolicy(EVirtualSink sink, EDevice device, int percent);
+
+    /// Volume percentage, offset by a number of dB. Never goes the wrong direction,
+    // and never rounds a non-trivial volume down to 0.
+    int     adjust(EVirtualSink sink, EDevice device, int percent, int dB);
+
+    /// Pulse volume from 0 to cMaxPulseVolume, offset by a number of dB, clamped.
+    static int  addDB(int pulseVolume, int dB);
+
+    static EDevice deviceFromName(const char * name, bool & valid);
+
+private:
+    struct Curve
+    {
+        Curve() : mDirty(true) {}
+
+        bool                                mDirty;
+        std::vector<Point>                  mPoints;    // empty: use the default table
+        int                                 mTable[101];
+        int                                 mPolicy[101];   // percent to send for each percent
+        std::map<int, std::vector<int> >    mAdjusted;  // percent -> percent, by dB offset
+    };
+
+    Curve & curve(EVirtualSink sink, EDevice device);
+    void    buildTable(Curve & curve, EDevice device);
+    int     computeAdjusted(const int * table, int percent, int dB);
+    int     nearestDefault(EDevice device, int pulseVolume);
+
+    int     mDefault[eDevice_Count][101];
+    Curve   mCurves[eVirtualSink_Count][eDevice_Count];
+    Curve   mAllSinks[eDevice_Count];
+};
+
+#endif // _VOLUME_CURVES_H_
@@ -34,6 +34,7 @@
 #include "alarm.h"
 #include "timer.h"
 #include "alert.h"
+#include "FlightRecorder.h"
 
 GenericScenarioModule * GenericScenarioModule::sCurrentModule = 0;
 
@@ -63,7 +64,10 @@ GenericScenarioModule::_setCurrentScenarioByPriority ()
         }
     }
     if (VERIFY (mCurrentScenario != 0) && mCurrentScenario != previouslyCurrent)
-    g_message("Scenario '%s' selected by priority", mCurrentScenario->getName());
+    {
+        g_message("Scenario '%s' selected by priority", mCurrentScenario->getName());
+        gFlightRecorder.record(eFlightEvent_Scenario, 'p', 0, 0, 0, mCurrentScenario->getName());
+    }
 }
 
 bool
@@ -114,6 +118,7 @@ GenericScenarioModule::setCurrentScenario (const char * name)
         if (s != mCurrentScenario)
         {
             g_message("Scenario '%s' selected", s->getName());
+            gFlightRecorder.record(eFlightEvent_Scenario, 's', 0, 0, 0, s->getName());
             int flags = UPDATE_CHANGED_SCENARIO;
             int volume = -1;
             int micgain = -1;
@@ -213,6 +213,10 @@ public:
     void storePreferences();
     /// Restore preferences now
     void restorePreferences();
+    /// Store preferences in luna-prefs format
+    void exportPreferences();
+    /// Restore volumes from the preference journal
+    void restoreJournaledVolumes();
 
     bool setCurrentScenarioByPriority();
 
@@ -222,6 +226,8 @@ public:
     bool sendChangedUpdate (int changedFlags,
     const gchar * broadCastEvent = 0);
     bool sendRequestedUpdate (LSHandle *sh, LSMessage *message, bool subscribed);
+    /// Copy the module's status to the shared status page
+    void publishStatus ();
     bool sendEnabledUpdate (const char *scenario,
     int enabledFlags);
 
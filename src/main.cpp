@@ -38,11 +38,25 @@
 #include "utils.h"
 #include "messageUtils.h"
 #include "MixerInit.h"
+#include "StartupProfiler.h"
+#include "Metrics.h"
+#include "FlightRecorder.h"
+#include "StallWatchdog.h"
 #include "main.h"
 
 
 #define CONFIG_DIR_PATH "/etc/palm/audiod"
 
+// where the startup profile is written, & how long after the main loop started (s)
+#define STARTUP_PROFILE_PATH "/tmp/audiod-startup.json"
+#define STARTUP_PROFILE_DELAY 10
+
+// how often the metrics are dumped in the logs (s)
+#define METRICS_LOG_INTERVAL 900
+
+// how often the main loop beats for the stall watchdog (ms)
+#define MAINLOOP_HEARTBEAT_INTERVAL 250
+
 #define str(s)      # s
 #define xstr(s)     str(s)
 
@@ -54,6 +68,7 @@
 
 static GMainLoop * gMainLoop = NULL;
 static LSHandle *gLSHandle = NULL;
+static StallWatchdog gStallWatchdog;
 
 void
 term_handler(int signal)
@@ -73,7 +88,9 @@ PrintUsage(const char* progname)
             " -t send all log entries to the terminal\n"
            " -g turn debug logging on and use the system log (only)\n"
            " -s N sleep N milliseconds & quit\n"
-           " -n <priority> set the priority level\n");
+           " -n <priority> set the priority level\n"
+           " -w <ms> report main loop stalls longer than that (default %u)\n",
+           StallWatchdog::cDefaultThreshold);
 }
 
 GMainContext *
@@ -113,14 +130,42 @@ bool RegisterPalmService()
 }
 
 
+static gboolean
+_reportStartupProfile(gpointer data)
+{
+    std::string report = gStartupProfiler.finish();
+    g_message("Startup profile: %s", report.c_str());
+    if (!StartupProfiler::write(report, STARTUP_PROFILE_PATH))
+        g_warning("Could not write startup profile to '%s'", STARTUP_PROFILE_PATH);
+    return FALSE;
+}
+
+static gboolean
+_logMetrics(gpointer data)
+{
+    std::string summary = Metrics::summary();
+    if (!summary.empty())
+        g_message("Metrics:\n%s", summary.c_str());
+    return TRUE;
+}
+
+static gboolean
+_mainLoopHeartbeat(gpointer data)
+{
+    gStallWatchdog.beat(Metrics::now());
+    return TRUE;
+}
+
 int
 main(int argc, char **argv)
 {
     int opt;
     int niceme = 0;
+    unsigned stallThreshold = StallWatchdog::cDefaultThreshold;
 
     signal(SIGTERM, term_handler);
     signal(SIGINT, term_handler);
+    gFlightRecorder.dumpOnSignal(SIGUSR1, FLIGHT_RECORDER_PATH);
 
     if (argc > 1 && strcmp(argv[1], "--version") == 0)
     {
@@ -131,7 +176,7 @@ main(int argc, char **argv)
 
     setProcessName(argv[0]);
 
-    while ((opt = getopt(argc, argv, "hdr:n:gfts:")) != -1)
+    while ((opt = getopt(argc, argv, "hdr:n:gfts:w:")) != -1)
     {
         switch (opt)
         {
@@ -158,6 +203,9 @@ main(int argc, char **argv)
         case 's':
             usleep(atoi(optarg) * 1000);
             return 0;
+        case 'w':
+            stallThreshold = atoi(optarg);
+            break;
         case 'h':
         default:
 
@@ -173,12 +221,18 @@ main(int argc, char **argv)
 
     setpriority(PRIO_PROCESS,getpid(),niceme);
 
+    gStartupProfiler.mark("main");
+
     // Initialized audiod shared properties. Do not use them before this point!
+    gStartupProfiler.begin("state init");
     gState.init();
+    gStartupProfiler.end("state init");
 
     // Initialize HW and verify, but before all registered inits,
     // except for static initializations & shared properties.
+    gStartupProfiler.begin("device pre_init");
     VERIFY(gAudioDevice.pre_init());
+    gStartupProfiler.end("device pre_init");
 
     gMainLoop = g_main_loop_new(NULL, FALSE);
 
@@ -186,14 +240,17 @@ main(int argc, char **argv)
      *  initialize the lunaservice and we want it before all the init
      *  stuff happening.
      */
+    gStartupProfiler.begin("luna service registration");
     if(RegisterPalmService() == false)
         return -1;
+    gStartupProfiler.end("luna service registration");
     g_message("Register [com.webos.service.audio] Successful");
 
 
     std::stringstream configPath;
     configPath << CONFIG_DIR_PATH << "/" << "mixerconfig.json";
     MixerInit mObjMixerInit(configPath);
+    gStartupProfiler.begin("mixer init");
     if(mObjMixerInit.readMixerConfig())
     {
       mObjMixerInit.initMixerInterface();
@@ -202,12 +259,28 @@ main(int argc, char **argv)
     {
       g_message("Could not reaad mixer config json file");
     }
+    gStartupProfiler.end("mixer init");
+    gStartupProfiler.begin("init hooks");
     oneInitForAll (gMainLoop, GetPalmService());
+    gStartupProfiler.end("init hooks");
     // Verify HW initialization, but after all registered inits,
     // static initializations & shared properties.
+    gStartupProfiler.begin("device post_init");
     VERIFY(gAudioDevice.post_init());
+    gStartupProfiler.end("device post_init");
     g_debug("Starting main loop!");
+    gStartupProfiler.mark("main loop");
+    g_timeout_add_seconds(STARTUP_PROFILE_DELAY, _reportStartupProfile, NULL);
+    g_timeout_add_seconds(METRICS_LOG_INTERVAL, _logMetrics, NULL);
+    gStallWatchdog.configure(MAINLOOP_HEARTBEAT_INTERVAL, stallThreshold);
+    g_timeout_add_full(G_PRIORITY_HIGH, MAINLOOP_HEARTBEAT_INTERVAL, _mainLoopHeartbeat, NULL, NULL);
+    gStallWatchdog.start();
     g_main_loop_run(gMainLoop);
+    gStallWatchdog.stop();
+
+    // don't lose the preference changes waiting for their write, and leave
+    // a fresh snapshot for a quick restore at next boot
+    gState.flushPreferences(true);
 
     g_main_loop_unref(gMainLoop);
 
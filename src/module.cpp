@@ -1014,6 +1014,7 @@ GenericScenarioModule::registerMe (LSMethod *methods)
         g_message("%s: Registering Service for '%s' category failed", __FUNCTION__, mCategory.c_str());
         return false;
     }
+    publishStatus();
 
     return true;
 }
@@ -41,6 +41,7 @@
 #include "vvm.h"
 #include "timer.h"
 #include "alert.h"
+#include "StallWatchdog.h"
 
 
 static MediaScenarioModule * sMediaModule = 0;
@@ -118,7 +119,8 @@ bool MediaScenarioModule::getRequestedState(void)
 void
 MediaScenarioModule::programMediaVolumes(bool rampVolumes,
                                          bool rampMedia,
-                                         bool muteMedia)
+                                         bool muteMedia,
+                                         int fadeMs)
 {
 
     const int cNavigationDuck = -18;    // dB
@@ -161,18 +163,18 @@ MediaScenarioModule::programMediaVolumes(bool rampVolumes,
     }
 
     if (mediaVolume > 0 && duckMedia != 0)
-        mediaVolume = gAudioMixer.adjustVolume(mediaVolume, duckMedia);
+        mediaVolume = gAudioMixer.adjustVolume(mediaVolume, duckMedia, emedia);
 
     if (flashVolume > 0 && duckFlash != 0)
-        flashVolume = gAudioMixer.adjustVolume(flashVolume, duckFlash);
+        flashVolume = gAudioMixer.adjustVolume(flashVolume, duckFlash, eflash);
 
     if (defaultAppVolume > 0 && duckDefaultApp != 0)
         defaultAppVolume = gAudioMixer.adjustVolume(defaultAppVolume,
-                                                    duckDefaultApp);
+                                                    duckDefaultApp, edefaultapp);
 
     if (navigationVolume > 0 && duckNavigation != 0)
         navigationVolume = gAudioMixer.adjustVolume(navigationVolume,
-                                                    duckNavigation);
+                                                    duckNavigation, enavigation);
 
     // Apply as necessary, with or without ramping
 
@@ -200,28 +202,58 @@ MediaScenarioModule::programMediaVolumes(bool rampVolumes,
             volume_to_set = navigationVolume;
 
         if(-1 != mPreviousSink )
-            programVolume(mPreviousSink, volume_to_set, rampVolumes || rampMedia);
+            programVolume(mPreviousSink, volume_to_set, rampVolumes || rampMedia, fadeMs);
     }
 
     if(mPreviousSink != emedia)
-        programVolume(emedia, mediaVolume, rampVolumes);
+        programVolume(emedia, mediaVolume, rampVolumes, fadeMs);
 
     if(mPreviousSink != eflash)
-        programVolume(eflash, flashVolume, rampVolumes);
+        programVolume(eflash, flashVolume, rampVolumes, fadeMs);
 
     if(mPreviousSink != edefaultapp)
     {
-        programVolume(edefaultapp, defaultAppVolume, rampVolumes);
+        programVolume(edefaultapp, defaultAppVolume, rampVolumes, fadeMs);
     }
 
     if(mPreviousSink != enavigation)
-        programVolume(enavigation, navigationVolume, rampVolumes);
+        programVolume(enavigation, navigationVolume, rampVolumes, fadeMs);
 
 }
 
+void
+MediaScenarioModule::_resumeMediaPlayback(int fadeMs)
+{
+    VirtualSinkSet activeStreams = gAudioMixer.getActiveStreams ();
+    if (activeStreams.contain(emedia))
+        _startSinkPlayback (emedia, fadeMs);
+    else if (activeStreams.contain(eflash))
+        _startSinkPlayback (eflash, fadeMs);
+    else if (activeStreams.contain(edefaultapp))
+        _startSinkPlayback (edefaultapp, fadeMs);
+    else if (activeStreams.contain(enavigation))
+        _startSinkPlayback (enavigation, fadeMs);
+    else
+        programMediaVolumes(true, false, false);
+}
+
+gboolean
+MediaScenarioModule::_alertEndTimeout(gpointer)
+{
+    MAINLOOP_HANDLER("media.alert_end");
+    MediaScenarioModule * media = getMediaModule();
+
+    g_message("No alarm, timer or ringtone for %d ms: fading media back in",
+              media->cAlertEndQuietMs);
+    media->mAlertEndTimerID = 0;
+    media->_resumeMediaPlayback(media->cAlertEndFadeMs);
+    return FALSE;
+}
+
 gboolean
 MediaScenarioModule::_A2DPDelayedUpdate(gpointer)
 {
+    MAINLOOP_HANDLER("media.a2dp_update");
     MediaScenarioModule * media = getMediaModule();
 
     if (media->mA2DPRequestedState == eA2DP_Playing) {
@@ -608,10 +640,10 @@ MediaScenarioModule::programState ()
 }
 
 void
-MediaScenarioModule::_startSinkPlayback (EVirtualSink sink)
+MediaScenarioModule::_startSinkPlayback (EVirtualSink sink, int fadeMs)
 {
 
-    programMediaVolumes(false, false, false);
+    programMediaVolumes(false, false, false, fadeMs);
 
     if (isMediaSink(sink)) {
         getSystemModule()->programSystemVolumes(false);
@@ -668,30 +700,6 @@ MediaScenarioModule::_updateRouting()
     }
 }
 
-gboolean timerTimeout (gpointer data)
-{
-    g_message("Timer expired... Calling onSinkChanged for media module when timer sink is closed");
-    MediaScenarioModule *mediaModule = (MediaScenarioModule *)data;
-    mediaModule->onSinkChanged(etimer, eControlEvent_LastStreamClosed,ePulseAudio);
-    return FALSE;
-}
-
-gboolean alarmTimeout (gpointer data)
-{
-    g_message("Timer expired... Calling onSinkChanged for media module when alarm sink is closed");
-    MediaScenarioModule *mediaModule = (MediaScenarioModule *)data;
-    mediaModule->onSinkChanged(ealarm, eControlEvent_LastStreamClosed,ePulseAudio);
-    return FALSE;
-}
-
-gboolean ringtoneTimeout (gpointer data)
-{
-    g_message("Ringtone expired... Calling onSinChanged for media module when ringtone sink is closed");
-    MediaScenarioModule *mediaModule = (MediaScenarioModule *)data;
-    mediaModule->onSinkChanged(eringtones, eControlEvent_LastStreamClosed,ePulseAudio);
-    return FALSE;
-}
-
 void MediaScenarioModule::sendAckToPowerd(bool isWakeup)
 {
 
@@ -730,8 +738,6 @@ MediaScenarioModule::onSinkChanged (EVirtualSink sink, EControlEvent event, ESin
 
       _updateRouting();
 
-      VirtualSinkSet activeStreams = gAudioMixer.getActiveStreams ();
-
       if (emedia == sink || eflash == sink || edefaultapp == sink ||
            enavigation == sink )
       {
@@ -783,61 +789,28 @@ MediaScenarioModule::onSinkChanged (EVirtualSink sink, EControlEvent event, ESin
               3rd parameter to true enables the code to mute the media in case
               playback through some other sinks are starting */
               //programMediaVolumes(true, false, false);
-              programMediaVolumes(true, false, true);
-              if(sink == ealarm ){
-                  if(alarmTimeoutSource != 0)
-                      if(g_source_remove(alarmTimeoutSource)){
-                          g_message("Removed timer since new alarm stream is created");
-                          alarmTimeoutSource = 0;
-                      }
-              }
-              if(sink == etimer){
-                  if(timerTimeoutSource != 0)
-                      if(g_source_remove(timerTimeoutSource)){
-                          g_message("Removed timer since new timer stream is created");
-                          timerTimeoutSource = 0;
-                      }
-              }
-              if (sink == eringtones) {
-                  if (mRingtoneTimeoutSource != 0)
-                      if (g_source_remove(mRingtoneTimeoutSource)) {
-                          g_message("Removed ringtone timer since new ringtone stream is created");
-                          mRingtoneTimeoutSource = 0;
-                      }
+              // also cancels the fade in of a previous alarm, timer or ringtone
+              if (mAlertEndTimerID)
+              {
+                  g_message("Media stays ducked: new stream on sink %d", sink);
+                  g_source_remove(mAlertEndTimerID);
+                  mAlertEndTimerID = 0;
               }
+              programMediaVolumes(true, false, true);
           }
           else if (eControlEvent_LastStreamClosed == event)
           {
-              if ((sink == ealarm && !alarmTimeoutSource) || (sink == etimer && !timerTimeoutSource)
-                          || (sink == eringtones && !mRingtoneTimeoutSource)) {
-                  if (someMediaIsPlaying() || gState.isRecording ()) {
-                       g_message("Setting timer for 400ms");
-                       if(etimer == sink)
-                           timerTimeoutSource = g_timeout_add (400, timerTimeout, this);
-                       else if (ealarm == sink)
-                           alarmTimeoutSource = g_timeout_add (400, alarmTimeout, this);
-                       else
-                           mRingtoneTimeoutSource = g_timeout_add (400, ringtoneTimeout, this);
-                  }
-              }
-              else
+              // back to back alarms, timers or ringtones must not let media
+              // through between them: wait for a quiet period, then fade it in
+              if ((sink == ealarm || sink == etimer || sink == eringtones) &&
+                  (someMediaIsPlaying() || gState.isRecording ()))
               {
-                  alarmTimeoutSource = 0;
-                  timerTimeoutSource = 0;
-                  mRingtoneTimeoutSource = 0;
-                  if (activeStreams.contain(emedia))
-                      _startSinkPlayback (emedia);
-                  else if (activeStreams.contain(eflash))
-                      _startSinkPlayback (eflash);
-                  else if (activeStreams.contain(edefaultapp))
-                      _startSinkPlayback (edefaultapp);
-                  else if (activeStreams.contain(enavigation))
-                      _startSinkPlayback (enavigation);
-                  else
-                  {
-                      programMediaVolumes(true, false, false);
-                  }
+                  if (mAlertEndTimerID)
+                      g_source_remove(mAlertEndTimerID);
+                  mAlertEndTimerID = g_timeout_add (cAlertEndQuietMs, _alertEndTimeout, NULL);
               }
+              else if (!mAlertEndTimerID)
+                  _resumeMediaPlayback (0);
           }
       }
       else if (efeedback ==sink )
@@ -923,9 +896,7 @@ MediaScenarioModule::MediaScenarioModule(int default_volume) :
     mWirelessVolume(cMedia_Wireless, 50),
     mFrontMicGain(cMedia_Mic_Front, -1),
     mHeadsetMicGain(cMedia_Mic_HeadsetMic, -1),
-    alarmTimeoutSource(0),
-    timerTimeoutSource(0),
-    mRingtoneTimeoutSource(0)
+    mAlertEndTimerID(0)
 {
     mPreviousSink = eVirtualSink_None;
     g_debug("%s: MediaScenarioModule with arg '%d' volume", __FUNCTION__, default_volume);
@@ -951,9 +922,7 @@ MediaScenarioModule::MediaScenarioModule() :
     mWirelessVolume(cMedia_Wireless, 50),
     mFrontMicGain(cMedia_Mic_Front, -1),
     mHeadsetMicGain(cMedia_Mic_HeadsetMic, -1),
-    alarmTimeoutSource(0),
-    timerTimeoutSource(0),
-    mRingtoneTimeoutSource(0)
+    mAlertEndTimerID(0)
 {
     mPreviousSink = eVirtualSink_None;
 
@@ -42,10 +42,11 @@ public:
     virtual int        adjustAlertVolume(int volume, bool alertStarting = false);
     virtual int        adjustSystemVolume(int volume);
 
-    // emedia, eflash, edefaultapp, enavigation
+    // emedia, eflash, edefaultapp, enavigation. Faded in over fadeMs if given.
     virtual void programMediaVolumes(bool rampVolumes,
                          bool rampMedia = false,
-                         bool muteMedia = false);
+                         bool muteMedia = false,
+                         int fadeMs = 0);
 
     // Ramp down media, wait long enough (if necessary), then mute media module
     virtual void rampDownAndMute();
@@ -76,20 +77,23 @@ private:
     Volume            mA2DPVolume;
     Volume            mWirelessVolume;
     Volume            mHeadsetMicGain;
-    guint             alarmTimeoutSource;
-    guint             timerTimeoutSource;
-    guint             mRingtoneTimeoutSource;
     std::string       mA2DPAddress;
+    guint             mAlertEndTimerID;
+
+    void              _resumeMediaPlayback(int fadeMs);
+    static gboolean   _alertEndTimeout(gpointer data);
 
 protected:
     const int cAlertDuck = -12;
+    const int cAlertEndQuietMs = 400;   // no new alarm or ringtone for that long...
+    const int cAlertEndFadeMs = 1000;   // ...then media fades back in
     Volume mFrontMicGain;
     Volume mBackSpeakerVolume;
     bool mPriorityToAlerts;
     bool mAlertsRoutingActive;
     guint mA2DPUpdateTimerID;
     virtual void _updateRouting();
-    virtual void _startSinkPlayback(EVirtualSink sink);
+    virtual void _startSinkPlayback(EVirtualSink sink, int fadeMs = 0);
     virtual void _endSinkPlayback(EVirtualSink sink);
     virtual bool _isWirelessStreamActive();
     static gboolean _A2DPDelayedUpdate(gpointer data);
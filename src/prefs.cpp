@@ -22,8 +22,177 @@
 #include "IPC_SharedAudiodProperties.h"
 #include "main.h"
 #include "genericScenarioModule.h"
+#include "PreferenceJournal.h"
+#include "StartupProfiler.h"
+#include "StallWatchdog.h"
+
+#include <set>
+
+#define AUDIOD_PREFERENCES_DIR "/var/lib/audiod"
+
+// delay between a preference change & its write to flash (ms)
+#define PREFERENCES_FLUSH_DELAY 2000
+
+// Journal keys are "<owner>/<name>", where owner is "state" or a module category.
+// "imported/<owner>" marks the owners already copied over from luna-prefs.
+// These markers live in the binary snapshot once compacted: if that snapshot
+// is rejected at boot, the owners are read again from luna-prefs, which got a
+// copy of the same values at compaction time, with the journal applied on top.
+static PreferenceJournal sJournal(AUDIOD_PREFERENCES_DIR, "preferences");
+static guint sJournalFlushID = 0;
+
+static bool _openJournal()
+{
+    static bool sTried = false;
+    if (!sTried)
+    {
+        sTried = true;
+        if (g_mkdir_with_parents(AUDIOD_PREFERENCES_DIR, 0700) != 0)
+            g_warning("_openJournal: can't create '%s'", AUDIOD_PREFERENCES_DIR);
+        else
+        {
+            sJournal.open();
+            if (sJournal.snapshotRejected())
+                g_warning("_openJournal: preference snapshot unusable, restoring from luna-prefs");
+        }
+    }
+    return sJournal.isOpen();
+}
+
+static std::string _importedKey(const char * owner)
+{
+    return std::string("imported/") + owner;
+}
+
+static bool _isImported(const char * owner)
+{
+    std::string value;
+    return sJournal.get(_importedKey(owner), value);
+}
+
+// Values the journal holds for an owner, as a JSON object
+static pbnjson::JValue _journalObject(const std::string & owner)
+{
+    pbnjson::JValue object = pbnjson::Object();
+    std::string prefix = owner + "/";
+    const PreferenceJournal::Values & values = sJournal.values();
+    for (PreferenceJournal::Values::const_iterator iter = values.lower_bound(prefix);
+            iter != values.end() && iter->first.compare(0, prefix.size(), prefix) == 0;
+                                                                           ++iter)
+    {
+        pbnjson::JValue value = preferenceToJson(iter->second);
+        if (!value.isNull())
+            object.put(iter->first.substr(prefix.size()), value);
+    }
+    return object;
+}
+
+// Write the journal's values the way they were stored in luna-prefs,
+// one '<owner>_preferences' object per owner, so that luna-prefs stays a
+// usable (if not up to date) copy for anything reading it.
+static void _exportJournal()
+{
+    LPAppHandle prefHandle = NULL;
+
+    if (!VERIFY(LPAppGetHandle(AUDIOD_SERVICE_PATH, &prefHandle) == LP_ERR_NONE) ||
+                                                          !VERIFY(prefHandle))
+        return;
+
+    std::set<std::string> owners;
+    const PreferenceJournal::Values & values = sJournal.values();
+    for (PreferenceJournal::Values::const_iterator iter = values.begin();
+                                            iter != values.end(); ++iter)
+    {
+        size_t slash = iter->first.find('/');
+        if (slash != std::string::npos && iter->first.compare(0, slash, "imported") != 0)
+            owners.insert(iter->first.substr(0, slash));
+    }
+
+    for (std::set<std::string>::iterator iter = owners.begin();
+                                         iter != owners.end(); ++iter)
+    {
+        std::string label = *iter + "_preferences";
+        std::string prefString = jsonToString(_journalObject(*iter));
+        g_debug("Exporting '%s': %s", label.c_str(), prefString.c_str());
+        CHECK(LPAppSetValue(prefHandle, label.c_str(),
+                                           prefString.c_str()) == LP_ERR_NONE);
+    }
+
+    VERIFY(LPAppFreeHandle(prefHandle, true) == LP_ERR_NONE);
+}
+
+static gboolean _flushPreferencesCallback(gpointer data)
+{
+    MAINLOOP_HANDLER("prefs.flush");
+    sJournalFlushID = 0;
+    gState.flushPreferences();
+    return FALSE;
+}
+
+static void _scheduleFlush()
+{
+    // coalesce changes made in a burst (slider drags...) into one write
+    if (0 == sJournalFlushID)
+        sJournalFlushID = g_timeout_add_full(G_PRIORITY_DEFAULT_IDLE,
+                                             PREFERENCES_FLUSH_DELAY,
+                                             _flushPreferencesCallback,
+                                             NULL, NULL);
+}
+
+void State::flushPreferences(bool compact)
+{
+    if (sJournalFlushID)
+    {
+        g_source_remove(sJournalFlushID);
+        sJournalFlushID = 0;
+    }
+
+    if (!sJournal.isOpen())
+        return;
+
+    CHECK(sJournal.flush());
+    if ((compact || sJournal.needsCompaction()) && CHECK(sJournal.compact()))
+        _exportJournal();
+}
+
+template <class T> void _journalPreferences(const std::map<std::string, PreferencePair<T> > & preferences,
+                                            std::string (*convert)(T))
+{
+    for (typename std::map<std::string, PreferencePair<T> >::const_iterator iter =
+                          preferences.begin(); iter != preferences.end(); ++iter)
+    {
+        std::string key = "state/" + iter->first;
+        if (iter->second.mValue != iter->second.mDefaultValue)
+            sJournal.set(key, convert(iter->second.mValue));
+        else
+            sJournal.erase(key);
+    }
+}
+
+static std::string _fromString(std::string value)
+{
+    return PreferenceJournal::fromString(value);
+}
 
 bool State::storePreferences()
+{
+    if (!_openJournal())
+        return exportPreferences();
+
+    // don't store preferences set to default value,
+    // that's a waste of time to store & restore
+    _journalPreferences(mBooleanPreferences, PreferenceJournal::fromBool);
+    _journalPreferences(mStringPreferences, _fromString);
+    _journalPreferences(mIntegerPreferences, PreferenceJournal::fromInt);
+    sJournal.set(_importedKey("state"), PreferenceJournal::fromBool(true));
+
+    if (sJournal.hasPendingChanges())
+        _scheduleFlush();
+
+    return true;
+}
+
+bool State::exportPreferences()
 {
     LPAppHandle prefHandle = NULL;
 
@@ -72,8 +241,103 @@ template <class T> bool _restorePreference(LPAppHandle prefHandle,
     return result;
 }
 
+void State::applyPreferences(pbnjson::JValue request)
+{
+    // clients see the properties restored change together, once
+    IPC_Transaction transaction(*gAudiodProperties);
+
+    for (pbnjson::JValue::ObjectIterator pair = request.begin();
+                                        pair != request.end(); pair++)
+    {
+        std::string    name, value;
+        if (VERIFY((*pair).first.asString(name) == CONV_OK))
+        {
+            if (!preferenceFromJson((*pair).second, value) || !applyPreference(name, value))
+                g_warning("State::applyPreferences: invalid   \
+                      preference '%s'", name.c_str());    // name or type incorrect
+        }
+    }
+}
+
+void State::applyJournaledPreferences()
+{
+    IPC_Transaction transaction(*gAudiodProperties);
+
+    const std::string prefix("state/");
+    const PreferenceJournal::Values & values = sJournal.values();
+    for (PreferenceJournal::Values::const_iterator iter = values.lower_bound(prefix);
+            iter != values.end() && iter->first.compare(0, prefix.size(), prefix) == 0;
+                                                                           ++iter)
+    {
+        std::string name = iter->first.substr(prefix.size());
+        if (!applyPreference(name, iter->second))
+            g_warning("State::applyJournaledPreferences: invalid preference '%s'", name.c_str());
+    }
+}
+
+// Set a restored preference, encoded the journal's way, & what depends on it
+bool State::applyPreference(const std::string & name, const std::string & value)
+{
+    if (!restorePreference(mBooleanPreferences, mStringPreferences, mIntegerPreferences,
+                                                                      name, value))
+        return false;
+
+    bool boolValue;
+    int integerValue;
+    if (PreferenceJournal::toBool(value, boolValue))
+    {
+        if (name == "RingerOn") {
+            gState.setPreference(cPref_RingerOn, boolValue);
+            gAudiodProperties->mRingerOn.set(boolValue);
+        }
+
+        if (name == "PrevRingerOn")
+            gState.setPreference(cPref_PrevRingerOn, boolValue);
+
+        if (name == "DndOn")
+            gState.setPreference(cPref_DndOn, boolValue);
+
+        if (name == "TouchOn") {
+            gState.setPreference(cPref_TouchOn, boolValue);
+            gAudiodProperties->mTouchOn.set(boolValue);
+        }
+
+        if (name == "AlarmOn") {
+            gState.setPreference(cPref_OverrideRingerForAlaram, boolValue);
+            gAudiodProperties->mAlarmOn.set(boolValue);
+        }
+
+        if (name == "TimerOn") {
+            gState.setPreference(cPref_OverrideRingerForTimer, boolValue);
+            gAudiodProperties->mTimerOn.set(boolValue);
+        }
+
+        if (name == "RingtonewithVibrationWhenEnabled") {
+            gState.setPreference(cPref_RingtoneWithVibration, boolValue);
+            gAudiodProperties->mRingtoneWithVibration.set(boolValue);
+        }
+    }
+    else if (PreferenceJournal::toInt(value, integerValue))
+    {
+        if (name == "VolumeBalance") {
+            gState.setPreference(cPref_VolumeBalanceOnHeadphones, integerValue);
+            gAudiodProperties->mBalanceVolume.set(integerValue != 0);
+        }
+    }
+    return true;
+}
+
 bool State::restorePreferences()
 {
+    StartupPhase phase(gStartupProfiler, "restore preferences");
+
+    if (_openJournal() && _isImported("state"))
+    {
+        // fast path: values mapped from the binary snapshot & the journal
+        applyJournaledPreferences();
+        return true;
+    }
+
     LPAppHandle prefHandle = NULL;
 
     if (!VERIFY(LPAppGetHandle(AUDIOD_SERVICE_PATH, &prefHandle) == LP_ERR_NONE) ||
@@ -87,88 +351,7 @@ bool State::restorePreferences()
         JsonMessageParser    msg(json, SCHEMA_ANY);
         if (CHECK(msg.parse(__FUNCTION__)))
         {
-            pbnjson::JValue request = msg.get();
-            for (pbnjson::JValue::ObjectIterator pair = request.begin();
-                                                pair != request.end(); pair++)
-            {
-                std::string    name;
-                if (VERIFY((*pair).first.asString(name) == CONV_OK))
-                {
-                    bool found = false;
-                    bool boolValue;
-                    std::string    stringValue;
-                    int integerValue;
-                    if ((*pair).second.asBool(boolValue) == CONV_OK)
-                    {
-                        TBooleanPreferences::iterator iter =
-                                         gState.mBooleanPreferences.find(name);
-                        if (iter != gState.mBooleanPreferences.end())
-                        {
-                            iter->second.mValue = boolValue;
-                            found = true;
-                            if (name == "RingerOn") {
-                                gState.setPreference(cPref_RingerOn, boolValue);
-                                gAudiodProperties->mRingerOn.set(boolValue);
-                            }
-
-                            if (name == "PrevRingerOn")
-                                gState.setPreference(cPref_PrevRingerOn, boolValue);
-
-                            if (name == "DndOn")
-                                gState.setPreference(cPref_DndOn, boolValue);
-
-                            if (name == "TouchOn") {
-                                gState.setPreference(cPref_TouchOn, boolValue);
-                                gAudiodProperties->mTouchOn.set(boolValue);
-                            }
-
-                            if (name == "AlarmOn") {
-                                gState.setPreference(cPref_OverrideRingerForAlaram, boolValue);
-                                gAudiodProperties->mAlarmOn.set(boolValue);
-                            }
-
-                            if (name == "TimerOn") {
-                                gState.setPreference(cPref_OverrideRingerForTimer, boolValue);
-                                gAudiodProperties->mTimerOn.set(boolValue);
-                            }
-
-                            if (name == "RingtonewithVibrationWhenEnabled") {
-                                gState.setPreference(cPref_RingtoneWithVibration, boolValue);
-                                gAudiodProperties->mRingtoneWithVibration.set(boolValue);
-                            }
-                        }
-                    }
-                    else if ((*pair).second.asString(stringValue) == CONV_OK)
-                    {
-                        TStringPreferences::iterator iter =
-                                          gState.mStringPreferences.find(name);
-                        if (iter != gState.mStringPreferences.end())
-                        {
-                            iter->second.mValue = stringValue;
-                            found = true;
-                        }
-                    }
-
-                   else if ((*pair).second.asNumber(integerValue) == CONV_OK) //asNUmber for integers
-                    {
-                        TintPreferences::iterator iter =
-                                         gState.mIntegerPreferences.find(name);
-                        if (iter != gState.mIntegerPreferences.end())
-                        {
-                            iter->second.mValue = integerValue;
-                            found = true;
-                            if (name == "VolumeBalance") {
-                                gState.setPreference(cPref_VolumeBalanceOnHeadphones,integerValue);
-                                 gAudiodProperties->mBalanceVolume.set(boolValue);
-                            }
-                        }
-                  }
-
-                 if (!found)
-                        g_warning("State::restorePreferences: invalid   \
-                              preference '%s'", name.c_str());    // name or type incorrect
-                }
-            }
+            applyPreferences(msg.get());
         }
         g_free(json);
     }
@@ -196,10 +379,42 @@ bool State::restorePreferences()
     // close handle and discard stuff
     LPAppFreeHandle(prefHandle, false);
 
+    // first boot with the journal, or its snapshot was unusable:
+    // take over what luna-prefs had, plus changes journaled since
+    if (sJournal.isOpen())
+    {
+        applyJournaledPreferences();
+        storePreferences();
+    }
+
     return true;
 }
 
 void GenericScenarioModule::storePreferences()
+{
+    mStoreTimerID = 0;
+
+    if (!_openJournal())
+    {
+        exportPreferences();
+        return;
+    }
+
+    for (ScenarioMap::iterator iter = mScenarioTable.begin();
+                                         iter != mScenarioTable.end(); ++iter)
+    {
+        GenericScenario * scenario = iter->second;
+        std::string key = string_printf("%s/%s_volume", this->getCategory(),
+                                                       scenario->getName());
+        sJournal.set(key, PreferenceJournal::fromInt(mCurrentScenario->getVolume()));
+    }
+    sJournal.set(_importedKey(this->getCategory()), PreferenceJournal::fromBool(true));
+
+    if (sJournal.hasPendingChanges())
+        _scheduleFlush();
+}
+
+void GenericScenarioModule::exportPreferences()
 {
     LPAppHandle prefHandle = NULL;
 
@@ -224,12 +439,32 @@ void GenericScenarioModule::storePreferences()
     CHECK(LPAppSetValue(prefHandle, label, prefString.c_str()) == LP_ERR_NONE);
 
     VERIFY(LPAppFreeHandle(prefHandle, true) == LP_ERR_NONE);
+}
 
-    mStoreTimerID = 0;
+void GenericScenarioModule::restoreJournaledVolumes()
+{
+    for (ScenarioMap::iterator iter = mScenarioTable.begin();
+                                   iter != mScenarioTable.end(); ++iter)
+    {
+        GenericScenario * scenario = iter->second;
+        std::string key = string_printf("%s/%s_volume", this->getCategory(),
+                                                       scenario->getName());
+        std::string stored;
+        int value;
+        if (sJournal.get(key, stored) && PreferenceJournal::toInt(stored, value))
+            mCurrentScenario->setVolume(value);
+    }
+    publishStatus();
 }
 
 void GenericScenarioModule::restorePreferences()
 {
+    if (_openJournal() && _isImported(this->getCategory()))
+    {
+        restoreJournaledVolumes();
+        return;
+    }
+
     LPAppHandle prefHandle = NULL;
 
     if (!VERIFY(LPAppGetHandle(AUDIOD_SERVICE_PATH, &prefHandle) == LP_ERR_NONE) ||
@@ -274,11 +509,22 @@ void GenericScenarioModule::restorePreferences()
 
     // close handle and discard stuff
     LPAppFreeHandle(prefHandle, false);
+
+    // first boot with the journal, or its snapshot was unusable:
+    // take over what luna-prefs had, plus changes journaled since
+    if (sJournal.isOpen())
+    {
+        restoreJournaledVolumes();
+        storePreferences();
+    }
+    else
+        publishStatus();
 }
 
 static
 gboolean _storePreferencesCallback(gpointer data)
 {
+    MAINLOOP_HANDLER("prefs.store");
     ScenarioModule * module = (ScenarioModule *) data;
 
     module->storePreferences();
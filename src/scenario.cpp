@@ -15,7 +15,6 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include <cstring>
-#include <unistd.h>
 
 #include "update.h"
 #include "module.h"
@@ -37,11 +36,16 @@
 #include "alarm.h"
 #include "timer.h"
 #include "alert.h"
+#include "Metrics.h"
+#include "FlightRecorder.h"
+#include <audiodTracer.h>
 
 #define VOICE_COMMAND_SAMPLING_RATE 8000
 #define PHONE_SAMPLING_RATE 8000
 #define MEDIA_SAMPLING_RATE 44100
 
+static MetricsHistogram sProgramSoftwareMixerLatency("mixer.program_software_mixer");
+
 const ConstString    cMedia_Default(MEDIA_SCENARIO_DEFAULT);
 const ConstString    cMedia_FrontSpeaker(MEDIA_SCENARIO_FRONT_SPEAKER);
 const ConstString    cMedia_BackSpeaker(MEDIA_SCENARIO_BACK_SPEAKER);
@@ -129,6 +133,7 @@ bool ScenarioModule::makeCurrent ()
         previous->onDeactivated();
 
     sCurrentModule = this;
+    gFlightRecorder.record(eFlightEvent_Module, 0, 0, 0, 0, getCategory());
 
     onActivating();
 
@@ -160,10 +165,16 @@ void ScenarioModule::_updateHardwareSettings(bool muteMediaSink)
         //g_debug("ScenarioModule::
         //_updateHardwareSettings: %s", this->getCategory());
         LogIndent    indentLogs("| ");
-        gAudioMixer.muteAll ();
-        //We've retained the old code changes while separating from Scenario to Generic Architecture
-        if (this == getMediaModule())
-            usleep (2);  //changes reduced from 200ms to 2 microsecond
+        // Only sinks that change destination while audible get muted,
+        // everything else keeps playing through the scenario change.
+        Scenario * scenario = dynamic_cast <Scenario *> (mCurrentScenario);
+        if (scenario)
+        {
+            const MixerProgram & program = scenario->getMixerProgram();
+            gAudioMixer.programTransition (program.mSinks, program.mSinkCount);
+        }
+        else
+            gAudioMixer.muteAll ();
         programHardwareState ();
         programSoftwareMixer (true, muteMediaSink);
     }
@@ -174,6 +185,8 @@ void ScenarioModule::programSoftwareMixer (bool ramp, bool muteMediaSink)
     if (VERIFY(isCurrentModule()))
     {
         LogIndent    indentLogs("| ");
+        MetricsTimer timer(sProgramSoftwareMixerLatency);
+        PMTRACE_FUNCTION;
 
         if (!gAudioMixer.readyToProgram())
         {
@@ -181,26 +194,20 @@ void ScenarioModule::programSoftwareMixer (bool ramp, bool muteMediaSink)
             return;
         }
 
-        if ((!mCurrentScenario) && (!(dynamic_cast <Scenario *> (mCurrentScenario))))
+        Scenario * scenario = dynamic_cast <Scenario *> (mCurrentScenario);
+        if (!scenario)
         {
             g_warning ("%s: no current scenario", __FUNCTION__);
             return;
         }
 
+        const MixerProgram & program = scenario->getMixerProgram();
 
-        ConstString tail;
+        gAudioMixer.updateRate(program.mSampleRate);
 
-        if (mCurrentScenario->mName.hasPrefix(VOICE_COMMAND_, tail)) {
-            gAudioMixer.updateRate(VOICE_COMMAND_SAMPLING_RATE);
-        } else if (mCurrentScenario->mName.hasPrefix(PHONE_, tail)) {
-            gAudioMixer.updateRate(PHONE_SAMPLING_RATE);
-        } else {
-            gAudioMixer.updateRate(MEDIA_SAMPLING_RATE);
-        }
-
-        dynamic_cast <Scenario *> (mCurrentScenario)->logRoutes();
+        scenario->logRoutes();
 
-        gAudioMixer.programFilter(dynamic_cast <Scenario *> (mCurrentScenario)->mFilter);
+        gAudioMixer.programFilter(scenario->mFilter);
 
         /* effects' volume is only ever set here, when we switch module
         in particular, which is the only possible cause for a change*/
@@ -233,25 +240,13 @@ void ScenarioModule::programSoftwareMixer (bool ramp, bool muteMediaSink)
         //ecallertone
         getPhoneModule()->programCallertoneVolume(ramp);
         // Update routing
-        for (EVirtualSink sink = eVirtualSink_First; sink <= eVirtualSink_Last;
-               sink = EVirtualSink(sink + 1))
-        {
-            if (!strcmp(mCurrentScenario->getName(),"phone_bluetooth_sco") &&
-                 (sink == emedia || sink == edefaultapp))
-                 g_debug ("dont move media/defaultapp streams to MainSink");
-             else {
-                 EPhysicalSink    destination = dynamic_cast <Scenario *> (mCurrentScenario)->getDestination(sink);
-
-                 gAudioMixer.programDestination (sink, destination);
-            }
-        }
-        for (EVirtualSource source = eVirtualSource_First; source <=
-               eVirtualSource_Last; source = EVirtualSource(source + 1))
-        {
-            EPhysicalSource destination = dynamic_cast <Scenario *> (mCurrentScenario)->getDestination(source);
+        for (int i = 0; i < program.mSinkCount; i++)
+            gAudioMixer.programDestination (program.mSinks[i].mSink,
+                                            program.mSinks[i].mDestination);
 
-            gAudioMixer.programDestination (source, destination);
-        }
+        for (int i = 0; i < program.mSourceCount; i++)
+            gAudioMixer.programDestination (program.mSources[i].mSource,
+                                            program.mSources[i].mDestination);
 
 //for balance;
          g_message("The volume balance applying for the BT case = %d\n",gState.getSoundBalance());
@@ -260,7 +255,7 @@ void ScenarioModule::programSoftwareMixer (bool ramp, bool muteMediaSink)
     }
 }
 
-bool ScenarioModule::programVolume (EVirtualSink sink, int volume, bool ramp)
+bool ScenarioModule::programVolume (EVirtualSink sink, int volume, bool ramp, int fadeMs)
 {
     bool routed = true;
     if ((!sCurrentModule) && (!(dynamic_cast <ScenarioModule *> (sCurrentModule))))
@@ -278,13 +273,16 @@ bool ScenarioModule::programVolume (EVirtualSink sink, int volume, bool ramp)
 
     Scenario * scenario = dynamic_cast <Scenario*> (module->mCurrentScenario);
     // Check if the sink is enabled (routed) in the current scenario table
-    if (volume && VERIFY(module && module->mCurrentScenario) && (!scenario->isRouted(sink)))
+    if (volume && VERIFY(scenario && IsValidVirtualSink(sink)) &&
+        !scenario->getMixerProgram().mRouted[sink])
     {
         volume = 0;
         routed = false;
     }
 
     // always program the volume, even if it's not routed
+    if (fadeMs > 0)
+        return gAudioMixer.fadeVolume (sink, volume, fadeMs, eRampCurve_dB) && routed;
     return gAudioMixer.programVolume (sink, volume, ramp) && routed;
 }
 
@@ -306,8 +304,8 @@ bool ScenarioModule::programMute (EVirtualSource source, int mute)
 
     Scenario * scenario = dynamic_cast <Scenario*> (module->mCurrentScenario);
     // Check if the sink is enabled (routed) in the current scenario table
-    if (mute && VERIFY(module && module->mCurrentScenario) &&
-                      !scenario->isRouted(source))
+    if (mute && VERIFY(scenario && IsValidVirtualSource(source)) &&
+                      !scenario->getMixerProgram().mSourceRouted[source])
     {
         mute = 1;
         routed = false;
@@ -396,6 +394,7 @@ void Scenario::configureRoute (EVirtualSink sink,
     {
         route->mDestination = destination;
         route->mRouted = enabled;
+        invalidateMixerProgram();
     }
 }
 
@@ -409,6 +408,7 @@ void Scenario::configureRoute (EVirtualSource source,
     {
         route->mDestination = destination;
         route->mRouted = enabled;
+        invalidateMixerProgram();
     }
 }
 
@@ -475,6 +475,59 @@ void Scenario::logRoutes() const
                                      ringerOn ? "on" : "off", routeList.c_str());
 }
 
+const MixerProgram & Scenario::getMixerProgram()
+{
+    bool ringerOn = gState.getRingerOn();
+    MixerProgram & program = mPrograms[ringerOn ? 1 : 0];
+    if (!program.mValid)
+        compileMixerProgram(program, ringerOn);
+    return program;
+}
+
+void Scenario::compileMixerProgram(MixerProgram & program, bool ringerOn)
+{
+    ConstString tail;
+    if (mName.hasPrefix(VOICE_COMMAND_, tail))
+        program.mSampleRate = VOICE_COMMAND_SAMPLING_RATE;
+    else if (mName.hasPrefix(PHONE_, tail))
+        program.mSampleRate = PHONE_SAMPLING_RATE;
+    else
+        program.mSampleRate = MEDIA_SAMPLING_RATE;
+
+    // media & defaultapp streams stay where they are during a bluetooth call
+    bool keepMediaStreams = (mName == cPhone_BluetoothSCO);
+
+    const ScenarioRoute * routes = (ringerOn ? mRoutesRingerOn : mRoutesRingerOff);
+    program.mSinkCount = 0;
+    for (int sink = eVirtualSink_First; sink <= eVirtualSink_Last; ++sink)
+    {
+        program.mRouted[sink] = routes[sink].mRouted;
+        if (keepMediaStreams && (sink == emedia || sink == edefaultapp))
+            continue;
+
+        MixerProgramSink & step = program.mSinks[program.mSinkCount++];
+        step.mSink = EVirtualSink(sink);
+        step.mDestination = EPhysicalSink(routes[sink].mDestination);
+        step.mRouted = routes[sink].mRouted;
+    }
+
+    program.mSourceCount = 0;
+    for (int source = eVirtualSource_First; source <= eVirtualSource_Last; ++source)
+    {
+        program.mSourceRouted[source] = mRoutesSource[source].mRouted;
+
+        MixerProgramSource & step = program.mSources[program.mSourceCount++];
+        step.mSource = EVirtualSource(source);
+        step.mDestination = EPhysicalSource(mRoutesSource[source].mDestination);
+        step.mRouted = mRoutesSource[source].mRouted;
+    }
+
+    program.mValid = true;
+    g_debug("%s: compiled mixer program for %s ringer %s: %d sinks, %d sources",
+            __FUNCTION__, getName(), ringerOn ? "on" : "off",
+            program.mSinkCount, program.mSourceCount);
+}
+
 bool Scenario::setFilter(int filter)
 {
     mFilter = filter;
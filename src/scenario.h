@@ -83,6 +83,29 @@ struct ScenarioRoute {
     bool mRouted;
 };
 
+///
+//    A MixerProgram is the flattened, ready to apply form of a scenario's
+//  routing for one position of the ringer switch. It is compiled on first use
+//  and kept until the scenario's routes change, so that applying a
+//  scenario is a loop over a flat array rather than a walk of the route tables.
+//  Sinks that the scenario never moves (media & defaultapp during a bluetooth
+//  call) are left out of mSinks entirely, but keep their mRouted flag in
+//  mRouted[] so that volume programming still sees them.
+///
+struct MixerProgram {
+    MixerProgram() : mValid(false), mSinkCount(0), mSourceCount(0),
+                     mSampleRate(0) {}
+
+    bool                mValid;
+    int                 mSinkCount;
+    int                 mSourceCount;
+    int                 mSampleRate;
+    bool                mRouted[eVirtualSink_Count];
+    bool                mSourceRouted[eVirtualSource_Count];
+    MixerProgramSink    mSinks[eVirtualSink_Count];
+    MixerProgramSource  mSources[eVirtualSource_Count];
+};
+
 /// Scenario names: always use these definitions rather than constants!
 extern const ConstString    cMedia_Default;
 extern const ConstString    cMedia_BackSpeaker;
@@ -178,6 +201,9 @@ public:
                          bool ringerSwitchOn,
                          bool enabled = true);
     bool setFilter(int filter);
+    const MixerProgram & getMixerProgram();
+    void invalidateMixerProgram()
+        { mPrograms[0].mValid = mPrograms[1].mValid = false; }
     bool isRouted(EVirtualSink sink);
     bool isRouted(EVirtualSource source);
     EPhysicalSink getDestination(EVirtualSink sink);
@@ -193,6 +219,10 @@ private:
     ScenarioRoute mRoutesRingerOff[eVirtualSink_Count];
     ScenarioRoute mRoutesSource[eVirtualSource_Count];
 
+    void compileMixerProgram(MixerProgram & program, bool ringerOn);
+
+    MixerProgram mPrograms[2];    // indexed by ringer switch position
+
 };
 
 
@@ -216,7 +246,9 @@ public:
 
     void            programSoftwareMixer (bool ramp, bool muteMediaSink = false);
 
-    bool            programVolume (EVirtualSink sink, int volume, bool ramp = false);
+    /// Fade over fadeMs instead, when given
+    bool            programVolume (EVirtualSink sink, int volume, bool ramp = false,
+                                   int fadeMs = 0);
     bool            programMute (EVirtualSource source, int mute);
     bool            rampVolume (EVirtualSink sink, int volume)
                                 { return programVolume (sink, volume, true); }
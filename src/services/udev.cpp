@@ -161,5 +161,6 @@ UdevInterfaceInit(GMainLoop *loop, LSHandle *handle)
     return 0;
 }
 
-INIT_FUNC (UdevInit);
+// only a file test: doesn't need to hold the main thread
+INIT_HOOK (UdevInit, "", eInitHook_ThreadSafe);
 SERVICE_START_FUNC (UdevInterfaceInit);
@@ -17,6 +17,7 @@
 
 #include <lunaservice.h>
 #include <cstring>
+#include <boost/bind.hpp>
 
 #include "state.h"
 #include "utils.h"
@@ -34,6 +35,7 @@
 #include "log.h"
 #include "main.h"
 #include "../include/IPC_SharedAudiodProperties.cpp"
+#include "../include/AudiodStatusPage.cpp"
 #include "AudiodCallbacks.h"
 #include "VolumeControlChangesMonitor.h"
 #include "vibrate.h"
@@ -41,6 +43,9 @@
 #include "timer.h"
 #include "alert.h"
 #include "genericScenarioModule.h"
+#include "Metrics.h"
+#include "FlightRecorder.h"
+#include <audiodTracer.h>
 #include <pulse/simple.h>
 
 
@@ -217,6 +222,9 @@ State::State()
 void State::init()
 {
     IPC_SharedAudiodProperties::getInstance();
+    // modules & mixer fill in the rest as they start
+    if (gAudiodStatus.open())
+        gAudiodStatus.setHeadsetState(getHeadsetState());
 
     new PhoneCallHandler();
     gAudiodProperties->mDisplayOn.sendChanges(&onDisplayOnChanged);
@@ -323,6 +331,7 @@ void State::setOnActiveCall (bool state, ECallMode mode)
     }
 
     totalState = mVoip | mCarrier;
+    gFlightRecorder.record(eFlightEvent_State, 0, state, mode, totalState, "activeCall");
 
     if (mOnActiveCall != totalState)
     {
@@ -382,11 +391,13 @@ EPhoneStatus State::getPhoneStatus ()
 
 void State::setPhoneStatus (EPhoneStatus state)
 {
+    gFlightRecorder.record(eFlightEvent_State, 0, state, 0, 0, "phoneStatus");
     gAudiodProperties->mPhoneStatus.set(state);
 }
 
 void State::setDisplayOn (bool on)
 {
+    gFlightRecorder.record(eFlightEvent_State, 0, on, 0, 0, "displayOn");
     gAudiodProperties->mDisplayOn.set(on);
 }
 
@@ -430,6 +441,7 @@ void State::setRingerOn (bool ringerOn)
 {
     if (getRingerOn() != ringerOn)
     {
+        gFlightRecorder.record(eFlightEvent_State, 0, ringerOn, 0, 0, "ringerOn");
         gState.setPreference(cPref_RingerOn, ringerOn);
         gAudiodProperties->mRingerOn.set(ringerOn);
         if (ScenarioModule * module = dynamic_cast <ScenarioModule *> (ScenarioModule::getCurrent()))
@@ -543,6 +555,7 @@ void State::setTTYMode (ETTYMode mode)
 
     if (mTTYMode == mode)
         return;
+    gFlightRecorder.record(eFlightEvent_State, 0, mode, 0, 0, "ttyMode");
 
     switch (mode) {
         case eTTYMode_Full:
@@ -630,6 +643,7 @@ ECallMode State::getCallMode ()
 
 void State::setCallMode (ECallMode mode, ECallStatus status)
 {
+    gFlightRecorder.record(eFlightEvent_State, 0, mode, status, 0, "callMode");
     ScenarioModule * phone = getPhoneModule();
     MediaScenarioModule * media = getMediaModule();
 
@@ -799,6 +813,7 @@ void State::setSliderState (ESliderState state)
 {
     if (mSliderState != state)
     {
+        gFlightRecorder.record(eFlightEvent_State, 0, state, 0, 0, "slider");
         bool update = false;
         if (mSliderState == eSlider_Open ||
             (mSliderState != eSlider_Open && state == eSlider_Open))
@@ -885,10 +900,12 @@ void State::setHeadsetState (EHeadsetState newState)
         return;
 
     g_debug("%s: %s", __FUNCTION__, _getHeadsetStateName(newState));
+    gFlightRecorder.record(eFlightEvent_State, 0, newState, previousState, 0, "headset");
 
     setHeadsetRoute(newState);
 
     gAudiodProperties->mHeadsetState.set(newState);
+    gAudiodStatus.setHeadsetState(newState);
     gAudioDevice.setHeadsetState(newState);
 
     ScenarioModule *phone = getPhoneModule();
@@ -1130,6 +1147,7 @@ bool State::getPhoneLocked ()
 
 void State::setIncomingCallActive (bool state, ECallMode mode)
 {
+    gFlightRecorder.record(eFlightEvent_State, 0, state, mode, 0, "incomingCall");
     if (mode == eCallMode_Carrier) {
         if (mIncomingCarrierCallActive == state)
             return;
@@ -1171,6 +1189,7 @@ void State::setBTServerRunning (bool state)
 {
     if (mBTServerRunning != state)
     {
+        gFlightRecorder.record(eFlightEvent_State, 0, state, 0, 0, "btServer");
         mBTServerRunning = state;
         VolumeControlChangesMonitor::mediaModuleControllingVolumeChanged();
     }
@@ -2179,6 +2198,75 @@ cleanup:
     g_key_file_free(keyfile);
 }
 
+static bool
+_getMetrics(LSHandle *lshandle, LSMessage *message, void *ctx)
+{
+    LSMessageJsonParser    msg(message, SCHEMA_0);
+    if (!msg.parse(__FUNCTION__, lshandle))
+        return true;
+
+    std::string reply = "{\"returnValue\":true,\"metrics\":" + Metrics::report() + "}";
+    CLSError lserror;
+    if (!LSMessageReply(lshandle, message, reply.c_str(), &lserror))
+        lserror.Print(__FUNCTION__, __LINE__);
+
+    return true;
+}
+
+static bool
+_writeTrace(LSHandle *lshandle, LSMessage *message, void *ctx)
+{
+    LSMessageJsonParser    msg(message, SCHEMA_0);
+    if (!msg.parse(__FUNCTION__, lshandle))
+        return true;
+
+    pbnjson::JValue reply = pbnjson::Object();
+#ifdef HAS_LTTNG
+    reply.put("returnValue", false);
+    reply.put("errorText", "Tracepoints are recorded by LTTng");
+#else
+    bool written = TraceBuffer::writeChromeTrace(TRACE_BUFFER_PATH);
+    reply.put("returnValue", written);
+    if (written)
+        reply.put("path", TRACE_BUFFER_PATH);
+    else
+        reply.put("errorText", "Could not write " TRACE_BUFFER_PATH);
+#endif
+
+    CLSError lserror;
+    if (!LSMessageReply(lshandle, message, jsonToString(reply).c_str(), &lserror))
+        lserror.Print(__FUNCTION__, __LINE__);
+
+    return true;
+}
+
+#if defined(AUDIOD_TEST_API)
+static bool
+_dumpFlightRecorder(LSHandle *lshandle, LSMessage *message, void *ctx)
+{
+    LSMessageJsonParser    msg(message, SCHEMA_0);
+    if (!msg.parse(__FUNCTION__, lshandle))
+        return true;
+
+    pbnjson::JValue reply = pbnjson::Object();
+    bool dumped = gFlightRecorder.dump(FLIGHT_RECORDER_PATH);
+    reply.put("returnValue", dumped);
+    if (dumped)
+    {
+        reply.put("path", FLIGHT_RECORDER_PATH);
+        reply.put("recorded", (int64_t) gFlightRecorder.recorded());
+    }
+    else
+        reply.put("errorText", "Could not write " FLIGHT_RECORDER_PATH);
+
+    CLSError lserror;
+    if (!LSMessageReply(lshandle, message, jsonToString(reply).c_str(), &lserror))
+        lserror.Print(__FUNCTION__, __LINE__);
+
+    return true;
+}
+#endif
+
 static LSMethod stateMethods[] = {
 #if defined(AUDIOD_PALM_LEGACY)
     { "set", _setState},
@@ -2197,6 +2285,11 @@ static LSMethod stateMethods[] = {
     { "getTouchSound", _getTouchSound},
     { "loadRTPModule", _loadRTPModule},
     { "unloadRTPModule", _unloadRTPModule},
+    { "getMetrics", _getMetrics},
+    { "writeTrace", _writeTrace},
+#if defined(AUDIOD_TEST_API)
+    { "dumpFlightRecorder", _dumpFlightRecorder},
+#endif
     { },
 };
 
@@ -19,6 +19,9 @@
 #include "umiaudiomixer.h"
 #include "scenario.h"
 #include "IPC_SharedAudiodDefinitions.h"
+#include "PreferenceTables.h"
+
+namespace pbnjson { class JValue; }
 
 enum ESliderState
 {
@@ -54,20 +57,6 @@ enum ETTYMode
 };
 
 
-template <class T> struct PreferencePair
-{
-    void    init(const T & value)
-    {
-        mValue = mDefaultValue = value;
-    }
-    T    mValue;
-    T    mDefaultValue;
-};
-
-typedef std::map<std::string, PreferencePair<bool> > TBooleanPreferences;
-typedef std::map<std::string, PreferencePair<std::string> > TStringPreferences;
-typedef std::map<std::string, PreferencePair<int> > TintPreferences;
-
 // Preference name definitions to avoid typos in the code
 extern const char * cPref_VibrateWhenRingerOn;
 extern const char * cPref_VibrateWhenRingerOff;
@@ -169,6 +158,9 @@ public:
     /// Store/restore all preferences
     bool storePreferences();
     bool restorePreferences();
+    /// Write preference changes still buffered, now. Compacting leaves a
+    /// snapshot alone to load at next boot.
+    void flushPreferences(bool compact = false);
 
     // combines vibrate switch state & vibrate preferences
     bool shouldVibrate();
@@ -248,6 +240,11 @@ public:
     umiaudiomixer* mObjUmiMixerInstance;
 
 private:
+    bool                exportPreferences();
+    void                applyPreferences(pbnjson::JValue request);
+    void                applyJournaledPreferences();
+    bool                applyPreference(const std::string & name, const std::string & value);
+
     bool                mOnActiveCall;
     bool                mVoip;
     int                 mNumVoip;
@@ -164,8 +164,10 @@ int SettingsInterfaceInit(GMainLoop *loop, LSHandle *handle)
 
     if(soundSettingsInstance)
     {
-        result = LSRegisterCategoryAppend(handle, "/soundSettings", soundSettingsMethods, nullptr, &lserror);
-        if (!result || !LSCategorySetData(handle, "/soundSettings", soundSettingsInstance, &lserror))
+        void *categoryData = soundSettingsInstance;
+        LSMethod *methods = timedLunaMethods("/soundSettings", soundSettingsMethods, &categoryData);
+        result = LSRegisterCategoryAppend(handle, "/soundSettings", methods, nullptr, &lserror);
+        if (!result || !LSCategorySetData(handle, "/soundSettings", categoryData, &lserror))
         {
             g_message("%s: Registering Service for '%s' category failed", __FUNCTION__, "/soundSettings");
             LSErrorPrint(&lserror, stderr);
@@ -723,9 +723,11 @@ int masterVolumeInit(GMainLoop *loop, LSHandle *handle)
     {
         return (-1);
     }
-    bRetVal = LSRegisterCategoryAppend(handle, "/master", MasterVolumeMethods, nullptr, &lSError);
+    void *categoryData = volumeInstance;
+    LSMethod *methods = timedLunaMethods("/master", MasterVolumeMethods, &categoryData);
+    bRetVal = LSRegisterCategoryAppend(handle, "/master", methods, nullptr, &lSError);
 
-    if (!bRetVal || !LSCategorySetData(handle, "/master", volumeInstance, &lSError))
+    if (!bRetVal || !LSCategorySetData(handle, "/master", categoryData, &lSError))
     {
         g_message("%s: Registering Service for '%s' category failed", __FUNCTION__, "/master");
         LSErrorPrint(&lSError, stderr);
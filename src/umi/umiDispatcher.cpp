@@ -28,6 +28,7 @@
 #include "umiScenarioModule.h"
 #include "umiDispatcher.h"
 #include "main.h"
+#include <audiodTracer.h>
 
 Dispatcher * Dispatcher :: getDispatcher()
 {
@@ -67,6 +68,7 @@ bool Dispatcher :: _mute(LSHandle *lshandle, LSMessage *message, void *ctx) {
 
    /*TBD: Implementation of input volume mute/unmute
      Temporarily, sending success message on receiving this API */
+    PMTRACE_UMI_CALL("mute", "");
 
     LSMessageJsonParser msg(message, STRICT_SCHEMA(PROPS_4(PROP(source, string),
     PROP(sourcePort, integer), PROP(sink, string), PROP(mute, boolean))
@@ -97,6 +99,7 @@ bool Dispatcher :: _connectAudioOut (LSHandle *lshandle, LSMessage *message, voi
         return true;
     std::string audioType;
     msg.get("audioType",audioType);
+    PMTRACE_UMI_CALL("connectAudioOut", audioType.c_str());
     g_debug("Dispatcher::_connectAudioOut:: Audio connect request");
     UMIScenarioModule *module = nullptr;
     if (nullptr != ctx)
@@ -130,6 +133,7 @@ bool Dispatcher :: _disconnectAudioOut (LSHandle *lshandle, LSMessage *message,
 
     std::string audioType;
     msg.get("audioType",audioType);
+    PMTRACE_UMI_CALL("disconnectAudioOut", audioType.c_str());
     g_debug("Dispatcher::_disconnectAudioOut:: Audio disconnect request");
     UMIScenarioModule *module = nullptr;
     if (nullptr != ctx)
@@ -154,6 +158,7 @@ bool Dispatcher :: _disconnectAudioOut (LSHandle *lshandle, LSMessage *message,
 
 bool Dispatcher :: getAudioOutputStatus(LSHandle *lshandle, LSMessage *message, void *ctx)
 {
+    PMTRACE_UMI_CALL("getAudioOutputStatus", "");
     envelopeRef *handle = nullptr;
 
     if (nullptr != message)
@@ -202,6 +207,7 @@ bool Dispatcher :: getAudioOutputStatus(LSHandle *lshandle, LSMessage *message,
 
 bool Dispatcher :: _getStatus(LSHandle *lshandle, LSMessage *message, void *ctx)
 {
+    PMTRACE_UMI_CALL("getStatus", "");
     g_debug("Dispatcher ::_getStatus:: Audio get status request");
     LSMessageJsonParser msg (message, NORMAL_SCHEMA(PROPS_1(PROP(subscribe, boolean))));
 
@@ -293,9 +299,11 @@ int dispatcherptrInterfaceInit(void)
     bool result = false;
 
     LSHandle *handle = GetPalmService();
-    result = LSRegisterCategoryAppend(handle, UMI_CATEGORY_NAME, Dispatcher :: DispatcherMethods, nullptr, &lSError);
+    void *categoryData = Dispatcher :: getDispatcher();
+    LSMethod *methods = timedLunaMethods(UMI_CATEGORY_NAME, Dispatcher :: DispatcherMethods, &categoryData);
+    result = LSRegisterCategoryAppend(handle, UMI_CATEGORY_NAME, methods, nullptr, &lSError);
 
-    if (!result || !LSCategorySetData(handle, UMI_CATEGORY_NAME, (Dispatcher :: getDispatcher()), &lSError))
+    if (!result || !LSCategorySetData(handle, UMI_CATEGORY_NAME, categoryData, &lSError))
     {
         g_message("%s: Registering Service for '%s' category failed", __FUNCTION__, UMI_CATEGORY_NAME);
         LSErrorPrint(&lSError, stderr);
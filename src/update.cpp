@@ -21,6 +21,12 @@
 #include "main.h"
 #include "AudioDevice.h"
 #include "genericScenarioModule.h"
+#include "Metrics.h"
+#include "AudiodStatusPage.h"
+#include <audiodTracer.h>
+
+static MetricsCounter   sSubscriptionPostFailures("luna.subscription_post.failures");
+static MetricsHistogram sSubscriptionPostLatency("luna.subscription_post");
 
 bool GenericScenarioModule::subscriptionPost(LSHandle * palmService, std::string replyString,ESendUpdate update)
 {
@@ -48,10 +54,13 @@ bool GenericScenarioModule::subscriptionPost(LSHandle * palmService, std::string
            return result;
     }
 
+    PMTRACE_SUBSCRIPTION_POST(key.c_str());
+    MetricsTimer timer(sSubscriptionPostLatency);
     result = LSSubscriptionReply(palmService, key.c_str(), replyString.c_str(), &lserror);
 
     if (!result)
     {
+        sSubscriptionPostFailures.add();
         lserror.Print(__FUNCTION__, __LINE__);
         return false;
     }
@@ -63,6 +72,7 @@ bool
 GenericScenarioModule::sendChangedUpdate(int changedFlags, const gchar * broadCastEvent)
 {
     g_message("sendChangedUpdate");
+    publishStatus();
     pbnjson::JValue reply = pbnjson::Object();
     bool ringtoneWithVibration = false;
 
@@ -176,6 +186,15 @@ GenericScenarioModule::sendChangedUpdate(int changedFlags, const gchar * broadCa
     return result;
 }
 
+void
+GenericScenarioModule::publishStatus()
+{
+    gAudiodStatus.setCategory(getCategory(), getCurrentScenarioName(),
+                              mCurrentScenario ? mCurrentScenario->getVolume() : -1,
+                              mCurrentScenario ? mCurrentScenario->getMicGain() : -1,
+                              mMuted, isCurrentModule());
+}
+
 bool
 GenericScenarioModule::sendRequestedUpdate(LSHandle *sh, LSMessage *message, bool subscribed)
 {
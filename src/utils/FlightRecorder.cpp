@@ -0,0 +1,253 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+#include "FlightRecorder.h"
+
+// about 400 KB
+#define FLIGHT_RECORDER_EVENTS 8192
+
+FlightRecorder gFlightRecorder(FLIGHT_RECORDER_EVENTS);
+
+static const char cMagic[4] = { 'A', 'F', 'R', 'C' };
+
+static const char * cEventNames[eFlightEvent_Count] = {
+    "none",
+    "mixer",
+    "pulse",
+    "connection",
+    "state",
+    "module",
+    "scenario",
+    "luna",
+    "stall"
+};
+
+static uint64_t _clock(clockid_t clock)
+{
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return uint64_t(now.tv_sec) * 1000000000ULL + uint64_t(now.tv_nsec);
+}
+
+FlightRecorder::FlightRecorder(size_t capacity) :
+    mNext(0)
+{
+    size_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+    mEvents = new Event[size];
+    mMask = size - 1;
+    for (size_t i = 0; i < size; i++)
+    {
+        mEvents[i].mSequence.store(0, std::memory_order_relaxed);
+        mEvents[i].mType = eFlightEvent_None;
+    }
+}
+
+FlightRecorder::~FlightRecorder()
+{
+    delete [] mEvents;
+}
+
+void FlightRecorder::record(EFlightEvent type, char code, int32_t a, int32_t b,
+                            int32_t c, const char * tag)
+{
+    uint64_t time = _clock(CLOCK_MONOTONIC);
+    uint64_t index = mNext.fetch_add(1, std::memory_order_relaxed);
+    Event & event = mEvents[index & mMask];
+
+    // a reader seeing 0, or a sequence that isn't the one it expects,
+    // knows that the event is being overwritten
+    event.mSequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.mTime = time;
+    event.mType = type;
+    event.mCode = code;
+    event.mArgs[0] = a;
+    event.mArgs[1] = b;
+    event.mArgs[2] = c;
+    // a full length tag is left unterminated, as the decoder expects
+    size_t length = 0;
+    if (tag)
+    {
+        length = strnlen(tag, cTagSize);
+        memcpy(event.mTag, tag, length);
+    }
+    if (length < cTagSize)
+        event.mTag[length] = 0;
+    event.mSequence.store(index + 1, std::memory_order_release);
+}
+
+// write() may be interrupted or write less: loop, with async-signal safe calls only
+static bool _writeAll(int fd, const void * data, size_t size)
+{
+    const char * bytes = (const char *) data;
+    while (size > 0)
+    {
+        ssize_t written = write(fd, bytes, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool FlightRecorder::dump(int fd) const
+{
+    Header header;
+    memcpy(header.mMagic, cMagic, sizeof(cMagic));
+    header.mVersion = cVersion;
+    header.mEventSize = sizeof(Event);
+    header.mCapacity = mMask + 1;
+    header.mNext = mNext.load(std::memory_order_acquire);
+    header.mMonotonic = _clock(CLOCK_MONOTONIC);
+    header.mRealtime = _clock(CLOCK_REALTIME);
+    return _writeAll(fd, &header, sizeof(header)) &&
+           _writeAll(fd, mEvents, sizeof(Event) * (mMask + 1));
+}
+
+bool FlightRecorder::dump(const char * path) const
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (fd < 0)
+        return false;
+    bool ok = dump(fd);
+    return close(fd) == 0 && ok;
+}
+
+static const FlightRecorder *   sSignalRecorder = NULL;
+static char                     sSignalPath[256];
+
+static void _dumpOnSignal(int signal)
+{
+    int savedErrno = errno;
+    if (sSignalRecorder)
+        sSignalRecorder->dump(sSignalPath);
+    errno = savedErrno;
+}
+
+bool FlightRecorder::dumpOnSignal(int signal, const char * path)
+{
+    if (strlen(path) >= sizeof(sSignalPath))
+        return false;
+    strcpy(sSignalPath, path);
+    sSignalRecorder = this;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = _dumpOnSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    return sigaction(signal, &action, NULL) == 0;
+}
+
+// what an event looks like in a dump
+struct DumpedEvent
+{
+    uint64_t    mSequence;
+    uint64_t    mTime;
+    uint16_t    mType;
+    char        mCode;
+    uint8_t     mReserved;
+    int32_t     mArgs[3];
+    char        mTag[FlightRecorder::cTagSize];
+};
+
+static bool _bySequence(const DumpedEvent & a, const DumpedEvent & b)
+{
+    return a.mSequence < b.mSequence;
+}
+
+bool FlightRecorder::decode(const char * path, std::string & text)
+{
+    static_assert(sizeof(DumpedEvent) == sizeof(Event), "dumped event layout");
+
+    FILE * file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    Header header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+              memcmp(header.mMagic, cMagic, sizeof(cMagic)) == 0 &&
+              header.mVersion == cVersion &&
+              header.mEventSize == sizeof(DumpedEvent) &&
+              header.mCapacity > 0 && header.mCapacity <= (1U << 24);
+    std::vector<DumpedEvent> events;
+    if (ok)
+    {
+        events.resize(header.mCapacity);
+        ok = fread(&events[0], sizeof(DumpedEvent), events.size(), file) == events.size();
+    }
+    fclose(file);
+    if (!ok)
+        return false;
+
+    // keep the events of the last lap that were completely written
+    uint64_t first = header.mNext > header.mCapacity ? header.mNext - header.mCapacity : 0;
+    std::vector<DumpedEvent> kept;
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        uint64_t sequence = events[i].mSequence;
+        if (sequence > first && sequence <= header.mNext &&
+            (sequence - 1) % header.mCapacity == i &&
+            events[i].mType < eFlightEvent_Count)
+            kept.push_back(events[i]);
+    }
+    std::sort(kept.begin(), kept.end(), _bySequence);
+
+    char line[160];
+    snprintf(line, sizeof(line), "# %llu events recorded, %zu kept\n",
+             (unsigned long long) header.mNext, kept.size());
+    text = line;
+    for (size_t i = 0; i < kept.size(); i++)
+    {
+        const DumpedEvent & event = kept[i];
+        // date the event from the clocks read at the time of the dump
+        uint64_t age = header.mMonotonic > event.mTime ? header.mMonotonic - event.mTime : 0;
+        uint64_t date = header.mRealtime > age ? header.mRealtime - age : 0;
+        time_t seconds = date / 1000000000ULL;
+        struct tm calendar;
+        gmtime_r(&seconds, &calendar);
+        char stamp[32];
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &calendar);
+
+        char tag[cTagSize + 1];
+        memcpy(tag, event.mTag, cTagSize);
+        tag[cTagSize] = 0;
+        char code = event.mCode >= ' ' && event.mCode < 0x7f ? event.mCode : '.';
+        snprintf(line, sizeof(line), "%llu %s.%06llu %-10s %c %d %d %d %s\n",
+                 (unsigned long long) event.mSequence, stamp,
+                 (unsigned long long) (date % 1000000000ULL) / 1000,
+                 cEventNames[event.mType], code,
+                 event.mArgs[0], event.mArgs[1], event.mArgs[2], tag);
+        text += line;
+    }
+    return true;
+}
@@ -0,0 +1,333 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <algorithm>
+#include <map>
+
+#include "InitScheduler.h"
+
+InitScheduler::InitScheduler() :
+    mDone(0),
+    mRunning(0),
+    mWorkers(0),
+    mStop(false),
+    mObserver(NULL),
+    mObserverData(NULL)
+{
+    pthread_mutex_init(&mMutex, NULL);
+    pthread_cond_init(&mCondition, NULL);
+}
+
+InitScheduler::~InitScheduler()
+{
+    pthread_cond_destroy(&mCondition);
+    pthread_mutex_destroy(&mMutex);
+}
+
+void InitScheduler::add(EInitPhase phase, const char * name, HookFunction function,
+                        void * data, const char * dependencies, int flags)
+{
+    Hook hook;
+    hook.mPhase = phase;
+    hook.mName = name ? name : "";
+    hook.mFunction = function;
+    hook.mData = data;
+    hook.mDeclared = dependencies != NULL;
+    hook.mThreadSafe = hook.mDeclared && (flags & eInitHook_ThreadSafe);
+    hook.mPending = 0;
+
+    if (dependencies)
+    {
+        std::string list(dependencies);
+        size_t start = 0;
+        while (start <= list.size())
+        {
+            size_t end = list.find(',', start);
+            if (end == std::string::npos)
+                end = list.size();
+            std::string dependency = list.substr(start, end - start);
+            dependency.erase(0, dependency.find_first_not_of(" \t"));
+            dependency.erase(dependency.find_last_not_of(" \t") + 1);
+            if (!dependency.empty())
+                hook.mDependencyNames.push_back(dependency);
+            start = end + 1;
+        }
+    }
+
+    mHooks.push_back(hook);
+}
+
+void InitScheduler::clear()
+{
+    mHooks.clear();
+    mWorkerQueue.clear();
+    mMainQueue.clear();
+}
+
+void InitScheduler::setObserver(Observer observer, void * data)
+{
+    mObserver = observer;
+    mObserverData = data;
+}
+
+int InitScheduler::call(size_t index)
+{
+    const Hook & hook = mHooks[index];
+    if (mObserver)
+        mObserver(hook.mName, true, mObserverData);
+    int result = hook.mFunction(hook.mData);
+    if (mObserver)
+        mObserver(hook.mName, false, mObserverData);
+    return result;
+}
+
+bool InitScheduler::resolve()
+{
+    // hooks are registered by static constructors, in link order:
+    // sort them by phase, keeping the registration order within a phase
+    std::vector<std::pair<int, size_t> > order;
+    for (size_t i = 0; i < mHooks.size(); i++)
+        order.push_back(std::make_pair((int) mHooks[i].mPhase, i));
+    std::sort(order.begin(), order.end());
+    std::vector<Hook> sorted;
+    for (size_t i = 0; i < order.size(); i++)
+        sorted.push_back(mHooks[order[i].second]);
+    mHooks.swap(sorted);
+
+    std::map<std::string, size_t> byName;
+    for (size_t i = 0; i < mHooks.size(); i++)
+    {
+        mHooks[i].mDependents.clear();
+        mHooks[i].mPending = 0;
+        if (!mHooks[i].mName.empty())
+            byName.insert(std::make_pair(mHooks[i].mName, i));
+    }
+
+    // a hook without declaration waits for the previous undeclared hook,
+    // which itself waited for everything before it, & for the declared hooks
+    // registered before it
+    std::vector<size_t> declaredSoFar;
+    bool hasPrevious = false;
+    size_t previous = 0;
+    for (size_t i = 0; i < mHooks.size(); i++)
+    {
+        Hook & hook = mHooks[i];
+        if (hook.mDeclared)
+        {
+            for (size_t d = 0; d < hook.mDependencyNames.size(); d++)
+            {
+                std::map<std::string, size_t>::iterator dependency =
+                                                byName.find(hook.mDependencyNames[d]);
+                if (dependency == byName.end())
+                {
+                    mSerialReason = "unknown dependency '" + hook.mDependencyNames[d] +
+                                                      "' of '" + hook.mName + "'";
+                    return false;
+                }
+                mHooks[dependency->second].mDependents.push_back(i);
+                hook.mPending++;
+            }
+            declaredSoFar.push_back(i);
+        }
+        else
+        {
+            if (hasPrevious)
+            {
+                mHooks[previous].mDependents.push_back(i);
+                hook.mPending++;
+            }
+            for (size_t d = 0; d < declaredSoFar.size(); d++)
+            {
+                mHooks[declaredSoFar[d]].mDependents.push_back(i);
+                hook.mPending++;
+            }
+            declaredSoFar.clear();
+            hasPrevious = true;
+            previous = i;
+        }
+    }
+
+    // cycle detection: a topological sort has to reach every hook
+    std::vector<int> pending(mHooks.size());
+    std::vector<size_t> ready;
+    for (size_t i = 0; i < mHooks.size(); i++)
+    {
+        pending[i] = mHooks[i].mPending;
+        if (pending[i] == 0)
+            ready.push_back(i);
+    }
+    size_t reached = 0;
+    while (!ready.empty())
+    {
+        size_t index = ready.back();
+        ready.pop_back();
+        reached++;
+        const std::vector<size_t> & dependents = mHooks[index].mDependents;
+        for (size_t d = 0; d < dependents.size(); d++)
+            if (--pending[dependents[d]] == 0)
+                ready.push_back(dependents[d]);
+    }
+    if (reached != mHooks.size())
+    {
+        for (size_t i = 0; i < mHooks.size(); i++)
+            if (pending[i] > 0)
+            {
+                mSerialReason = "dependency cycle through '" + mHooks[i].mName + "'";
+                break;
+            }
+        return false;
+    }
+
+    return true;
+}
+
+bool InitScheduler::runSerially()
+{
+    for (size_t i = 0; i < mHooks.size(); i++)
+    {
+        if (call(i) != 0)
+        {
+            mFailedHook = mHooks[i].mName;
+            return false;
+        }
+    }
+    return true;
+}
+
+// called with the mutex held
+void InitScheduler::release(size_t index)
+{
+    if (mHooks[index].mThreadSafe && mWorkers > 0)
+        mWorkerQueue.push_back(index);
+    else
+        mMainQueue.insert(index);
+}
+
+// called with the mutex held
+void InitScheduler::complete(size_t index, int result)
+{
+    mRunning--;
+    mDone++;
+    if (result != 0)
+    {
+        if (mFailedHook.empty())
+            mFailedHook = mHooks[index].mName;
+        mStop = true;
+    }
+    else if (!mStop)
+    {
+        const std::vector<size_t> & dependents = mHooks[index].mDependents;
+        for (size_t d = 0; d < dependents.size(); d++)
+            if (--mHooks[dependents[d]].mPending == 0)
+                release(dependents[d]);
+    }
+    pthread_cond_broadcast(&mCondition);
+}
+
+void * InitScheduler::workerThread(void * data)
+{
+    InitScheduler * self = (InitScheduler *) data;
+
+    pthread_mutex_lock(&self->mMutex);
+    for (;;)
+    {
+        while (self->mWorkerQueue.empty() && !self->mStop)
+            pthread_cond_wait(&self->mCondition, &self->mMutex);
+        if (self->mStop)
+            break;
+
+        size_t index = self->mWorkerQueue.front();
+        self->mWorkerQueue.pop_front();
+        self->mRunning++;
+        pthread_mutex_unlock(&self->mMutex);
+
+        int result = self->call(index);
+
+        pthread_mutex_lock(&self->mMutex);
+        self->complete(index, result);
+    }
+    pthread_mutex_unlock(&self->mMutex);
+
+    return NULL;
+}
+
+bool InitScheduler::run(int workers)
+{
+    mFailedHook.clear();
+    mSerialReason.clear();
+    mWorkerQueue.clear();
+    mMainQueue.clear();
+    mDone = 0;
+    mRunning = 0;
+    mWorkers = 0;
+    mStop = false;
+
+    if (!resolve())
+        return runSerially();
+
+    int threadSafe = 0;
+    for (size_t i = 0; i < mHooks.size(); i++)
+        if (mHooks[i].mThreadSafe)
+            threadSafe++;
+
+    std::vector<pthread_t> threads(std::min(workers, threadSafe));
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        if (pthread_create(&threads[i], NULL, workerThread, this) != 0)
+        {
+            // run with the workers we got, possibly none
+            threads.resize(i);
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&mMutex);
+    mWorkers = threads.size();
+    for (size_t i = 0; i < mHooks.size(); i++)
+        if (mHooks[i].mPending == 0)
+            release(i);
+
+    while (mDone < mHooks.size())
+    {
+        if (!mStop && !mMainQueue.empty())
+        {
+            // main thread hooks in registration order, whenever several are ready
+            size_t index = *mMainQueue.begin();
+            mMainQueue.erase(mMainQueue.begin());
+            mRunning++;
+            pthread_mutex_unlock(&mMutex);
+
+            int result = call(index);
+
+            pthread_mutex_lock(&mMutex);
+            complete(index, result);
+        }
+        else if (mRunning > 0 || (!mStop && !mWorkerQueue.empty()))
+            pthread_cond_wait(&mCondition, &mMutex);
+        else
+            break;  // a hook failed, nothing else will complete
+    }
+
+    mStop = true;
+    pthread_cond_broadcast(&mCondition);
+    pthread_mutex_unlock(&mMutex);
+
+    for (size_t i = 0; i < threads.size(); i++)
+        pthread_join(threads[i], NULL);
+
+    return mFailedHook.empty();
+}
@@ -0,0 +1,229 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <cstdio>
+#include <cstring>
+#include <pthread.h>
+#include <time.h>
+#include <algorithm>
+
+#include "Metrics.h"
+
+// Both are constant initialized, so that metrics can register themselves
+// during static initialization, in any order.
+static pthread_mutex_t  sMetricsMutex = PTHREAD_MUTEX_INITIALIZER;
+static Metric *         sMetrics = NULL;
+
+const uint64_t MetricsHistogram::cBounds[cBucketCount - 1] = {
+    50, 100, 250, 500,
+    1000, 2500, 5000, 10000,
+    25000, 50000, 100000, 250000,
+    500000, 1000000, 5000000
+};
+
+Metric::Metric(const char * name, EType type) :
+    mName(name),
+    mType(type),
+    mNext(NULL)
+{
+    Metrics::add(this);
+}
+
+Metric::~Metric()
+{
+    Metrics::remove(this);
+}
+
+MetricsHistogram::MetricsHistogram(const char * name) :
+    Metric(name, eHistogram),
+    mCount(0),
+    mSum(0),
+    mMax(0)
+{
+    for (int i = 0; i < cBucketCount; i++)
+        mBuckets[i].store(0, std::memory_order_relaxed);
+}
+
+void MetricsHistogram::record(uint64_t microseconds)
+{
+    int bucket = 0;
+    while (bucket < cBucketCount - 1 && microseconds > cBounds[bucket])
+        bucket++;
+    mBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    mCount.fetch_add(1, std::memory_order_relaxed);
+    mSum.fetch_add(microseconds, std::memory_order_relaxed);
+    uint64_t max = mMax.load(std::memory_order_relaxed);
+    while (microseconds > max &&
+           !mMax.compare_exchange_weak(max, microseconds, std::memory_order_relaxed))
+        ;
+}
+
+uint64_t Metrics::now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return uint64_t(now.tv_sec) * 1000000ULL + uint64_t(now.tv_nsec) / 1000ULL;
+}
+
+void Metrics::add(Metric * metric)
+{
+    pthread_mutex_lock(&sMetricsMutex);
+    metric->mNext = sMetrics;
+    sMetrics = metric;
+    pthread_mutex_unlock(&sMetricsMutex);
+}
+
+void Metrics::remove(Metric * metric)
+{
+    pthread_mutex_lock(&sMetricsMutex);
+    for (Metric ** link = &sMetrics; *link; link = &(*link)->mNext)
+    {
+        if (*link == metric)
+        {
+            *link = metric->mNext;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sMetricsMutex);
+}
+
+static bool _byName(const Metric * a, const Metric * b)
+{
+    return strcmp(a->getName(), b->getName()) < 0;
+}
+
+// called with the mutex held
+std::vector<const Metric *> Metrics::sorted()
+{
+    std::vector<const Metric *> metrics;
+    for (const Metric * metric = sMetrics; metric; metric = metric->mNext)
+        metrics.push_back(metric);
+    std::sort(metrics.begin(), metrics.end(), _byName);
+    return metrics;
+}
+
+static void _appendName(std::string & out, const char * name)
+{
+    out += '"';
+    for (const char * c = name; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            out += '\\';
+        out += (unsigned char) *c < 0x20 ? ' ' : *c;
+    }
+    out += "\": ";
+}
+
+std::string Metrics::report()
+{
+    char buffer[96];
+    std::string sections[3];
+    pthread_mutex_lock(&sMetricsMutex);
+    std::vector<const Metric *> metrics = sorted();
+    for (size_t i = 0; i < metrics.size(); i++)
+    {
+        const Metric * metric = metrics[i];
+        std::string & out = sections[metric->getType()];
+        out += out.empty() ? " " : ", ";
+        _appendName(out, metric->getName());
+        switch (metric->getType())
+        {
+        case Metric::eCounter:
+            snprintf(buffer, sizeof(buffer), "%llu",
+                     (unsigned long long) static_cast<const MetricsCounter *>(metric)->get());
+            out += buffer;
+            break;
+        case Metric::eGauge:
+            snprintf(buffer, sizeof(buffer), "%lld",
+                     (long long) static_cast<const MetricsGauge *>(metric)->get());
+            out += buffer;
+            break;
+        case Metric::eHistogram:
+        {
+            const MetricsHistogram * histogram = static_cast<const MetricsHistogram *>(metric);
+            snprintf(buffer, sizeof(buffer), "{ \"count\": %llu, \"sum_us\": %llu, \"max_us\": %llu, \"bounds_us\": [",
+                     (unsigned long long) histogram->getCount(),
+                     (unsigned long long) histogram->getSum(),
+                     (unsigned long long) histogram->getMax());
+            out += buffer;
+            for (int b = 0; b < MetricsHistogram::cBucketCount - 1; b++)
+            {
+                snprintf(buffer, sizeof(buffer), "%s%llu", b ? ", " : " ",
+                         (unsigned long long) MetricsHistogram::cBounds[b]);
+                out += buffer;
+            }
+            out += " ], \"counts\": [";
+            for (int b = 0; b < MetricsHistogram::cBucketCount; b++)
+            {
+                snprintf(buffer, sizeof(buffer), "%s%llu", b ? ", " : " ",
+                         (unsigned long long) histogram->getBucket(b));
+                out += buffer;
+            }
+            out += " ] }";
+            break;
+        }
+        }
+    }
+    pthread_mutex_unlock(&sMetricsMutex);
+
+    return "{ \"counters\": {" + sections[Metric::eCounter] +
+           " }, \"gauges\": {" + sections[Metric::eGauge] +
+           " }, \"histograms\": {" + sections[Metric::eHistogram] + " } }";
+}
+
+std::string Metrics::summary()
+{
+    char buffer[160];
+    std::string out;
+    pthread_mutex_lock(&sMetricsMutex);
+    std::vector<const Metric *> metrics = sorted();
+    for (size_t i = 0; i < metrics.size(); i++)
+    {
+        const Metric * metric = metrics[i];
+        switch (metric->getType())
+        {
+        case Metric::eCounter:
+        {
+            uint64_t value = static_cast<const MetricsCounter *>(metric)->get();
+            if (value == 0)
+                continue;
+            snprintf(buffer, sizeof(buffer), "%s: %llu\n", metric->getName(),
+                     (unsigned long long) value);
+            break;
+        }
+        case Metric::eGauge:
+            snprintf(buffer, sizeof(buffer), "%s: %lld\n", metric->getName(),
+                     (long long) static_cast<const MetricsGauge *>(metric)->get());
+            break;
+        case Metric::eHistogram:
+        {
+            const MetricsHistogram * histogram = static_cast<const MetricsHistogram *>(metric);
+            uint64_t count = histogram->getCount();
+            if (count == 0)
+                continue;
+            snprintf(buffer, sizeof(buffer), "%s: %llu, avg %llu us, max %llu us\n",
+                     metric->getName(), (unsigned long long) count,
+                     (unsigned long long) (histogram->getSum() / count),
+                     (unsigned long long) histogram->getMax());
+            break;
+        }
+        }
+        out += buffer;
+    }
+    pthread_mutex_unlock(&sMetricsMutex);
+    return out;
+}
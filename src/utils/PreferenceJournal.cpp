@@ -0,0 +1,433 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "PreferenceJournal.h"
+
+// The snapshot is binary, so that it can be loaded straight from a mapping at
+// boot: a header, then for each value its key & value sizes (16 bits each),
+// followed by the key & value bytes. Host byte order: it never leaves the device.
+static const char cSnapshotMagic[4] = { 'A', 'P', 'R', 'F' };
+
+struct SnapshotHeader
+{
+    char        mMagic[4];
+    uint32_t    mVersion;
+    uint32_t    mCount;
+    uint32_t    mPayloadSize;
+    uint32_t    mChecksum;      // crc32 of the payload
+};
+
+static unsigned int _crc32(const char * data, size_t size)
+{
+    unsigned int crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc ^= (unsigned char) data[i];
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+// keys & values are written escaped, so that a record is always a single line
+// made of space separated fields
+static void _escape(std::string & out, const std::string & in)
+{
+    for (size_t i = 0; i < in.size(); i++)
+    {
+        switch (in[i])
+        {
+            case '\\':  out += "\\\\";  break;
+            case ' ':   out += "\\s";   break;
+            case '\n':  out += "\\n";   break;
+            case '\t':  out += "\\t";   break;
+            default:    out += in[i];   break;
+        }
+    }
+}
+
+static bool _unescape(std::string & out, const char * in, size_t size)
+{
+    out.clear();
+    for (size_t i = 0; i < size; i++)
+    {
+        if (in[i] != '\\')
+        {
+            out += in[i];
+            continue;
+        }
+        if (++i >= size)
+            return false;
+        switch (in[i])
+        {
+            case '\\':  out += '\\';    break;
+            case 's':   out += ' ';     break;
+            case 'n':   out += '\n';    break;
+            case 't':   out += '\t';    break;
+            default:    return false;
+        }
+    }
+    return true;
+}
+
+static bool _writeAll(int fd, const char * data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = write(fd, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool _syncDirectory(const std::string & directory)
+{
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0)
+        return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+PreferenceJournal::PreferenceJournal(const std::string & directory, const std::string & name) :
+    mDirectory(directory),
+    mSnapshotPath(directory + "/" + name + ".snapshot"),
+    mJournalPath(directory + "/" + name + ".journal"),
+    mJournalFd(-1),
+    mJournalRecords(0),
+    mSnapshotRejected(false)
+{
+}
+
+PreferenceJournal::~PreferenceJournal()
+{
+    if (mJournalFd >= 0)
+        close(mJournalFd);
+}
+
+bool PreferenceJournal::open()
+{
+    mValues.clear();
+    mPending.clear();
+    mJournalRecords = 0;
+
+    bool found = loadSnapshot();
+    off_t validSize = 0;
+    if (replay(mJournalPath, validSize))
+    {
+        found = true;
+        struct stat info;
+        if (stat(mJournalPath.c_str(), &info) == 0 && info.st_size > validSize)
+        {
+            // drop the torn record left by a crash, so that new records don't follow garbage
+            if (truncate(mJournalPath.c_str(), validSize) != 0)
+                return false;
+        }
+    }
+
+    return openJournal() && found;
+}
+
+bool PreferenceJournal::openJournal()
+{
+    if (mJournalFd >= 0)
+        return true;
+    mJournalFd = ::open(mJournalPath.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    return mJournalFd >= 0;
+}
+
+bool PreferenceJournal::loadSnapshot()
+{
+    mSnapshotRejected = false;
+
+    int fd = ::open(mSnapshotPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    void * map = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size >= (off_t) sizeof(SnapshotHeader))
+        map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED || !parseSnapshot((const char *) map, info.st_size))
+    {
+        // stale or damaged: the caller has to get these values some other way
+        mSnapshotRejected = true;
+        mValues.clear();
+    }
+
+    if (map != MAP_FAILED)
+        munmap(map, info.st_size);
+    return !mSnapshotRejected;
+}
+
+bool PreferenceJournal::parseSnapshot(const char * data, size_t size)
+{
+    SnapshotHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.mMagic, cSnapshotMagic, sizeof(cSnapshotMagic)) != 0 ||
+        header.mVersion != cSnapshotVersion ||
+        header.mPayloadSize != size - sizeof(header))
+        return false;
+
+    const char * payload = data + sizeof(header);
+    if (header.mChecksum != _crc32(payload, header.mPayloadSize))
+        return false;
+
+    size_t offset = 0;
+    for (uint32_t i = 0; i < header.mCount; i++)
+    {
+        uint16_t sizes[2];
+        if (header.mPayloadSize - offset < sizeof(sizes))
+            return false;
+        memcpy(sizes, payload + offset, sizeof(sizes));
+        offset += sizeof(sizes);
+        if (header.mPayloadSize - offset < (size_t) sizes[0] + sizes[1])
+            return false;
+        mValues[std::string(payload + offset, sizes[0])] =
+                                std::string(payload + offset + sizes[0], sizes[1]);
+        offset += sizes[0] + sizes[1];
+    }
+    return offset == header.mPayloadSize;
+}
+
+bool PreferenceJournal::replay(const std::string & path, off_t & validSize)
+{
+    FILE * file = fopen(path.c_str(), "r");
+    if (!file)
+        return false;
+
+    char * line = NULL;
+    size_t capacity = 0;
+    ssize_t length;
+    while ((length = getline(&line, &capacity, file)) > 0)
+    {
+        // a record without its end of line was never fully written
+        if (line[length - 1] != '\n' || !apply(std::string(line, length - 1)))
+            break;
+        validSize += length;
+        mJournalRecords++;
+    }
+
+    free(line);
+    fclose(file);
+    return true;
+}
+
+bool PreferenceJournal::apply(const std::string & line)
+{
+    // "<op> <key> <value> <crc>", crc covering everything before its separator
+    size_t crcStart = line.rfind(' ');
+    if (crcStart == std::string::npos || line.size() < 4 || line[1] != ' ')
+        return false;
+
+    char * end = NULL;
+    unsigned long crc = strtoul(line.c_str() + crcStart + 1, &end, 16);
+    if (*end != 0 || crc != _crc32(line.data(), crcStart))
+        return false;
+
+    size_t keyEnd = line.find(' ', 2);
+    if (keyEnd == std::string::npos || keyEnd > crcStart)
+        return false;
+
+    std::string key, value;
+    if (!_unescape(key, line.data() + 2, keyEnd - 2))
+        return false;
+
+    switch (line[0])
+    {
+        case 'S':
+            if (keyEnd == crcStart ||
+                !_unescape(value, line.data() + keyEnd + 1, crcStart - keyEnd - 1))
+                return false;
+            mValues[key] = value;
+            return true;
+        case 'D':
+            mValues.erase(key);
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool PreferenceJournal::get(const std::string & key, std::string & value) const
+{
+    Values::const_iterator iter = mValues.find(key);
+    if (iter == mValues.end())
+        return false;
+    value = iter->second;
+    return true;
+}
+
+void PreferenceJournal::append(char op, const std::string & key, const std::string & value)
+{
+    std::string record;
+    record += op;
+    record += ' ';
+    _escape(record, key);
+    record += ' ';
+    _escape(record, value);
+
+    char crc[16];
+    snprintf(crc, sizeof(crc), " %08x\n", _crc32(record.data(), record.size()));
+    mPending += record;
+    mPending += crc;
+    mJournalRecords++;
+}
+
+void PreferenceJournal::set(const std::string & key, const std::string & value)
+{
+    Values::iterator iter = mValues.find(key);
+    if (iter != mValues.end() && iter->second == value)
+        return;
+
+    mValues[key] = value;
+    append('S', key, value);
+}
+
+void PreferenceJournal::erase(const std::string & key)
+{
+    if (mValues.erase(key) > 0)
+        append('D', key, "");
+}
+
+bool PreferenceJournal::flush()
+{
+    if (mPending.empty())
+        return true;
+    if (!openJournal())
+        return false;
+
+    if (!_writeAll(mJournalFd, mPending.data(), mPending.size()) || fdatasync(mJournalFd) != 0)
+        return false;
+
+    mPending.clear();
+    return true;
+}
+
+bool PreferenceJournal::needsCompaction() const
+{
+    return mJournalRecords >= cCompactionThreshold;
+}
+
+bool PreferenceJournal::compact()
+{
+    // if we crash before the journal is emptied, replaying it over the new
+    // snapshot must end up on the same values: it needs all the changes
+    if (!flush())
+        return false;
+
+    std::string content(sizeof(SnapshotHeader), '\0');
+    for (Values::const_iterator iter = mValues.begin(); iter != mValues.end(); ++iter)
+    {
+        if (iter->first.size() > UINT16_MAX || iter->second.size() > UINT16_MAX)
+            return false;
+        uint16_t sizes[2] = { (uint16_t) iter->first.size(), (uint16_t) iter->second.size() };
+        content.append((const char *) sizes, sizeof(sizes));
+        content += iter->first;
+        content += iter->second;
+    }
+
+    SnapshotHeader header;
+    memcpy(header.mMagic, cSnapshotMagic, sizeof(cSnapshotMagic));
+    header.mVersion = cSnapshotVersion;
+    header.mCount = mValues.size();
+    header.mPayloadSize = content.size() - sizeof(header);
+    header.mChecksum = _crc32(content.data() + sizeof(header), header.mPayloadSize);
+    content.replace(0, sizeof(header), (const char *) &header, sizeof(header));
+
+    std::string temporary = mSnapshotPath + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return false;
+    bool ok = _writeAll(fd, content.data(), content.size()) && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(temporary.c_str(), mSnapshotPath.c_str()) != 0)
+    {
+        unlink(temporary.c_str());
+        return false;
+    }
+    _syncDirectory(mDirectory);
+    mSnapshotRejected = false;
+
+    if (mJournalFd >= 0)
+    {
+        close(mJournalFd);
+        mJournalFd = -1;
+    }
+    mJournalFd = ::open(mJournalPath.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    mPending.clear();
+    mJournalRecords = 0;
+
+    return mJournalFd >= 0;
+}
+
+std::string PreferenceJournal::fromInt(int value)
+{
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "i%d", value);
+    return buffer;
+}
+
+bool PreferenceJournal::toBool(const std::string & value, bool & out)
+{
+    if (value == "b1" || value == "b0")
+    {
+        out = value[1] == '1';
+        return true;
+    }
+    return false;
+}
+
+bool PreferenceJournal::toInt(const std::string & value, int & out)
+{
+    if (value.size() < 2 || value[0] != 'i')
+        return false;
+    char * end = NULL;
+    long number = strtol(value.c_str() + 1, &end, 10);
+    if (*end != 0)
+        return false;
+    out = (int) number;
+    return true;
+}
+
+bool PreferenceJournal::toString(const std::string & value, std::string & out)
+{
+    if (value.empty() || value[0] != 's')
+        return false;
+    out = value.substr(1);
+    return true;
+}
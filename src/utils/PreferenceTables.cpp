@@ -0,0 +1,77 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <pbnjson.hpp>
+
+#include "PreferenceJournal.h"
+#include "PreferenceTables.h"
+
+bool preferenceFromJson(pbnjson::JValue json, std::string & value)
+{
+    bool boolValue;
+    std::string stringValue;
+    int integerValue;
+    if (json.asBool(boolValue) == CONV_OK)
+        value = PreferenceJournal::fromBool(boolValue);
+    else if (json.asString(stringValue) == CONV_OK)
+        value = PreferenceJournal::fromString(stringValue);
+    else if (json.asNumber(integerValue) == CONV_OK)
+        value = PreferenceJournal::fromInt(integerValue);
+    else
+        return false;
+    return true;
+}
+
+pbnjson::JValue preferenceToJson(const std::string & value)
+{
+    bool boolValue;
+    int integerValue;
+    std::string stringValue;
+    if (PreferenceJournal::toBool(value, boolValue))
+        return pbnjson::JValue(boolValue);
+    if (PreferenceJournal::toInt(value, integerValue))
+        return pbnjson::JValue(integerValue);
+    if (PreferenceJournal::toString(value, stringValue))
+        return pbnjson::JValue(stringValue);
+    return pbnjson::JValue();
+}
+
+template <class T> static bool _set(std::map<std::string, PreferencePair<T> > & table,
+                                    const std::string & name, const T & value)
+{
+    typename std::map<std::string, PreferencePair<T> >::iterator iter = table.find(name);
+    if (iter == table.end())
+        return false;
+    iter->second.mValue = value;
+    return true;
+}
+
+bool restorePreference(TBooleanPreferences & booleans, TStringPreferences & strings,
+                       TintPreferences & integers, const std::string & name,
+                       const std::string & value)
+{
+    bool boolValue;
+    int integerValue;
+    std::string stringValue;
+    if (PreferenceJournal::toBool(value, boolValue))
+        return _set(booleans, name, boolValue);
+    if (PreferenceJournal::toInt(value, integerValue))
+        return _set(integers, name, integerValue);
+    if (PreferenceJournal::toString(value, stringValue))
+        return _set(strings, name, stringValue);
+    return false;
+}
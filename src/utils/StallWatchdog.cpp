@@ -0,0 +1,160 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <unistd.h>
+
+#include "StallWatchdog.h"
+#include "FlightRecorder.h"
+#include "Metrics.h"
+#include "log.h"
+
+std::atomic<const char *> MainLoopHandler::sCurrent(NULL);
+std::atomic<uint64_t> StallWatchdog::sThreshold(0);
+
+static MetricsHistogram sMainLoopLag("mainloop.lag");
+static MetricsCounter   sMainLoopStalls("mainloop.stalls");
+static MetricsCounter   sLongHandlers("mainloop.long_handlers");
+
+MainLoopHandler::MainLoopHandler(const char * name) :
+    mName(name),
+    mPrevious(sCurrent.exchange(name, std::memory_order_relaxed)),
+    mStart(Metrics::now())
+{
+}
+
+MainLoopHandler::~MainLoopHandler()
+{
+    sCurrent.store(mPrevious, std::memory_order_relaxed);
+
+    uint64_t threshold = StallWatchdog::threshold();
+    uint64_t duration = Metrics::now() - mStart;
+    if (threshold > 0 && duration > threshold)
+    {
+        sLongHandlers.add();
+        gFlightRecorder.record(eFlightEvent_Stall, 'h', (int32_t) (duration / 1000), 0, 0, mName);
+        g_warning("%s ran for %llu ms in the main loop", mName,
+                  (unsigned long long) (duration / 1000));
+    }
+}
+
+StallWatchdog::StallWatchdog() :
+    mInterval(cDefaultInterval * 1000ULL),
+    mThreshold(cDefaultThreshold * 1000ULL),
+    mLastBeat(0),
+    mReportedBeat(0),
+    mRunning(false),
+    mThread()
+{
+}
+
+StallWatchdog::~StallWatchdog()
+{
+    stop();
+}
+
+void StallWatchdog::configure(unsigned intervalMs, unsigned thresholdMs)
+{
+    mInterval = (intervalMs > 0 ? intervalMs : cDefaultInterval) * 1000ULL;
+    mThreshold = (thresholdMs > 0 ? thresholdMs : cDefaultThreshold) * 1000ULL;
+    sThreshold.store(mThreshold, std::memory_order_relaxed);
+}
+
+uint64_t StallWatchdog::beat(uint64_t now)
+{
+    uint64_t last = mLastBeat.exchange(now, std::memory_order_relaxed);
+    if (last == 0 || now <= last + mInterval)
+    {
+        sMainLoopLag.record(0);
+        return 0;
+    }
+
+    uint64_t lag = now - last - mInterval;
+    sMainLoopLag.record(lag);
+    if (lag > mThreshold)
+    {
+        gFlightRecorder.record(eFlightEvent_Stall, 'e', (int32_t) (lag / 1000));
+        g_warning("Main loop was stalled for %llu ms", (unsigned long long) (lag / 1000));
+    }
+    return lag;
+}
+
+bool StallWatchdog::check(uint64_t now, Stall & stall)
+{
+    uint64_t last = mLastBeat.load(std::memory_order_relaxed);
+    if (last == 0 || last == mReportedBeat)
+        return false;
+
+    uint64_t due = last + mInterval;
+    if (now <= due + mThreshold)
+        return false;
+
+    // report once per stall: the next one needs another beat first
+    mReportedBeat = last;
+    stall.mDuration = now - due;
+    stall.mHandler = MainLoopHandler::current();
+    sMainLoopStalls.add();
+    return true;
+}
+
+void * StallWatchdog::run(void * data)
+{
+    StallWatchdog * watchdog = (StallWatchdog *) data;
+    uint64_t period = (watchdog->mInterval < watchdog->mThreshold ?
+                       watchdog->mInterval : watchdog->mThreshold) / 2;
+
+    while (watchdog->mRunning.load(std::memory_order_relaxed))
+    {
+        usleep(period);
+
+        Stall stall;
+        if (watchdog->check(Metrics::now(), stall))
+        {
+            const char * handler = stall.mHandler ? stall.mHandler : "unknown handler";
+            gFlightRecorder.record(eFlightEvent_Stall, 'w', (int32_t) (stall.mDuration / 1000),
+                                   0, 0, handler);
+            g_warning("Main loop stalled for %llu ms so far, in %s",
+                      (unsigned long long) (stall.mDuration / 1000), handler);
+        }
+    }
+    return NULL;
+}
+
+bool StallWatchdog::start()
+{
+    if (mRunning.load())
+        return true;
+
+    sThreshold.store(mThreshold, std::memory_order_relaxed);
+    mLastBeat.store(0, std::memory_order_relaxed);
+    mReportedBeat = 0;
+    mRunning.store(true);
+    if (pthread_create(&mThread, NULL, run, this) != 0)
+    {
+        mRunning.store(false);
+        g_warning("Could not start the main loop watchdog");
+        return false;
+    }
+    return true;
+}
+
+void StallWatchdog::stop()
+{
+    if (!mRunning.exchange(false))
+        return;
+
+    pthread_join(mThread, NULL);
+}
@@ -0,0 +1,167 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <cstdio>
+#include <time.h>
+
+#include "StartupProfiler.h"
+
+StartupProfiler gStartupProfiler;
+
+static void _appendEscaped(std::string & out, const std::string & in)
+{
+    for (size_t i = 0; i < in.size(); i++)
+    {
+        char c = in[i];
+        if (c == '"' || c == '\\')
+            out += '\\';
+        if ((unsigned char) c < 0x20)
+            c = ' ';
+        out += c;
+    }
+}
+
+uint64_t StartupProfiler::now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return uint64_t(now.tv_sec) * 1000000ULL + uint64_t(now.tv_nsec) / 1000ULL;
+}
+
+StartupProfiler::StartupProfiler() :
+    mOrigin(now()),
+    mRecording(true)
+{
+    pthread_mutex_init(&mMutex, NULL);
+}
+
+StartupProfiler::~StartupProfiler()
+{
+    pthread_mutex_destroy(&mMutex);
+}
+
+StartupProfiler::Event * StartupProfiler::find(const std::string & name)
+{
+    for (size_t i = 0; i < mEvents.size(); i++)
+        if (mEvents[i].mName == name)
+            return &mEvents[i];
+    return NULL;
+}
+
+void StartupProfiler::begin(const std::string & name)
+{
+    uint64_t time = now();
+    pthread_mutex_lock(&mMutex);
+    if (mRecording && !find(name))
+    {
+        Event event = { name, time, time, false, true };
+        mEvents.push_back(event);
+    }
+    pthread_mutex_unlock(&mMutex);
+}
+
+void StartupProfiler::end(const std::string & name)
+{
+    uint64_t time = now();
+    pthread_mutex_lock(&mMutex);
+    Event * event = mRecording ? find(name) : NULL;
+    if (event && event->mOpen)
+    {
+        event->mEnd = time;
+        event->mOpen = false;
+    }
+    pthread_mutex_unlock(&mMutex);
+}
+
+bool StartupProfiler::mark(const std::string & name)
+{
+    uint64_t time = now();
+    bool recorded = false;
+    pthread_mutex_lock(&mMutex);
+    if (mRecording && !find(name))
+    {
+        Event event = { name, time, time, true, false };
+        mEvents.push_back(event);
+        recorded = true;
+    }
+    pthread_mutex_unlock(&mMutex);
+    return recorded;
+}
+
+bool StartupProfiler::isRecording() const
+{
+    pthread_mutex_lock(&mMutex);
+    bool recording = mRecording;
+    pthread_mutex_unlock(&mMutex);
+    return recording;
+}
+
+// called with the mutex held
+std::string StartupProfiler::report() const
+{
+    char buffer[96];
+    std::string out;
+    snprintf(buffer, sizeof(buffer), "{ \"origin_us\": %llu, \"events\": [",
+                                                   (unsigned long long) mOrigin);
+    out += buffer;
+    for (size_t i = 0; i < mEvents.size(); i++)
+    {
+        const Event & event = mEvents[i];
+        out += i ? ",\n    { \"name\": \"" : "\n    { \"name\": \"";
+        _appendEscaped(out, event.mName);
+        if (event.mInstant)
+            snprintf(buffer, sizeof(buffer), "\", \"at_us\": %llu }",
+                     (unsigned long long) (event.mStart - mOrigin));
+        else if (event.mOpen)
+            // never ended: that's worth seeing in the report too
+            snprintf(buffer, sizeof(buffer), "\", \"start_us\": %llu }",
+                     (unsigned long long) (event.mStart - mOrigin));
+        else
+            snprintf(buffer, sizeof(buffer), "\", \"start_us\": %llu, \"end_us\": %llu }",
+                     (unsigned long long) (event.mStart - mOrigin),
+                     (unsigned long long) (event.mEnd - mOrigin));
+        out += buffer;
+    }
+    out += " ] }\n";
+    return out;
+}
+
+std::string StartupProfiler::finish()
+{
+    pthread_mutex_lock(&mMutex);
+    mRecording = false;
+    std::string out = report();
+    pthread_mutex_unlock(&mMutex);
+    return out;
+}
+
+bool StartupProfiler::write(const std::string & report, const std::string & path)
+{
+    // write aside & rename, so that a reader never sees half a report
+    std::string temporary = path + ".tmp";
+    FILE * file = fopen(temporary.c_str(), "w");
+    if (!file)
+        return false;
+    bool ok = fwrite(report.data(), 1, report.size(), file) == report.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
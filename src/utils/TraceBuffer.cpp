@@ -0,0 +1,213 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <cstdio>
+#include <cstring>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "TraceBuffer.h"
+
+std::atomic<bool> TraceBuffer::sEnabled(true);
+
+struct TraceEvent
+{
+    uint64_t        mTime;      // monotonic, in ns
+    const char *    mName;
+    char            mPhase;
+    char            mCode;
+    uint8_t         mArgs;
+    int32_t         mA;
+    int32_t         mB;
+    char            mText[TraceBuffer::cTextSize];
+};
+
+// A thread's ring. Only that thread writes it. Rings are never freed, so
+// that the events of threads that ended are still in the trace.
+struct ThreadTraceBuffer
+{
+    std::atomic<uint64_t>   mHead;      // events recorded by the thread
+    pid_t                   mThread;
+    char                    mThreadName[16];
+    ThreadTraceBuffer *     mNext;
+    TraceEvent              mEvents[TraceBuffer::cEventsPerThread];
+};
+
+static pthread_mutex_t          sBuffersMutex = PTHREAD_MUTEX_INITIALIZER;
+static ThreadTraceBuffer *      sBuffers = NULL;
+static __thread ThreadTraceBuffer * tBuffer = NULL;
+
+static ThreadTraceBuffer * _threadBuffer()
+{
+    ThreadTraceBuffer * buffer = new ThreadTraceBuffer;
+    buffer->mHead.store(0, std::memory_order_relaxed);
+    buffer->mThread = (pid_t) syscall(SYS_gettid);
+    buffer->mThreadName[0] = 0;
+    prctl(PR_GET_NAME, buffer->mThreadName, 0, 0, 0);
+    buffer->mThreadName[sizeof(buffer->mThreadName) - 1] = 0;
+
+    pthread_mutex_lock(&sBuffersMutex);
+    buffer->mNext = sBuffers;
+    sBuffers = buffer;
+    pthread_mutex_unlock(&sBuffersMutex);
+
+    tBuffer = buffer;
+    return buffer;
+}
+
+void TraceBuffer::add(EPhase phase, const char * name, EArgs args,
+                      const char * text, char code, int32_t a, int32_t b)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    ThreadTraceBuffer * buffer = tBuffer ? tBuffer : _threadBuffer();
+    uint64_t head = buffer->mHead.load(std::memory_order_relaxed);
+    TraceEvent & event = buffer->mEvents[head % cEventsPerThread];
+    event.mTime = uint64_t(now.tv_sec) * 1000000000ULL + uint64_t(now.tv_nsec);
+    event.mName = name;
+    event.mPhase = phase;
+    event.mCode = code;
+    event.mArgs = args;
+    event.mA = a;
+    event.mB = b;
+    if (text)
+    {
+        strncpy(event.mText, text, cTextSize - 1);
+        event.mText[cTextSize - 1] = 0;
+    }
+    else
+        event.mText[0] = 0;
+    buffer->mHead.store(head + 1, std::memory_order_release);
+}
+
+static void _appendEscaped(std::string & out, const char * in)
+{
+    for (const char * c = in; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            out += '\\';
+        out += (unsigned char) *c < 0x20 ? ' ' : *c;
+    }
+}
+
+static void _appendThreadName(std::string & out, pid_t process, pid_t thread, const char * name)
+{
+    char buffer[160];
+    snprintf(buffer, sizeof(buffer), "%s{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, \"args\": { \"name\": \"",
+             out.empty() ? "{ \"traceEvents\": [\n  " : ",\n  ", process, thread);
+    out += buffer;
+    _appendEscaped(out, name);
+    out += "\" } }";
+}
+
+static void _appendEvent(std::string & out, const TraceEvent & event, pid_t process, pid_t thread)
+{
+    char buffer[128];
+    out += out.empty() ? "{ \"traceEvents\": [\n  { \"name\": \"" : ",\n  { \"name\": \"";
+    _appendEscaped(out, event.mName);
+    snprintf(buffer, sizeof(buffer), "\", \"ph\": \"%c\", \"ts\": %llu.%03u, \"pid\": %d, \"tid\": %d",
+             event.mPhase, (unsigned long long) (event.mTime / 1000),
+             (unsigned) (event.mTime % 1000), process, thread);
+    out += buffer;
+    if (event.mPhase == TraceBuffer::ePhase_Instant)
+        out += ", \"s\": \"t\"";
+
+    switch (event.mArgs)
+    {
+    case TraceBuffer::eArgs_Text:
+        out += ", \"args\": { \"text\": \"";
+        _appendEscaped(out, event.mText);
+        out += "\" }";
+        break;
+    case TraceBuffer::eArgs_MixerCommand:
+        snprintf(buffer, sizeof(buffer), ", \"args\": { \"cmd\": \"%c\", \"sink\": %d, \"value\": %d }",
+                 event.mCode >= ' ' && event.mCode < 0x7f && event.mCode != '"' && event.mCode != '\\' ?
+                                                                                event.mCode : '?',
+                 event.mA, event.mB);
+        out += buffer;
+        break;
+    case TraceBuffer::eArgs_Sample:
+        out += ", \"args\": { \"sample\": \"";
+        _appendEscaped(out, event.mText);
+        snprintf(buffer, sizeof(buffer), "\", \"sink\": %d }", event.mA);
+        out += buffer;
+        break;
+    default:
+        break;
+    }
+    out += " }";
+}
+
+std::string TraceBuffer::chromeTrace()
+{
+    std::string out;
+    pid_t process = getpid();
+    std::vector<TraceEvent> events;
+
+    pthread_mutex_lock(&sBuffersMutex);
+    for (ThreadTraceBuffer * buffer = sBuffers; buffer; buffer = buffer->mNext)
+    {
+        // copy, then drop what the thread may have overwritten meanwhile,
+        // including the slot it may be writing now
+        uint64_t head = buffer->mHead.load(std::memory_order_acquire);
+        uint64_t first = head > cEventsPerThread ? head - cEventsPerThread : 0;
+        events.clear();
+        for (uint64_t i = first; i < head; i++)
+            events.push_back(buffer->mEvents[i % cEventsPerThread]);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = buffer->mHead.load(std::memory_order_relaxed);
+        uint64_t valid = after >= cEventsPerThread ? after - cEventsPerThread + 1 : 0;
+        size_t skip = valid > first ? valid - first : 0;
+        if (skip > events.size())
+            skip = events.size();
+
+        _appendThreadName(out, process, buffer->mThread, buffer->mThreadName);
+
+        for (size_t i = skip; i < events.size(); i++)
+            _appendEvent(out, events[i], process, buffer->mThread);
+    }
+    pthread_mutex_unlock(&sBuffersMutex);
+
+    if (out.empty())
+        out = "{ \"traceEvents\": [";
+    out += " ],\n  \"displayTimeUnit\": \"ms\" }\n";
+    return out;
+}
+
+bool TraceBuffer::writeChromeTrace(const char * path)
+{
+    std::string trace = chromeTrace();
+
+    // write aside & rename, so that a reader never sees half a trace
+    std::string temporary = std::string(path) + ".tmp";
+    FILE * file = fopen(temporary.c_str(), "w");
+    if (!file)
+        return false;
+    bool ok = fwrite(trace.data(), 1, trace.size(), file) == trace.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(temporary.c_str(), path) != 0)
+    {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
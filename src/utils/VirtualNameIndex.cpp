@@ -0,0 +1,53 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <algorithm>
+#include <cstring>
+
+#include "VirtualNameIndex.h"
+
+bool VirtualNameIndex::lessThan(const Entry & entry, const char * name)
+{
+    return strcmp(entry.mName, name) < 0;
+}
+
+void VirtualNameIndex::insert(const char * name, int identifier)
+{
+    // tables are small and built once, so keep the vector sorted as we go
+    std::vector<Entry>::iterator it = std::lower_bound(mEntries.begin(),
+                                                       mEntries.end(),
+                                                       name, lessThan);
+    if (it != mEntries.end() && strcmp(it->mName, name) == 0)
+        return;
+
+    Entry entry = { name, identifier };
+    mEntries.insert(it, entry);
+}
+
+int VirtualNameIndex::lookup(const char * name, int notFound) const
+{
+    if (name == NULL)
+        return notFound;
+
+    std::vector<Entry>::const_iterator it = std::lower_bound(mEntries.begin(),
+                                                             mEntries.end(),
+                                                             name, lessThan);
+    if (it != mEntries.end() && strcmp(it->mName, name) == 0)
+        return it->mIdentifier;
+
+    return notFound;
+}
@@ -17,6 +17,7 @@
 
 #include "messageUtils.h"
 #include "ConstString.h"
+#include "log.h"
 
 void CLSError::Print(const char * where, int line, GLogLevelFlags logLevel)
 {
@@ -21,32 +21,48 @@
 #include "messageUtils.h"
 #include "log.h"
 #include "main.h"
+#include "StartupProfiler.h"
+#include "Metrics.h"
+#include "FlightRecorder.h"
+#include "StallWatchdog.h"
+
+// number of threads running the thread safe init hooks
+#define INIT_WORKER_THREADS InitScheduler::cDefaultWorkers
 
-static GHookList *sInitList         = NULL;
-static GHookList *sModuleStartList  = NULL;
-static GHookList *sControlStartList = NULL;
-static GHookList *sServiceStartList = NULL;
 static GHookList *sCancelSubscriptionCallbackList = NULL;
 
 static GMainLoop *sCurrentLoop = NULL;
 static LSHandle *sCurrentHandle =NULL;
 
-static void
+// hooks are registered by static constructors: construct on first use
+static InitScheduler &
+initScheduler()
+{
+    static InitScheduler sScheduler;
+    return sScheduler;
+}
+
+static int
 hookInit(gpointer func)
 {
     InitFunction function = (InitFunction) func;
-    int ret = function ();
-    if (ret != 0)
-        g_error ("%s: Could not run init function %p", __FUNCTION__, func);
+    return function ();
 }
 
-static void
+static int
 hookStart(gpointer func)
 {
     StartFunction function = (StartFunction) func;
-    int ret = function (sCurrentLoop, sCurrentHandle);
-    if (ret != 0)
-        g_error ("%s: Could not run start function %p", __FUNCTION__, func);
+    return function (sCurrentLoop, sCurrentHandle);
+}
+
+static void
+profileHook(const std::string & hook, bool started, void * data)
+{
+    if (started)
+        gStartupProfiler.begin("hook " + hook);
+    else
+        gStartupProfiler.end("hook " + hook);
 }
 
 guint64 getCurrentTimeInMs ()
@@ -56,68 +72,32 @@ guint64 getCurrentTimeInMs ()
     return guint64(now.tv_sec) * 1000ULL + guint64(now.tv_nsec) / 1000000ULL;
 }
 
-void registerInitFunction (InitFunction function)
+void registerInitFunction (InitFunction function, const char * name,
+                           const char * dependencies, int flags)
 {
-    if (NULL == sInitList)
-    {
-       sInitList = (GHookList*) malloc (sizeof (GHookList));
-       g_hook_list_init(sInitList, sizeof (GHook));
-    }
-
-    GHook *hook = g_hook_alloc (sInitList);
-    hook->func = (gpointer) hookInit;
-    hook->data = (gpointer) function;
-
-    g_hook_append(sInitList, hook);
+    initScheduler().add(eInitPhase_Init, name, hookInit, (gpointer) function,
+                        dependencies, flags);
 }
 
-void registerModuleFunction (StartFunction function)
+void registerModuleFunction (StartFunction function, const char * name,
+                             const char * dependencies, int flags)
 {
-
-    if (NULL == sModuleStartList)
-    {
-       sModuleStartList = (GHookList*) malloc (sizeof (GHookList));
-       g_hook_list_init(sModuleStartList, sizeof (GHook));
-    }
-
-    GHook *hook = g_hook_alloc (sModuleStartList);
-    hook->func = (gpointer) hookStart;
-    hook->data = (gpointer) function;
-
-    g_hook_append(sModuleStartList, hook);
+    initScheduler().add(eInitPhase_Module, name, hookStart, (gpointer) function,
+                        dependencies, flags);
 }
 
-void registerControlFunction (StartFunction function)
+void registerControlFunction (StartFunction function, const char * name,
+                              const char * dependencies, int flags)
 {
-
-    if (NULL == sControlStartList)
-    {
-       sControlStartList = (GHookList*) malloc (sizeof (GHookList));
-       g_hook_list_init(sControlStartList, sizeof (GHook));
-    }
-
-    GHook *hook = g_hook_alloc (sControlStartList);
-    hook->func = (gpointer) hookStart;
-    hook->data = (gpointer) function;
-
-
-    g_hook_append(sControlStartList, hook);
+    initScheduler().add(eInitPhase_Control, name, hookStart, (gpointer) function,
+                        dependencies, flags);
 }
 
-void registerServiceFunction (StartFunction function)
+void registerServiceFunction (StartFunction function, const char * name,
+                              const char * dependencies, int flags)
 {
-
-    if (NULL == sServiceStartList)
-    {
-       sServiceStartList = (GHookList*) malloc (sizeof (GHookList));
-       g_hook_list_init(sServiceStartList, sizeof (GHook));
-    }
-
-    GHook *hook = g_hook_alloc (sServiceStartList);
-    hook->func = (gpointer) hookStart;
-    hook->data = (gpointer) function;
-
-    g_hook_append(sServiceStartList, hook);
+    initScheduler().add(eInitPhase_Service, name, hookStart, (gpointer) function,
+                        dependencies, flags);
 }
 
 static LSMessage * sCancelSubscription_LSMessage = NULL;
@@ -170,14 +150,7 @@ _cancelSubscription (LSHandle *lshandle, LSMessage *message, void *ctx)
 
 void oneFreeForAll()
 {
-    g_hook_list_clear(sInitList);
-    free(sInitList);
-    g_hook_list_clear(sServiceStartList);
-    free(sServiceStartList);
-    g_hook_list_clear(sModuleStartList);
-    free(sModuleStartList);
-    g_hook_list_clear(sControlStartList);
-    free(sControlStartList);
+    initScheduler().clear();
     g_hook_list_clear(sCancelSubscriptionCallbackList);
     free(sCancelSubscriptionCallbackList);
 }
@@ -198,21 +171,15 @@ void oneInitForAll(GMainLoop *loop, LSHandle *handle)
     sCurrentLoop   = loop;
     sCurrentHandle = handle;
 
-    g_debug ("%s: calling all init functions", __FUNCTION__);
-    if (NULL != sInitList)
-        g_hook_list_invoke (sInitList, FALSE);
-
-    g_debug ("%s: calling all start module functions", __FUNCTION__);
-    if (NULL != sModuleStartList)
-        g_hook_list_invoke (sModuleStartList, FALSE);
-
-    g_debug ("%s: calling all start control functions", __FUNCTION__);
-    if (NULL != sControlStartList)
-        g_hook_list_invoke (sControlStartList, FALSE);
-
-    g_debug ("%s: calling all start service functions", __FUNCTION__);
-    if (NULL != sServiceStartList)
-        g_hook_list_invoke (sServiceStartList, FALSE);
+    g_debug ("%s: calling all init & start functions", __FUNCTION__);
+    InitScheduler & scheduler = initScheduler();
+    scheduler.setObserver(profileHook, NULL);
+    if (!scheduler.run(INIT_WORKER_THREADS))
+        g_error ("%s: Could not run init function %s", __FUNCTION__,
+                                              scheduler.failedHook().c_str());
+    if (!scheduler.serialReason().empty())
+        g_warning ("%s: init functions ran serially: %s", __FUNCTION__,
+                                              scheduler.serialReason().c_str());
 
 
     registerCancelSubscription(GetPalmService());
@@ -222,12 +189,80 @@ void oneInitForAll(GMainLoop *loop, LSHandle *handle)
     g_debug("oneInitForAll: complete!");
 }
 
+struct TimedLunaMethod
+{
+    const char *        mName;
+    LSMethodFunction    mFunction;
+    MetricsHistogram *  mLatency;
+};
+
+struct TimedLunaCategory
+{
+    void *              mUserData;
+    TimedLunaMethod *   mMethods;
+    int                 mCount;
+};
+
+static bool
+_timedLunaMethod(LSHandle *sh, LSMessage *message, void *ctx)
+{
+    TimedLunaCategory * category = (TimedLunaCategory *) ctx;
+    const char * name = LSMessageGetMethod(message);
+    for (int i = 0; name && i < category->mCount; i++)
+    {
+        TimedLunaMethod & method = category->mMethods[i];
+        if (strcmp(method.mName, name) == 0)
+        {
+            MAINLOOP_HANDLER(method.mLatency->getName());
+            gFlightRecorder.record(eFlightEvent_LunaCall, 'b', 0, 0, 0, name);
+            uint64_t start = Metrics::now();
+            bool result = method.mFunction(sh, message, category->mUserData);
+            uint64_t duration = Metrics::now() - start;
+            method.mLatency->record(duration);
+            gFlightRecorder.record(eFlightEvent_LunaCall, 'e', (int32_t) duration, 0, 0, name);
+            return result;
+        }
+    }
+    g_warning("%s: unknown method '%s'", __FUNCTION__, name ? name : "");
+    return false;
+}
+
+// categories are registered for the life of the service: never freed
+LSMethod *
+timedLunaMethods(const char *category, LSMethod *methods,
+        void **category_user_data)
+{
+    int count = 0;
+    while (methods[count].name)
+        count++;
+
+    TimedLunaCategory * timed = new TimedLunaCategory;
+    timed->mUserData = *category_user_data;
+    timed->mMethods = new TimedLunaMethod[count];
+    timed->mCount = count;
+    LSMethod * wrapped = new LSMethod[count + 1];
+    for (int i = 0; i < count; i++)
+    {
+        timed->mMethods[i].mName = methods[i].name;
+        timed->mMethods[i].mFunction = methods[i].function;
+        timed->mMethods[i].mLatency = new MetricsHistogram(
+                g_strdup_printf("luna.%s/%s", category, methods[i].name));
+        wrapped[i] = methods[i];
+        wrapped[i].function = _timedLunaMethod;
+    }
+    wrapped[count] = methods[count];
+
+    *category_user_data = timed;
+    return wrapped;
+}
+
 bool ServiceRegisterCategory(const char *category, LSMethod *methods,
         LSSignal *signal, void *category_user_data)
 {
     bool result;
     CLSError lserror;
     g_message("%s: Registering Service for '%s' category", __FUNCTION__, category);
+    methods = timedLunaMethods(category, methods, &category_user_data);
     result = LSRegisterCategory (GetPalmService(), category,
             methods, signal, NULL, &lserror);
     if (!result)
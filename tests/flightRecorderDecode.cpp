@@ -0,0 +1,37 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+// Decodes a flight recorder dump taken from audiod (kill -USR1, or the
+// dumpFlightRecorder test method) to text, on the device or offline.
+
+#include <stdio.h>
+#include <string>
+
+#include "FlightRecorder.h"
+
+int main(int argc, char ** argv)
+{
+    const char * path = argc > 1 ? argv[1] : FLIGHT_RECORDER_PATH;
+    std::string text;
+    if (!FlightRecorder::decode(path, text))
+    {
+        fprintf(stderr, "%s: '%s' is not a flight recorder dump\n", argv[0], path);
+        return 1;
+    }
+    fputs(text.c_str(), stdout);
+    return 0;
+}
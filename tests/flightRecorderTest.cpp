@@ -0,0 +1,102 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+// Records events, some from several threads, dumps & decodes them.
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string>
+
+#include "FlightRecorder.h"
+#include "testUtils.h"
+
+static const int cThreads = 4;
+static const int cEventsPerThread = 50000;
+
+static void * recordEvents(void * data)
+{
+    FlightRecorder * recorder = (FlightRecorder *) data;
+    for (int i = 0; i < cEventsPerThread; i++)
+        recorder->record(eFlightEvent_MixerCommand, 'v', i, 50, 1);
+    return NULL;
+}
+
+static int countLines(const std::string & text, const char * pattern)
+{
+    int count = 0;
+    for (size_t found = text.find(pattern); found != std::string::npos;
+                                            found = text.find(pattern, found + 1))
+        count++;
+    return count;
+}
+
+int main(int argc, char ** argv)
+{
+    const char * path = "/tmp/flightRecorderTest.bin";
+    std::string text;
+
+    {
+        FlightRecorder recorder(8);
+        recorder.record(eFlightEvent_State, 0, 1, 0, 0, "ringer");
+        recorder.record(eFlightEvent_Scenario, 0, 0, 0, 0, "media_back_speaker_long");
+        recorder.record(eFlightEvent_PulseMessage, 'o', 3, 17);
+        EXPECT(recorder.dump(path), "dump failed");
+        EXPECT(FlightRecorder::decode(path, text), "decode failed");
+        EXPECT(text.find("# 3 events recorded, 3 kept\n") == 0, "wrong header: %s", text.c_str());
+        EXPECT(text.find(" state      . 1 0 0 ringer\n") != std::string::npos, "state event: %s", text.c_str());
+        EXPECT(text.find(" scenario   . 0 0 0 media_back_speak\n") != std::string::npos, "tag not truncated: %s", text.c_str());
+        EXPECT(text.find(" pulse      o 3 17 0 \n") != std::string::npos, "pulse event: %s", text.c_str());
+        EXPECT(text.find("ringer") < text.find("media_back") && text.find("media_back") < text.find("pulse"),
+               "events out of order: %s", text.c_str());
+
+        // only the last lap is kept, oldest first
+        for (int i = 0; i < 20; i++)
+            recorder.record(eFlightEvent_LunaCall, 'e', i, 0, 0, "getVolume");
+        EXPECT(recorder.recorded() == 23, "wrong count");
+        EXPECT(recorder.dump(path) && FlightRecorder::decode(path, text), "second dump failed");
+        EXPECT(countLines(text, " luna ") == 8 && text.find("ringer") == std::string::npos, "not the last lap: %s", text.c_str());
+        EXPECT(text.find("e 12 0 0 getVolume") < text.find("e 19 0 0 getVolume"), "lap out of order: %s", text.c_str());
+    }
+
+    // concurrent recording, then a dump from a signal handler
+    {
+        FlightRecorder recorder(1024);
+        pthread_t threads[cThreads];
+        for (int t = 0; t < cThreads; t++)
+            pthread_create(&threads[t], NULL, recordEvents, &recorder);
+        for (int t = 0; t < cThreads; t++)
+            pthread_join(threads[t], NULL);
+        EXPECT(recorder.recorded() == cThreads * cEventsPerThread, "events lost");
+
+        unlink(path);
+        EXPECT(recorder.dumpOnSignal(SIGUSR1, path), "could not install the signal handler");
+        raise(SIGUSR1);
+        EXPECT(FlightRecorder::decode(path, text), "signal dump not decoded");
+        EXPECT(countLines(text, " mixer      v ") == 1024, "wrong number of events: %d",
+               countLines(text, " mixer      v "));
+        signal(SIGUSR1, SIG_DFL);
+    }
+
+    EXPECT(!FlightRecorder::decode("/dev/null", text), "empty file decoded");
+    unlink(path);
+
+    printf("flight recorder: %s\n", sFailures ? "FAILED" : "OK");
+    return sFailures ? 1 : 0;
+}
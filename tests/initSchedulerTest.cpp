@@ -0,0 +1,159 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+// Runs fake init hooks through the scheduler & checks the order they ran in,
+// the threads they ran on, and the serial fallback.
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <string>
+
+#include "InitScheduler.h"
+#include "testUtils.h"
+
+static pthread_t sMainThread;
+static pthread_mutex_t sLogMutex = PTHREAD_MUTEX_INITIALIZER;
+static std::string sLog;
+
+struct FakeHook
+{
+    const char *    mName;
+    int             mSleepMs;
+    int             mResult;
+    bool            mOnMainThread;
+};
+
+static int runHook(void * data)
+{
+    FakeHook * hook = (FakeHook *) data;
+    hook->mOnMainThread = pthread_equal(pthread_self(), sMainThread);
+    if (hook->mSleepMs)
+        usleep(hook->mSleepMs * 1000);
+    pthread_mutex_lock(&sLogMutex);
+    sLog += hook->mName;
+    sLog += ' ';
+    pthread_mutex_unlock(&sLogMutex);
+    return hook->mResult;
+}
+
+static size_t position(const char * name)
+{
+    return sLog.find(std::string(name) + " ");
+}
+
+int main(int argc, char ** argv)
+{
+    sMainThread = pthread_self();
+
+    // undeclared hooks keep the phase & registration order, whatever the
+    // order their constructors ran in
+    {
+        FakeHook service = { "service", 0, 0, false };
+        FakeHook init1 = { "init1", 0, 0, false };
+        FakeHook module = { "module", 0, 0, false };
+        FakeHook init2 = { "init2", 0, 0, false };
+        InitScheduler scheduler;
+        scheduler.add(eInitPhase_Service, "service", runHook, &service, NULL, 0);
+        scheduler.add(eInitPhase_Init, "init1", runHook, &init1, NULL, 0);
+        scheduler.add(eInitPhase_Module, "module", runHook, &module, NULL, eInitHook_ThreadSafe);
+        scheduler.add(eInitPhase_Init, "init2", runHook, &init2, NULL, 0);
+        sLog.clear();
+        EXPECT(scheduler.run(InitScheduler::cDefaultWorkers), "run failed");
+        EXPECT(sLog == "init1 init2 module service ", "wrong order: %s", sLog.c_str());
+        EXPECT(module.mOnMainThread, "undeclared hook moved to a worker");
+        EXPECT(scheduler.serialReason().empty(), "serial run: %s", scheduler.serialReason().c_str());
+    }
+
+    // declared thread safe hooks overlap with each other & with the main thread,
+    // and the hooks depending on them wait for them
+    {
+        FakeHook slow1 = { "slow1", 200, 0, false };
+        FakeHook slow2 = { "slow2", 200, 0, false };
+        FakeHook first = { "first", 0, 0, false };
+        FakeHook user = { "user", 0, 0, false };
+        FakeHook after = { "after", 0, 0, false };
+        InitScheduler scheduler;
+        scheduler.add(eInitPhase_Init, "first", runHook, &first, NULL, 0);
+        scheduler.add(eInitPhase_Init, "slow1", runHook, &slow1, "", eInitHook_ThreadSafe);
+        scheduler.add(eInitPhase_Init, "slow2", runHook, &slow2, "", eInitHook_ThreadSafe);
+        scheduler.add(eInitPhase_Module, "user", runHook, &user, "slow1", eInitHook_MainThread);
+        scheduler.add(eInitPhase_Service, "after", runHook, &after, NULL, 0);
+        sLog.clear();
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        EXPECT(scheduler.run(2), "run failed");
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        long elapsedMs = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+        EXPECT(elapsedMs < 350, "thread safe hooks didn't overlap: %ld ms", elapsedMs);
+        EXPECT(!slow1.mOnMainThread && !slow2.mOnMainThread, "thread safe hooks on the main thread");
+        EXPECT(first.mOnMainThread && user.mOnMainThread && after.mOnMainThread, "main thread hook on a worker");
+        EXPECT(position("first") < position("slow1"), "slow hooks finished first: %s", sLog.c_str());
+        EXPECT(position("slow1") < position("user"), "dependency not respected: %s", sLog.c_str());
+        EXPECT(position("slow2") < position("after"), "undeclared hook didn't wait: %s", sLog.c_str());
+    }
+
+    // a failure stops the hooks that depend on it
+    {
+        FakeHook failing = { "failing", 0, -1, false };
+        FakeHook dependent = { "dependent", 0, 0, false };
+        FakeHook later = { "later", 0, 0, false };
+        InitScheduler scheduler;
+        scheduler.add(eInitPhase_Init, "failing", runHook, &failing, "", eInitHook_ThreadSafe);
+        scheduler.add(eInitPhase_Init, "dependent", runHook, &dependent, "failing", eInitHook_ThreadSafe);
+        scheduler.add(eInitPhase_Module, "later", runHook, &later, NULL, 0);
+        sLog.clear();
+        EXPECT(!scheduler.run(2), "failure not reported");
+        EXPECT(scheduler.failedHook() == "failing", "wrong failed hook: %s", scheduler.failedHook().c_str());
+        EXPECT(position("dependent") == std::string::npos && position("later") == std::string::npos,
+               "hooks run after a failure: %s", sLog.c_str());
+    }
+
+    // cycles & unknown names fall back on a serial run, on the main thread
+    {
+        FakeHook a = { "a", 0, 0, false };
+        FakeHook b = { "b", 0, 0, false };
+        FakeHook c = { "c", 0, 0, false };
+        InitScheduler scheduler;
+        scheduler.add(eInitPhase_Init, "a", runHook, &a, "b", eInitHook_ThreadSafe);
+        scheduler.add(eInitPhase_Init, "b", runHook, &b, " a ", eInitHook_ThreadSafe);
+        scheduler.add(eInitPhase_Init, "c", runHook, &c, NULL, 0);
+        sLog.clear();
+        EXPECT(scheduler.run(2), "serial run failed");
+        EXPECT(!scheduler.serialReason().empty(), "cycle not detected");
+        EXPECT(sLog == "a b c ", "wrong serial order: %s", sLog.c_str());
+        EXPECT(a.mOnMainThread && b.mOnMainThread, "serial run used workers");
+
+        InitScheduler unknown;
+        unknown.add(eInitPhase_Init, "a", runHook, &a, "missing", eInitHook_ThreadSafe);
+        sLog.clear();
+        EXPECT(unknown.run(2) && unknown.serialReason().find("missing") != std::string::npos,
+               "unknown dependency not reported: %s", unknown.serialReason().c_str());
+    }
+
+    // without workers, thread safe hooks just run on the main thread
+    {
+        FakeHook a = { "a", 0, 0, false };
+        InitScheduler scheduler;
+        scheduler.add(eInitPhase_Init, "a", runHook, &a, "", eInitHook_ThreadSafe);
+        EXPECT(scheduler.run(0) && a.mOnMainThread, "hook not run on the main thread");
+    }
+
+    printf("init scheduler: %s\n", sFailures ? "FAILED" : "OK");
+    return sFailures ? 1 : 0;
+}
@@ -0,0 +1,257 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Checks that the server only sends clients what they use: a client that
+// declared its interests before connecting doesn't get the values &
+// messages of other properties, until it adds listeners or changes its
+// interests, and that regaining interest in a local copy brings its current
+// value. A client that declares nothing still gets everything.
+// Each step is requested by the selective client: the server changes
+// everything, then tells the step is done, so that what the clients got
+// before can be checked.
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+
+#include "IPC_Property.hpp"
+#include "testUtils.h"
+
+static const int cSteps = 4;
+
+static bool sDeclareInterests = false;
+
+template <template <class> class Property> class TestProperties : public IPC_SharedProperties
+{
+public:
+    static const bool cIsServerNotClient = Property<bool>::cIsServerNotClient;
+
+    Property<int>       mReady;         ///< by the client that gets everything
+    Property<int>       mStep;          ///< requested by the other one
+    Property<int>       mDone;          ///< by the server, once it changed everything
+    Property<int>       mVolume;        ///< local copies
+    Property<int>       mMode;
+    Property<int>       mHeadsetState;  ///< in shared memory
+
+protected:
+    TestProperties(const std::string & name) : IPC_SharedProperties(name, sizeof(TestProperties))
+    {
+        mReady.init(0);
+        mStep.init(0);
+        mDone.init(0);
+        mVolume.init(0);
+        mMode.init(0);
+        mHeadsetState.init(0);
+        mVolume.setFlag(IPC_PropertyBase::ePropertyFlag_UseLocalCopy);
+        mMode.setFlag(IPC_PropertyBase::ePropertyFlag_UseLocalCopy);
+        // told to the server when connecting
+        if (!cIsServerNotClient && sDeclareInterests)
+        {
+            IPC_PropertyID interests[] = { mStep.getID(), mVolume.getID() };
+            setInterests(interests, 2);
+        }
+    }
+    friend class IPC_SharedProperties;
+};
+
+typedef TestProperties<IPC_ServerProperty>  ServerProperties;
+typedef TestProperties<IPC_ClientProperty>  ClientProperties;
+
+static ServerProperties * sServer;
+
+// the server changes everything, then says so
+static void stepRequested(const int & step)
+{
+    sServer->mVolume.set(step);
+    sServer->mMode.set(step);
+    sServer->mHeadsetState.set(step);
+    sServer->mVolume.sendMessage("volume");
+    sServer->mMode.sendMessage("mode");
+    sServer->mDone.set(step);
+}
+
+struct Received
+{
+    Received() : mDone(0), mHeadsetState(0), mVolumeMessages(0), mModeMessages(0) {}
+
+    void    done(const int & step)              { mDone = step; }
+    void    headsetState(const int & state)     { mHeadsetState = state; }
+    void    volumeMessage(const char *)         { mVolumeMessages++; }
+    void    modeMessage(const char *)           { mModeMessages++; }
+
+    int     mDone;
+    int     mHeadsetState;
+    int     mVolumeMessages;
+    int     mModeMessages;
+};
+
+static Received sReceived;
+
+template <class Condition> static bool runUntil(Condition condition)
+{
+    for (int i = 0; i < 50 && !condition(); i++)
+        g_main_context_iteration(NULL, TRUE);
+    return condition();
+}
+
+static bool runStep(ClientProperties & client, int step)
+{
+    client.mStep.set(step);
+    return runUntil([=] { return sReceived.mDone == step; });
+}
+
+#define CHECK_CLIENT(cond, ...) do { if (!(cond)) { printf("  client: "); printf(__VA_ARGS__); \
+                                                    printf("\n"); failures++; } } while (0)
+
+// declared its interests: the step & the volume
+static int selectiveClient(ClientProperties & client)
+{
+    int failures = 0;
+    client.mDone.sendChanges(boost::bind(&Received::done, &sReceived, _1));
+
+    // changes of the mode don't come
+    if (!runStep(client, 1))
+        return 1;
+    CHECK_CLIENT(client.mVolume.get() == 1, "step 1: volume %d", client.mVolume.get());
+    CHECK_CLIENT(client.mMode.get() == 0, "step 1: mode %d sent", client.mMode.get());
+
+    // a listener makes the property interesting
+    client.mHeadsetState.sendChanges(boost::bind(&Received::headsetState, &sReceived, _1));
+    client.mMode.sendMessages(boost::bind(&Received::modeMessage, &sReceived, _1));
+    CHECK_CLIENT(runUntil([&] { return client.mMode.get() == 1; }),
+                 "mode listened to: %d, not 1", client.mMode.get());
+    if (!runStep(client, 2))
+        return 1;
+    CHECK_CLIENT(sReceived.mHeadsetState == 2, "step 2: headset state %d", sReceived.mHeadsetState);
+    CHECK_CLIENT(sReceived.mModeMessages == 1, "step 2: %d mode messages", sReceived.mModeMessages);
+    CHECK_CLIENT(client.mMode.get() == 2, "step 2: mode %d", client.mMode.get());
+
+    // interests changed: the volume no longer comes, listened properties still do
+    IPC_PropertyID interests[] = { client.mStep.getID() };
+    client.setInterests(interests, 1);
+    if (!runStep(client, 3))
+        return 1;
+    CHECK_CLIENT(client.mVolume.get() == 2, "step 3: volume %d sent", client.mVolume.get());
+    CHECK_CLIENT(sReceived.mHeadsetState == 3 && client.mMode.get() == 3 &&
+                 sReceived.mModeMessages == 2, "step 3: listened properties lost");
+
+    // back to everything: the volume's local copy catches up right away
+    client.setInterestedInAll();
+    CHECK_CLIENT(runUntil([&] { return client.mVolume.get() == 3; }),
+                 "interest regained: volume %d, not 3", client.mVolume.get());
+    client.mVolume.sendMessages(boost::bind(&Received::volumeMessage, &sReceived, _1));
+    if (!runStep(client, 4))
+        return 1;
+    CHECK_CLIENT(client.mVolume.get() == 4 && sReceived.mVolumeMessages == 1,
+                 "step 4: volume %d, %d messages", client.mVolume.get(), sReceived.mVolumeMessages);
+    fflush(stdout);
+    return failures;
+}
+
+// declared nothing: gets everything, like clients that predate interests
+static int wildcardClient(ClientProperties & client)
+{
+    int failures = 0;
+    client.mDone.sendChanges(boost::bind(&Received::done, &sReceived, _1));
+    client.mMode.sendMessages(boost::bind(&Received::modeMessage, &sReceived, _1));
+    client.mReady.set(1);
+    for (int step = 1; step <= cSteps; step++)
+    {
+        if (!runUntil([=] { return sReceived.mDone >= step; }))
+            return 1;
+        CHECK_CLIENT(client.mVolume.get() >= step && client.mMode.get() >= step,
+                     "wildcard, step %d: volume %d, mode %d", step, client.mVolume.get(),
+                     client.mMode.get());
+    }
+    CHECK_CLIENT(sReceived.mModeMessages == cSteps, "wildcard: %d mode messages",
+                 sReceived.mModeMessages);
+    fflush(stdout);
+    return failures;
+}
+
+// forked before the server exists, so that it doesn't inherit its sockets
+static pid_t forkClient(const char * name, int (*run)(ClientProperties &), bool declare,
+                        int & start)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+        return -1;
+    pid_t child = fork();
+    if (child == 0)
+    {
+        close(fds[1]);
+        char go;
+        if (read(fds[0], &go, 1) != 1)
+            _exit(1);
+        sDeclareInterests = declare;
+        ClientProperties * client =
+                     IPC_SharedProperties::createSharedProperties<ClientProperties>(name);
+        _exit(client ? run(*client) : 1);
+    }
+    close(fds[0]);
+    start = fds[1];
+    return child;
+}
+
+static void startClient(int start)
+{
+    char go = 1;
+    if (write(start, &go, 1) != 1)
+        perror("write");
+    close(start);
+}
+
+int main(int argc, char ** argv)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "Audiod-Interest-Test-%d", (int) getpid());
+    int startSelective, startWildcard;
+    pid_t selective = forkClient(name, selectiveClient, true, startSelective);
+    pid_t wildcard = forkClient(name, wildcardClient, false, startWildcard);
+
+    sServer = IPC_SharedProperties::createSharedProperties<ServerProperties>(name);
+    if (!sServer)
+        return 1;
+    sServer->mStep.sendChanges(&stepRequested);
+
+    // the wildcard client first: it must not miss a step
+    startClient(startWildcard);
+    EXPECT(runUntil([] { return sServer->mReady.get() == 1; }), "wildcard client not ready");
+    startClient(startSelective);
+
+    pid_t children[2] = { selective, wildcard };
+    pid_t done[2] = { 0, 0 };
+    int statuses[2] = { 0, 0 };
+    runUntil([&] {
+        for (int i = 0; i < 2; i++)
+            if (done[i] == 0)
+                done[i] = waitpid(children[i], &statuses[i], WNOHANG);
+        return done[0] != 0 && done[1] != 0; });
+    EXPECT(done[0] == selective && WIFEXITED(statuses[0]) && WEXITSTATUS(statuses[0]) == 0,
+           "selective client failed");
+    EXPECT(done[1] == wildcard && WIFEXITED(statuses[1]) && WEXITSTATUS(statuses[1]) == 0,
+           "wildcard client failed");
+
+    boost::interprocess::shared_memory_object::remove(name);
+    boost::interprocess::shared_memory_object::remove(
+                                IPC_SharedProperties::changesName(name).c_str());
+
+    printf("ipc interests: %s\n", sFailures ? "FAILED" : "OK");
+    return sFailures ? 1 : 0;
+}
@@ -0,0 +1,191 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Compares the cost of notifying property listeners with boost::signals2,
+// with & without its lock, & with IPC_ListenerList. Also checks the
+// listener list: no allocation, interest masks, listeners connecting &
+// disconnecting while notified.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <boost/bind.hpp>
+#include <boost/signals2.hpp>
+
+#include "IPC_ListenerList.h"
+#include "testUtils.h"
+
+static const int cNotifications = 2000000;
+
+static unsigned long sAllocations = 0;
+
+// counts the allocations of new too
+extern "C" void * __libc_malloc(size_t size);
+extern "C" void * malloc(size_t size)
+{
+    sAllocations++;
+    return __libc_malloc(size);
+}
+
+static double now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// like the audiod objects listening to a property
+struct Listener
+{
+    Listener() : mCalls(0), mSum(0) {}
+
+    void    changed(const int & value)      { mCalls++; mSum += value; }
+
+    int     mCalls;
+    long    mSum;
+};
+
+typedef boost::signals2::signal<void (const int &)> TLockedSignal;
+typedef boost::signals2::signal_type<void (const int &),
+            boost::signals2::keywords::mutex_type<boost::signals2::dummy_mutex> >::type
+                                                            TUnlockedSignal;
+typedef IPC_ListenerList<void (const int &), 4> TListenerList;
+
+template <class Signal> static void bench(const char * name, int listenerCount)
+{
+    Signal signal;
+    Listener listeners[4];
+    for (int i = 0; i < listenerCount; i++)
+        signal.connect(boost::bind(&Listener::changed, &listeners[i], _1));
+
+    unsigned long allocations = sAllocations;
+    double start = now();
+    for (int value = 0; value < cNotifications; value++)
+        signal(value);
+    double elapsed = now() - start;
+    allocations = sAllocations - allocations;
+
+    for (int i = 0; i < listenerCount; i++)
+        EXPECT(listeners[i].mCalls == cNotifications, "%s: %d calls", name, listeners[i].mCalls);
+    printf("  %-18s %d listener%s: %6.1f ns per notification, %lu allocations\n", name,
+           listenerCount, listenerCount > 1 ? "s" : " ", elapsed * 1e9 / cNotifications,
+           allocations);
+}
+
+// listeners changing the list while being notified
+struct Reentrant
+{
+    Reentrant(TListenerList & list) : mList(list), mCalls(0), mOtherCalls(0) {}
+
+    void    disconnectSelf(const int &)     { mCalls++; mSelf.disconnect(); }
+    void    disconnectOther(const int &)    { mCalls++; mOther.disconnect(); }
+    void    connectOther(const int &)
+    {
+        mCalls++;
+        if (!mOther.connected())
+            mOther = mList.connect(boost::bind(&Reentrant::other, this, _1));
+    }
+    void    other(const int &)              { mOtherCalls++; }
+
+    TListenerList &             mList;
+    IPC_ListenerConnection      mSelf;
+    IPC_ListenerConnection      mOther;
+    int                         mCalls;
+    int                         mOtherCalls;
+};
+
+static void checkListenerList()
+{
+    // disconnected from inside the notification
+    {
+        TListenerList list;
+        Reentrant reentrant(list);
+        reentrant.mSelf = list.connect(boost::bind(&Reentrant::disconnectSelf, &reentrant, _1));
+        list(1);
+        list(2);
+        EXPECT(reentrant.mCalls == 1 && list.empty(), "self disconnection: %d calls",
+               reentrant.mCalls);
+    }
+    {
+        TListenerList list;
+        Reentrant reentrant(list);
+        list.connect(boost::bind(&Reentrant::disconnectOther, &reentrant, _1));
+        reentrant.mOther = list.connect(boost::bind(&Reentrant::other, &reentrant, _1));
+        list(1);
+        EXPECT(reentrant.mOtherCalls == 0 && list.num_slots() == 1,
+               "disconnected listener called %d times", reentrant.mOtherCalls);
+    }
+    // connected from inside the notification: called from the next one
+    {
+        TListenerList list;
+        Reentrant reentrant(list);
+        list.connect(boost::bind(&Reentrant::connectOther, &reentrant, _1));
+        list(1);
+        EXPECT(reentrant.mOtherCalls == 0, "new listener called during its connection");
+        list(2);
+        EXPECT(reentrant.mOtherCalls == 1, "new listener called %d times", reentrant.mOtherCalls);
+    }
+    // interests, capacity & old connections
+    {
+        TListenerList list;
+        Listener listeners[5];
+        IPC_ListenerConnection first =
+                         list.connect(boost::bind(&Listener::changed, &listeners[0], _1), 1);
+        list.connect(boost::bind(&Listener::changed, &listeners[1], _1), 2);
+        list.connect(boost::bind(&Listener::changed, &listeners[2], _1));
+        list.notify(2, 1);
+        EXPECT(listeners[0].mCalls == 0 && listeners[1].mCalls == 1 && listeners[2].mCalls == 1,
+               "interests: %d, %d & %d calls", listeners[0].mCalls, listeners[1].mCalls,
+               listeners[2].mCalls);
+        EXPECT(list.connect(boost::bind(&Listener::changed, &listeners[3], _1)).connected() &&
+               !list.connect(boost::bind(&Listener::changed, &listeners[4], _1)).connected(),
+               "capacity not enforced");
+        IPC_ListenerConnection old = first;
+        first.disconnect();
+        IPC_ListenerConnection reused =
+                            list.connect(boost::bind(&Listener::changed, &listeners[4], _1));
+        old.disconnect();
+        EXPECT(reused.connected() && list.num_slots() == 4,
+               "an old connection disconnected a new listener");
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    checkListenerList();
+
+    printf("%d notifications of an int:\n", cNotifications);
+    for (int listeners = 1; listeners <= 4; listeners += 3)
+    {
+        bench<TLockedSignal>("signals2", listeners);
+        bench<TUnlockedSignal>("signals2, no lock", listeners);
+        bench<TListenerList>("IPC_ListenerList", listeners);
+    }
+
+    // notifying the listener list must not allocate
+    {
+        TListenerList list;
+        Listener listener;
+        list.connect(boost::bind(&Listener::changed, &listener, _1));
+        unsigned long allocations = sAllocations;
+        list(1);
+        EXPECT(sAllocations == allocations, "IPC_ListenerList allocated");
+    }
+
+    printf("ipc listeners: %s\n", sFailures ? "FAILED" : "OK");
+    return sFailures ? 1 : 0;
+}
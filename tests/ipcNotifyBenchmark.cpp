@@ -0,0 +1,280 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Compares the two ways a client learns that a shared property changed:
+// a change notification on its socket, or a futex wakeup on the change count
+// in shared memory. A forked reader maps the value read only & the change
+// count read write, like clients do, & measures the latency of each
+// notification. CPU time is measured on both sides. Also checks that a burst
+// of changes is coalesced into fewer wakeups of the reader, & that signals
+// don't make a wait last longer than its timeout.
+
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <new>
+
+#include "IPC_ChangeNotifier.h"
+#include "IPC_Seqlock.h"
+#include "testUtils.h"
+
+static const int cNotifications = 20000;
+static const int cBurst = 10000;
+
+// a wide value, like levels of several streams
+struct Levels
+{
+    uint64_t    mChanged;   // when, in ns
+    uint32_t    mCount;
+    int32_t     mLevels[14];
+};
+
+// what the server shares: read only for the reader
+struct SharedPage
+{
+    IPC_Seqlock         mSeqlock;
+    Levels              mValue;
+};
+
+// how the reader answers & reports
+struct ReaderPage
+{
+    IPC_ChangeNotifier  mAcks;
+    uint64_t            mLatency;   // total, in ns
+    uint32_t            mWakeups;
+    uint32_t            mLastCount;
+};
+
+enum ENotification
+{
+    eNotification_Futex,
+    eNotification_Socket
+};
+
+static uint64_t now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return uint64_t(time.tv_sec) * 1000000000ULL + uint64_t(time.tv_nsec);
+}
+
+static uint64_t cpuTime(int who)
+{
+    struct rusage usage;
+    getrusage(who, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ULL +
+            usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static void * sharedPages(size_t size)
+{
+    void * memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    return memory == MAP_FAILED ? NULL : memory;
+}
+
+static void publish(SharedPage * shared, uint32_t count)
+{
+    shared->mSeqlock.writeBegin();
+    shared->mValue.mCount = count;
+    for (int i = 0; i < 14; i++)
+        shared->mValue.mLevels[i] = count;
+    shared->mValue.mChanged = now();
+    shared->mSeqlock.writeEnd();
+}
+
+// reads the value after each wakeup, until it saw the last count
+static int reader(const SharedPage * shared, IPC_ChangeNotifier * changes, ReaderPage * page,
+                  ENotification notification, int socket, uint32_t seen, uint32_t last, bool ack)
+{
+    Levels value;
+    memset(&value, 0, sizeof(value));
+    while (value.mCount != last)
+    {
+        if (notification == eNotification_Futex)
+        {
+            if (!changes->wait(seen, 1000))
+                return 1;
+            seen = changes->changes();
+        }
+        else
+        {
+            uint16_t id;
+            if (recv(socket, &id, sizeof(id), 0) != sizeof(id))
+                return 1;
+        }
+        uint64_t woken = now();
+        if (!shared->mSeqlock.read(&value, &shared->mValue, sizeof(value)))
+            return 1;
+        page->mLatency += woken - value.mChanged;
+        page->mWakeups++;
+        page->mLastCount = value.mCount;
+        if (ack)
+            page->mAcks.notify();
+    }
+    return 0;
+}
+
+static pid_t startReader(SharedPage * shared, IPC_ChangeNotifier * changes, ReaderPage * page,
+                         ENotification notification, int sockets[2], uint32_t last, bool ack)
+{
+    page->mLatency = 0;
+    page->mWakeups = 0;
+    page->mLastCount = 0;
+    // from before the writer can change anything
+    uint32_t seen = changes->changes();
+    pid_t child = fork();
+    if (child == 0)
+    {
+        // clients map the properties read only
+        mprotect(shared, sizeof(SharedPage), PROT_READ);
+        _exit(reader(shared, changes, page, notification, sockets[1], seen, last, ack));
+    }
+    return child;
+}
+
+static bool waitReader(pid_t child)
+{
+    int status = 0;
+    return child > 0 && waitpid(child, &status, 0) == child &&
+           WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// one change at a time, waiting for the reader to have seen it
+static void benchLatency(SharedPage * shared, IPC_ChangeNotifier * changes, ReaderPage * page,
+                         ENotification notification, const char * name)
+{
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets) != 0)
+        return;
+    uint64_t cpuBefore = cpuTime(RUSAGE_SELF) + cpuTime(RUSAGE_CHILDREN);
+    pid_t child = startReader(shared, changes, page, notification, sockets, cNotifications,
+                              true);
+
+    for (uint32_t count = 1; count <= (uint32_t) cNotifications; count++)
+    {
+        uint32_t acks = page->mAcks.changes();
+        publish(shared, count);
+        if (notification == eNotification_Futex)
+            changes->notify();
+        else
+        {
+            uint16_t id = 1;
+            send(sockets[0], &id, sizeof(id), 0);
+        }
+        if (!page->mAcks.wait(acks, 1000))
+            break;
+    }
+    EXPECT(waitReader(child), "%s: reader failed", name);
+    uint64_t cpu = cpuTime(RUSAGE_SELF) + cpuTime(RUSAGE_CHILDREN) - cpuBefore;
+    close(sockets[0]);
+    close(sockets[1]);
+
+    EXPECT(page->mLastCount == (uint32_t) cNotifications, "%s: last change seen %u",
+           name, page->mLastCount);
+    printf("  %-8s: %5.1f us latency, %5.1f us of cpu per change (writer, reader & acks)\n", name,
+           page->mWakeups ? page->mLatency / 1000.0 / page->mWakeups : 0.0,
+           (double) cpu / cNotifications);
+}
+
+// changes as fast as possible: the futex reader wakes up less than once per change
+static void checkBurst(SharedPage * shared, IPC_ChangeNotifier * changes, ReaderPage * page)
+{
+    int sockets[2] = { -1, -1 };
+    pid_t child = startReader(shared, changes, page, eNotification_Futex, sockets, cBurst, false);
+    usleep(10000);  // let it wait first
+    for (uint32_t count = 1; count <= (uint32_t) cBurst; count++)
+    {
+        publish(shared, count);
+        changes->notify();
+    }
+    EXPECT(waitReader(child), "burst: reader failed");
+    EXPECT(page->mLastCount == (uint32_t) cBurst, "burst: last change seen %u", page->mLastCount);
+    EXPECT(page->mWakeups < (uint32_t) cBurst, "burst: %u wakeups", page->mWakeups);
+    printf("  burst of %d changes: %u wakeups\n", cBurst, page->mWakeups);
+}
+
+static void interrupted(int)
+{
+}
+
+// each signal interrupts the futex wait: the timeout still counts from the start
+static void checkInterruptedWait()
+{
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = interrupted;
+    sigaction(SIGALRM, &action, NULL);
+    struct itimerval timer = { { 0, 5000 }, { 0, 5000 } };
+    setitimer(ITIMER_REAL, &timer, NULL);
+
+    IPC_ChangeNotifier notifier;
+    uint64_t start = now();
+    EXPECT(!notifier.wait(notifier.changes(), 100), "wakeup without a change");
+    uint64_t waited = now() - start;
+
+    struct itimerval stop = { { 0, 0 }, { 0, 0 } };
+    setitimer(ITIMER_REAL, &stop, NULL);
+    signal(SIGALRM, SIG_DFL);
+    EXPECT(waited >= 100000000ull && waited < 500000000ull, "waited %.0f ms for 100 ms",
+           waited / 1e6);
+}
+
+int main(int argc, char ** argv)
+{
+    // single process basics
+    {
+        IPC_ChangeNotifier notifier;
+        uint32_t seen = notifier.changes();
+        EXPECT(!notifier.wait(seen, 10), "wakeup without a change");
+        notifier.notify();
+        notifier.notify();
+        EXPECT(notifier.wait(seen, 10), "change missed");
+        EXPECT(notifier.changes() == seen + 2, "changes: %u", notifier.changes());
+    }
+    checkInterruptedWait();
+
+    void * sharedMemory = sharedPages(sizeof(SharedPage));
+    void * changesMemory = sharedPages(sizeof(IPC_ChangeNotifier));
+    void * readerMemory = sharedPages(sizeof(ReaderPage));
+    if (!sharedMemory || !changesMemory || !readerMemory)
+    {
+        perror("mmap");
+        return 1;
+    }
+    SharedPage * shared = new (sharedMemory) SharedPage;
+    IPC_ChangeNotifier * changes = new (changesMemory) IPC_ChangeNotifier;
+    ReaderPage * page = new (readerMemory) ReaderPage;
+
+    printf("%d changes of a %lu bytes value:\n", cNotifications, (unsigned long) sizeof(Levels));
+    fflush(stdout);
+    benchLatency(shared, changes, page, eNotification_Socket, "socket");
+    benchLatency(shared, changes, page, eNotification_Futex, "futex");
+    checkBurst(shared, changes, page);
+
+    munmap(sharedMemory, sizeof(SharedPage));
+    munmap(changesMemory, sizeof(IPC_ChangeNotifier));
+    munmap(readerMemory, sizeof(ReaderPage));
+
+    printf("ipc notifications: %s\n", sFailures ? "FAILED" : "OK");
+    return sFailures ? 1 : 0;
+}
@@ -0,0 +1,181 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Stress test of the seqlock guarding wide property values in shared memory:
+// forked writers keep updating a wide value, forked readers keep checking
+// that they never see half an update, nor an update go backwards.
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <new>
+
+#include "IPC_Seqlock.h"
+#include "testUtils.h"
+
+static const int cWriters = 2;
+static const int cReaders = 4;
+static const int cWritesPerWriter = 500000;
+static const size_t cWords = 64;
+
+// wide enough to be torn by any copy: all words are always equal
+struct WideValue
+{
+    uint64_t    mWords[cWords];
+};
+
+struct SharedPage
+{
+    IPC_Seqlock         mSeqlock;
+    WideValue           mValue;
+    std::atomic<int>    mWritersDone;
+};
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static int writer(SharedPage * page)
+{
+    for (int i = 0; i < cWritesPerWriter; i++)
+    {
+        page->mSeqlock.writeBegin();
+        uint64_t next = page->mValue.mWords[0] + 1;
+        for (size_t w = 0; w < cWords; w++)
+            page->mValue.mWords[w] = next;
+        page->mSeqlock.writeEnd();
+    }
+    page->mWritersDone.fetch_add(1);
+    return 0;
+}
+
+static int reader(SharedPage * page, int index)
+{
+    int torn = 0, backwards = 0;
+    long long reads = 0;
+    uint64_t last = 0;
+    double start = now();
+    bool done = false;
+    while (!done)
+    {
+        // one last read once all writers are done, to see the final value
+        done = page->mWritersDone.load() == cWriters;
+
+        WideValue value;
+        if (!page->mSeqlock.read(&value, &page->mValue, sizeof(value)))
+        {
+            printf("reader %d: no consistent copy\n", index);
+            fflush(stdout);
+            return 1;
+        }
+        reads++;
+        for (size_t w = 1; w < cWords; w++)
+            if (value.mWords[w] != value.mWords[0])
+            {
+                torn++;
+                break;
+            }
+        if (value.mWords[0] < last)
+            backwards++;
+        last = value.mWords[0];
+    }
+    double duration = now() - start;
+
+    if (torn || backwards || last != (uint64_t) cWriters * cWritesPerWriter)
+    {
+        printf("reader %d: %d torn reads, %d going backwards, last value %llu\n",
+               index, torn, backwards, (unsigned long long) last);
+        fflush(stdout);
+        return 1;
+    }
+    printf("  reader %d: %lld consistent reads, %.0f reads/s\n", index, reads, reads / duration);
+    fflush(stdout);
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    // single process basics
+    {
+        SharedPage page;
+        memset(&page.mValue, 0, sizeof(page.mValue));
+        EXPECT(page.mSeqlock.sequence() == 0, "initial sequence");
+        page.mSeqlock.writeBegin();
+        EXPECT(page.mSeqlock.sequence() == 1, "sequence not odd while writing");
+        page.mValue.mWords[3] = 42;
+        page.mSeqlock.writeEnd();
+        EXPECT(page.mSeqlock.sequence() == 2, "sequence not even after writing");
+
+        WideValue value;
+        EXPECT(page.mSeqlock.read(&value, &page.mValue, sizeof(value)) &&
+               value.mWords[3] == 42, "value not read");
+
+        // a writer that never finished: readers give up instead of hanging
+        page.mSeqlock.writeBegin();
+        EXPECT(!page.mSeqlock.read(&value, &page.mValue, sizeof(value)),
+               "read during an update that never ends");
+        page.mSeqlock.writeEnd();
+    }
+
+    // processes sharing a page, like audiod & its clients
+    void * memory = mmap(NULL, sizeof(SharedPage), PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+    SharedPage * page = new (memory) SharedPage;
+    memset(&page->mValue, 0, sizeof(page->mValue));
+    page->mWritersDone.store(0);
+
+    printf("%d writers, %d readers, %lu bytes value:\n", cWriters, cReaders,
+           (unsigned long) sizeof(WideValue));
+    fflush(stdout);
+    pid_t children[cWriters + cReaders];
+    for (int i = 0; i < cWriters + cReaders; i++)
+    {
+        children[i] = fork();
+        if (children[i] == 0)
+            _exit(i < cReaders ? reader(page, i) : writer(page));
+        EXPECT(children[i] > 0, "fork failed");
+    }
+    for (int i = 0; i < cWriters + cReaders; i++)
+    {
+        int status = 0;
+        if (children[i] > 0)
+        {
+            waitpid(children[i], &status, 0);
+            EXPECT(WIFEXITED(status) && WEXITSTATUS(status) == 0, "child %d failed", i);
+        }
+    }
+
+    // writers exclude each other: no update was lost
+    EXPECT(page->mValue.mWords[0] == (uint64_t) cWriters * cWritesPerWriter,
+           "lost updates: %llu", (unsigned long long) page->mValue.mWords[0]);
+    EXPECT(page->mSeqlock.sequence() == 2u * cWriters * cWritesPerWriter,
+           "sequence %u", page->mSeqlock.sequence());
+    munmap(memory, sizeof(SharedPage));
+
+    printf("ipc seqlock: %s\n", sFailures ? "FAILED" : "OK");
+    return sFailures ? 1 : 0;
+}
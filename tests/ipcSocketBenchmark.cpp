@@ -0,0 +1,394 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Compares the throughput of IPC_Socket::send, which sends a frame's header
+// & payload with one sendmsg, with the former way, one send per segment.
+// Also checks that frames the socket takes partially are completed intact,
+// and that the receive side handles a burst of frames in one wakeup.
+// Then compares the throughput & latency of all the packet modes.
+
+#include <stdio.h>
+#include <string.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "IPC_Socket.hpp"
+#include "testUtils.h"
+
+static const int cFrames = 200000;
+static const int cPayloadSize = 32;     // a property update & its header
+
+static double now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// an IPC_Socket on one end of a socket pair
+struct BenchSocket : public IPC_Socket
+{
+    void attach(int fd, ESocketPacketsSize mode = eSocketPacketsSize_Controlled,
+                ssize_t packetSize = -1)
+    {
+        setPacketing(mode, packetSize);
+        mFD = fd;
+    }
+
+    int fd() const          { return mFD; }
+
+    bool receive()          { return receiveData(); }
+    bool holdsBuffer() const    { return mBuffer != 0; }
+
+    // wait for the socket to take what it queued
+    void drain()
+    {
+        while (hasPendingSend())
+        {
+            struct pollfd writable = { mFD, POLLOUT, 0 };
+            poll(&writable, 1, -1);
+            flushPending();
+        }
+    }
+};
+
+// checks the frames a socket receives: numbered, aligned
+class FrameChecker : public IPC_SocketCallbacks
+{
+public:
+    FrameChecker() : mFrames(0), mErrors(0), mLastSize(0) {}
+
+    void    connectionEstablished(IPC_Socket * socket)  {}
+    void    closed(IPC_Socket * socket)                 {}
+    void    dataReceived(const void * data, ssize_t size)
+    {
+        const unsigned char * bytes = (const unsigned char *) data;
+        if (bytes[0] != (unsigned char) mFrames || bytes[size - 1] != (unsigned char) mFrames ||
+            reinterpret_cast<uintptr_t>(data) % sizeof(ssize_t) != 0)
+            mErrors++;
+        mFrames++;
+        mLastSize = size;
+    }
+
+    int         mFrames;
+    int         mErrors;
+    ssize_t     mLastSize;
+};
+
+static bool sendNumbered(BenchSocket & socket, int number, int size)
+{
+    static char payload[16 * 1024];
+    memset(payload, (unsigned char) number, size);
+    return socket.send(payload, size);
+}
+
+static void checkReceive()
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        return;
+    BenchSocket sender, receiver;
+    sender.attach(fds[0]);
+    receiver.attach(fds[1]);
+    FrameChecker checker;
+    receiver.setCallbacks(&checker);
+
+    // a burst of odd sized frames, more than a pooled buffer
+    int sent = 0;
+    for (int i = 0; i < 100; i++)
+        sendNumbered(sender, sent++, 1 + i % 50);
+    EXPECT(receiver.receive(), "receive error");
+    EXPECT(checker.mFrames == 100 && checker.mErrors == 0, "burst: %d frames, %d errors",
+           checker.mFrames, checker.mErrors);
+    EXPECT(!receiver.holdsBuffer(), "buffer held after complete frames");
+
+    // a frame bigger than a pooled buffer
+    sendNumbered(sender, sent++, 10000);
+    EXPECT(receiver.receive(), "receive error");
+    EXPECT(checker.mFrames == sent && checker.mLastSize == 10000 && checker.mErrors == 0,
+           "big frame: %d frames, last of %zd bytes", checker.mFrames, checker.mLastSize);
+
+    // a frame coming in pieces, header included
+    IPC_Header header(20);
+    char payload[20];
+    memset(payload, (unsigned char) sent++, sizeof(payload));
+    ::send(fds[0], &header, 4, 0);
+    EXPECT(receiver.receive() && checker.mFrames == sent - 1 && receiver.holdsBuffer(),
+           "part of a header");
+    ::send(fds[0], (char *) &header + 4, sizeof(header) - 4, 0);
+    ::send(fds[0], payload, 5, 0);
+    EXPECT(receiver.receive() && checker.mFrames == sent - 1, "part of a frame");
+    ::send(fds[0], payload + 5, sizeof(payload) - 5, 0);
+    EXPECT(receiver.receive() && checker.mFrames == sent && checker.mErrors == 0,
+           "frame in pieces not received");
+    EXPECT(!receiver.holdsBuffer(), "buffer held after complete frames");
+}
+
+// frames received per wakeup, when they come by bursts
+static void benchReceive(int frames, int burst)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        return;
+    int size = 256 * 1024;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    BenchSocket sender, receiver;
+    sender.attach(fds[0]);
+    receiver.attach(fds[1]);
+    FrameChecker checker;
+    receiver.setCallbacks(&checker);
+
+    int wakeups = 0;
+    double start = now();
+    for (int sent = 0; sent < frames; )
+    {
+        for (int i = 0; i < burst && sent < frames; i++)
+            sendNumbered(sender, sent++, cPayloadSize);
+        sender.drain();
+        while (checker.mFrames < sent)
+        {
+            receiver.receive();
+            wakeups++;
+        }
+    }
+    double elapsed = now() - start;
+    EXPECT(checker.mFrames == frames && checker.mErrors == 0, "%d frames of %d received, %d errors",
+           checker.mFrames, frames, checker.mErrors);
+    printf("  bursts of %d: %.1f frames per wakeup, %.0f frames/s sent & received\n",
+           burst, double(frames) / wakeups, frames / elapsed);
+}
+
+// counts the bytes received, & sends them back if asked to
+class ByteCounter : public IPC_SocketCallbacks
+{
+public:
+    ByteCounter(IPC_Socket * echo = 0) : mBytes(0), mEcho(echo) {}
+
+    void    connectionEstablished(IPC_Socket * socket)  {}
+    void    closed(IPC_Socket * socket)                 {}
+    void    dataReceived(const void * data, ssize_t size)
+    {
+        mBytes += size;
+        if (mEcho)
+            mEcho->send(data, size);
+    }
+
+    long long       mBytes;
+    IPC_Socket *    mEcho;
+};
+
+static const struct
+{
+    ESocketPacketsSize  mMode;
+    int                 mType;
+    const char *        mName;
+} cModes[] = {
+    { eSocketPacketsSize_Free,          SOCK_STREAM,    "free" },
+    { eSocketPacketsSize_Fixed,         SOCK_STREAM,    "fixed" },
+    { eSocketPacketsSize_Controlled,    SOCK_STREAM,    "controlled" },
+    { eSocketPacketsSize_Sequenced,     SOCK_SEQPACKET, "sequenced" }
+};
+
+static bool sEchoing;
+
+static void * echo(void * data)
+{
+    BenchSocket * socket = (BenchSocket *) data;
+    while (sEchoing)
+    {
+        struct pollfd readable = { socket->fd(), POLLIN, 0 };
+        if (poll(&readable, 1, 10) > 0)
+            socket->receive();
+    }
+    return NULL;
+}
+
+// frames/s by bursts of 64, & round trip time of a frame, for each mode
+static void benchModes(int frames)
+{
+    char payload[cPayloadSize];
+    memset(payload, 'x', sizeof(payload));
+    printf("modes, %d bytes frames:\n", cPayloadSize);
+
+    for (size_t m = 0; m < sizeof(cModes) / sizeof(cModes[0]); m++)
+    {
+        int fds[2];
+        if (socketpair(AF_UNIX, cModes[m].mType, 0, fds) != 0)
+            continue;
+        BenchSocket sender, receiver;
+        sender.attach(fds[0], cModes[m].mMode, cPayloadSize);
+        receiver.attach(fds[1], cModes[m].mMode, cPayloadSize);
+        ByteCounter received;
+        receiver.setCallbacks(&received);
+
+        double start = now();
+        for (int sent = 0; sent < frames; )
+        {
+            for (int i = 0; i < 64 && sent < frames; i++, sent++)
+                sender.send(payload, sizeof(payload));
+            sender.drain();
+            while (received.mBytes < (long long) sent * (long long) sizeof(payload))
+                receiver.receive();
+        }
+        double throughput = frames / (now() - start);
+
+        // round trips through a thread that echoes the frames
+        ByteCounter echoed(&receiver);
+        receiver.setCallbacks(&echoed);
+        ByteCounter back;
+        sender.setCallbacks(&back);
+        sEchoing = true;
+        pthread_t thread;
+        pthread_create(&thread, NULL, echo, &receiver);
+        int trips = frames / 10;
+        start = now();
+        for (int i = 0; i < trips; i++)
+        {
+            sender.send(payload, sizeof(payload));
+            while (back.mBytes < (long long) (i + 1) * (long long) sizeof(payload))
+            {
+                struct pollfd readable = { fds[0], POLLIN, 0 };
+                poll(&readable, 1, 100);
+                sender.receive();
+            }
+        }
+        double roundTrip = (now() - start) / trips;
+        sEchoing = false;
+        pthread_join(thread, NULL);
+
+        EXPECT(received.mBytes == (long long) frames * (long long) sizeof(payload) &&
+               back.mBytes == (long long) trips * (long long) sizeof(payload),
+               "%s: bytes lost", cModes[m].mName);
+        printf("  %-10s: %8.0f frames/s, %5.1f us round trip\n",
+               cModes[m].mName, throughput, roundTrip * 1e6);
+    }
+}
+
+struct Reader
+{
+    int     mFD;
+    int     mExpected;
+    int     mFrames;
+    int     mErrors;
+};
+
+// read frames as IPC_Socket::receiveData would, checking them
+static void * readFrames(void * data)
+{
+    Reader * reader = (Reader *) data;
+    static char buffer[64 * 1024];
+    size_t used = 0;
+    while (reader->mFrames < reader->mExpected)
+    {
+        ssize_t bytes = recv(reader->mFD, buffer + used, sizeof(buffer) - used, 0);
+        if (bytes <= 0)
+            break;
+        used += bytes;
+        size_t offset = 0;
+        while (used - offset >= sizeof(IPC_Header))
+        {
+            IPC_Header header;
+            memcpy(&header, buffer + offset, sizeof(header));
+            if (header.mMagic != cMagicSignature || header.mSize <= 0 ||
+                header.mSize > (ssize_t) (sizeof(buffer) - sizeof(header)))
+            {
+                reader->mErrors++;
+                return NULL;
+            }
+            if (used - offset < sizeof(header) + header.mSize)
+                break;
+            const unsigned char * payload = (const unsigned char *) buffer + offset + sizeof(header);
+            if (payload[0] != (unsigned char) reader->mFrames ||
+                payload[header.mSize - 1] != (unsigned char) reader->mFrames)
+                reader->mErrors++;
+            reader->mFrames++;
+            offset += sizeof(header) + header.mSize;
+        }
+        memmove(buffer, buffer + offset, used - offset);
+        used -= offset;
+    }
+    return NULL;
+}
+
+// how IPC_Socket::send used to send a frame: a system call per segment
+static bool legacySend(int fd, const void * data, ssize_t size)
+{
+    IPC_Header header(size);
+    return ::send(fd, &header, sizeof(header), 0) == sizeof(header) &&
+           ::send(fd, data, size, 0) == size;
+}
+
+static double run(bool gathered, int frames, int payloadSize, int sendBufferSize)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        return 0;
+    if (sendBufferSize > 0)
+        setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sendBufferSize, sizeof(sendBufferSize));
+
+    BenchSocket socket;
+    socket.attach(fds[0]);
+    Reader reader = { fds[1], frames, 0, 0 };
+    pthread_t thread;
+    pthread_create(&thread, NULL, readFrames, &reader);
+
+    char payload[4096];
+    double start = now();
+    for (int i = 0; i < frames; i++)
+    {
+        memset(payload, (unsigned char) i, payloadSize);
+        // wait like the blocking sends do, rather than let frames pile up
+        // in the queue & go by big chunks
+        socket.drain();
+        bool sent = gathered ? socket.send(payload, payloadSize) : legacySend(fds[0], payload, payloadSize);
+        EXPECT(sent, "frame %d not sent", i);
+        if (!sent)
+            break;
+    }
+    socket.drain();
+    pthread_join(thread, NULL);
+    double elapsed = now() - start;
+    close(fds[1]);
+
+    EXPECT(reader.mFrames == frames && reader.mErrors == 0,
+           "%s: %d frames of %d received, %d errors", gathered ? "sendmsg" : "send",
+           reader.mFrames, frames, reader.mErrors);
+    return elapsed;
+}
+
+int main(int argc, char ** argv)
+{
+    // small socket buffer & big frames: sendmsg often sends part of a frame
+    run(true, 20000, 3000, 4096);
+
+    double legacy = run(false, cFrames, cPayloadSize, 0);
+    double gathered = run(true, cFrames, cPayloadSize, 0);
+    printf("%d frames of %d bytes:\n", cFrames, cPayloadSize);
+    printf("  send per segment: %.0f frames/s\n", cFrames / legacy);
+    printf("  sendmsg:          %.0f frames/s (x%.2f)\n", cFrames / gathered, legacy / gathered);
+
+    checkReceive();
+    printf("receive:\n");
+    benchReceive(cFrames, 1);
+    benchReceive(cFrames, 64);
+
+    benchModes(cFrames);
+
+    printf("ipc socket: %s\n", sFailures ? "FAILED" : "OK");
+    return sFailures ? 1 : 0;
+}
@@ -0,0 +1,265 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Checks transactions on shared properties: listeners notified once, after
+// all the values changed. A forked client reading the values while the
+// server changes them together never sees some changed & not the others.
+// A client transaction reaches the server in one message, & the server's
+// reach the client as one batch.
+
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+
+#include "IPC_Property.hpp"
+#include "testUtils.h"
+
+static const int cTransactions = 20000;
+
+// like the call state of the audiod properties
+template <template <class> class Property> class TestProperties : public IPC_SharedProperties
+{
+public:
+    static const bool cIsServerNotClient = Property<bool>::cIsServerNotClient;
+
+    Property<int>       mPhoneStatus;
+    Property<int>       mHeadsetState;
+    Property<bool>      mRingerOn;
+
+protected:
+    TestProperties(const std::string & name) : IPC_SharedProperties(name, sizeof(TestProperties))
+    {
+        mPhoneStatus.init(0);
+        mHeadsetState.init(0);
+        mRingerOn.init(false);
+    }
+    friend class IPC_SharedProperties;
+};
+
+typedef TestProperties<IPC_ServerProperty>  ServerProperties;
+typedef TestProperties<IPC_ClientProperty>  ClientProperties;
+
+// counts notifications & checks the values are consistent when they come
+template <class Properties> struct Listener
+{
+    Listener(Properties & properties) : mProperties(properties), mCalls(0), mInconsistent(0),
+                                        mTransactions(0), mChanges(0) {}
+
+    void    changed(int)
+    {
+        mCalls++;
+        if (mProperties.mPhoneStatus.get() != mProperties.mHeadsetState.get())
+            mInconsistent++;
+    }
+    void    transaction(const IPC_PropertyID * ids, size_t count)
+    {
+        mTransactions++;
+        mChanges = count;
+    }
+    void    listen()
+    {
+        mProperties.mPhoneStatus.sendChanges(boost::bind(&Listener::changed, this, _1));
+        mProperties.mHeadsetState.sendChanges(boost::bind(&Listener::changed, this, _1));
+        mProperties.sendTransactions(boost::bind(&Listener::transaction, this, _1, _2));
+    }
+
+    Properties &    mProperties;
+    int             mCalls;
+    int             mInconsistent;
+    int             mTransactions;
+    size_t          mChanges;
+};
+
+static void setCallState(ServerProperties & server, int state)
+{
+    IPC_Transaction transaction(server);
+    server.mPhoneStatus.set(state);
+    server.mHeadsetState.set(state);
+    server.mRingerOn.set(state % 2 != 0);
+}
+
+template <class Condition> static bool runUntil(Condition condition)
+{
+    for (int i = 0; i < 50 && !condition(); i++)
+        g_main_context_iteration(NULL, TRUE);
+    return condition();
+}
+
+// reads the call state as fast as it can while the server changes it
+static int readCallStates(ClientProperties & client)
+{
+    int inconsistent = 0, reads = 0, state = 0;
+    while (state != cTransactions)
+    {
+        guint32 seen = client.getChangeCount();
+        int headset = 0;
+        bool ringer = false;
+        if (!client.readTransaction([&] {
+                state = client.mPhoneStatus.get();
+                headset = client.mHeadsetState.get();
+                ringer = client.mRingerOn.get(); }))
+            return 1;
+        reads++;
+        if (headset != state || ringer != (state % 2 != 0))
+            inconsistent++;
+        if (state != cTransactions && !client.waitForChanges(seen, 1000))
+            return 1;
+    }
+    printf("  client: %d reads, %d inconsistent\n", reads, inconsistent);
+    fflush(stdout);
+    return inconsistent ? 1 : 0;
+}
+
+// one transaction to the server, then waits for one from the server
+static int exchangeTransactions(ClientProperties & client)
+{
+    Listener<ClientProperties> listener(client);
+    listener.listen();
+    {
+        IPC_Transaction transaction(client);
+        client.mPhoneStatus.set(-1);
+        client.mHeadsetState.set(-1);
+        client.mRingerOn.set(true);
+    }
+    // its own changes come back, then the server's
+    bool received = runUntil([&] { return listener.mTransactions == 2 &&
+                                          client.mPhoneStatus.get() == -2; });
+    if (!received || listener.mChanges != 2 ||
+        listener.mInconsistent != 0)
+    {
+        printf("  client: %d batches of %d changes, %d inconsistent\n", listener.mTransactions,
+               (int) listener.mChanges, listener.mInconsistent);
+        fflush(stdout);
+        return 1;
+    }
+    return 0;
+}
+
+// forked before the server exists, so that it doesn't inherit its sockets
+// & main loop sources. Runs once started.
+static pid_t forkClient(const char * name, int (*run)(ClientProperties &), int & start)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+        return -1;
+    pid_t child = fork();
+    if (child == 0)
+    {
+        close(fds[1]);
+        char go;
+        if (read(fds[0], &go, 1) != 1)
+            _exit(1);
+        ClientProperties * client =
+                     IPC_SharedProperties::createSharedProperties<ClientProperties>(name);
+        _exit(client ? run(*client) : 1);
+    }
+    close(fds[0]);
+    start = fds[1];
+    return child;
+}
+
+static void startClient(int start)
+{
+    char go = 1;
+    if (write(start, &go, 1) != 1)
+        perror("write");
+    close(start);
+}
+
+static bool waitClient(pid_t child)
+{
+    int status = 0;
+    return child > 0 && waitpid(child, &status, 0) == child &&
+           WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char ** argv)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "Audiod-Transaction-Test-%d", (int) getpid());
+    int startReader, startExchanger;
+    pid_t reader = forkClient(name, readCallStates, startReader);
+    pid_t exchanger = forkClient(name, exchangeTransactions, startExchanger);
+
+    ServerProperties * server =
+                     IPC_SharedProperties::createSharedProperties<ServerProperties>(name);
+    if (!server)
+        return 1;
+
+    // listeners are notified once, when everything changed
+    Listener<ServerProperties> listener(*server);
+    listener.listen();
+    guint32 changes = server->getChangeCount();
+    {
+        IPC_Transaction transaction(*server);
+        server->mPhoneStatus.set(1);
+        {
+            IPC_Transaction nested(*server);
+            server->mHeadsetState.set(2);
+            server->mHeadsetState.set(1);
+        }
+        EXPECT(listener.mCalls == 0, "listeners called during the transaction");
+        EXPECT(server->getChangeCount() == changes, "change published during the transaction");
+        server->mRingerOn.set(true);
+    }
+    EXPECT(listener.mCalls == 2 && listener.mInconsistent == 0,
+           "%d listener calls, %d inconsistent", listener.mCalls, listener.mInconsistent);
+    EXPECT(listener.mTransactions == 1 && listener.mChanges == 3,
+           "%d batches of %d changes", listener.mTransactions, (int) listener.mChanges);
+    EXPECT(server->getChangeCount() == changes + 1, "changes published %u times",
+           server->getChangeCount() - changes);
+    EXPECT(server->mPhoneStatus.getGeneration() == 2 && server->mHeadsetState.getGeneration() == 3,
+           "generations %u & %u", server->mPhoneStatus.getGeneration(),
+           server->mHeadsetState.getGeneration());
+
+    // a client process reading while the server changes the values
+    printf("%d transactions:\n", cTransactions);
+    fflush(stdout);
+    setCallState(*server, 0);
+    startClient(startReader);
+    usleep(10000);
+    for (int state = 1; state <= cTransactions; state++)
+        setCallState(*server, state);
+    EXPECT(waitClient(reader), "client saw inconsistent values");
+
+    // transactions both ways
+    listener.mTransactions = 0;
+    startClient(startExchanger);
+    EXPECT(runUntil([&] { return server->mPhoneStatus.get() == -1; }) &&
+           server->mHeadsetState.get() == -1 && server->mRingerOn.get(),
+           "client transaction not applied");
+    EXPECT(listener.mTransactions == 1 && listener.mChanges == 3,
+           "client transaction: %d batches of %d changes", listener.mTransactions,
+           (int) listener.mChanges);
+    setCallState(*server, -2);
+    int status = 0;
+    pid_t done = 0;
+    runUntil([&] {
+        if (done == 0)
+            done = waitpid(exchanger, &status, WNOHANG);
+        return done != 0; });
+    EXPECT(done == exchanger && WIFEXITED(status) && WEXITSTATUS(status) == 0,
+           "client didn't get the server transaction");
+
+    boost::interprocess::shared_memory_object::remove(name);
+    boost::interprocess::shared_memory_object::remove(
+                                IPC_SharedProperties::changesName(name).c_str());
+
+    printf("ipc transactions: %s\n", sFailures ? "FAILED" : "OK");
+    return sFailures ? 1 : 0;
+}
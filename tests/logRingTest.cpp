@@ -0,0 +1,170 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+// Exercises the log ring: multi-part & multi-slot records, truncation, drops
+// when full, and several producer threads against one consumer.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <atomic>
+#include <string>
+
+#include "LogRing.h"
+#include "testUtils.h"
+
+static bool pushString(LogRing & ring, unsigned char tag, const std::string & text)
+{
+    struct iovec part = { (void *) text.data(), text.size() };
+    return ring.push(tag, &part, 1);
+}
+
+static const int cProducers = 4;
+static const int cRecordsPerProducer = 20000;
+
+struct Producer
+{
+    LogRing *   mRing;
+    int         mIndex;
+    int         mDropped;
+    std::atomic<bool> mFinished;
+};
+
+static void * produce(void * data)
+{
+    Producer * producer = (Producer *) data;
+    char buffer[600];
+    for (int i = 0; i < cRecordsPerProducer; i++)
+    {
+        // variable sizes, so that records span 1 to 3 slots
+        int length = snprintf(buffer, sizeof(buffer), "%d %d ", producer->mIndex, i);
+        int padding = (i * 37) % 500;
+        memset(buffer + length, 'a' + producer->mIndex, padding);
+        struct iovec parts[2] = { { buffer, (size_t) length }, { buffer + length, (size_t) padding } };
+        if (!producer->mRing->push(producer->mIndex, parts, 2))
+            producer->mDropped++;
+    }
+    producer->mFinished = true;
+    return NULL;
+}
+
+int main(int argc, char ** argv)
+{
+    {
+        LogRing ring(8);
+        unsigned char tag = 0;
+        std::string record;
+        EXPECT(ring.empty() && !ring.pop(tag, record), "new ring not empty");
+
+        struct iovec parts[3] = { { (void *) "12:00 ", 6 }, { (void *) "| ", 2 }, { (void *) "hello\n", 6 } };
+        EXPECT(ring.push('m', parts, 3), "push failed");
+        EXPECT(ring.pop(tag, record) && tag == 'm' && record == "12:00 | hello\n", "wrong record '%s'", record.c_str());
+        EXPECT(ring.empty(), "ring not empty after pop");
+
+        // a record over several slots
+        std::string big(LogRing::cSlotDataSize * 2 + 17, 'x');
+        big[0] = '<';
+        big[big.size() - 1] = '>';
+        EXPECT(pushString(ring, 'd', big), "big push failed");
+        EXPECT(ring.pop(tag, record) && record == big, "big record damaged (%zu bytes)", record.size());
+
+        // records are truncated to half the ring at most
+        std::string huge(LogRing::cSlotDataSize * 6, 'y');
+        EXPECT(pushString(ring, 'd', huge), "huge push failed");
+        EXPECT(ring.pop(tag, record) && record.size() == LogRing::cSlotDataSize * 4, "huge record not truncated: %zu", record.size());
+
+        // full ring: drops are counted, nothing is overwritten
+        int pushed = 0;
+        while (pushString(ring, 'i', std::string(1, 'a' + pushed)))
+            pushed++;
+        EXPECT(pushed == 8, "ring of 8 took %d records", pushed);
+        EXPECT(!pushString(ring, 'i', "more") && ring.takeDropped() == 2, "drops not counted");
+        EXPECT(ring.takeDropped() == 0, "drop count not reset");
+        EXPECT(ring.pop(tag, record) && record == "a", "oldest record lost: '%s'", record.c_str());
+        EXPECT(pushString(ring, 'i', "z"), "no room after pop");
+        for (int i = 1; i < 8; i++)
+            ring.pop(tag, record);
+        EXPECT(ring.pop(tag, record) && record == "z" && ring.empty(), "wrong order after wrapping");
+    }
+
+    // concurrent producers: every record comes out whole, in each producer's order
+    {
+        LogRing ring(256);
+        Producer producers[cProducers];
+        pthread_t threads[cProducers];
+        for (int p = 0; p < cProducers; p++)
+        {
+            producers[p].mRing = &ring;
+            producers[p].mIndex = p;
+            producers[p].mDropped = 0;
+            producers[p].mFinished = false;
+            pthread_create(&threads[p], NULL, produce, &producers[p]);
+        }
+
+        int received[cProducers] = { 0 };
+        int last[cProducers];
+        for (int p = 0; p < cProducers; p++)
+            last[p] = -1;
+        int running = cProducers;
+        bool joined[cProducers] = { false };
+        unsigned char tag;
+        std::string record;
+        while (running > 0 || !ring.empty())
+        {
+            if (!ring.pop(tag, record))
+            {
+                for (int p = 0; p < cProducers; p++)
+                {
+                    if (!joined[p] && producers[p].mFinished)
+                    {
+                        pthread_join(threads[p], NULL);
+                        joined[p] = true;
+                        running--;
+                    }
+                }
+                continue;
+            }
+            int producer = -1, index = -1, offset = 0;
+            sscanf(record.c_str(), "%d %d %n", &producer, &index, &offset);
+            if (producer < 0 || producer >= cProducers || tag != producer)
+            {
+                EXPECT(false, "garbled record '%.40s'", record.c_str());
+                break;
+            }
+            size_t padding = (index * 37) % 500;
+            EXPECT(record.size() == offset + padding &&
+                   record.find_first_not_of((char) ('a' + producer), offset) == std::string::npos,
+                   "damaged record %d/%d", producer, index);
+            EXPECT(index > last[producer], "out of order: %d after %d", index, last[producer]);
+            last[producer] = index;
+            received[producer]++;
+        }
+
+        int total = 0, dropped = 0;
+        for (int p = 0; p < cProducers; p++)
+        {
+            total += received[p];
+            dropped += producers[p].mDropped;
+        }
+        EXPECT(total + dropped == cProducers * cRecordsPerProducer, "records lost: %d + %d", total, dropped);
+        EXPECT((int) ring.takeDropped() == dropped, "drop counter differs");
+    }
+
+    printf("log ring: %s\n", sFailures ? "FAILED" : "OK");
+    return sFailures ? 1 : 0;
+}
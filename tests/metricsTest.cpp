@@ -0,0 +1,98 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+// Exercises the metrics: histogram buckets, updates from several threads,
+// and the report & summary of the registry.
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <string>
+
+#include "Metrics.h"
+#include "testUtils.h"
+
+static MetricsCounter   sCounter("test.counter");
+static MetricsGauge     sGauge("test.gauge");
+static MetricsHistogram sHistogram("test.latency");
+
+static const int cThreads = 4;
+static const int cUpdatesPerThread = 100000;
+
+static void * update(void * data)
+{
+    for (int i = 0; i < cUpdatesPerThread; i++)
+    {
+        sCounter.add();
+        sGauge.add(1);
+        sHistogram.record(i % 200);
+    }
+    return NULL;
+}
+
+int main(int argc, char ** argv)
+{
+    {
+        MetricsHistogram histogram("test.buckets");
+        histogram.record(0);
+        histogram.record(50);       // bounds are inclusive
+        histogram.record(51);
+        histogram.record(1000000);
+        histogram.record(100000000);
+        EXPECT(histogram.getBucket(0) == 2, "bucket 0: %llu", (unsigned long long) histogram.getBucket(0));
+        EXPECT(histogram.getBucket(1) == 1, "bucket 1: %llu", (unsigned long long) histogram.getBucket(1));
+        EXPECT(histogram.getBucket(13) == 1, "bucket 13: %llu", (unsigned long long) histogram.getBucket(13));
+        EXPECT(histogram.getBucket(MetricsHistogram::cBucketCount - 1) == 1, "overflow bucket not used");
+        EXPECT(histogram.getCount() == 5 && histogram.getMax() == 100000000, "wrong count or max");
+        EXPECT(histogram.getSum() == 0 + 50 + 51 + 1000000 + 100000000, "wrong sum");
+        EXPECT(Metrics::report().find("\"test.buckets\"") != std::string::npos, "local histogram not reported");
+    }
+    EXPECT(Metrics::report().find("\"test.buckets\"") == std::string::npos, "destroyed histogram still reported");
+
+    pthread_t threads[cThreads];
+    for (int t = 0; t < cThreads; t++)
+        pthread_create(&threads[t], NULL, update, NULL);
+    for (int t = 0; t < cThreads; t++)
+        pthread_join(threads[t], NULL);
+    sGauge.add(-10);
+
+    EXPECT(sCounter.get() == cThreads * cUpdatesPerThread, "counter lost updates: %llu",
+           (unsigned long long) sCounter.get());
+    EXPECT(sGauge.get() == cThreads * cUpdatesPerThread - 10, "gauge lost updates");
+    EXPECT(sHistogram.getCount() == cThreads * cUpdatesPerThread && sHistogram.getMax() == 199,
+           "histogram lost updates");
+
+    std::string report = Metrics::report();
+    EXPECT(report.find("\"counters\": { \"test.counter\": 400000 }") != std::string::npos,
+           "counter not reported: %s", report.c_str());
+    EXPECT(report.find("\"gauges\": { \"test.gauge\": 399990 }") != std::string::npos,
+           "gauge not reported: %s", report.c_str());
+    EXPECT(report.find("\"test.latency\": { \"count\": 400000, ") != std::string::npos,
+           "histogram not reported: %s", report.c_str());
+
+    {
+        MetricsTimer timer(sHistogram);
+    }
+    EXPECT(sHistogram.getCount() == cThreads * cUpdatesPerThread + 1, "timer not recorded");
+
+    std::string summary = Metrics::summary();
+    EXPECT(summary.find("test.counter: 400000\n") != std::string::npos, "summary: %s", summary.c_str());
+    EXPECT(summary.find("test.latency: 400001, avg ") != std::string::npos, "summary: %s", summary.c_str());
+
+    printf("metrics: %s\n", sFailures ? "FAILED" : "OK");
+    return sFailures ? 1 : 0;
+}
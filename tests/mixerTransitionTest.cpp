@@ -0,0 +1,293 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+// Plays scenario transitions against a mock of the pulse policy socket and
+// checks that no sink ever drops to zero volume unless the test expects it to
+// fade out because it moves while audible, that audible sinks are silent when
+// they move, that volumes programmed after the transition wait for the move,
+// and that the call tone is never faded.
+// The commands are those MixerTransition::program sends to the mixer, with
+// fades & deferred moves run through a RampScheduler on a fake clock, like
+// PulseAudioMixer does. Pulse ramps take RampScheduler::cStepMs to complete.
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "MixerTransition.h"
+#include "testUtils.h"
+
+/// What pulse would have, as far as the policy commands are concerned
+struct MockPolicy
+{
+    int         mVolume[eVirtualSink_Count];
+    uint64_t    mRampEnd[eVirtualSink_Count];   ///< when mVolume is reached
+    int         mRoute[eVirtualSink_Count];
+    bool        mActive[eVirtualSink_Count];
+    bool        mFadeExpected[eVirtualSink_Count];
+    bool        mMoved[eVirtualSink_Count];
+    int         mCommands;
+};
+
+static void sendCommand(int fd, char cmd, int sink, int value)
+{
+    // same formatting as PulseAudioMixer::programSource
+    char buffer[SIZE_MESG_TO_PULSE];
+    memset(buffer, 0, sizeof(buffer));
+    snprintf(buffer, sizeof(buffer), "%c %i %i %i", cmd, sink, value, 0);
+    if (send(fd, buffer, SIZE_MESG_TO_PULSE, MSG_DONTWAIT) != SIZE_MESG_TO_PULSE)
+        perror("send");
+}
+
+/// Pulse gets the commands sent at 'now'
+static void receiveCommands(int fd, MockPolicy & pulse, uint64_t now)
+{
+    char buffer[SIZE_MESG_TO_PULSE];
+    while (recv(fd, buffer, SIZE_MESG_TO_PULSE, MSG_DONTWAIT) == SIZE_MESG_TO_PULSE)
+    {
+        char cmd;
+        int sink, value;
+        if (sscanf(buffer, "%c %i %i", &cmd, &sink, &value) != 3 ||
+            sink < eVirtualSink_First || sink > eVirtualSink_Last)
+        {
+            EXPECT(false, "malformed command '%s'", buffer);
+            continue;
+        }
+        pulse.mCommands++;
+        switch (cmd)
+        {
+        case 'v':
+        case 'r':
+            EXPECT(value > 0 || pulse.mFadeExpected[sink], "sink %d muted needlessly", sink);
+            EXPECT(value == 0 || !pulse.mFadeExpected[sink] || pulse.mMoved[sink],
+                   "sink %d back up to %d at %d ms, before it moved", sink, value, (int) now);
+            pulse.mVolume[sink] = value;
+            pulse.mRampEnd[sink] = now + (cmd == 'r' ? RampScheduler::cStepMs : 0);
+            break;
+        case 'd':
+            EXPECT(!pulse.mActive[sink] || pulse.mVolume[sink] <= 0 || sink == ecallertone,
+                   "sink %d moved while audible", sink);
+            // nothing moves until every fade out is over
+            for (int faded = eVirtualSink_First; faded <= eVirtualSink_Last; faded++)
+                EXPECT(!pulse.mFadeExpected[faded] || pulse.mMoved[faded] ||
+                       pulse.mRampEnd[faded] <= now,
+                       "sink %d moved at %d ms, while sink %d fades out until %d ms", sink,
+                       (int) now, faded, (int) pulse.mRampEnd[faded]);
+            pulse.mRoute[sink] = value;
+            pulse.mMoved[sink] = true;
+            break;
+        default:
+            EXPECT(false, "unexpected command '%c'", cmd);
+        }
+    }
+}
+
+/// The mixer as the transition sees it, like PulseAudioMixer: fades are cut in
+/// Pulse ramps by a RampScheduler, deferred moves & the volumes programmed
+/// meanwhile wait on its timeline, driven here by a fake clock
+class MockMixer : public MixerTransition::Output
+{
+public:
+    MockMixer(int fds[2], MockPolicy & pulse) : mFds(fds), mPulse(pulse), mNow(0) {}
+
+    bool    fadeVolume(EVirtualSink sink, int endVolume, int durationMs, ERampCurve curve)
+    {
+        if (mRamps.holdVolume(sink, endVolume))
+            return true;
+        int from = mPulse.mVolume[sink] > 0 ? mPulse.mVolume[sink] : 0;
+        mRamps.start(sink, from, endVolume, durationMs, curve, mNow);
+        runRamps();
+        return true;
+    }
+
+    bool    programDestination(EVirtualSink sink, EPhysicalSink destination)
+    {
+        if (mRamps.pendingMove(sink) >= 0)
+            mRamps.deferMove(sink, destination, 0);
+        else
+            send('d', sink, destination);
+        return true;
+    }
+
+    bool    deferDestination(EVirtualSink sink, EPhysicalSink destination, int afterMs)
+    {
+        mRamps.deferMove(sink, destination, mNow + afterMs);
+        runRamps();
+        return true;
+    }
+
+    /// The regular volume programming
+    void    programVolume(EVirtualSink sink, int volume)
+    {
+        if (mRamps.holdVolume(sink, volume))
+            return;
+        mRamps.cancel(sink);
+        send('r', sink, volume);
+    }
+
+    /// Fire the ramp timer at each deadline, until nothing is left
+    void    runTimers()
+    {
+        int64_t deadline;
+        while ((deadline = mRamps.nextDeadline()) >= 0)
+        {
+            if ((uint64_t) deadline > mNow)
+                mNow = deadline;
+            runRamps();
+        }
+    }
+
+    uint64_t    now() const     { return mNow; }
+
+private:
+    void    send(char cmd, int sink, int value)
+    {
+        // like programSource, what pulse already has isn't sent again
+        if ((cmd == 'd' && mPulse.mRoute[sink] == value) ||
+            (cmd == 'r' && mPulse.mVolume[sink] == value))
+            return;
+        sendCommand(mFds[0], cmd, sink, value);
+        receiveCommands(mFds[1], mPulse, mNow);
+    }
+
+    void    runRamps()
+    {
+        std::vector<RampScheduler::Command> commands;
+        mRamps.advance(mNow, commands);
+        for (size_t i = 0; i < commands.size(); i++)
+            send('r', commands[i].mSink, commands[i].mVolume);
+
+        std::vector<RampScheduler::Move> moves;
+        mRamps.takeMoves(mNow, moves);
+        for (size_t i = 0; i < moves.size(); i++)
+        {
+            send('d', moves[i].mSink, moves[i].mDestination);
+            if (moves[i].mVolume >= 0)
+                programVolume(moves[i].mSink, moves[i].mVolume);
+        }
+    }
+
+    int *           mFds;
+    MockPolicy &    mPulse;
+    RampScheduler   mRamps;
+    uint64_t        mNow;
+};
+
+/// Run one transition from the mock's current state to the targets given,
+/// then program the routes & volumes again like programSoftwareMixer does.
+/// Only the sinks listed in faded may drop to zero.
+static void runTransition(int fds[2], MockPolicy & pulse, const int * targets, int volume,
+                          const EVirtualSink * faded = 0, int fadedCount = 0)
+{
+    MixerTransition transition;
+    for (int sink = eVirtualSink_First; sink <= eVirtualSink_Last; sink++)
+    {
+        transition.setCurrent(EVirtualSink(sink), pulse.mRoute[sink], pulse.mVolume[sink], pulse.mActive[sink]);
+        transition.setTarget(EVirtualSink(sink), targets[sink]);
+        pulse.mFadeExpected[sink] = false;
+        pulse.mMoved[sink] = false;
+        pulse.mRampEnd[sink] = 0;
+    }
+    for (int i = 0; i < fadedCount; i++)
+        pulse.mFadeExpected[faded[i]] = true;
+
+    MockMixer mixer(fds, pulse);
+    transition.program(mixer);
+
+    // right away, while the fades run
+    for (int sink = eVirtualSink_First; sink <= eVirtualSink_Last; sink++)
+    {
+        if (pulse.mActive[sink] && pulse.mVolume[sink] != volume)
+            mixer.programVolume(EVirtualSink(sink), volume);
+        if (targets[sink] >= 0)
+            mixer.programDestination(EVirtualSink(sink), EPhysicalSink(targets[sink]));
+    }
+    mixer.runTimers();
+
+    for (int sink = eVirtualSink_First; sink <= eVirtualSink_Last; sink++)
+    {
+        EXPECT(targets[sink] < 0 || pulse.mRoute[sink] == targets[sink],
+               "sink %d on %d instead of %d", sink, pulse.mRoute[sink], targets[sink]);
+        EXPECT(pulse.mMoved[sink] == (targets[sink] >= 0 && transition.isMoving(EVirtualSink(sink))),
+               "sink %d moved: %d", sink, pulse.mMoved[sink]);
+        EXPECT(!pulse.mActive[sink] || pulse.mVolume[sink] == volume,
+               "sink %d volume %d after the transition", sink, pulse.mVolume[sink]);
+    }
+    EXPECT(fadedCount == 0 || mixer.now() >= (uint64_t) MixerTransition::cFadeOutMs,
+           "transition over at %d ms", (int) mixer.now());
+}
+
+int main(int argc, char ** argv)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) < 0)
+    {
+        perror("socketpair");
+        return 1;
+    }
+
+    MockPolicy pulse;
+    memset(&pulse, 0, sizeof(pulse));
+    int targets[eVirtualSink_Count];
+    for (int sink = eVirtualSink_First; sink <= eVirtualSink_Last; sink++)
+    {
+        pulse.mRoute[sink] = eMainSink;
+        pulse.mVolume[sink] = 60;
+        targets[sink] = eMainSink;
+    }
+    pulse.mActive[emedia] = true;
+    pulse.mActive[eeffects] = true;
+    pulse.mActive[ecallertone] = true;
+
+    // Headset plugged in: the routes don't change, nothing may be touched
+    runTransition(fds, pulse, targets, 60);
+    EXPECT(pulse.mCommands == 0, "%d commands sent for an identical routing", pulse.mCommands);
+    EXPECT(pulse.mVolume[emedia] == 60, "media volume changed to %d", pulse.mVolume[emedia]);
+
+    // Switch to A2DP: media moves while playing, defaultapp moves while idle,
+    // the call tone moves while playing but is never faded
+    targets[emedia] = eA2DPSink;
+    targets[edefaultapp] = eA2DPSink;
+    targets[ecallertone] = eA2DPSink;
+    const EVirtualSink media[] = { emedia };
+    runTransition(fds, pulse, targets, 60, media, 1);
+    EXPECT(pulse.mVolume[edefaultapp] == 60, "idle defaultapp muted");
+    EXPECT(pulse.mVolume[eeffects] == 60, "effects muted although not moving");
+    EXPECT(pulse.mVolume[ecallertone] == 60, "call tone faded");
+
+    // Back, with some sinks left untouched by the new scenario
+    targets[emedia] = eMainSink;
+    targets[edefaultapp] = -1;
+    runTransition(fds, pulse, targets, 60, media, 1);
+    EXPECT(pulse.mRoute[edefaultapp] == eA2DPSink, "untargeted sink moved");
+
+    // Unknown current routing (right after connecting to pulse): everything moves
+    for (int sink = eVirtualSink_First; sink <= eVirtualSink_Last; sink++)
+    {
+        pulse.mRoute[sink] = -1;
+        pulse.mVolume[sink] = -1;
+        targets[sink] = eMainSink;
+    }
+    runTransition(fds, pulse, targets, 60);
+
+    close(fds[0]);
+    close(fds[1]);
+
+    printf("mixer transitions: %s\n", sFailures ? "FAILED" : "OK");
+    return sFailures ? 1 : 0;
+}
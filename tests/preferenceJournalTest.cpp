@@ -0,0 +1,356 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+// Exercises the preference journal in a temporary directory: replay after
+// reopening, torn records left by a crash, compaction & value encoding, and
+// checks that loading the binary snapshot gives the same values as replaying
+// the journal they came from, and that preferences restored from luna-prefs
+// JSON end up the same as from the journal or its snapshot.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "PreferenceJournal.h"
+#include "PreferenceTables.h"
+#include "messageUtils.h"
+#include "testUtils.h"
+
+static off_t fileSize(const std::string & path)
+{
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? info.st_size : -1;
+}
+
+static void writeAt(const std::string & path, off_t offset, const void * data, size_t size)
+{
+    int fd = open(path.c_str(), O_WRONLY);
+    if (fd >= 0)
+    {
+        if (pwrite(fd, data, size, offset) < 0)
+            perror("pwrite");
+        close(fd);
+    }
+}
+
+static void appendRaw(const std::string & path, const char * data)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_APPEND);
+    if (fd >= 0)
+    {
+        if (write(fd, data, strlen(data)) < 0)
+            perror("write");
+        close(fd);
+    }
+}
+
+/// Preferences as State declares them, with their defaults
+struct Preferences
+{
+    Preferences()
+    {
+        mBooleans["RingerOn"].init(true);
+        mBooleans["DndOn"].init(false);
+        mBooleans["TouchOn"].init(true);
+        mStrings["Tricky"].init("");
+        mStrings["Empty"].init("not empty");
+        mIntegers["VolumeBalance"].init(0);
+        mIntegers["Big"].init(0);
+    }
+
+    bool restore(const std::string & name, const std::string & value)
+    {
+        return restorePreference(mBooleans, mStrings, mIntegers, name, value);
+    }
+
+    template <class T> static bool same(const std::map<std::string, PreferencePair<T> > & a,
+                                        const std::map<std::string, PreferencePair<T> > & b)
+    {
+        if (a.size() != b.size())
+            return false;
+        for (typename std::map<std::string, PreferencePair<T> >::const_iterator iter = a.begin(),
+                                       other = b.begin(); iter != a.end(); ++iter, ++other)
+            if (iter->first != other->first || iter->second.mValue != other->second.mValue)
+                return false;
+        return true;
+    }
+
+    bool operator==(const Preferences & other) const
+    {
+        return same(mBooleans, other.mBooleans) && same(mStrings, other.mStrings) &&
+               same(mIntegers, other.mIntegers);
+    }
+
+    TBooleanPreferences mBooleans;
+    TStringPreferences  mStrings;
+    TintPreferences     mIntegers;
+};
+
+/// What State::applyPreferences does with the 'state_preferences' JSON of luna-prefs
+static int restoreFromJson(Preferences & preferences, const std::string & json)
+{
+    int refused = 0;
+    JsonMessageParser msg(json.c_str(), SCHEMA_ANY);
+    EXPECT(msg.parse(__FUNCTION__), "can't parse %s", json.c_str());
+    pbnjson::JValue object = msg.get();
+    for (pbnjson::JValue::ObjectIterator pair = object.begin(); pair != object.end(); pair++)
+    {
+        std::string name, value;
+        if ((*pair).first.asString(name) != CONV_OK || !preferenceFromJson((*pair).second, value) ||
+                                                          !preferences.restore(name, value))
+            refused++;
+    }
+    return refused;
+}
+
+/// What State::applyJournaledPreferences does with the journal's "state/" values
+static int restoreFromJournal(Preferences & preferences, const PreferenceJournal & journal)
+{
+    int refused = 0;
+    const std::string prefix("state/");
+    const PreferenceJournal::Values & values = journal.values();
+    for (PreferenceJournal::Values::const_iterator iter = values.lower_bound(prefix);
+            iter != values.end() && iter->first.compare(0, prefix.size(), prefix) == 0; ++iter)
+        if (!preferences.restore(iter->first.substr(prefix.size()), iter->second))
+            refused++;
+    return refused;
+}
+
+/// The same changes, restored from luna-prefs JSON, from the journal & from its snapshot
+static void checkRestoreSources(const char * directory, const std::string & tricky)
+{
+    std::string journalPath = std::string(directory) + "/state.journal";
+    std::string snapshotPath = std::string(directory) + "/state.snapshot";
+
+    // stored the way State::exportPreferences & State::storePreferences store them
+    pbnjson::JValue object = pbnjson::Object();
+    PreferenceJournal journal(directory, "state");
+    journal.open();
+    object.put("RingerOn", false);
+    journal.set("state/RingerOn", PreferenceJournal::fromBool(false));
+    object.put("DndOn", true);
+    journal.set("state/DndOn", PreferenceJournal::fromBool(true));
+    object.put("Tricky", tricky);
+    journal.set("state/Tricky", PreferenceJournal::fromString(tricky));
+    object.put("Empty", std::string());
+    journal.set("state/Empty", PreferenceJournal::fromString(""));
+    object.put("VolumeBalance", -7);
+    journal.set("state/VolumeBalance", PreferenceJournal::fromInt(-7));
+    object.put("Big", 2147483647);
+    journal.set("state/Big", PreferenceJournal::fromInt(2147483647));
+    // unknown, or of the wrong type: refused either way
+    object.put("Unknown", 3);
+    journal.set("state/Unknown", PreferenceJournal::fromInt(3));
+    object.put("TouchOn", 1);
+    journal.set("state/TouchOn", PreferenceJournal::fromInt(1));
+    journal.flush();
+
+    Preferences fromJson;
+    std::string json = jsonToString(object);
+    EXPECT(restoreFromJson(fromJson, json) == 2, "JSON: wrong number of refused preferences");
+    EXPECT(!(fromJson == Preferences()), "nothing restored from %s", json.c_str());
+    EXPECT(fromJson.mIntegers["VolumeBalance"].mValue == -7 && fromJson.mStrings["Tricky"].mValue == tricky &&
+           fromJson.mBooleans["TouchOn"].mValue, "JSON values not restored as stored");
+
+    PreferenceJournal replayed(directory, "state");
+    EXPECT(replayed.open(), "journal not found");
+    Preferences fromJournal;
+    EXPECT(restoreFromJournal(fromJournal, replayed) == 2, "journal: wrong number of refused preferences");
+    EXPECT(fromJournal == fromJson, "journal replay restores differently from luna-prefs JSON");
+    EXPECT(replayed.compact(), "compaction failed");
+
+    PreferenceJournal mapped(directory, "state");
+    EXPECT(mapped.open() && !mapped.snapshotRejected() && fileSize(journalPath) == 0, "snapshot not loaded");
+    Preferences fromSnapshot;
+    EXPECT(restoreFromJournal(fromSnapshot, mapped) == 2, "snapshot: wrong number of refused preferences");
+    EXPECT(fromSnapshot == fromJson, "snapshot restores differently from luna-prefs JSON");
+
+    // what gets exported back to luna-prefs converts back to the same values
+    const PreferenceJournal::Values & values = mapped.values();
+    for (PreferenceJournal::Values::const_iterator iter = values.begin(); iter != values.end(); ++iter)
+    {
+        std::string value;
+        EXPECT(preferenceFromJson(preferenceToJson(iter->second), value) && value == iter->second,
+               "'%s' changes through JSON", iter->first.c_str());
+    }
+
+    unlink(journalPath.c_str());
+    unlink(snapshotPath.c_str());
+}
+
+int main(int argc, char ** argv)
+{
+    char directory[] = "/tmp/prefsjournalXXXXXX";
+    if (!mkdtemp(directory))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string journalPath = std::string(directory) + "/test.journal";
+    std::string snapshotPath = std::string(directory) + "/test.snapshot";
+    const std::string tricky("with spaces, \\back\\slashes\nand\ttabs");
+
+    {
+        PreferenceJournal journal(directory, "test");
+        EXPECT(!journal.open(), "empty directory reported existing preferences");
+        journal.set("state/RingerOn", PreferenceJournal::fromBool(false));
+        journal.set("state/VolumeBalance", PreferenceJournal::fromInt(-7));
+        journal.set("state/Tricky", PreferenceJournal::fromString(tricky));
+        journal.set("media/media_back_speaker_volume", PreferenceJournal::fromInt(50));
+        EXPECT(fileSize(journalPath) == 0, "written before flush");
+        EXPECT(journal.flush(), "flush failed");
+        off_t size = fileSize(journalPath);
+        EXPECT(size > 0, "nothing written by flush");
+
+        // unchanged values don't produce records
+        journal.set("state/RingerOn", PreferenceJournal::fromBool(false));
+        EXPECT(!journal.hasPendingChanges(), "unchanged value recorded");
+        journal.set("media/media_back_speaker_volume", PreferenceJournal::fromInt(60));
+        journal.erase("state/VolumeBalance");
+        EXPECT(journal.flush(), "second flush failed");
+    }
+
+    {
+        PreferenceJournal journal(directory, "test");
+        EXPECT(journal.open(), "existing journal not found");
+        bool ringerOn = true;
+        int volume = 0;
+        std::string value, text;
+        EXPECT(journal.get("state/RingerOn", value) && PreferenceJournal::toBool(value, ringerOn) && !ringerOn, "bool lost");
+        EXPECT(journal.get("media/media_back_speaker_volume", value) && PreferenceJournal::toInt(value, volume) && volume == 60,
+               "latest int not replayed: %d", volume);
+        EXPECT(!journal.get("state/VolumeBalance", value), "erased key replayed");
+        EXPECT(journal.get("state/Tricky", value) && PreferenceJournal::toString(value, text) && text == tricky,
+               "string not preserved: '%s'", text.c_str());
+        EXPECT(!PreferenceJournal::toInt(PreferenceJournal::fromBool(true), volume), "bool read as an int");
+    }
+
+    // a crash in the middle of a write leaves a partial record: it is ignored & dropped
+    off_t beforeCrash = fileSize(journalPath);
+    appendRaw(journalPath, "S media/media_back_speaker_volume i99 1234");
+    {
+        PreferenceJournal journal(directory, "test");
+        EXPECT(journal.open(), "journal with torn record not opened");
+        std::string value;
+        int volume = 0;
+        EXPECT(journal.get("media/media_back_speaker_volume", value) && PreferenceJournal::toInt(value, volume) && volume == 60,
+               "torn record applied: %d", volume);
+        EXPECT(fileSize(journalPath) == beforeCrash, "torn record not truncated");
+        journal.set("state/DndOn", PreferenceJournal::fromBool(true));
+        EXPECT(journal.flush(), "flush after recovery failed");
+    }
+
+    // a complete record with a bad checksum stops the replay too
+    appendRaw(journalPath, "S state/DndOn b0 00000000\n");
+    {
+        PreferenceJournal journal(directory, "test");
+        journal.open();
+        std::string value;
+        bool dnd = false;
+        EXPECT(journal.get("state/DndOn", value) && PreferenceJournal::toBool(value, dnd) && dnd, "corrupted record applied");
+    }
+
+    // compaction keeps every value, pending ones included, and empties the journal
+    {
+        PreferenceJournal journal(directory, "test");
+        journal.open();
+        for (int i = 0; i < PreferenceJournal::cCompactionThreshold; i++)
+            journal.set("media/media_back_speaker_volume", PreferenceJournal::fromInt(i % 100));
+        EXPECT(journal.needsCompaction(), "no compaction needed after %d records", PreferenceJournal::cCompactionThreshold);
+        journal.set("state/Pending", PreferenceJournal::fromInt(1));
+        PreferenceJournal::Values before = journal.values();
+        EXPECT(journal.compact(), "compaction failed");
+        EXPECT(fileSize(journalPath) == 0, "journal not emptied by compaction");
+        EXPECT(fileSize(snapshotPath) > 0, "no snapshot written");
+        EXPECT(!journal.needsCompaction(), "compaction still needed");
+        journal.set("state/AfterCompaction", PreferenceJournal::fromInt(2));
+        journal.flush();
+
+        PreferenceJournal reopened(directory, "test");
+        EXPECT(reopened.open(), "snapshot not found");
+        before["state/AfterCompaction"] = PreferenceJournal::fromInt(2);
+        EXPECT(reopened.values() == before, "values changed by compaction");
+    }
+
+    // both load paths must agree: the same changes read back from the journal
+    // alone, and from a snapshot written by compaction
+    {
+        unlink(journalPath.c_str());
+        unlink(snapshotPath.c_str());
+        PreferenceJournal journal(directory, "test");
+        journal.open();
+        for (int i = 0; i < 40; i++)
+        {
+            char key[32];
+            snprintf(key, sizeof(key), "module%d/scenario%d_volume", i % 5, i);
+            journal.set(key, PreferenceJournal::fromInt(i * 3));
+            if (i % 7 == 0)
+                journal.erase(key);
+        }
+        journal.set("state/Tricky", PreferenceJournal::fromString(tricky));
+        journal.set("state/Empty", PreferenceJournal::fromString(""));
+        journal.set("imported/state", PreferenceJournal::fromBool(true));
+        journal.flush();
+
+        PreferenceJournal fromJournal(directory, "test");
+        EXPECT(fromJournal.open() && !fromJournal.snapshotRejected(), "journal not loaded");
+        EXPECT(fromJournal.values() == journal.values(), "journal replay differs");
+        EXPECT(fromJournal.compact(), "compaction failed");
+
+        PreferenceJournal fromSnapshot(directory, "test");
+        EXPECT(fromSnapshot.open() && !fromSnapshot.snapshotRejected(), "snapshot not loaded");
+        EXPECT(fileSize(journalPath) == 0, "journal used along with the snapshot");
+        EXPECT(fromSnapshot.values() == fromJournal.values(), "snapshot load differs from journal replay");
+    }
+
+    // a damaged snapshot is rejected as a whole, so that the caller falls back
+    {
+        char byte = 0x5a;
+        writeAt(snapshotPath, fileSize(snapshotPath) - 1, &byte, 1);
+        PreferenceJournal journal(directory, "test");
+        journal.open();
+        EXPECT(journal.snapshotRejected(), "damaged snapshot not reported");
+        EXPECT(journal.values().empty(), "values from a damaged snapshot");
+
+        // rewriting it makes it usable again
+        journal.set("state/RingerOn", PreferenceJournal::fromBool(true));
+        EXPECT(journal.compact() && !journal.snapshotRejected(), "snapshot not rewritten");
+        PreferenceJournal reopened(directory, "test");
+        EXPECT(reopened.open() && reopened.values() == journal.values(), "rewritten snapshot not loaded");
+    }
+
+    // so is a snapshot of another version
+    {
+        unsigned int version = PreferenceJournal::cSnapshotVersion + 1;
+        writeAt(snapshotPath, 4, &version, sizeof(version));
+        PreferenceJournal journal(directory, "test");
+        journal.open();
+        EXPECT(journal.snapshotRejected(), "snapshot of another version used");
+    }
+
+    checkRestoreSources(directory, tricky);
+
+    unlink(journalPath.c_str());
+    unlink(snapshotPath.c_str());
+    rmdir(directory);
+
+    printf("preference journal: %s\n", sFailures ? "FAILED" : "OK");
+    return sFailures ? 1 : 0;
+}
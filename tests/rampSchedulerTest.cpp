@@ -0,0 +1,147 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+// Drives the ramp scheduler like the mixer's timer does, with a fake clock,
+// and checks single, overlapping, retargeted & cancelled fades.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "RampScheduler.h"
+#include "testUtils.h"
+
+/// Volumes sent per sink, in order, as Pulse would have received them
+struct Trace
+{
+    std::vector<int> mVolumes[eVirtualSink_Count];
+    int              mCommands;
+};
+
+/// Run the scheduler until 'until' or until no fade is left, firing at each deadline
+static uint64_t run(RampScheduler & ramps, Trace & trace, uint64_t now, uint64_t until)
+{
+    int64_t deadline;
+    while ((deadline = ramps.nextDeadline()) >= 0 && (uint64_t) deadline <= until)
+    {
+        if ((uint64_t) deadline > now)
+            now = deadline;
+        std::vector<RampScheduler::Command> commands;
+        ramps.advance(now, commands);
+        for (size_t i = 0; i < commands.size(); i++)
+        {
+            trace.mVolumes[commands[i].mSink].push_back(commands[i].mVolume);
+            trace.mCommands++;
+        }
+    }
+    return now;
+}
+
+static void clear(Trace & trace)
+{
+    for (int i = 0; i < eVirtualSink_Count; i++)
+        trace.mVolumes[i].clear();
+    trace.mCommands = 0;
+}
+
+static bool monotonic(const std::vector<int> & volumes, bool up)
+{
+    for (size_t i = 1; i < volumes.size(); i++)
+        if (up ? volumes[i] < volumes[i - 1] : volumes[i] > volumes[i - 1])
+            return false;
+    return true;
+}
+
+int main(int argc, char ** argv)
+{
+    const EVirtualSink a = eVirtualSink_First;
+    const EVirtualSink b = EVirtualSink(eVirtualSink_First + 1);
+    RampScheduler ramps;
+    Trace trace;
+    clear(trace);
+
+    // A fade shorter than a step is a single Pulse ramp
+    ramps.start(a, 0, 80, 100, eRampCurve_Linear, 0);
+    run(ramps, trace, 0, 10000);
+    EXPECT(trace.mCommands == 1 && trace.mVolumes[a][0] == 80, "short fade: %d commands", trace.mCommands);
+    EXPECT(!ramps.isRamping(a), "short fade still running");
+
+    // A fade to the volume already set sends nothing
+    clear(trace);
+    ramps.start(a, 80, 80, 2000, eRampCurve_Linear, 0);
+    run(ramps, trace, 0, 10000);
+    EXPECT(trace.mCommands == 0, "no-op fade sent %d commands", trace.mCommands);
+
+    // Long linear fade: few, monotonic steps ending exactly on the target
+    clear(trace);
+    ramps.start(a, 0, 100, 2000, eRampCurve_Linear, 0);
+    run(ramps, trace, 0, 10000);
+    int steps = 2000 / RampScheduler::cStepMs;
+    EXPECT((int) trace.mVolumes[a].size() <= steps + 1, "linear fade: %d commands", (int) trace.mVolumes[a].size());
+    EXPECT(monotonic(trace.mVolumes[a], true), "linear fade not monotonic");
+    EXPECT(trace.mVolumes[a].back() == 100, "linear fade ends on %d", trace.mVolumes[a].back());
+
+    // Overlapping fades on two sinks, starting at different times, one timer deadline
+    clear(trace);
+    ramps.start(a, 100, 0, 3000, eRampCurve_Linear, 0);
+    uint64_t now = run(ramps, trace, 0, 1000);
+    ramps.start(b, 0, 60, 1500, eRampCurve_Linear, now);
+    EXPECT(ramps.nextDeadline() == (int64_t) now, "new fade not due immediately");
+    now = run(ramps, trace, now, 100000);
+    EXPECT(monotonic(trace.mVolumes[a], false) && trace.mVolumes[a].back() == 0, "overlapping fade a");
+    EXPECT(monotonic(trace.mVolumes[b], true) && trace.mVolumes[b].back() == 60, "overlapping fade b");
+    EXPECT(ramps.nextDeadline() < 0, "fades left over");
+
+    // Retarget in the middle of a fade: continue from where it is, no jump
+    clear(trace);
+    ramps.start(a, 0, 100, 2000, eRampCurve_Linear, 0);
+    now = run(ramps, trace, 0, 1000);
+    int reached = ramps.valueAt(a, now);
+    EXPECT(abs(reached - 50) <= 1, "midpoint is %d", reached);
+    size_t before = trace.mVolumes[a].size();
+    ramps.start(a, 0, 0, 1000, eRampCurve_Linear, now);  // 'from' ignored when retargeting
+    EXPECT(ramps.valueAt(a, now) == reached, "retarget jumped to %d", ramps.valueAt(a, now));
+    run(ramps, trace, now, 100000);
+    std::vector<int> after(trace.mVolumes[a].begin() + before, trace.mVolumes[a].end());
+    EXPECT(!after.empty() && monotonic(after, false) && after.back() == 0, "retargeted fade");
+    EXPECT(!after.empty() && after.front() <= trace.mVolumes[a][before - 1], "retargeted fade went up first");
+
+    // Cancel stops sending at once
+    clear(trace);
+    ramps.start(a, 0, 100, 2000, eRampCurve_Linear, 0);
+    now = run(ramps, trace, 0, 500);
+    int sent = trace.mCommands;
+    ramps.cancel(a);
+    run(ramps, trace, now, 100000);
+    EXPECT(trace.mCommands == sent, "commands sent after cancel");
+    EXPECT(ramps.nextDeadline() < 0, "cancelled fade still scheduled");
+
+    // dB fades spend more time in the quiet range than linear ones
+    ramps.start(a, 100, 0, 2000, eRampCurve_dB, 0);
+    int dBMiddle = ramps.valueAt(a, 1000);
+    ramps.cancel(a);
+    ramps.start(a, 100, 0, 2000, eRampCurve_Linear, 0);
+    int linearMiddle = ramps.valueAt(a, 1000);
+    ramps.cancel(a);
+    EXPECT(dBMiddle < linearMiddle, "dB midpoint %d, linear %d", dBMiddle, linearMiddle);
+    clear(trace);
+    ramps.start(a, 100, 0, 2000, eRampCurve_dB, 0);
+    run(ramps, trace, 0, 100000);
+    EXPECT(monotonic(trace.mVolumes[a], false) && trace.mVolumes[a].back() == 0, "dB fade");
+
+    printf("ramp scheduler: %s\n", sFailures ? "FAILED" : "OK");
+    return sFailures ? 1 : 0;
+}
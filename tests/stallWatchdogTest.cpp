@@ -0,0 +1,87 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Exercises the main loop stall detector: lag of the beats, stalls reported
+// once by the watchdog with the handler running, and nested handler markers.
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+
+#include "StallWatchdog.h"
+#include "Metrics.h"
+#include "testUtils.h"
+
+int main(int argc, char ** argv)
+{
+    EXPECT(MainLoopHandler::current() == NULL, "handler before any marker");
+    {
+        MAINLOOP_HANDLER("outer");
+        EXPECT(strcmp(MainLoopHandler::current(), "outer") == 0, "outer handler");
+        {
+            MAINLOOP_HANDLER("inner");
+            EXPECT(strcmp(MainLoopHandler::current(), "inner") == 0, "inner handler");
+        }
+        EXPECT(strcmp(MainLoopHandler::current(), "outer") == 0, "outer handler not restored");
+    }
+    EXPECT(MainLoopHandler::current() == NULL, "handler after the markers");
+
+    // times in us: beats every 250 ms, stalls reported past 100 ms of lag
+    StallWatchdog watchdog;
+    watchdog.configure(250, 100);
+    StallWatchdog::Stall stall;
+
+    EXPECT(!watchdog.check(1000000, stall), "stall reported before the first beat");
+    EXPECT(watchdog.beat(1000000) == 0, "first beat late");
+    EXPECT(watchdog.beat(1250000) == 0, "beat on time late");
+    EXPECT(watchdog.beat(1510000) == 10000, "beat 10 ms late");
+    EXPECT(!watchdog.check(1800000, stall), "stall reported under the threshold");
+
+    {
+        MAINLOOP_HANDLER("slowHandler");
+        EXPECT(watchdog.check(1900000, stall), "stall not reported");
+        EXPECT(stall.mDuration == 140000, "stall duration %llu", (unsigned long long) stall.mDuration);
+        EXPECT(stall.mHandler && strcmp(stall.mHandler, "slowHandler") == 0, "stall handler");
+        EXPECT(!watchdog.check(2500000, stall), "stall reported twice");
+    }
+    EXPECT(watchdog.beat(3000000) == 1240000, "lag of the stall");
+    EXPECT(!watchdog.check(3100000, stall), "stall reported after the beat");
+    EXPECT(watchdog.check(3400000, stall) && stall.mHandler == NULL, "unmarked stall");
+
+    std::string report = Metrics::report();
+    EXPECT(report.find("\"mainloop.stalls\": 2") != std::string::npos, "stalls: %s", report.c_str());
+    EXPECT(report.find("\"mainloop.lag\": { \"count\": 4, ") != std::string::npos,
+           "lag: %s", report.c_str());
+
+    // a stall the thread notices, with real time
+    StallWatchdog threaded;
+    threaded.configure(20, 10);
+    EXPECT(threaded.start(), "watchdog thread not started");
+    threaded.beat(Metrics::now());
+    {
+        MAINLOOP_HANDLER("blockingHandler");
+        usleep(100000);
+    }
+    threaded.stop();
+    report = Metrics::report();
+    EXPECT(report.find("\"mainloop.stalls\": 3") != std::string::npos, "stalls: %s", report.c_str());
+    EXPECT(report.find("\"mainloop.long_handlers\": 1") != std::string::npos,
+           "long handlers: %s", report.c_str());
+
+    printf("stall watchdog: %s\n", sFailures ? "FAILED" : "OK");
+    return sFailures ? 1 : 0;
+}
@@ -0,0 +1,98 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+// Records a fake startup & checks the profile reported.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+
+#include "StartupProfiler.h"
+#include "testUtils.h"
+
+// value of a field of the event with the given name, -1 if missing
+static long long field(const std::string & report, const std::string & name, const char * key)
+{
+    size_t event = report.find("\"name\": \"" + name + "\"");
+    if (event == std::string::npos)
+        return -1;
+    size_t eventEnd = report.find('}', event);
+    size_t value = report.find(std::string("\"") + key + "\": ", event);
+    if (value == std::string::npos || value > eventEnd)
+        return -1;
+    return atoll(report.c_str() + value + strlen(key) + 4);
+}
+
+int main(int argc, char ** argv)
+{
+    StartupProfiler profiler;
+
+    profiler.begin("state init");
+    usleep(20000);
+    profiler.end("state init");
+    {
+        StartupPhase phase(profiler, "restore preferences");
+        usleep(10000);
+    }
+    // only the first occurrence counts
+    profiler.begin("restore preferences");
+    profiler.end("restore preferences");
+    EXPECT(profiler.mark("pulse connected"), "first mark not recorded");
+    EXPECT(!profiler.mark("pulse connected"), "second mark recorded");
+    profiler.begin("never ended");
+    profiler.begin("quote\"d");
+    profiler.end("quote\"d");
+
+    std::string report = profiler.finish();
+    EXPECT(!profiler.isRecording(), "still recording");
+    profiler.mark("too late");
+
+    long long start = field(report, "state init", "start_us");
+    long long end = field(report, "state init", "end_us");
+    EXPECT(start >= 0 && end - start >= 20000, "wrong phase: %lld-%lld", start, end);
+    long long restoreStart = field(report, "restore preferences", "start_us");
+    long long restoreEnd = field(report, "restore preferences", "end_us");
+    EXPECT(restoreStart >= end && restoreEnd - restoreStart >= 10000 && restoreEnd - restoreStart < 1000000,
+           "wrong scoped phase: %lld-%lld", restoreStart, restoreEnd);
+    EXPECT(field(report, "pulse connected", "at_us") >= restoreEnd, "mark missing or misplaced");
+    EXPECT(field(report, "never ended", "start_us") >= 0 && field(report, "never ended", "end_us") < 0,
+           "open phase misreported");
+    EXPECT(report.find("quote\\\"d") != std::string::npos, "name not escaped");
+    EXPECT(report.find("too late") == std::string::npos, "recorded after finish");
+    EXPECT(report.find("\"origin_us\": ") == 2, "no origin: %s", report.c_str());
+
+    char path[] = "/tmp/startupprofileXXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0)
+        close(fd);
+    EXPECT(StartupProfiler::write(report, path), "report not written");
+    FILE * file = fopen(path, "r");
+    char buffer[4096] = "";
+    if (file)
+    {
+        size_t size = fread(buffer, 1, sizeof(buffer) - 1, file);
+        buffer[size] = 0;
+        fclose(file);
+    }
+    EXPECT(report == buffer, "file differs from report");
+    unlink(path);
+
+    printf("startup profiler: %s\n", sFailures ? "FAILED" : "OK");
+    return sFailures ? 1 : 0;
+}
@@ -0,0 +1,205 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Checks the status page: what readers see, readers in other processes
+// never seeing half an update while the writer updates it, & a new audiod
+// taking over the page of a previous one, even one that died in the middle
+// of an update or had an incompatible layout, but never a page another user
+// created.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "AudiodStatusPage.h"
+#include "testUtils.h"
+
+static const int cUpdates = 200000;
+static const int cReaders = 2;
+
+static double now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// each update writes the same value twice: a reader must never see them differ
+static int readUpdates(const char * name)
+{
+    AudiodStatusReader reader;
+    AudiodStatus status;
+    int last = 0, reads = 0, inconsistent = 0;
+    reader.open(name);
+    double start = now();
+    while (last < cUpdates)
+    {
+        if (!reader.read(status))
+            continue;   // not created yet
+        reads++;
+        const AudiodSinkStatus * sink = status.findSink("pmedia");
+        const AudiodCategoryStatus * category = status.findCategory("media");
+        if (!sink || !category)
+            continue;
+        if (sink->mVolume != sink->mActiveStreams || category->mVolume != category->mMicGain ||
+            sink->mVolume < last)
+            inconsistent++;
+        last = sink->mVolume;
+    }
+    printf("  reader: %d reads, %d inconsistent, %.0f reads/s\n", reads, inconsistent,
+           reads / (now() - start));
+    fflush(stdout);
+    return inconsistent == 0 ? 0 : 1;
+}
+
+static void checkContent(AudiodStatusWriter & writer, AudiodStatusReader & reader)
+{
+    writer.setHeadsetState(2);
+    writer.setCategory("media", "media_back_speaker", 60, -1, false, true);
+    writer.setCategory("phone", "phone_front_speaker", 40, 50, true, false);
+    writer.setSink(2, "pmedia", 65536, 1);
+    AudiodStatus status;
+    EXPECT(reader.read(status), "no status");
+    EXPECT(status.mHeadsetState == 2, "headset %d", status.mHeadsetState);
+    const AudiodCategoryStatus * media = status.findCategory("media");
+    const AudiodCategoryStatus * phone = status.findCategory("phone");
+    EXPECT(media && strcmp(media->mScenario, "media_back_speaker") == 0 &&
+           media->mVolume == 60 && media->mActive, "media status");
+    EXPECT(phone && phone->mMuted && phone->mMicGain == 50 && !phone->mActive, "phone status");
+    const AudiodSinkStatus * sink = status.findSink("pmedia");
+    EXPECT(sink && sink == &status.mSinks[2] && sink->mVolume == 65536 &&
+           sink->mActiveStreams == 1, "sink status");
+    EXPECT(status.mSinkCount == 3 && status.mSinks[0].mVolume == -1, "unknown sinks");
+    EXPECT(!status.findCategory("alarm") && !status.findSink("palerts"), "found missing");
+
+    // one active category at a time, & updating doesn't add one
+    uint32_t sequence = reader.sequence();
+    writer.setCategory("phone", "phone_front_speaker", 40, 50, true, true);
+    EXPECT(reader.read(status) && status.mCategoryCount == 2 &&
+           !status.findCategory("media")->mActive && status.findCategory("phone")->mActive,
+           "active category not switched");
+    EXPECT(reader.sequence() == sequence + 2, "sequence %u after %u", reader.sequence(), sequence);
+}
+
+static void checkConcurrentReads(AudiodStatusWriter & writer, const char * name)
+{
+    writer.setSink(2, "pmedia", 0, 0);
+    writer.setCategory("media", "media_back_speaker", 0, 0, false, true);
+    pid_t readers[cReaders];
+    for (int i = 0; i < cReaders; i++)
+        if ((readers[i] = fork()) == 0)
+            _exit(readUpdates(name));
+
+    printf("%d updates, %d readers:\n", cUpdates, cReaders);
+    fflush(stdout);
+    for (int value = 1; value <= cUpdates; value++)
+    {
+        writer.setSink(2, "pmedia", value, value);
+        writer.setCategory("media", "media_back_speaker", value, value, false, true);
+    }
+    for (int i = 0; i < cReaders; i++)
+    {
+        int status = 0;
+        EXPECT(waitpid(readers[i], &status, 0) == readers[i] && WIFEXITED(status) &&
+               WEXITSTATUS(status) == 0, "reader %d saw inconsistent values", i);
+    }
+}
+
+static void checkTakeOver(AudiodStatusWriter & writer, AudiodStatusReader & reader,
+                          const char * name)
+{
+    AudiodStatus status;
+
+    // a new audiod, after one that died in the middle of an update
+    uint32_t sequence = reader.sequence();
+    int fd = shm_open(name, O_RDWR, 0);
+    AudiodStatusPage * page = static_cast<AudiodStatusPage *>(mmap(NULL,
+            sizeof(AudiodStatusPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    close(fd);
+    EXPECT(page != MAP_FAILED, "can't map the page");
+    if (page == MAP_FAILED)
+        return;
+    page->mSeqlock.writeBegin();
+    writer.close();
+    EXPECT(writer.open(name), "can't take over");
+    writer.setHeadsetState(1);
+    EXPECT(reader.read(status) && status.mHeadsetState == 1 && status.mCategoryCount == 0,
+           "old status kept: headset %d, %u categories", status.mHeadsetState,
+           status.mCategoryCount);
+    EXPECT(reader.sequence() > sequence, "sequence went back from %u to %u", sequence,
+           reader.sequence());
+
+    // a new audiod with another layout replaces the page: readers follow
+    page->mVersion = AudiodStatusPage::cVersion + 1;
+    munmap(page, sizeof(AudiodStatusPage));
+    writer.close();
+    EXPECT(writer.open(name), "can't replace");
+    writer.setHeadsetState(3);
+    EXPECT(reader.read(status) && status.mHeadsetState == 3, "reader didn't reopen");
+
+    // a page someone else created is replaced, never written (needs root to fake)
+    if (geteuid() != 0)
+        return;
+    fd = shm_open(name, O_RDWR, 0);
+    page = static_cast<AudiodStatusPage *>(mmap(NULL, sizeof(AudiodStatusPage),
+            PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    EXPECT(page != MAP_FAILED && fchown(fd, 1, 1) == 0, "can't give the page away");
+    close(fd);
+    if (page == MAP_FAILED)
+        return;
+    sequence = page->mSeqlock.sequence();
+    writer.close();
+    EXPECT(writer.open(name), "can't replace a foreign page");
+    writer.setHeadsetState(4);
+    EXPECT(memcmp(page->mMagic, "ASTS", 4) == 0 && page->mSeqlock.sequence() == sequence &&
+           page->mStatus.mHeadsetState == 3, "foreign page written");
+    munmap(page, sizeof(AudiodStatusPage));
+    AudiodStatusReader newReader;
+    struct stat info;
+    fd = shm_open(name, O_RDONLY, 0);
+    EXPECT(fd >= 0 && fstat(fd, &info) == 0 && info.st_uid == 0, "foreign page kept");
+    if (fd >= 0)
+        close(fd);
+    EXPECT(newReader.open(name) && newReader.read(status) && status.mHeadsetState == 4,
+           "new page not readable");
+}
+
+int main(int argc, char ** argv)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/audiod-status-test-%d", (int) getpid());
+
+    AudiodStatusReader reader;
+    AudiodStatus status;
+    EXPECT(!reader.open(name) && !reader.read(status), "read without a writer");
+
+    AudiodStatusWriter writer;
+    if (!writer.open(name))
+        return 1;
+    checkContent(writer, reader);
+    checkConcurrentReads(writer, name);
+    checkTakeOver(writer, reader, name);
+
+    writer.close();
+    shm_unlink(name);
+
+    printf("status page: %s\n", sFailures ? "FAILED" : "OK");
+    return sFailures ? 1 : 0;
+}
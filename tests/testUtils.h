@@ -0,0 +1,31 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef TESTUTILS_H_
+#define TESTUTILS_H_
+
+#include <stdio.h>
+
+// Shared by the test programs: each is a single file, built on its own.
+// Checks count their failures in sFailures, which main() turns into the exit code.
+
+static int sFailures = 0;
+
+/// Report where & why the condition failed (printf style), & keep going
+#define EXPECT(cond, ...) do { if (!(cond)) { printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+                                               printf(__VA_ARGS__); printf("\n"); sFailures++; } } while (0)
+
+#endif /* TESTUTILS_H_ */
@@ -0,0 +1,84 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+// Records tracepoints through the fallback backend of audiodTracer.h,
+// from two threads, & checks the Chrome trace written.
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <string>
+
+#undef HAS_LTTNG
+#include "audiodTracer.h"
+#include "testUtils.h"
+
+static int count(const std::string & text, const std::string & pattern)
+{
+    int found = 0;
+    for (size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1))
+        found++;
+    return found;
+}
+
+static void * overflow(void * data)
+{
+    for (unsigned i = 0; i < TraceBuffer::cEventsPerThread + 100; i++)
+        PMTRACE("worker event");
+    return NULL;
+}
+
+int main(int argc, char ** argv)
+{
+    {
+        PMTRACE_SCOPE("outer scope");
+        PMTRACE_MIXER_COMMAND('v', 3, 50);
+        PMTRACE_SAMPLE_PLAY("alert_\"1\"", 2);
+        std::string audioType = "media";
+        PMTRACE_UMI_CALL("connectAudioOut", audioType.c_str());
+        PMTRACE_SUBSCRIPTION_POST("/media/status");
+    }
+
+    TraceBuffer::setEnabled(false);
+    PMTRACE("not recorded");
+    TraceBuffer::setEnabled(true);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, overflow, NULL);
+    pthread_join(thread, NULL);
+
+    std::string trace = TraceBuffer::chromeTrace();
+    EXPECT(trace.find("{ \"traceEvents\": [\n") == 0, "wrong start: %.60s", trace.c_str());
+    const char * end = " ],\n  \"displayTimeUnit\": \"ms\" }\n";
+    EXPECT(trace.rfind(end) == trace.size() - strlen(end), "wrong end");
+    EXPECT(count(trace, "\"name\": \"outer scope\", \"ph\": \"B\"") == 1 &&
+           count(trace, "\"name\": \"outer scope\", \"ph\": \"E\"") == 1, "scope not traced");
+    EXPECT(trace.find("\"args\": { \"cmd\": \"v\", \"sink\": 3, \"value\": 50 }") != std::string::npos,
+           "mixer command not traced");
+    EXPECT(trace.find("\"args\": { \"sample\": \"alert_\\\"1\\\"\", \"sink\": 2 }") != std::string::npos,
+           "sample not traced or not escaped");
+    EXPECT(trace.find("\"name\": \"connectAudioOut\", \"ph\": \"B\"") < trace.find("\"name\": \"subscription post\"") &&
+           trace.find("\"args\": { \"text\": \"media\" }") != std::string::npos, "umi call not traced");
+    EXPECT(trace.find("not recorded") == std::string::npos, "recorded while disabled");
+    // the oldest slot of a full ring may be under rewrite: it's never kept
+    EXPECT(count(trace, "\"name\": \"worker event\"") == (int) TraceBuffer::cEventsPerThread - 1,
+           "wrong number of events kept: %d", count(trace, "\"name\": \"worker event\""));
+    EXPECT(count(trace, "\"name\": \"thread_name\"") == 2, "threads not named");
+
+    printf("trace buffer: %s\n", sFailures ? "FAILED" : "OK");
+    return sFailures ? 1 : 0;
+}
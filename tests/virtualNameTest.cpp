@@ -0,0 +1,75 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+// Checks that every virtual sink & source name of the pulse policy tables
+// round-trips through the sorted name index used by getSinkByName/getSourceByName.
+
+#include <stdio.h>
+
+#include <pulse/module-palm-policy-tables.h>
+
+#include "VirtualNameIndex.h"
+#include "testUtils.h"
+
+static void check(bool condition, const char * what, const char * name, int expected, int found)
+{
+    if (!condition)
+    {
+        printf("FAIL: %s '%s': expected %d, found %d\n", what, name, expected, found);
+        sFailures++;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    VirtualNameIndex sinks = VirtualNameIndex::fromSinkMap(systemdependantvirtualsinkmap,
+                                                           eVirtualSink_First, eVirtualSink_Last);
+    VirtualNameIndex sources = VirtualNameIndex::fromSourceMap(systemdependantvirtualsourcemap,
+                                                               eVirtualSource_First, eVirtualSource_Last);
+
+    for (int i = eVirtualSink_First; i <= eVirtualSink_Last; i++)
+    {
+        const char * name = systemdependantvirtualsinkmap[i].virtualsinkname;
+        int found = sinks.lookup(name, eVirtualSink_None);
+        check(found == i, "sink", name, i, found);
+        found = sinks.lookup(name + 1, eVirtualSink_None);
+        check(found == i, "sink", name + 1, i, found);
+    }
+
+    for (int i = eVirtualSource_First; i <= eVirtualSource_Last; i++)
+    {
+        const char * name = systemdependantvirtualsourcemap[i].virtualsourcename;
+        int found = sources.lookup(name, eVirtualSource_None);
+        check(found == i, "source", name, i, found);
+        found = sources.lookup(name + 1, eVirtualSource_None);
+        check(found == i, "source", name + 1, i, found);
+    }
+
+    int found = sinks.lookup("<not a sink>", eVirtualSink_None);
+    check(found == eVirtualSink_None, "sink", "<not a sink>", eVirtualSink_None, found);
+    found = sources.lookup("", eVirtualSource_None);
+    check(found == eVirtualSource_None, "source", "", eVirtualSource_None, found);
+    found = sinks.lookup(NULL, eVirtualSink_None);
+    check(found == eVirtualSink_None, "sink", "(null)", eVirtualSink_None, found);
+
+    printf("%d sinks, %d sources: %s\n",
+           eVirtualSink_Last - eVirtualSink_First + 1,
+           eVirtualSource_Last - eVirtualSource_First + 1,
+           sFailures ? "FAILED" : "OK");
+
+    return sFailures ? 1 : 0;
+}
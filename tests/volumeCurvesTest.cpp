@@ -0,0 +1,180 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+// Checks the volume curve tables built from the palm policy defaults and from
+// configured curves: monotonicity, endpoints, dB adjustments, lazy rebuilds &
+// the percentages sent to the policy module to follow a configured curve.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pulse/module-palm-policy-tables.h>
+
+#include "VolumeCurves.h"
+#include "testUtils.h"
+
+static void checkSink(VolumeCurves & curves, EVirtualSink sink, VolumeCurves::EDevice device)
+{
+    EXPECT(curves.toPulse(sink, device, 0) == 0, "sink %d device %d: 0%% not silent", sink, device);
+    for (int percent = 1; percent <= 100; percent++)
+    {
+        int previous = curves.toPulse(sink, device, percent - 1);
+        int current = curves.toPulse(sink, device, percent);
+        EXPECT(current >= previous, "sink %d device %d: %d%% louder than %d%%", sink, device, percent - 1, percent);
+        EXPECT(current >= 0 && current <= VolumeCurves::cMaxPulseVolume, "sink %d: %d%% out of range", sink, percent);
+    }
+
+    static const int cOffsets[] = { -30, -18, -12, -3, 3, 12 };
+    for (size_t i = 0; i < sizeof(cOffsets) / sizeof(cOffsets[0]); i++)
+    {
+        int dB = cOffsets[i];
+        int previous = 0;
+        for (int percent = 0; percent <= 100; percent++)
+        {
+            int adjusted = curves.adjust(sink, device, percent, dB);
+            EXPECT(adjusted >= 0 && adjusted <= 100, "adjusted %d%% %+d dB = %d", percent, dB, adjusted);
+            EXPECT(dB < 0 ? adjusted <= percent : adjusted >= percent,
+                   "%d%% %+d dB went the wrong way: %d", percent, dB, adjusted);
+            EXPECT(adjusted >= previous, "adjustment of %d%% %+d dB not monotonic", percent, dB);
+            EXPECT(percent <= 1 || adjusted > 0, "%d%% %+d dB rounded to 0", percent, dB);
+            previous = adjusted;
+        }
+        EXPECT(curves.adjust(sink, device, 0, dB) <= 0 || dB > 0, "silence %+d dB not silent", dB);
+    }
+    EXPECT(curves.adjust(sink, device, 42, 0) == 42, "0 dB changed the volume");
+
+    EXPECT(curves.toPolicy(sink, device, 0) == 0, "sink %d device %d: 0%% sent as %d", sink,
+           device, curves.toPolicy(sink, device, 0));
+    for (int percent = 1; percent <= 100; percent++)
+    {
+        int policy = curves.toPolicy(sink, device, percent);
+        EXPECT(policy >= curves.toPolicy(sink, device, percent - 1) && policy > 0 && policy <= 100,
+               "sink %d device %d: %d%% sent as %d", sink, device, percent, policy);
+    }
+}
+
+/// What the policy module will play must be as close to the curve as its table allows
+static void checkPolicy(VolumeCurves & curves, EVirtualSink sink, VolumeCurves::EDevice device)
+{
+    const int * table = _mapPercentToPulseVolume[device];
+    for (int percent = 1; percent <= 100; percent++)
+    {
+        int wanted = curves.toPulse(sink, device, percent);
+        int sent = curves.toPolicy(sink, device, percent);
+        int error = abs(table[sent] - wanted);
+        for (int other = 1; other <= 100; other++)
+            EXPECT(error <= abs(table[other] - wanted), "%d%% sent as %d, %d is closer", percent,
+                   sent, other);
+    }
+}
+
+/// _add_dB as PulseAudioMixer had it, before the tables moved to VolumeCurves
+static int baselineAddDB(int current, int dB_diff)
+{
+    if (current <= 0 && dB_diff <= 0)
+        return 0;
+    else if (current >= 65535 && dB_diff >= 0)
+        return 65535;
+
+    float dB_current = (((float)(current) - 65535)/65535.0) * 100;
+    float desired = 65535 * ((dB_current + (float)(dB_diff)) / 100 + 1);
+
+    if (desired < 0)
+        desired = 0;
+    else if (desired > 65535)
+        desired = 65535;
+
+    return (int) desired;
+}
+
+/// dB offsets must land on the very same pulse volumes as before, over the whole range
+static void checkAddDB()
+{
+    for (int dB = -VolumeCurves::cdBRange - 10; dB <= 30; dB++)
+    {
+        int mismatches = 0, first = -1;
+        for (int current = 0; current <= VolumeCurves::cMaxPulseVolume; current++)
+            if (VolumeCurves::addDB(current, dB) != baselineAddDB(current, dB) && mismatches++ == 0)
+                first = current;
+        EXPECT(mismatches == 0, "%+d dB: %d pulse volumes differ, first %d: %d, was %d", dB, mismatches,
+               first, VolumeCurves::addDB(first, dB), baselineAddDB(first, dB));
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    checkAddDB();
+
+    VolumeCurves curves;
+    curves.setDefault(VolumeCurves::eDevice_Speaker, _mapPercentToPulseVolume[0]);
+    curves.setDefault(VolumeCurves::eDevice_Headset, _mapPercentToPulseVolume[1]);
+    curves.build();
+
+    // defaults follow the palm policy tables exactly, & are sent as they are
+    for (int device = 0; device < VolumeCurves::eDevice_Count; device++)
+        for (int percent = 1; percent <= 100; percent++)
+        {
+            EXPECT(curves.toPulse(eVirtualSink_First, VolumeCurves::EDevice(device), percent) ==
+                   _mapPercentToPulseVolume[device][percent], "default table differs at %d%%", percent);
+            EXPECT(curves.toPolicy(eVirtualSink_First, VolumeCurves::EDevice(device), percent) ==
+                   percent, "default table doesn't send %d%%", percent);
+        }
+
+    // a configured curve for one sink, on the headset only
+    std::vector<VolumeCurves::Point> points;
+    VolumeCurves::Point low = { 10, -50.0 }, mid = { 50, -20.0 }, high = { 100, 0.0 };
+    points.push_back(low);
+    points.push_back(mid);
+    points.push_back(high);
+    int before = curves.toPulse(eVirtualSink_First, VolumeCurves::eDevice_Headset, 50);
+    EXPECT(curves.setCurve(eVirtualSink_First, VolumeCurves::eDevice_Headset, points), "valid curve rejected");
+    int after = curves.toPulse(eVirtualSink_First, VolumeCurves::eDevice_Headset, 50);
+    EXPECT(after == (int) (VolumeCurves::cMaxPulseVolume * 0.8 + 0.5), "50%% is %d after the curve change (was %d)", after, before);
+    EXPECT(curves.toPulse(eVirtualSink_First, VolumeCurves::eDevice_Headset, 100) == VolumeCurves::cMaxPulseVolume,
+           "100%% is not full volume");
+    EXPECT(curves.toPulse(eVirtualSink_First, VolumeCurves::eDevice_Speaker, 50) == _mapPercentToPulseVolume[0][50],
+           "speaker curve changed with the headset's");
+    checkPolicy(curves, eVirtualSink_First, VolumeCurves::eDevice_Headset);
+    EXPECT(curves.toPolicy(eVirtualSink_First, VolumeCurves::eDevice_Headset, 50) != 50,
+           "the curve doesn't change what is sent");
+
+    // invalid curves are refused & leave the previous one in place
+    std::vector<VolumeCurves::Point> bad(points);
+    bad[1].mdB = -60.0;    // goes down
+    EXPECT(!curves.setCurve(eVirtualSink_First, VolumeCurves::eDevice_Headset, bad), "decreasing curve accepted");
+    bad = points;
+    bad[2].mdB = 6.0;      // above full volume
+    EXPECT(!curves.setCurve(eVirtualSink_First, VolumeCurves::eDevice_Headset, bad), "curve above 0 dB accepted");
+    EXPECT(curves.toPulse(eVirtualSink_First, VolumeCurves::eDevice_Headset, 50) == after, "refused curve applied");
+
+    // a curve for all sinks also applies to lookups without a sink
+    EXPECT(curves.setCurve(eVirtualSink_All, VolumeCurves::eDevice_Speaker, points), "all sinks curve rejected");
+    EXPECT(curves.toPulse(eVirtualSink_None, VolumeCurves::eDevice_Speaker, 50) == after, "sinkless lookup ignores the curve");
+
+    for (int sink = eVirtualSink_First; sink <= eVirtualSink_Last; sink++)
+        for (int device = 0; device < VolumeCurves::eDevice_Count; device++)
+            checkSink(curves, EVirtualSink(sink), VolumeCurves::EDevice(device));
+    checkSink(curves, eVirtualSink_None, VolumeCurves::eDevice_Headset);
+
+    curves.resetCurves();
+    EXPECT(curves.toPulse(eVirtualSink_First, VolumeCurves::eDevice_Headset, 50) == _mapPercentToPulseVolume[1][50],
+           "reset didn't restore the default table");
+    checkSink(curves, eVirtualSink_First, VolumeCurves::eDevice_Headset);
+
+    printf("volume curves: %s\n", sFailures ? "FAILED" : "OK");
+    return sFailures ? 1 : 0;
+}
@@ -0,0 +1,141 @@
+// Copyright (c) 2012-2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <cstring>
+#include "LogRing.h"
+
+LogRing::LogRing(size_t slots) :
+    mEnqueuePosition(0),
+    mDequeuePosition(0),
+    mDropped(0)
+{
+    size_t size = 2;
+    while (size < slots)
+        size <<= 1;
+    mSlots = new Slot[size];
+    mMask = size - 1;
+    // a record never takes more than half the ring, so that there is room
+    // for a producer to claim slots while the consumer frees others
+    mMaxSlots = size / 2 < cMaxSlotsPerRecord ? size / 2 : cMaxSlotsPerRecord;
+    for (size_t i = 0; i < size; i++)
+        mSlots[i].mSequence.store(i, std::memory_order_relaxed);
+}
+
+LogRing::~LogRing()
+{
+    delete [] mSlots;
+}
+
+bool LogRing::push(unsigned char tag, const struct iovec * parts, int count)
+{
+    size_t total = 0;
+    for (int i = 0; i < count; i++)
+        total += parts[i].iov_len;
+    size_t slots = total == 0 ? 1 : (total + cSlotDataSize - 1) / cSlotDataSize;
+    if (slots > mMaxSlots)
+    {
+        slots = mMaxSlots;
+        total = slots * cSlotDataSize;
+    }
+
+    // claim 'slots' consecutive slots. The consumer frees slots in order, so
+    // if the last one is free for this lap, all the ones before it are too.
+    size_t position = mEnqueuePosition.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        size_t first = slot(position).mSequence.load(std::memory_order_acquire);
+        size_t last = slot(position + slots - 1).mSequence.load(std::memory_order_acquire);
+        if (first == position && last == position + slots - 1)
+        {
+            if (mEnqueuePosition.compare_exchange_weak(position, position + slots,
+                                                       std::memory_order_relaxed))
+                break;
+        }
+        else if ((ptrdiff_t) (first - position) < 0 || (ptrdiff_t) (last - (position + slots - 1)) < 0)
+        {
+            // not consumed yet: full
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+            position = mEnqueuePosition.load(std::memory_order_relaxed);
+    }
+
+    // copy the parts over the slots
+    size_t part = 0, partOffset = 0;
+    for (size_t i = 0; i < slots; i++)
+    {
+        Slot & current = slot(position + i);
+        size_t size = total - i * cSlotDataSize;
+        if (size > cSlotDataSize)
+            size = cSlotDataSize;
+        current.mTag = tag;
+        current.mCount = i == 0 ? slots : 0;
+        current.mSize = size;
+        size_t offset = 0;
+        while (offset < size && part < (size_t) count)
+        {
+            size_t chunk = parts[part].iov_len - partOffset;
+            if (chunk > size - offset)
+                chunk = size - offset;
+            memcpy(current.mData + offset, (const char *) parts[part].iov_base + partOffset, chunk);
+            offset += chunk;
+            partOffset += chunk;
+            if (partOffset == parts[part].iov_len)
+            {
+                part++;
+                partOffset = 0;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < slots; i++)
+        slot(position + i).mSequence.store(position + i + 1, std::memory_order_release);
+
+    return true;
+}
+
+bool LogRing::pop(unsigned char & tag, std::string & record)
+{
+    size_t position = mDequeuePosition.load(std::memory_order_relaxed);
+    Slot & first = slot(position);
+    if (first.mSequence.load(std::memory_order_acquire) != position + 1)
+        return false;
+
+    // producers publish their slots one after the other: wait for the last one
+    size_t slots = first.mCount;
+    for (size_t i = 1; i < slots; i++)
+        if (slot(position + i).mSequence.load(std::memory_order_acquire) != position + i + 1)
+            return false;
+
+    tag = first.mTag;
+    record.clear();
+    for (size_t i = 0; i < slots; i++)
+    {
+        Slot & current = slot(position + i);
+        record.append(current.mData, current.mSize);
+        current.mSequence.store(position + i + mMask + 1, std::memory_order_release);
+    }
+    mDequeuePosition.store(position + slots, std::memory_order_relaxed);
+
+    return true;
+}
+
+bool LogRing::empty() const
+{
+    return mDequeuePosition.load(std::memory_order_relaxed) ==
+                                mEnqueuePosition.load(std::memory_order_relaxed);
+}
@@ -17,11 +17,18 @@
 #include <unistd.h>
 #include "log.h"
 #include "ConstString.h"
+#include "LogRing.h"
 #include "PmLogLib.h"
 #include <cstdio>
 #include <cerrno>
 #include <time.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <limits.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <map>
 
 
@@ -47,19 +54,33 @@ static const char *        sProcessName = "unnamed";
 
 static PmLogContext gLogContext = 0;
 
+std::atomic<int>          gLogLevelGate(G_LOG_LEVEL_MESSAGE);
+static std::atomic<bool>  sLogIndentEnabled(false);
+
+// what the macros test, so that they match what logFilter would drop
+static void updateLogGate()
+{
+    gLogLevelGate = sLogDestination == eLogDestination_None ? 0 : (int) sLogLevel;
+    sLogIndentEnabled = (sLogDestination & (eLogDestination_PrivateLogFiles |
+                                            eLogDestination_Terminal)) != 0;
+}
+
 void setLogDestination(ELogDestination logDestination)
 {
     sLogDestination = logDestination;
+    updateLogGate();
 }
 
 void addLogDestination(ELogDestination logDestination)
 {
     sLogDestination = (ELogDestination) (sLogDestination | logDestination);
+    updateLogGate();
 }
 
 void setLogLevel(GLogLevelFlags level)
 {
     sLogLevel = level;
+    updateLogGate();
 }
 
 GLogLevelFlags getLogLevel (void)
@@ -112,7 +133,257 @@ static const char * logLevelName(GLogLevelFlags logLevel)
     return name;
 }
 
-static GStaticMutex slogFilter_mutex = G_STATIC_MUTEX_INIT;
+// Terminal & private file output is asynchronous: logFilter formats the line &
+// queues it in a lock-free ring, and a writer thread writes batches of lines.
+// When the ring is full, lines are dropped & counted rather than blocking
+// the caller. Fatal messages are written before logFilter returns.
+
+// slots of LogRing::cSlotDataSize bytes
+#define LOG_RING_SLOTS              4096
+// lines written by one writev
+#define LOG_WRITER_BATCH            64
+// the private log file is rotated when it gets bigger than this
+#define LOG_FILE_MAX_SIZE           (8 * 1024 * 1024)
+#define LOG_FILE_ROTATIONS          5
+
+#define COLORESCAPE        "\033["
+
+#define RESETCOLOR        COLORESCAPE "0m"
+
+#define BOLDCOLOR        COLORESCAPE "1m"
+#define REDOVERBLACK    COLORESCAPE "1;31m"
+#define BLUEOVERBLACK    COLORESCAPE "1;34m"
+#define YELLOWOVERBLACK    COLORESCAPE "1;33m"
+
+// what precedes the text of a line queued in the ring
+struct LogLineHeader
+{
+    uint16_t    mStampSize;     // time stamp, then indent
+    uint16_t    mIndentSize;
+};
+
+static pthread_once_t           sLogWriterOnce = PTHREAD_ONCE_INIT;
+static LogRing *                sLogRing = 0;
+static int                      sLogWakeFd = -1;
+static std::atomic<bool>        sLogWriterSleeping(false);
+static std::atomic<bool>        sLogWriterBusy(false);
+static struct timespec          sLogStartSeconds = { 0 };
+static struct tm                sLogStartTime = { 0 };
+static char                     sLogStartTimeText[64];
+
+static struct iovec makePart(const void * data, size_t size)
+{
+    struct iovec part = { (void *) data, size };
+    return part;
+}
+
+/// Write all the parts, resuming after short writes. The parts are consumed.
+// Returns how many bytes were written, which is less than asked on error.
+static off_t writeAll(int fd, struct iovec * iov, int count)
+{
+    off_t total = 0;
+    while (count > 0)
+    {
+        int batch = count < IOV_MAX ? count : IOV_MAX;
+        ssize_t written = ::writev(fd, iov, batch);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (written == 0 && iov->iov_len > 0)
+            break;
+        total += written;
+        // skip what was written, even if it ends in the middle of a part
+        while (count > 0 && (size_t) written >= iov->iov_len)
+        {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = (char *) iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    return total;
+}
+
+static int openLogFile(bool rotate)
+{
+    std::string    baseName = string_printf("/var/log/%s.log", sProcessName);
+    if (rotate)
+        sMoveLogFile(baseName.c_str(), LOG_FILE_ROTATIONS);
+    return ::open(baseName.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0644);
+}
+
+static const char * terminalColor(char levelName)
+{
+    switch (levelName)
+    {
+        case 'd':   return "";
+        case 'w':   return YELLOWOVERBLACK;
+        case 'm':   return BLUEOVERBLACK;
+        default:    return g_ascii_isupper(levelName) ? REDOVERBLACK : BOLDCOLOR;
+    }
+}
+
+static void * logWriterThread(void * data)
+{
+    int         logFile = -1;
+    off_t       logFileSize = 0;
+    std::string lines[LOG_WRITER_BATCH];
+    unsigned char levels[LOG_WRITER_BATCH];
+    struct iovec fileParts[LOG_WRITER_BATCH + 1];
+    struct iovec terminalParts[(LOG_WRITER_BATCH + 1) * 7];
+    char        pidText[32];
+    size_t      pidSize = ::snprintf(pidText, sizeof(pidText), "(%d) ", getpid());
+    char        droppedText[96];
+
+    // rotation used to happen with the first message: now it's done here
+    if (sLogDestination & eLogDestination_PrivateLogFiles)
+    {
+        logFile = openLogFile(true);
+        if (logFile >= 0)
+        {
+            struct iovec start = makePart(sLogStartTimeText, ::strlen(sLogStartTimeText));
+            logFileSize = writeAll(logFile, &start, 1);
+        }
+    }
+    if (sLogDestination & eLogDestination_Terminal)
+    {
+        struct iovec start = makePart(sLogStartTimeText, ::strlen(sLogStartTimeText));
+        writeAll(STDOUT_FILENO, &start, 1);
+    }
+
+    for (;;)
+    {
+        sLogWriterBusy = true;
+        int count = 0;
+        while (count < LOG_WRITER_BATCH && sLogRing->pop(levels[count], lines[count]))
+            count++;
+
+        if (count == 0)
+        {
+            sLogWriterSleeping = true;
+            sLogWriterBusy = false;
+            // a producer may have pushed before seeing us sleeping: check again
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sLogRing->empty())
+            {
+                struct pollfd wake = { sLogWakeFd, POLLIN, 0 };
+                if (::poll(&wake, 1, -1) > 0)
+                {
+                    uint64_t value;
+                    ::read(sLogWakeFd, &value, sizeof(value));
+                }
+            }
+            sLogWriterSleeping = false;
+            continue;
+        }
+
+        int fileCount = 0, terminalCount = 0;
+        unsigned long dropped = sLogRing->takeDropped();
+        if (dropped > 0)
+        {
+            size_t size = ::snprintf(droppedText, sizeof(droppedText),
+                                     "*** %lu log messages dropped ***\n", dropped);
+            fileParts[fileCount++] = makePart(droppedText, size);
+            terminalParts[terminalCount++] = makePart(droppedText, size);
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            const std::string & line = lines[i];
+            LogLineHeader header;
+            if (line.size() < sizeof(header))
+                continue;
+            ::memcpy(&header, line.data(), sizeof(header));
+            const char * stamp = line.data() + sizeof(header);
+            size_t textSize = line.size() - sizeof(header);
+            if (header.mStampSize > textSize || header.mIndentSize > header.mStampSize)
+                continue;
+            fileParts[fileCount++] = makePart(stamp, textSize);
+
+            // terminal: color, time stamp & indent, pid, indent again, message, reset
+            const char * color = terminalColor(levels[i]);
+            size_t colorSize = ::strlen(color);
+            const char * message = stamp + header.mStampSize;
+            size_t messageSize = textSize - header.mStampSize;
+            if (colorSize)
+                terminalParts[terminalCount++] = makePart(color, colorSize);
+            terminalParts[terminalCount++] = makePart(stamp, header.mStampSize);
+            terminalParts[terminalCount++] = makePart(pidText, pidSize);
+            terminalParts[terminalCount++] = makePart((message - header.mIndentSize),
+                                                              header.mIndentSize);
+            if (colorSize && messageSize > 0 && message[messageSize - 1] == '\n')
+            {
+                terminalParts[terminalCount++] = makePart(message, messageSize - 1);
+                terminalParts[terminalCount++] = makePart(RESETCOLOR "\n",
+                                                                  sizeof(RESETCOLOR "\n") - 1);
+            }
+            else
+            {
+                terminalParts[terminalCount++] = makePart(message, messageSize);
+                if (colorSize)
+                    terminalParts[terminalCount++] = makePart(RESETCOLOR,
+                                                                      sizeof(RESETCOLOR) - 1);
+            }
+        }
+
+        if (logFile >= 0)
+            logFileSize += writeAll(logFile, fileParts, fileCount);
+        if (sLogDestination & eLogDestination_Terminal)
+            writeAll(STDOUT_FILENO, terminalParts, terminalCount);
+
+        if (logFile >= 0 && logFileSize > LOG_FILE_MAX_SIZE)
+        {
+            ::close(logFile);
+            logFile = openLogFile(true);
+            logFileSize = 0;
+        }
+    }
+
+    return NULL;
+}
+
+static void flushLogs()
+{
+    // bounded wait: a stuck writer must not hang the process
+    for (int i = 0; i < 1000 && sLogRing && (!sLogRing->empty() || sLogWriterBusy); i++)
+    {
+        struct timespec delay = { 0, 1000000 };
+        ::nanosleep(&delay, NULL);
+    }
+}
+
+static void startLogWriter()
+{
+    time_t now = ::time(0);
+    ::clock_gettime(CLOCK_MONOTONIC, &sLogStartSeconds);
+    ::localtime_r(&now, &sLogStartTime);
+    ::asctime_r(&sLogStartTime, sLogStartTimeText);
+
+    sLogWakeFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    sLogRing = new LogRing(LOG_RING_SLOTS);
+
+    pthread_t thread;
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    if (sLogWakeFd < 0 || ::pthread_create(&thread, &attributes, logWriterThread, NULL) != 0)
+    {
+        delete sLogRing;
+        sLogRing = 0;
+    }
+    pthread_attr_destroy(&attributes);
+
+    // don't lose the last lines when exiting
+    if (sLogRing)
+        ::atexit(flushLogs);
+}
 
 void logFilter(const gchar *log_domain, GLogLevelFlags log_level, const gchar *message, gpointer unused_data)
 {
@@ -148,42 +419,11 @@ void logFilter(const gchar *log_domain, GLogLevelFlags log_level, const gchar *m
 
     if (sLogDestination & (eLogDestination_PrivateLogFiles | eLogDestination_Terminal))
     {
-        GStaticMutexLocker            lock(slogFilter_mutex);    // race protection only needed for terminal and file logging
+        ::pthread_once(&sLogWriterOnce, startLogWriter);
+        if (!sLogRing)
+            return;
 
-        static int                     sLogFile = 0;
-        static struct timespec        sLogStartSeconds = { 0 };
-        static struct tm            sLogStartTime = { 0 };
         const char *                indent = LogIndent::getTotalIndent();
-        if (sLogFile == 0)
-        {
-            std::string    baseName = string_printf("/var/log/%s.log", sProcessName);
-            sMoveLogFile(baseName.c_str(), 5);
-            if (sLogDestination & eLogDestination_PrivateLogFiles)
-                sLogFile = ::open(baseName.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_NONBLOCK, 0644);
-            else
-                sLogFile = -1;    // don't log to private log file
-            time_t now = ::time(0);
-            ::clock_gettime(CLOCK_MONOTONIC, &sLogStartSeconds);
-            ::localtime_r(&now, &sLogStartTime);
-            char startTime[64];
-            ::asctime_r(&sLogStartTime, startTime);
-            if (sLogDestination & eLogDestination_PrivateLogFiles)
-            {
-                if (sLogFile > 0)
-                {
-                    ::write(sLogFile, startTime, ::strlen(startTime));
-                    std::string    msg;
-                    msg = string_printf("Logging to private log file '%s' at %s", baseName.c_str(), startTime);
-                }
-                else
-                {
-                    std::string    msg;
-                    msg = string_printf("Unable to log to private log file '%s' at %s", baseName.c_str(), startTime);
-                }
-            }
-             if (sLogDestination & eLogDestination_Terminal)
-                ::fprintf(stdout, "%s", startTime);
-        }
         struct timespec now;
         ::clock_gettime(CLOCK_MONOTONIC, &now);
         int ms = (now.tv_nsec - sLogStartSeconds.tv_nsec) / 1000000;
@@ -206,70 +446,29 @@ void logFilter(const gchar *log_domain, GLogLevelFlags log_level, const gchar *m
             len = G_N_ELEMENTS(timeStamp) - 1;
             timeStamp[len] = 0;
         }
-        if (sLogFile > 0)
-            ::write(sLogFile, timeStamp, len);
-        len = ::strlen(indent);
-        if (len > 0 && sLogFile > 0)
-            ::write(sLogFile, indent, len);
-        len = ::strlen(message);
-        if (sLogFile > 0)
-            ::write(sLogFile, message, len);
-        bool    needLF = false;
-        if (len < 1 || message[len - 1] != '\n')
+        size_t indentLen = ::strlen(indent);
+        size_t messageLen = ::strlen(message);
+
+        LogLineHeader header = { (uint16_t) (len + indentLen), (uint16_t) indentLen };
+        struct iovec parts[] = {
+            { &header, sizeof(header) },
+            { timeStamp, len },
+            { (void *) indent, indentLen },
+            { (void *) message, messageLen },
+            { (void *) "\n", (size_t) (message[messageLen - 1] != '\n') }
+        };
+        sLogRing->push(levelName, parts, G_N_ELEMENTS(parts));
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sLogWriterSleeping.exchange(false))
         {
-            needLF = true;
-            if (sLogFile > 0)
-                ::write(sLogFile, "\n", 1);
+            uint64_t one = 1;
+            ::write(sLogWakeFd, &one, sizeof(one));
         }
-        if (sLogDestination & eLogDestination_Terminal)
-        {
-
-#define COLORESCAPE        "\033["
-
-#define RESETCOLOR        COLORESCAPE "0m"
-
-#define BOLDCOLOR        COLORESCAPE "1m"
-#define REDOVERBLACK    COLORESCAPE "1;31m"
-#define BLUEOVERBLACK    COLORESCAPE "1;34m"
-#define YELLOWOVERBLACK    COLORESCAPE "1;33m"
 
-            if (levelName ==  'd')
-            {
-                if (needLF)
-                    ::fprintf(stdout, "%s%s(%d) %s%s\n", timeStamp, indent, getpid(), indent, message);
-                else
-                    ::fprintf(stdout, "%s%s(%d) %s%s", timeStamp, indent, getpid(), indent, message);
-            }
-            else if (levelName ==  'w')
-            {
-                if (needLF)
-                    ::fprintf(stdout, YELLOWOVERBLACK "%s%s(%d) %s%s" RESETCOLOR "\n", timeStamp, indent, getpid(), indent, message);
-                else
-                    ::fprintf(stdout, YELLOWOVERBLACK "%s%s(%d) %s%s" RESETCOLOR, timeStamp, indent, getpid(), indent, message);
-            }
-            else if (levelName ==  'm')
-            {
-                if (needLF)
-                    ::fprintf(stdout, BLUEOVERBLACK "%s%s(%d) %s%s" RESETCOLOR "\n", timeStamp, indent, getpid(), indent, message);
-                else
-                    ::fprintf(stdout, BLUEOVERBLACK "%s%s(%d) %s%s" RESETCOLOR, timeStamp, indent, getpid(), indent, message);
-            }
-            else if (g_ascii_isupper(levelName))
-            {
-                if (needLF)
-                    ::fprintf(stdout, REDOVERBLACK "%s%s(%d) %s%s" RESETCOLOR "\n", timeStamp, indent, getpid(), indent, message);
-                else
-                    ::fprintf(stdout, REDOVERBLACK "%s%s(%d) %s%s" RESETCOLOR, timeStamp, indent, getpid(), indent, message);
-            }
-            else
-            {
-                if (needLF)
-                    ::fprintf(stdout, BOLDCOLOR "%s%s(%d) %s%s" RESETCOLOR "\n", timeStamp, indent, getpid(), indent, message);
-                else
-                    ::fprintf(stdout, BOLDCOLOR "%s%s(%d) %s%s" RESETCOLOR, timeStamp, indent, getpid(), indent, message);
-            }
-            ::fflush(stdout);
-        }
+        // the process is about to abort: get this one out first
+        if (log_level & (G_LOG_FLAG_FATAL | G_LOG_LEVEL_ERROR))
+            flushLogs();
     }
 }
 
@@ -423,16 +622,19 @@ void logCheck(const gchar * test, const gchar * file, int line, const gchar * fu
     log_and_filter(G_LOG_LEVEL_WARNING, "Failed check", test, "is false ", function, file, line);
 }
 
-static std::string sLogIndent;
+// per thread: threads other than the main loop's (the stall watchdog...) log too
+static thread_local std::string sLogIndent;
 
-LogIndent::LogIndent(const char * indent) : mIndent(indent)
+LogIndent::LogIndent(const char * indent) : mIndent(sLogIndentEnabled ? indent : 0)
 {
-    sLogIndent += indent;
+    if (mIndent)
+        sLogIndent += mIndent;
 }
 
 LogIndent::~LogIndent()
 {
-    sLogIndent.resize(sLogIndent.size() - ::strlen(mIndent));
+    if (mIndent)
+        sLogIndent.resize(sLogIndent.size() - ::strlen(mIndent));
 }
 
 const char * LogIndent::getTotalIndent()